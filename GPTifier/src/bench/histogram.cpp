@@ -0,0 +1,124 @@
+#include "histogram.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <stdexcept>
+
+namespace bench {
+
+namespace {
+
+// Each power of two range is split into 1024 linear sub-buckets, which bounds the relative error to 2^-10
+const int SUB_BUCKET_BITS = 11;
+const std::uint64_t SUB_BUCKET_COUNT = std::uint64_t(1) << SUB_BUCKET_BITS;
+const std::uint64_t SUB_BUCKET_HALF = SUB_BUCKET_COUNT / 2;
+
+// Larger values are clamped. In microseconds this is almost two weeks
+const int MAX_VALUE_BITS = 40;
+const std::uint64_t MAX_VALUE = (std::uint64_t(1) << MAX_VALUE_BITS) - 1;
+
+const std::size_t NUM_BUCKETS = SUB_BUCKET_COUNT + (MAX_VALUE_BITS - SUB_BUCKET_BITS) * SUB_BUCKET_HALF;
+
+std::size_t get_index_(const std::uint64_t value)
+{
+    if (value < SUB_BUCKET_COUNT) {
+        return value;
+    }
+
+    const int shift = std::bit_width(value) - SUB_BUCKET_BITS;
+    return SUB_BUCKET_COUNT + (shift - 1) * SUB_BUCKET_HALF + ((value >> shift) - SUB_BUCKET_HALF);
+}
+
+std::uint64_t get_highest_equivalent_value_(const std::size_t index)
+{
+    if (index < SUB_BUCKET_COUNT) {
+        return index;
+    }
+
+    const std::size_t offset = index - SUB_BUCKET_COUNT;
+    const int shift = offset / SUB_BUCKET_HALF + 1;
+    const std::uint64_t sub_bucket = offset % SUB_BUCKET_HALF + SUB_BUCKET_HALF;
+
+    return ((sub_bucket + 1) << shift) - 1;
+}
+
+} // namespace
+
+Histogram::Histogram() :
+    counts_(NUM_BUCKETS, 0)
+{
+}
+
+void Histogram::record(std::uint64_t value)
+{
+    value = std::min(value, MAX_VALUE);
+
+    this->counts_[get_index_(value)]++;
+    this->min_ = this->count_ == 0 ? value : std::min(this->min_, value);
+    this->max_ = std::max(this->max_, value);
+    this->sum_ += value;
+    this->count_++;
+}
+
+void Histogram::merge(const Histogram &other)
+{
+    if (other.count_ == 0) {
+        return;
+    }
+
+    for (std::size_t i = 0; i < NUM_BUCKETS; ++i) {
+        this->counts_[i] += other.counts_[i];
+    }
+
+    this->min_ = this->count_ == 0 ? other.min_ : std::min(this->min_, other.min_);
+    this->max_ = std::max(this->max_, other.max_);
+    this->sum_ += other.sum_;
+    this->count_ += other.count_;
+}
+
+std::uint64_t Histogram::get_count() const
+{
+    return this->count_;
+}
+
+std::uint64_t Histogram::get_max() const
+{
+    return this->max_;
+}
+
+std::uint64_t Histogram::get_min() const
+{
+    return this->min_;
+}
+
+double Histogram::get_mean() const
+{
+    return this->count_ == 0 ? 0.0 : this->sum_ / this->count_;
+}
+
+std::uint64_t Histogram::get_percentile(const double percentile) const
+{
+    if (percentile < 0.0 or percentile > 100.0) {
+        throw std::runtime_error("Percentile must be between 0 and 100");
+    }
+
+    if (this->count_ == 0) {
+        return 0;
+    }
+
+    const std::uint64_t rank = std::max<std::uint64_t>(1, std::ceil(percentile / 100.0 * this->count_));
+    std::uint64_t seen = 0;
+
+    for (std::size_t i = 0; i < NUM_BUCKETS; ++i) {
+        seen += this->counts_[i];
+
+        if (seen >= rank) {
+            return std::min(get_highest_equivalent_value_(i), this->max_);
+        }
+    }
+
+    return this->max_;
+}
+
+} // namespace bench
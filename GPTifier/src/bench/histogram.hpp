@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace bench {
+
+// A log-linear histogram in the spirit of HdrHistogram. Values are recorded with a relative error below
+// 0.1% in constant memory regardless of how many values are recorded, and histograms filled on different
+// threads can be merged
+class Histogram {
+public:
+    Histogram();
+
+    void record(std::uint64_t value);
+    void merge(const Histogram &other);
+
+    std::uint64_t get_count() const;
+    std::uint64_t get_max() const;
+    std::uint64_t get_min() const;
+    double get_mean() const;
+
+    // The highest value that `percentile` percent of all recorded values are at most equivalent to
+    std::uint64_t get_percentile(const double percentile) const;
+
+private:
+    std::vector<std::uint64_t> counts_;
+    std::uint64_t count_ = 0;
+    std::uint64_t max_ = 0;
+    std::uint64_t min_ = 0;
+    double sum_ = 0.0;
+};
+
+} // namespace bench
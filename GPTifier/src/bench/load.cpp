@@ -0,0 +1,101 @@
+#include "load.hpp"
+
+#include "parallel.hpp"
+
+#include <atomic>
+#include <exception>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace bench {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+void send_request_(LoadReport &report, const std::function<Usage()> &request, const Clock::time_point since)
+{
+    report.num_requests++;
+
+    try {
+        const Usage usage = request();
+        const auto latency = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - since);
+
+        report.latencies.record(latency.count());
+        report.usage.input_tokens += usage.input_tokens;
+        report.usage.output_tokens += usage.output_tokens;
+    } catch (const std::exception &e) {
+        // I.e. a malformed response can surface as a JSON exception rather than as a runtime error
+        report.num_errors++;
+        report.errors[e.what()]++;
+    }
+}
+
+} // namespace
+
+LoadReport run_load(const LoadOptions &options, const std::function<Usage()> &request)
+{
+    if (options.concurrency < 1) {
+        throw std::runtime_error("Concurrency must be a positive number");
+    }
+
+    if (options.rate < 0.0) {
+        throw std::runtime_error("Rate must not be negative");
+    }
+
+    if (options.duration.count() <= 0.0) {
+        throw std::runtime_error("Duration must be positive");
+    }
+
+    // Each worker fills its own report so that recording needs no synchronization
+    std::vector<LoadReport> workers(options.concurrency);
+    std::atomic<std::size_t> next_request = 0;
+
+    const auto start = Clock::now();
+    const auto deadline = start + std::chrono::duration_cast<Clock::duration>(options.duration);
+
+    parallel::for_each_index(workers.size(), workers.size(), [&](const std::size_t w) {
+        LoadReport &worker = workers[w];
+
+        if (options.rate == 0.0) {
+            while (Clock::now() < deadline) {
+                send_request_(worker, request, Clock::now());
+            }
+            return;
+        }
+
+        // Latency is measured from when a request was due rather than from when it was sent. Otherwise a
+        // backend that falls behind would also slow down the rate of requests and hide its own queueing delay
+        while (true) {
+            const auto offset = std::chrono::duration<double>(next_request.fetch_add(1) / options.rate);
+            const auto due = start + std::chrono::duration_cast<Clock::duration>(offset);
+
+            if (due >= deadline) {
+                break;
+            }
+
+            std::this_thread::sleep_until(due);
+            send_request_(worker, request, due);
+        }
+    });
+
+    LoadReport report;
+    report.elapsed = Clock::now() - start;
+
+    for (const LoadReport &worker: workers) {
+        report.latencies.merge(worker.latencies);
+        report.num_errors += worker.num_errors;
+        report.num_requests += worker.num_requests;
+        report.usage.input_tokens += worker.usage.input_tokens;
+        report.usage.output_tokens += worker.usage.output_tokens;
+
+        for (const auto &[error, count]: worker.errors) {
+            report.errors[error] += count;
+        }
+    }
+
+    return report;
+}
+
+} // namespace bench
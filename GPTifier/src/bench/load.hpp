@@ -0,0 +1,41 @@
+#pragma once
+
+#include "histogram.hpp"
+
+#include <chrono>
+#include <functional>
+#include <map>
+#include <string>
+
+namespace bench {
+
+struct LoadOptions {
+    // Requests in flight at once. Without a rate, each worker sends its next request as soon as the previous
+    // one returns (a closed loop)
+    int concurrency = 1;
+
+    // Requests started per second regardless of how quickly responses come back (an open loop). Zero for a
+    // closed loop
+    double rate = 0.0;
+
+    std::chrono::duration<double> duration = std::chrono::seconds(10);
+};
+
+struct Usage {
+    long input_tokens = 0;
+    long output_tokens = 0;
+};
+
+struct LoadReport {
+    Histogram latencies; // In microseconds, of successful requests only
+    Usage usage;
+    std::chrono::duration<double> elapsed;
+    std::map<std::string, std::size_t> errors;
+    std::size_t num_errors = 0;
+    std::size_t num_requests = 0;
+};
+
+// Call `request` under the requested load for the requested duration. A request fails by throwing
+LoadReport run_load(const LoadOptions &options, const std::function<Usage()> &request);
+
+} // namespace bench
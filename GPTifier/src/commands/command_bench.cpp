@@ -0,0 +1,296 @@
+#include "command_bench.hpp"
+
+#include "configs.hpp"
+#include "datadir.hpp"
+#include "embeddings.hpp"
+#include "load.hpp"
+#include "responses.hpp"
+#include "single_flight.hpp"
+#include "utils.hpp"
+
+#include <fmt/core.h>
+#include <getopt.h>
+#include <json.hpp>
+#include <optional>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+void help_bench_()
+{
+    const std::string messages = R"(Measure how a backend behaves under load by sending the same prompt (or
+embedding request) over and over for a while. Reports latency percentiles, throughput, tokens per second
+and errors.
+
+Usage:
+  gpt bench [OPTIONS] [PROMPT]
+
+Options:
+  -h, --help                 Print help information and exit
+  -l, --use-local            Connect to locally hosted LLM as opposed to OpenAI
+  -m, --model=MODEL          Select model
+  -e, --embed                Request embeddings as opposed to responses
+  -c, --concurrency=N        Keep up to N requests in flight at once (default 1)
+  -r, --rate=RPS             Start RPS requests per second regardless of how quickly responses come
+                             back, with up to N (see -c) in flight. Latency is then measured from when
+                             each request was due. By default, each of the N workers sends its next
+                             request as soon as the previous one returns
+  -d, --duration=SECONDS     Send requests for SECONDS seconds (default 10)
+  -u, --url=URL              Send requests to URL (i.e. a local stand-in) as opposed to the base URL
+                             of OpenAI or Ollama in the configuration file
+  -o, --output=FILE          Export the report to FILE (default ~/.gptifier/bench.gpt)
+
+Examples:
+  > Send 4 requests at a time to Ollama for 30 seconds:
+    $ gpt bench --use-local --concurrency=4 --duration=30
+  > Request 20 embeddings per second from a local stand-in for OpenAI:
+    $ gpt bench --embed --rate=20 --concurrency=32 --url=http://localhost:8080/v1
+)";
+
+    fmt::print("{}\n", messages);
+}
+
+struct Parameters {
+    bool embed = false;
+    bool use_local = false;
+    std::optional<std::string> concurrency;
+    std::optional<std::string> duration;
+    std::optional<std::string> model;
+    std::optional<std::string> output_file;
+    std::optional<std::string> rate;
+    std::optional<std::string> url;
+    std::string prompt = "What is 2 + 2?";
+};
+
+Parameters read_cli_(const int argc, char **argv)
+{
+    Parameters params;
+
+    while (true) {
+        static struct option long_options[] = {
+            { "help", no_argument, 0, 'h' },
+            { "use-local", no_argument, 0, 'l' },
+            { "model", required_argument, 0, 'm' },
+            { "embed", no_argument, 0, 'e' },
+            { "concurrency", required_argument, 0, 'c' },
+            { "rate", required_argument, 0, 'r' },
+            { "duration", required_argument, 0, 'd' },
+            { "url", required_argument, 0, 'u' },
+            { "output", required_argument, 0, 'o' },
+            { 0, 0, 0, 0 },
+        };
+
+        int option_index = 0;
+        const int c = getopt_long(argc, argv, "hlm:ec:r:d:u:o:", long_options, &option_index);
+
+        if (c == -1) {
+            break;
+        }
+
+        switch (c) {
+            case 'h':
+                help_bench_();
+                exit(EXIT_SUCCESS);
+            case 'l':
+                params.use_local = true;
+                break;
+            case 'm':
+                params.model = optarg;
+                break;
+            case 'e':
+                params.embed = true;
+                break;
+            case 'c':
+                params.concurrency = optarg;
+                break;
+            case 'r':
+                params.rate = optarg;
+                break;
+            case 'd':
+                params.duration = optarg;
+                break;
+            case 'u':
+                params.url = optarg;
+                break;
+            case 'o':
+                params.output_file = optarg;
+                break;
+            default:
+                utils::exit_on_failure();
+        }
+    }
+
+    for (int i = optind; i < argc; i++) {
+        if (strcmp("bench", argv[i]) != 0) {
+            params.prompt = argv[i];
+            break;
+        }
+    }
+
+    if (params.prompt.empty()) {
+        throw std::runtime_error("Prompt is empty");
+    }
+
+    return params;
+}
+
+bench::LoadOptions get_load_options_(const Parameters &params)
+{
+    bench::LoadOptions options;
+
+    if (params.concurrency) {
+        options.concurrency = utils::string_to_int(params.concurrency.value());
+    }
+
+    if (params.rate) {
+        options.rate = utils::string_to_float(params.rate.value());
+    }
+
+    if (params.duration) {
+        options.duration = std::chrono::duration<double>(utils::string_to_float(params.duration.value()));
+    }
+
+    return options;
+}
+
+std::string get_model_(const Parameters &params)
+{
+    if (params.model) {
+        return params.model.value();
+    }
+
+    if (params.embed) {
+        return params.use_local ? configs.model_embed_ollama.value() : configs.model_embed_openai.value();
+    }
+
+    return params.use_local ? configs.model_short_ollama.value() : configs.model_short_openai.value();
+}
+
+bench::Usage send_request_(const Parameters &params, const std::string &model)
+{
+    bench::Usage usage;
+
+    if (params.embed) {
+        // Embedding endpoints do not all report usage so estimate it instead
+        if (params.use_local) {
+            serialization::create_ollama_embedding(model, params.prompt, 0);
+        } else {
+            serialization::create_openai_embedding(model, params.prompt, 0);
+        }
+
+        usage.input_tokens = utils::estimate_token_count(params.prompt);
+        return usage;
+    }
+
+    serialization::Response response;
+
+    if (params.use_local) {
+        response = serialization::create_ollama_response(params.prompt, model);
+    } else {
+        response = serialization::create_openai_response(params.prompt, model, 1.0);
+    }
+
+    usage.input_tokens = response.input_tokens;
+    usage.output_tokens = response.output_tokens;
+    return usage;
+}
+
+double to_milliseconds_(const std::uint64_t microseconds)
+{
+    return microseconds / 1000.0;
+}
+
+void print_report_(const bench::LoadReport &report)
+{
+    const double elapsed = report.elapsed.count();
+    const bench::Histogram &latencies = report.latencies;
+
+    fmt::print("Requests: {} in {:.2f} s ({} errors)\n", report.num_requests, elapsed, report.num_errors);
+    fmt::print("Throughput: {:.2f} successful requests/s\n", latencies.get_count() / elapsed);
+    fmt::print("Tokens: {} input, {} output ({:.1f} output tokens/s)\n",
+        report.usage.input_tokens, report.usage.output_tokens, report.usage.output_tokens / elapsed);
+    fmt::print("Latency (ms): p50 {:.2f}, p90 {:.2f}, p99 {:.2f}, max {:.2f}\n",
+        to_milliseconds_(latencies.get_percentile(50)), to_milliseconds_(latencies.get_percentile(90)),
+        to_milliseconds_(latencies.get_percentile(99)), to_milliseconds_(latencies.get_max()));
+
+    for (const auto &[error, count]: report.errors) {
+        fmt::print("Error: {} x {}\n", count, error);
+    }
+}
+
+void export_report_(const Parameters &params, const std::string &model, const bench::LoadOptions &options, const bench::LoadReport &report)
+{
+    const double elapsed = report.elapsed.count();
+    const bench::Histogram &latencies = report.latencies;
+
+    nlohmann::json percentiles = nlohmann::json::object();
+
+    for (const double percentile: { 50.0, 75.0, 90.0, 95.0, 99.0, 99.9 }) {
+        percentiles[fmt::format("p{}", percentile)] = to_milliseconds_(latencies.get_percentile(percentile));
+    }
+
+    const nlohmann::json latency = {
+        { "max", to_milliseconds_(latencies.get_max()) },
+        { "mean", latencies.get_mean() / 1000.0 },
+        { "min", to_milliseconds_(latencies.get_min()) },
+        { "percentiles", percentiles },
+    };
+
+    const nlohmann::json json = {
+        { "concurrency", options.concurrency },
+        { "duration", elapsed },
+        { "errors", report.errors },
+        { "input_tokens", report.usage.input_tokens },
+        { "latency_ms", latency },
+        { "model", model },
+        { "num_errors", report.num_errors },
+        { "num_requests", report.num_requests },
+        { "output_tokens", report.usage.output_tokens },
+        { "output_tokens_per_second", report.usage.output_tokens / elapsed },
+        { "rate", options.rate },
+        { "requests_per_second", latencies.get_count() / elapsed },
+        { "source", params.use_local ? "Ollama" : "OpenAI" },
+        { "workload", params.embed ? "embed" : "prompt" },
+    };
+
+    const std::string filename = params.output_file.value_or(datadir::GPT_BENCH.string());
+    fmt::print("Dumping report to '{}'\n", filename);
+    utils::write_to_file(filename, json.dump(2));
+}
+
+} // namespace
+
+namespace commands {
+
+void command_bench(const int argc, char **argv)
+{
+    const Parameters params = read_cli_(argc, argv);
+    const bench::LoadOptions options = get_load_options_(params);
+    const std::string model = get_model_(params);
+
+    if (params.url) {
+        if (params.use_local) {
+            configs.base_url_ollama = params.url.value();
+        } else {
+            configs.base_url_openai = params.url.value();
+        }
+    }
+
+    // Identical requests are normally coalesced, which would defeat the point of generating load
+    networking::set_single_flight(false);
+
+    fmt::print("Sending requests to {} ({}) for {:.1f} s\n", params.use_local ? "Ollama" : "OpenAI", model, options.duration.count());
+
+    const bench::LoadReport report = bench::run_load(options, [&]() {
+        return send_request_(params, model);
+    });
+
+    utils::separator();
+    print_report_(report);
+    utils::separator();
+
+    export_report_(params, model, options, report);
+}
+
+} // namespace commands
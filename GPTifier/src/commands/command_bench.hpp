@@ -0,0 +1,5 @@
+#pragma once
+
+namespace commands {
+void command_bench(const int argc, char **argv);
+}
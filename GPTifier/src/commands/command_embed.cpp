@@ -1,10 +1,22 @@
 #include "command_embed.hpp"
 
+#include "chunking.hpp"
+#include "cluster.hpp"
 #include "configs.hpp"
 #include "datadir.hpp"
+#include "dedupe.hpp"
+#include "embedder.hpp"
 #include "embeddings.hpp"
+#include "ingest.hpp"
+#include "search.hpp"
+#include "store.hpp"
 #include "utils.hpp"
+#include "watch.hpp"
 
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <filesystem>
 #include <fmt/core.h>
 #include <getopt.h>
 #include <iostream>
@@ -12,6 +24,8 @@
 #include <optional>
 #include <stdexcept>
 #include <string>
+#include <thread>
+#include <vector>
 
 namespace {
 
@@ -23,6 +37,14 @@ program via file (see --read-from-file).
 
 Usage:
   gpt embed [OPTIONS]
+  gpt embed COMMAND [ARGS]...
+
+Commands:
+  cluster  Group the chunks of a persistent store with k-means
+  dedupe   Find near duplicate chunks in a persistent store
+  ingest   Embed a directory tree into a persistent store
+  search   Search a persistent store
+  watch    Keep a persistent store in sync with a directory tree
 
 Options:
   -h, --help                     Print help information and exit
@@ -31,6 +53,169 @@ Options:
   -i, --input=TEXT               Input text to embed
   -r, --read-from-file=FILENAME  Read input text to embed from a file
   -o, --output-file=FILENAME     Export embedding to FILENAME
+  -c, --chunk-size=TOKENS        Split the input into chunks of roughly TOKENS tokens and embed
+                                 each chunk separately. Chunks are split on paragraph, line or word
+                                 boundaries and fenced code blocks are kept together where possible
+  -w, --overlap=TOKENS           Overlap consecutive chunks by roughly TOKENS tokens (default 64)
+  -j, --jobs=JOBS                Send up to JOBS embedding requests concurrently (default 4)
+  -D, --dimensions=N             Shorten embeddings to N dimensions. Supported natively by OpenAI's
+                                 text-embedding-3 models. Ollama embeddings are truncated and
+                                 renormalized, which suits Matryoshka models such as nomic-embed-text
+
+Examples:
+  > Embed a large manual in chunks of 500 tokens:
+    $ gpt embed -r manual.md -c 500 -o manual.json
+  > Embed text into 256 dimensions:
+    $ gpt embed -i "Lorem ipsum" -m text-embedding-3-small -D 256
+)";
+
+    fmt::print("{}\n", messages);
+}
+
+void help_embed_ingest_()
+{
+    const std::string messages = R"(Embed every text file under a directory into a persistent store. Stores
+live under ~/.gptifier/stores. Re-running the command only re-embeds files whose
+contents changed since the last run and drops files that no longer exist.
+
+Usage:
+  gpt embed ingest [OPTIONS] DIR
+
+Options:
+  -h, --help               Print help information and exit
+  -s, --store=NAME         Ingest into store NAME (default "default")
+  -m, --model=MODEL        Specify a valid embedding model
+  -l, --use-local          Connect to locally hosted LLM as opposed to OpenAI
+  -c, --chunk-size=TOKENS  Split files into chunks of roughly TOKENS tokens (default 512)
+  -w, --overlap=TOKENS     Overlap consecutive chunks by roughly TOKENS tokens (default 64)
+  -j, --jobs=JOBS          Send up to JOBS embedding requests concurrently (default 4)
+  -x, --ignore=GLOB        Skip files and directories matching GLOB. Can be repeated.
+                           Version control directories are always skipped
+  -q, --quantize=KIND      Also store compressed vectors for faster searches. One of "int8",
+                           "binary", "pq" or "none" (default: keep the store's current setting)
+  -D, --dimensions=N       Shorten embeddings to N dimensions (see "gpt embed -h"). Stores
+                           remember this setting
+
+Examples:
+  > Index a repository while skipping build artifacts:
+    $ gpt embed ingest --store=myrepo -x build -x '*.o' ~/src/myrepo
+)";
+
+    fmt::print("{}\n", messages);
+}
+
+void help_embed_watch_()
+{
+    const std::string messages = R"(Keep a persistent store in sync with a directory tree. The tree is ingested
+once on startup and then watched for writes, creations, deletions and renames.
+Bursts of changes are coalesced and only changed chunks are re-embedded. The
+command runs until interrupted and uses no CPU while the tree is idle.
+
+Usage:
+  gpt embed watch [OPTIONS] DIR
+
+Options:
+  -h, --help               Print help information and exit
+  -s, --store=NAME         Sync store NAME (default "default")
+  -m, --model=MODEL        Specify a valid embedding model
+  -l, --use-local          Connect to locally hosted LLM as opposed to OpenAI
+  -c, --chunk-size=TOKENS  Split files into chunks of roughly TOKENS tokens (default 512)
+  -w, --overlap=TOKENS     Overlap consecutive chunks by roughly TOKENS tokens (default 64)
+  -j, --jobs=JOBS          Send up to JOBS embedding requests concurrently (default 4)
+  -x, --ignore=GLOB        Skip files and directories matching GLOB. Can be repeated.
+                           Version control directories are always skipped
+  -q, --quantize=KIND      Also store compressed vectors for faster searches. One of "int8",
+                           "binary", "pq" or "none" (default: keep the store's current setting)
+  -D, --dimensions=N       Shorten embeddings to N dimensions (see "gpt embed -h"). Stores
+                           remember this setting
+  -d, --debounce=MS        Wait until no changes were seen for MS milliseconds before
+                           updating the store (default 500)
+
+Examples:
+  > Keep a store of a working tree live in the background:
+    $ gpt embed watch --store=myrepo -x build ~/src/myrepo &
+)";
+
+    fmt::print("{}\n", messages);
+}
+
+void help_embed_search_()
+{
+    const std::string messages = R"(Search a persistent store built with "gpt embed ingest". By default, chunks
+are ranked both lexically (BM25) and by embedding similarity and the two
+rankings are merged. Lexical search works fully offline and is best suited
+for exact identifiers and error messages.
+
+Usage:
+  gpt embed search [OPTIONS] QUERY
+
+Options:
+  -h, --help         Print help information and exit
+  -s, --store=NAME   Search store NAME (default "default")
+  -k, --top-k=K      Return the K best matching chunks (default 5)
+  -M, --mode=MODE    One of "hybrid", "lexical" or "vector" (default "hybrid")
+  -r, --rerank=N     For quantized stores, re-score the N best matches using the full
+                     vectors (default 100). Pass 0 to rank by the compressed vectors only
+
+Examples:
+  > Find where an error is raised:
+    $ gpt embed search --store=myrepo --mode=lexical "Unable to open"
+)";
+
+    fmt::print("{}\n", messages);
+}
+
+void help_embed_cluster_()
+{
+    const std::string messages = R"(Group the chunks of a persistent store with k-means++ seeded, mini-batch
+k-means. Vectors are read straight from the store's memory mapped vectors file
+and the final assignment of every chunk runs across all cores. Assignments are
+exported to ~/.gptifier/clusters.gpt (see --output-file).
+
+Usage:
+  gpt embed cluster [OPTIONS]
+
+Options:
+  -h, --help                  Print help information and exit
+  -s, --store=NAME            Cluster store NAME (default "default")
+  -k, --clusters=K            Form K clusters (default 8)
+  -i, --iterations=N          Number of mini-batches, or of full passes with --batch-size=0
+                              (default 100)
+  -b, --batch-size=N          Number of chunks per mini-batch (default 1024). Pass 0 to run
+                              classic k-means over all chunks on every pass
+  -j, --jobs=JOBS             Use up to JOBS threads (default: one per core)
+  -o, --output-file=FILENAME  Export assignments to FILENAME
+
+Examples:
+  > Split a store of support tickets into 50 topics:
+    $ gpt embed cluster --store=tickets -k 50
+)";
+
+    fmt::print("{}\n", messages);
+}
+
+void help_embed_dedupe_()
+{
+    const std::string messages = R"(Find groups of near duplicate chunks in a persistent store. Candidate pairs
+are found by hashing vectors with SimHash into several locality sensitive hash
+tables and are only reported if their cosine similarity reaches the threshold.
+Groups are exported to ~/.gptifier/duplicates.gpt (see --output-file).
+
+Usage:
+  gpt embed dedupe [OPTIONS]
+
+Options:
+  -h, --help                  Print help information and exit
+  -s, --store=NAME            Search store NAME for duplicates (default "default")
+  -t, --threshold=COSINE      Minimum cosine similarity of near duplicates (default 0.95)
+  -n, --tables=N              Number of hash tables (default 16). More tables miss fewer
+                              duplicates but take longer
+  -j, --jobs=JOBS             Use up to JOBS threads (default: one per core)
+  -o, --output-file=FILENAME  Export groups to FILENAME
+
+Examples:
+  > Find tickets that are almost certainly the same:
+    $ gpt embed dedupe --store=tickets -t 0.98
 )";
 
     fmt::print("{}\n", messages);
@@ -38,10 +223,14 @@ Options:
 
 struct Parameters {
     bool use_local = false;
+    std::optional<std::string> chunk_size;
+    std::optional<std::string> dimensions;
     std::optional<std::string> input;
     std::optional<std::string> input_file;
+    std::optional<std::string> jobs;
     std::optional<std::string> model;
     std::optional<std::string> output_file;
+    std::optional<std::string> overlap;
 };
 
 Parameters read_cli_(const int argc, char **argv)
@@ -55,10 +244,14 @@ Parameters read_cli_(const int argc, char **argv)
             { "input", required_argument, 0, 'i' },
             { "output-file", required_argument, 0, 'o' },
             { "read-from-file", required_argument, 0, 'r' },
+            { "chunk-size", required_argument, 0, 'c' },
+            { "overlap", required_argument, 0, 'w' },
+            { "jobs", required_argument, 0, 'j' },
+            { "dimensions", required_argument, 0, 'D' },
             { 0, 0, 0, 0 } };
 
         int option_index = 0;
-        const int c = getopt_long(argc, argv, "hm:li:o:r:", long_options, &option_index);
+        const int c = getopt_long(argc, argv, "hm:li:o:r:c:w:j:D:", long_options, &option_index);
 
         if (c == -1) {
             break;
@@ -83,6 +276,18 @@ Parameters read_cli_(const int argc, char **argv)
             case 'r':
                 params.input_file = optarg;
                 break;
+            case 'c':
+                params.chunk_size = optarg;
+                break;
+            case 'w':
+                params.overlap = optarg;
+                break;
+            case 'j':
+                params.jobs = optarg;
+                break;
+            case 'D':
+                params.dimensions = optarg;
+                break;
             default:
                 utils::exit_on_failure();
         }
@@ -94,6 +299,10 @@ Parameters read_cli_(const int argc, char **argv)
         }
     }
 
+    if (params.overlap and not params.chunk_size) {
+        throw std::runtime_error("Overlap can only be used alongside --chunk-size");
+    }
+
     return params;
 }
 
@@ -126,14 +335,14 @@ std::string get_text_to_embed_(const Parameters &params)
     return text_to_embed;
 }
 
-std::string select_model_(const Parameters &params)
+std::string select_model_(const std::optional<std::string> &model_from_cli, const bool use_local)
 {
     std::string model;
 
-    if (params.model) {
-        model = params.model.value();
+    if (model_from_cli) {
+        model = model_from_cli.value();
     } else {
-        if (params.use_local) {
+        if (use_local) {
             model = configs.model_embed_ollama.value();
         } else {
             model = configs.model_embed_openai.value();
@@ -147,11 +356,27 @@ std::string select_model_(const Parameters &params)
     return model;
 }
 
+int get_dimensions_(const std::optional<std::string> &dimensions)
+{
+    if (not dimensions) {
+        return 0;
+    }
+
+    const int value = utils::string_to_int(dimensions.value());
+
+    if (value < 1) {
+        throw std::runtime_error("Dimensions must be a positive number");
+    }
+
+    return value;
+}
+
 using serialization::Embedding;
 
 void export_embedding_(const Embedding &embedding, const std::string &output_file)
 {
     const nlohmann::json json = {
+        { "dimensions", embedding.embedding.size() },
         { "embedding", embedding.embedding },
         { "input", embedding.input },
         { "model", embedding.model },
@@ -162,24 +387,763 @@ void export_embedding_(const Embedding &embedding, const std::string &output_fil
     utils::write_to_file(output_file, json.dump(2));
 }
 
+// Chunked embeddings ---------------------------------------------------------------------------------------
+
+using retrieval::Chunk;
+
+void export_chunked_embeddings_(const std::vector<Chunk> &chunks, const serialization::Embeddings &embeddings, const std::string &output_file)
+{
+    nlohmann::json json_chunks = nlohmann::json::array();
+
+    for (std::size_t i = 0; i < chunks.size(); ++i) {
+        json_chunks.push_back({
+            { "embedding", embeddings.embeddings[i] },
+            { "input", chunks[i].text },
+            { "length", chunks[i].length },
+            { "offset", chunks[i].offset },
+        });
+    }
+
+    const std::size_t dimensions = embeddings.embeddings.empty() ? 0 : embeddings.embeddings.front().size();
+
+    const nlohmann::json json = {
+        { "chunks", json_chunks },
+        { "dimensions", dimensions },
+        { "model", embeddings.model },
+        { "source", embeddings.source },
+    };
+
+    fmt::print("Dumping JSON to '{}'\n", output_file);
+    utils::write_to_file(output_file, json.dump(2));
+}
+
+void embed_in_chunks_(const Parameters &params, const std::string &text_to_embed, const std::string &model, const std::string &output_file)
+{
+    retrieval::ChunkOptions chunk_options;
+    chunk_options.chunk_size = utils::string_to_int(params.chunk_size.value());
+
+    if (params.overlap) {
+        chunk_options.overlap = utils::string_to_int(params.overlap.value());
+    } else {
+        chunk_options.overlap = std::min(chunk_options.overlap, chunk_options.chunk_size / 4);
+    }
+
+    const std::vector<Chunk> chunks = retrieval::chunk_text(text_to_embed, chunk_options);
+
+    if (chunks.empty()) {
+        throw std::runtime_error("No input text provided anywhere");
+    }
+
+    fmt::print("Split input into {} chunks\n", chunks.size());
+
+    std::vector<std::string> texts;
+    texts.reserve(chunks.size());
+
+    for (const auto &chunk: chunks) {
+        texts.push_back(chunk.text);
+    }
+
+    retrieval::EmbedOptions embed_options;
+    embed_options.model = model;
+    embed_options.use_local = params.use_local;
+    embed_options.dimensions = get_dimensions_(params.dimensions);
+
+    if (params.jobs) {
+        embed_options.jobs = utils::string_to_int(params.jobs.value());
+    }
+
+    const serialization::Embeddings embeddings = retrieval::embed_texts(texts, embed_options);
+    export_chunked_embeddings_(chunks, embeddings, output_file);
+}
+
+// Ingest ---------------------------------------------------------------------------------------------------
+
+struct IngestParameters {
+    bool use_local = false;
+    std::optional<std::string> chunk_size;
+    std::optional<std::string> debounce;
+    std::optional<std::string> dimensions;
+    std::optional<std::string> directory;
+    std::optional<std::string> jobs;
+    std::optional<std::string> model;
+    std::optional<std::string> overlap;
+    std::optional<std::string> quantize;
+    std::string store = "default";
+    std::vector<std::string> ignore_globs;
+};
+
+IngestParameters read_cli_ingest_(const int argc, char **argv, void (*help)())
+{
+    IngestParameters params;
+
+    while (true) {
+        static struct option long_options[] = {
+            { "help", no_argument, 0, 'h' },
+            { "store", required_argument, 0, 's' },
+            { "model", required_argument, 0, 'm' },
+            { "use-local", no_argument, 0, 'l' },
+            { "chunk-size", required_argument, 0, 'c' },
+            { "overlap", required_argument, 0, 'w' },
+            { "jobs", required_argument, 0, 'j' },
+            { "ignore", required_argument, 0, 'x' },
+            { "quantize", required_argument, 0, 'q' },
+            { "debounce", required_argument, 0, 'd' },
+            { "dimensions", required_argument, 0, 'D' },
+            { 0, 0, 0, 0 },
+        };
+
+        int option_index = 0;
+        const int c = getopt_long(argc, argv, "hs:m:lc:w:j:x:q:d:D:", long_options, &option_index);
+
+        if (c == -1) {
+            break;
+        }
+
+        switch (c) {
+            case 'h':
+                help();
+                exit(EXIT_SUCCESS);
+            case 's':
+                params.store = optarg;
+                break;
+            case 'm':
+                params.model = optarg;
+                break;
+            case 'l':
+                params.use_local = true;
+                break;
+            case 'c':
+                params.chunk_size = optarg;
+                break;
+            case 'w':
+                params.overlap = optarg;
+                break;
+            case 'j':
+                params.jobs = optarg;
+                break;
+            case 'x':
+                params.ignore_globs.push_back(optarg);
+                break;
+            case 'q':
+                params.quantize = optarg;
+                break;
+            case 'd':
+                params.debounce = optarg;
+                break;
+            case 'D':
+                params.dimensions = optarg;
+                break;
+            default:
+                utils::exit_on_failure();
+        }
+    }
+
+    // Non-option arguments are permuted to the end, i.e. "embed" "ingest" DIR
+    if (optind + 2 < argc) {
+        params.directory = argv[optind + 2];
+    }
+
+    if (not params.directory or params.directory.value().empty()) {
+        throw std::runtime_error("A directory to ingest needs to be provided");
+    }
+
+    if (optind + 3 < argc) {
+        throw std::runtime_error(fmt::format("Only one directory can be ingested at a time. Unexpected argument '{}'", argv[optind + 3]));
+    }
+
+    return params;
+}
+
+retrieval::IngestOptions get_ingest_options_(const IngestParameters &params)
+{
+    retrieval::IngestOptions options;
+
+    if (params.chunk_size) {
+        options.chunk_options.chunk_size = utils::string_to_int(params.chunk_size.value());
+    }
+
+    if (params.overlap) {
+        options.chunk_options.overlap = utils::string_to_int(params.overlap.value());
+    } else {
+        options.chunk_options.overlap = std::min(options.chunk_options.overlap, options.chunk_options.chunk_size / 4);
+    }
+
+    if (params.jobs) {
+        options.embed_options.jobs = utils::string_to_int(params.jobs.value());
+    }
+
+    options.embed_options.model = select_model_(params.model, params.use_local);
+    options.embed_options.use_local = params.use_local;
+    options.embed_options.dimensions = get_dimensions_(params.dimensions);
+    options.ignore_globs = params.ignore_globs;
+
+    if (params.quantize) {
+        options.quantization = retrieval::get_quantization(params.quantize.value());
+    }
+
+    return options;
+}
+
+void ingest_directory_(const int argc, char **argv)
+{
+    const IngestParameters params = read_cli_ingest_(argc, argv, help_embed_ingest_);
+
+    if (params.debounce) {
+        throw std::runtime_error("Debounce can only be used alongside the watch command");
+    }
+
+    const retrieval::IngestOptions options = get_ingest_options_(params);
+    const std::filesystem::path store_path = retrieval::get_store_path(params.store);
+
+    const retrieval::StoreLock lock(store_path);
+    retrieval::Store store = retrieval::load_store(store_path);
+
+    fmt::print("Ingesting '{}' into store '{}'\n", params.directory.value(), params.store);
+    const retrieval::IngestSummary summary = retrieval::ingest_directory(params.directory.value(), store, options);
+
+    retrieval::save_store(store, store_path);
+
+    fmt::print("Files added: {} | Updated: {} | Removed: {} | Unchanged: {}\n",
+        summary.files_added, summary.files_updated, summary.files_removed, summary.files_unchanged);
+    fmt::print("Embedded {} chunks (reused {}). Store now holds {} chunks from {} files\n",
+        summary.chunks_embedded, summary.chunks_reused, store.records.size(), store.files.size());
+}
+
+// Watch ----------------------------------------------------------------------------------------------------
+
+void print_watch_update_(const retrieval::IngestSummary &summary)
+{
+    const std::time_t now = std::time(nullptr);
+    char timestamp[32];
+    std::strftime(timestamp, sizeof(timestamp), "%H:%M:%S", std::localtime(&now));
+
+    fmt::print("[{}] Added: {} | Updated: {} | Removed: {} | Chunks embedded: {} | Chunks reused: {}\n",
+        timestamp, summary.files_added, summary.files_updated, summary.files_removed, summary.chunks_embedded, summary.chunks_reused);
+    std::fflush(stdout);
+}
+
+void watch_directory_(const int argc, char **argv)
+{
+    const IngestParameters params = read_cli_ingest_(argc, argv, help_embed_watch_);
+
+    retrieval::WatchOptions options;
+    options.ingest_options = get_ingest_options_(params);
+
+    if (params.debounce) {
+        options.debounce_ms = utils::string_to_int(params.debounce.value());
+    }
+
+    const std::filesystem::path store_path = retrieval::get_store_path(params.store);
+    fmt::print("Watching '{}' and syncing store '{}'. Press Ctrl-C to stop\n", params.directory.value(), params.store);
+
+    retrieval::WatchCallbacks callbacks;
+    callbacks.on_update = print_watch_update_;
+    callbacks.on_error = [](const std::string &errmsg) {
+        fmt::print(stderr, "Failed to update store (will retry): {}\n", errmsg);
+    };
+
+    retrieval::watch_directory(params.directory.value(), store_path, options, callbacks);
+}
+
+// Search ---------------------------------------------------------------------------------------------------
+
+struct SearchParameters {
+    std::optional<std::string> mode;
+    std::optional<std::string> query;
+    std::optional<std::string> rerank;
+    std::optional<std::string> top_k;
+    std::string store = "default";
+};
+
+SearchParameters read_cli_search_(const int argc, char **argv)
+{
+    SearchParameters params;
+
+    while (true) {
+        static struct option long_options[] = {
+            { "help", no_argument, 0, 'h' },
+            { "store", required_argument, 0, 's' },
+            { "top-k", required_argument, 0, 'k' },
+            { "mode", required_argument, 0, 'M' },
+            { "rerank", required_argument, 0, 'r' },
+            { 0, 0, 0, 0 },
+        };
+
+        int option_index = 0;
+        const int c = getopt_long(argc, argv, "hs:k:M:r:", long_options, &option_index);
+
+        if (c == -1) {
+            break;
+        }
+
+        switch (c) {
+            case 'h':
+                help_embed_search_();
+                exit(EXIT_SUCCESS);
+            case 's':
+                params.store = optarg;
+                break;
+            case 'k':
+                params.top_k = optarg;
+                break;
+            case 'M':
+                params.mode = optarg;
+                break;
+            case 'r':
+                params.rerank = optarg;
+                break;
+            default:
+                utils::exit_on_failure();
+        }
+    }
+
+    // Unquoted multi-word queries are joined back together
+    for (int i = optind + 2; i < argc; ++i) {
+        params.query = params.query ? params.query.value() + " " + argv[i] : std::string(argv[i]);
+    }
+
+    if (not params.query or params.query.value().empty()) {
+        throw std::runtime_error("A query needs to be provided");
+    }
+
+    return params;
+}
+
+void print_search_result_(const std::size_t rank, const retrieval::SearchResult &result)
+{
+    std::string ranks;
+
+    if (result.lexical_rank) {
+        ranks += fmt::format(", lexical #{}", result.lexical_rank.value());
+    }
+
+    if (result.vector_rank) {
+        ranks += fmt::format(", vector #{}", result.vector_rank.value());
+    }
+
+    fmt::print(fg(green), "[{}] {} @ {}", rank, result.record.path, result.record.offset);
+    fmt::print(" (score {:.4f}{})\n", result.score, ranks);
+
+    // Only show the start of each chunk to keep the output skimmable
+    static const int max_lines = 4;
+    std::size_t pos = 0;
+
+    for (int line = 0; line < max_lines and pos < result.record.text.size(); ++line) {
+        std::size_t end = result.record.text.find('\n', pos);
+
+        if (end == std::string::npos) {
+            end = result.record.text.size();
+        }
+
+        fmt::print("    {}\n", result.record.text.substr(pos, end - pos));
+        pos = end + 1;
+    }
+
+    if (pos < result.record.text.size()) {
+        fmt::print("    ...\n");
+    }
+}
+
+void search_store_(const int argc, char **argv)
+{
+    const SearchParameters params = read_cli_search_(argc, argv);
+
+    retrieval::SearchOptions options;
+
+    if (params.mode) {
+        options.mode = retrieval::get_search_mode(params.mode.value());
+    }
+
+    if (params.top_k) {
+        const int top_k = utils::string_to_int(params.top_k.value());
+
+        if (top_k < 1) {
+            throw std::runtime_error("Number of results must be positive");
+        }
+
+        options.top_k = top_k;
+    }
+
+    if (params.rerank) {
+        const int rerank = utils::string_to_int(params.rerank.value());
+
+        if (rerank < 0) {
+            throw std::runtime_error("Number of matches to re-rank must not be negative");
+        }
+
+        options.rerank = rerank;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+
+    const retrieval::StoreReader reader(retrieval::get_store_path(params.store));
+    const std::vector<retrieval::SearchResult> results = retrieval::search_store(reader, params.query.value(), options);
+
+    const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        print_search_result_(i + 1, results[i]);
+    }
+
+    fmt::print("Found {} results among {} chunks in {:.1f} ms\n", results.size(), reader.size(), elapsed.count());
+}
+
+// Cluster --------------------------------------------------------------------------------------------------
+
+struct ClusterParameters {
+    std::optional<std::string> batch_size;
+    std::optional<std::string> clusters;
+    std::optional<std::string> iterations;
+    std::optional<std::string> jobs;
+    std::optional<std::string> output_file;
+    std::string store = "default";
+};
+
+ClusterParameters read_cli_cluster_(const int argc, char **argv)
+{
+    ClusterParameters params;
+
+    while (true) {
+        static struct option long_options[] = {
+            { "help", no_argument, 0, 'h' },
+            { "store", required_argument, 0, 's' },
+            { "clusters", required_argument, 0, 'k' },
+            { "iterations", required_argument, 0, 'i' },
+            { "batch-size", required_argument, 0, 'b' },
+            { "jobs", required_argument, 0, 'j' },
+            { "output-file", required_argument, 0, 'o' },
+            { 0, 0, 0, 0 },
+        };
+
+        int option_index = 0;
+        const int c = getopt_long(argc, argv, "hs:k:i:b:j:o:", long_options, &option_index);
+
+        if (c == -1) {
+            break;
+        }
+
+        switch (c) {
+            case 'h':
+                help_embed_cluster_();
+                exit(EXIT_SUCCESS);
+            case 's':
+                params.store = optarg;
+                break;
+            case 'k':
+                params.clusters = optarg;
+                break;
+            case 'i':
+                params.iterations = optarg;
+                break;
+            case 'b':
+                params.batch_size = optarg;
+                break;
+            case 'j':
+                params.jobs = optarg;
+                break;
+            case 'o':
+                params.output_file = optarg;
+                break;
+            default:
+                utils::exit_on_failure();
+        }
+    }
+
+    if (params.output_file and params.output_file.value().empty()) {
+        throw std::runtime_error("Output file argument provided with no value");
+    }
+
+    return params;
+}
+
+int get_jobs_(const std::optional<std::string> &jobs)
+{
+    if (not jobs) {
+        return std::max<int>(1, std::thread::hardware_concurrency());
+    }
+
+    const int value = utils::string_to_int(jobs.value());
+
+    if (value < 1) {
+        throw std::runtime_error("Number of jobs must be positive");
+    }
+
+    return value;
+}
+
+void export_clustering_(const retrieval::StoreReader &reader, const retrieval::Clustering &clustering, const std::string &output_file)
+{
+    nlohmann::json json_clusters = nlohmann::json::array();
+
+    for (std::size_t c = 0; c < clustering.sizes.size(); ++c) {
+        nlohmann::json json_cluster = {
+            { "offset", nullptr },
+            { "path", nullptr },
+            { "representative", nullptr },
+            { "size", clustering.sizes[c] },
+        };
+
+        if (const auto &representative = clustering.representatives[c]) {
+            const retrieval::Record record = reader.get_record(representative.value());
+            json_cluster["offset"] = record.offset;
+            json_cluster["path"] = record.path;
+            json_cluster["representative"] = representative.value();
+        }
+
+        json_clusters.push_back(json_cluster);
+    }
+
+    const nlohmann::json json = {
+        { "clusters", json_clusters },
+        { "labels", clustering.labels },
+        { "model", reader.get_manifest().model },
+        { "num_chunks", reader.size() },
+    };
+
+    // Not indented since there is a label per chunk
+    fmt::print("Dumping JSON to '{}'\n", output_file);
+    utils::write_to_file(output_file, json.dump());
+}
+
+void cluster_store_(const int argc, char **argv)
+{
+    const ClusterParameters params = read_cli_cluster_(argc, argv);
+
+    retrieval::KMeansOptions options;
+    options.batch_size = 1024;
+    options.iterations = 100;
+    options.jobs = get_jobs_(params.jobs);
+
+    if (params.clusters) {
+        const int clusters = utils::string_to_int(params.clusters.value());
+
+        if (clusters < 1) {
+            throw std::runtime_error("Number of clusters must be positive");
+        }
+
+        options.clusters = clusters;
+    }
+
+    if (params.iterations) {
+        options.iterations = utils::string_to_int(params.iterations.value());
+
+        if (options.iterations < 1) {
+            throw std::runtime_error("Number of iterations must be positive");
+        }
+    }
+
+    if (params.batch_size) {
+        const int batch_size = utils::string_to_int(params.batch_size.value());
+
+        if (batch_size < 0) {
+            throw std::runtime_error("Batch size must not be negative");
+        }
+
+        options.batch_size = batch_size;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+
+    const retrieval::StoreReader reader(retrieval::get_store_path(params.store));
+    const retrieval::Clustering clustering = retrieval::cluster_store(reader, options);
+
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    for (std::size_t c = 0; c < clustering.sizes.size(); ++c) {
+        fmt::print(fg(green), "[{}] {} chunks", c, clustering.sizes[c]);
+
+        if (const auto &representative = clustering.representatives[c]) {
+            const retrieval::Record record = reader.get_record(representative.value());
+            fmt::print(" (nearest {} @ {})\n", record.path, record.offset);
+        } else {
+            fmt::print(" (empty)\n");
+        }
+    }
+
+    fmt::print("Clustered {} chunks into {} clusters in {:.2f} s\n", reader.size(), clustering.sizes.size(), elapsed.count());
+    export_clustering_(reader, clustering, params.output_file.value_or(datadir::GPT_CLUSTERS.string()));
+}
+
+// Dedupe ---------------------------------------------------------------------------------------------------
+
+struct DedupeParameters {
+    std::optional<std::string> jobs;
+    std::optional<std::string> output_file;
+    std::optional<std::string> tables;
+    std::optional<std::string> threshold;
+    std::string store = "default";
+};
+
+DedupeParameters read_cli_dedupe_(const int argc, char **argv)
+{
+    DedupeParameters params;
+
+    while (true) {
+        static struct option long_options[] = {
+            { "help", no_argument, 0, 'h' },
+            { "store", required_argument, 0, 's' },
+            { "threshold", required_argument, 0, 't' },
+            { "tables", required_argument, 0, 'n' },
+            { "jobs", required_argument, 0, 'j' },
+            { "output-file", required_argument, 0, 'o' },
+            { 0, 0, 0, 0 },
+        };
+
+        int option_index = 0;
+        const int c = getopt_long(argc, argv, "hs:t:n:j:o:", long_options, &option_index);
+
+        if (c == -1) {
+            break;
+        }
+
+        switch (c) {
+            case 'h':
+                help_embed_dedupe_();
+                exit(EXIT_SUCCESS);
+            case 's':
+                params.store = optarg;
+                break;
+            case 't':
+                params.threshold = optarg;
+                break;
+            case 'n':
+                params.tables = optarg;
+                break;
+            case 'j':
+                params.jobs = optarg;
+                break;
+            case 'o':
+                params.output_file = optarg;
+                break;
+            default:
+                utils::exit_on_failure();
+        }
+    }
+
+    if (params.output_file and params.output_file.value().empty()) {
+        throw std::runtime_error("Output file argument provided with no value");
+    }
+
+    return params;
+}
+
+void export_duplicates_(const retrieval::StoreReader &reader, const std::vector<std::vector<std::size_t>> &groups, const float threshold, const std::string &output_file)
+{
+    nlohmann::json json_groups = nlohmann::json::array();
+
+    for (const auto &group: groups) {
+        nlohmann::json json_group = nlohmann::json::array();
+
+        for (const std::size_t chunk: group) {
+            const retrieval::Record record = reader.get_record(chunk);
+            json_group.push_back({ { "chunk", chunk }, { "offset", record.offset }, { "path", record.path } });
+        }
+
+        json_groups.push_back(json_group);
+    }
+
+    const nlohmann::json json = {
+        { "groups", json_groups },
+        { "model", reader.get_manifest().model },
+        { "threshold", threshold },
+    };
+
+    fmt::print("Dumping JSON to '{}'\n", output_file);
+    utils::write_to_file(output_file, json.dump());
+}
+
+void dedupe_store_(const int argc, char **argv)
+{
+    const DedupeParameters params = read_cli_dedupe_(argc, argv);
+
+    retrieval::DedupeOptions options;
+    options.jobs = get_jobs_(params.jobs);
+
+    if (params.threshold) {
+        options.threshold = utils::string_to_float(params.threshold.value());
+    }
+
+    if (params.tables) {
+        options.tables = utils::string_to_int(params.tables.value());
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+
+    const retrieval::StoreReader reader(retrieval::get_store_path(params.store));
+    const std::vector<std::vector<std::size_t>> groups = retrieval::find_near_duplicates(reader, options);
+
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    // Only the largest groups are shown. The export holds all of them
+    static const std::size_t max_groups = 10;
+    static const std::size_t max_members = 5;
+
+    std::size_t num_duplicates = 0;
+
+    for (std::size_t g = 0; g < groups.size(); ++g) {
+        num_duplicates += groups[g].size();
+
+        if (g >= max_groups) {
+            continue;
+        }
+
+        fmt::print(fg(green), "[{}] {} chunks", g + 1, groups[g].size());
+        fmt::print("\n");
+
+        for (std::size_t m = 0; m < std::min(max_members, groups[g].size()); ++m) {
+            const retrieval::Record record = reader.get_record(groups[g][m]);
+            fmt::print("    {} @ {}\n", record.path, record.offset);
+        }
+
+        if (groups[g].size() > max_members) {
+            fmt::print("    ...\n");
+        }
+    }
+
+    fmt::print("Found {} groups holding {} of {} chunks in {:.2f} s\n", groups.size(), num_duplicates, reader.size(), elapsed.count());
+    export_duplicates_(reader, groups, options.threshold, params.output_file.value_or(datadir::GPT_DUPLICATES.string()));
+}
+
 } // namespace
 
 namespace commands {
 
 void command_embed(const int argc, char **argv)
 {
-    const Parameters params = read_cli_(argc, argv);
-    const std::string text_to_embed = get_text_to_embed_(params);
-    const std::string model = select_model_(params);
+    if (argc > 2) {
+        const std::string subcommand = argv[2];
 
-    Embedding embedding;
+        if (subcommand == "cluster") {
+            cluster_store_(argc, argv);
+            return;
+        }
 
-    if (params.use_local) {
-        embedding = serialization::create_ollama_embedding(model, text_to_embed);
-    } else {
-        embedding = serialization::create_openai_embedding(model, text_to_embed);
+        if (subcommand == "dedupe") {
+            dedupe_store_(argc, argv);
+            return;
+        }
+
+        if (subcommand == "ingest") {
+            ingest_directory_(argc, argv);
+            return;
+        }
+
+        if (subcommand == "search") {
+            search_store_(argc, argv);
+            return;
+        }
+
+        if (subcommand == "watch") {
+            watch_directory_(argc, argv);
+            return;
+        }
     }
 
+    const Parameters params = read_cli_(argc, argv);
+    const int dimensions = get_dimensions_(params.dimensions);
+    const std::string text_to_embed = get_text_to_embed_(params);
+    const std::string model = select_model_(params.model, params.use_local);
+
     std::string output_file;
 
     if (params.output_file) {
@@ -188,6 +1152,19 @@ void command_embed(const int argc, char **argv)
         output_file = datadir::GPT_EMBEDDINGS.string();
     }
 
+    if (params.chunk_size) {
+        embed_in_chunks_(params, text_to_embed, model, output_file);
+        return;
+    }
+
+    Embedding embedding;
+
+    if (params.use_local) {
+        embedding = serialization::create_ollama_embedding(model, text_to_embed, dimensions);
+    } else {
+        embedding = serialization::create_openai_embedding(model, text_to_embed, dimensions);
+    }
+
     export_embedding_(embedding, output_file);
 }
 
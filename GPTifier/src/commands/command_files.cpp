@@ -1,10 +1,16 @@
 #include "command_files.hpp"
 
+#include "configs.hpp"
 #include "files.hpp"
 #include "utils.hpp"
 
+#include <algorithm>
+#include <chrono>
+#include <ctime>
 #include <fmt/core.h>
+#include <fnmatch.h>
 #include <getopt.h>
+#include <optional>
 #include <stdexcept>
 #include <string>
 #include <vector>
@@ -24,6 +30,7 @@ Options:
 Commands:
   list        Get list of files uploaded to OpenAI servers
   delete      Delete one or more uploaded files
+  download    Download the contents of one or more uploaded files
 )";
 
     fmt::print("{}\n", messages);
@@ -37,8 +44,16 @@ Usage:
   gpt files list [OPTIONS]
 
 Options:
-  -h, --help  Print help information and exit
-  -j, --json  Print raw JSON response from OpenAI
+  -h, --help                 Print help information and exit
+  -j, --json                 Print raw JSON response from OpenAI
+  -p, --purpose=<purpose>    Only list files uploaded for this purpose (i.e. "fine-tune")
+  -a, --after=<YYYY-MM-DD>   Only list files created on or after this date (UTC)
+  -b, --before=<YYYY-MM-DD>  Only list files created before this date (UTC)
+  -l, --page-size=<n>        Fetch files in pages of n files (1-10000, default 1000)
+  -s, --sync                 Sync the local mirror with OpenAI before listing
+
+Files are listed oldest first from a local mirror of the listing, which is refreshed in the background
+once it is older than the configured TTL. Only files uploaded since the last refresh are fetched
 )";
 
     fmt::print("{}\n", messages);
@@ -49,125 +64,543 @@ void help_files_delete_()
     const std::string messages = R"(Delete one or more uploaded files.
 
 Usage:
-  gpt files delete [OPTIONS] FILE-ID...
+  gpt files delete [OPTIONS] [FILE-ID...]
 
 Options:
-  -h, --help  Print help information and exit
-
-Use "gpt files list" to get the IDs corresponding to files to be deleted
+  -h, --help                 Print help information and exit
+  -n, --name=<glob>          Delete files whose filename matches the glob (i.e. "train_*.jsonl")
+  -p, --purpose=<purpose>    Delete files uploaded for this purpose (i.e. "fine-tune")
+  -b, --before=<YYYY-MM-DD>  Delete files created before this date (UTC)
+  -o, --older-than=<days>    Delete files created more than this many days ago
+  -c, --concurrency=<n>      Keep up to n deletes in flight at once (default 8)
+  -r, --retries=<n>          Retry rate limited or failed deletes up to n times (default 3)
+  -d, --dry-run              Print the files that would be deleted but do not delete them
+
+Files can be passed by ID, or selected from the listing with any combination of --name, --purpose,
+--before and --older-than (a file has to match all of them). Use "gpt files list" to get the IDs
+corresponding to files to be deleted
 )";
 
     fmt::print("{}\n", messages);
 }
 
-// List files -----------------------------------------------------------------------------------------------
+void help_files_download_()
+{
+    const std::string messages = R"(Download the contents of one or more uploaded files.
 
-using serialization::Files;
+Usage:
+  gpt files download [OPTIONS] FILE-ID...
 
-void print_uploaded_files_(const Files &files)
-{
-    fmt::print("{:<30}{:<30}{:<30}{}\n", "File ID", "Filename", "Creation time", "Purpose");
+Options:
+  -h, --help               Print help information and exit
+  -o, --output-dir=<dir>   Save files to this directory (default is the current directory)
+  -c, --concurrency=<n>    Download up to n files at once (default 4)
+  -r, --retries=<n>        Retry rate limited or failed downloads up to n times (default 3)
+
+Files are saved under their uploaded filename and are written to disk as they arrive. Files sharing a
+name with an earlier file are saved as "<name>.<file-id>.<ext>" instead. An interrupted download is left
+behind as a ".part" file, which is resumed rather than started over on the next run
+)";
 
-    for (const auto &file: files.files) {
-        fmt::print("{:<30}{:<30}{:<30}{}\n", file.id, file.filename, file.created_at_dt_str, file.purpose);
-    }
+    fmt::print("{}\n", messages);
 }
 
-void list_uploaded_files_(const int argc, char **argv)
-{
+// List files -----------------------------------------------------------------------------------------------
+
+using serialization::File;
+
+struct ListParameters {
     bool print_raw_json = false;
+    bool sync = false;
+    std::optional<std::string> after;
+    std::optional<std::string> before;
+    std::optional<std::string> page_size;
+    std::optional<std::string> purpose;
+};
+
+ListParameters read_cli_list_(const int argc, char **argv)
+{
+    ListParameters params;
 
     while (true) {
         static struct option long_options[] = {
+            { "after", required_argument, 0, 'a' },
+            { "before", required_argument, 0, 'b' },
             { "help", no_argument, 0, 'h' },
             { "json", no_argument, 0, 'j' },
+            { "page-size", required_argument, 0, 'l' },
+            { "purpose", required_argument, 0, 'p' },
+            { "sync", no_argument, 0, 's' },
             { 0, 0, 0, 0 }
         };
 
         int option_index = 0;
-        const int c = getopt_long(argc, argv, "hj", long_options, &option_index);
+        const int c = getopt_long(argc, argv, "a:b:hjl:p:s", long_options, &option_index);
 
         if (c == -1) {
             break;
         }
 
         switch (c) {
+            case 'a':
+                params.after = optarg;
+                break;
+            case 'b':
+                params.before = optarg;
+                break;
             case 'h':
                 help_files_list_();
                 exit(EXIT_SUCCESS);
             case 'j':
-                print_raw_json = true;
+                params.print_raw_json = true;
+                break;
+            case 'l':
+                params.page_size = optarg;
+                break;
+            case 'p':
+                params.purpose = optarg;
+                break;
+            case 's':
+                params.sync = true;
                 break;
             default:
                 utils::exit_on_failure();
         }
     }
 
-    const Files files = serialization::get_files();
+    return params;
+}
+
+std::time_t string_to_date_(const std::string &str)
+{
+    std::tm tm = {};
+    const char *end = strptime(str.c_str(), "%Y-%m-%d", &tm);
+
+    if (end == nullptr or *end != '\0') {
+        throw std::runtime_error(fmt::format("Invalid date '{}'. Expected YYYY-MM-DD", str));
+    }
+
+    return timegm(&tm);
+}
+
+serialization::FilesQuery get_files_query_(const ListParameters &params)
+{
+    serialization::FilesQuery query;
+    query.keep_raw_json = params.print_raw_json;
+
+    if (params.after) {
+        query.created_after = string_to_date_(params.after.value());
+    }
+
+    if (params.before) {
+        query.created_before = string_to_date_(params.before.value());
+    }
+
+    if (params.page_size) {
+        query.page_size = utils::string_to_int(params.page_size.value());
+
+        if (query.page_size < 1 or query.page_size > 10000) {
+            throw std::runtime_error("Page size must be between 1 and 10000");
+        }
+    }
+
+    if (params.purpose) {
+        if (params.purpose.value().empty()) {
+            throw std::runtime_error("Purpose is empty");
+        }
+
+        query.purpose = params.purpose.value();
+    }
 
-    if (print_raw_json) {
-        fmt::print("{}\n", files.raw_response);
+    return query;
+}
+
+void list_uploaded_files_(const int argc, char **argv)
+{
+    const ListParameters params = read_cli_list_(argc, argv);
+    const serialization::FilesQuery query = get_files_query_(params);
+
+    serialization::MirrorOptions options;
+    options.sync = params.sync;
+    options.ttl = configs.mirror_ttl.value();
+
+    if (params.print_raw_json) {
+        // Pages are merged into a single listing
+        bool first = true;
+        fmt::print("{{\"object\": \"list\", \"data\": [");
+
+        serialization::list_mirrored_files(query, options, [&first](const File &file) {
+            fmt::print("{}{}", first ? "" : ", ", file.raw_json);
+            first = false;
+        });
+
+        fmt::print("], \"has_more\": false}}\n");
         return;
     }
 
-    print_uploaded_files_(files);
+    fmt::print("{:<30}{:<30}{:<30}{}\n", "File ID", "Filename", "Creation time", "Purpose");
+
+    serialization::list_mirrored_files(query, options, [](const File &file) {
+        fmt::print("{:<30}{:<30}{:<30}{}\n", file.id, file.filename, file.created_at_dt_str, file.purpose);
+    });
 }
 
 // Delete files ---------------------------------------------------------------------------------------------
 
-bool loop_over_file_ids_to_delete_(const std::vector<std::string> &ids)
+struct DeleteParameters {
+    bool dry_run = false;
+    std::optional<std::string> before;
+    std::optional<std::string> concurrency;
+    std::optional<std::string> name;
+    std::optional<std::string> older_than;
+    std::optional<std::string> purpose;
+    std::optional<std::string> retries;
+    std::vector<std::string> ids;
+};
+
+DeleteParameters read_cli_delete_(const int argc, char **argv)
 {
-    bool success = true;
+    DeleteParameters params;
 
-    for (const auto &id: ids) {
-        if (id.empty()) {
-            fmt::print(stderr, "Cannot delete file. ID is empty\n");
-            success = false;
-            continue;
+    while (true) {
+        static struct option long_options[] = {
+            { "before", required_argument, 0, 'b' },
+            { "concurrency", required_argument, 0, 'c' },
+            { "dry-run", no_argument, 0, 'd' },
+            { "help", no_argument, 0, 'h' },
+            { "name", required_argument, 0, 'n' },
+            { "older-than", required_argument, 0, 'o' },
+            { "purpose", required_argument, 0, 'p' },
+            { "retries", required_argument, 0, 'r' },
+            { 0, 0, 0, 0 }
+        };
+
+        int option_index = 0;
+        const int c = getopt_long(argc, argv, "b:c:dhn:o:p:r:", long_options, &option_index);
+
+        if (c == -1) {
+            break;
+        }
+
+        switch (c) {
+            case 'b':
+                params.before = optarg;
+                break;
+            case 'c':
+                params.concurrency = optarg;
+                break;
+            case 'd':
+                params.dry_run = true;
+                break;
+            case 'h':
+                help_files_delete_();
+                exit(EXIT_SUCCESS);
+            case 'n':
+                params.name = optarg;
+                break;
+            case 'o':
+                params.older_than = optarg;
+                break;
+            case 'p':
+                params.purpose = optarg;
+                break;
+            case 'r':
+                params.retries = optarg;
+                break;
+            default:
+                utils::exit_on_failure();
         }
+    }
 
-        bool deleted = false;
+    // Non-option arguments are permuted to the end, i.e. "files" "delete" FILE-ID...
+    for (int i = optind + 2; i < argc; ++i) {
+        params.ids.push_back(argv[i]);
+    }
 
-        try {
-            deleted = serialization::delete_file(id);
-        } catch (const std::runtime_error &e) {
-            fmt::print(stderr, "Failed to delete file with ID: {}. The error was: \"{}\"\n", id, e.what());
-            success = false;
-            continue;
+    return params;
+}
+
+bool has_selection_(const DeleteParameters &params)
+{
+    return params.name or params.purpose or params.before or params.older_than;
+}
+
+std::vector<std::string> select_files_to_delete_(const DeleteParameters &params)
+{
+    serialization::FilesQuery query;
+    query.purpose = params.purpose.value_or("");
+
+    if (params.before) {
+        query.created_before = string_to_date_(params.before.value());
+    }
+
+    if (params.older_than) {
+        const int days = utils::string_to_int(params.older_than.value());
+
+        if (days < 0) {
+            throw std::runtime_error("Age must not be negative");
         }
 
-        if (deleted) {
-            fmt::print("Success! Deleted file with ID: {}\n", id);
+        const std::time_t cutoff = std::time(nullptr) - std::time_t(days) * 86400;
+        query.created_before = std::min(query.created_before.value_or(cutoff), cutoff);
+    }
+
+    std::vector<std::string> ids;
+
+    serialization::list_files(query, [&](const File &file) {
+        if (params.name and fnmatch(params.name.value().c_str(), file.filename.c_str(), 0) != 0) {
+            return;
+        }
+
+        if (params.dry_run) {
+            fmt::print("{:<30}{:<30}{:<30}{}\n", file.id, file.filename, file.created_at_dt_str, file.purpose);
+        }
+
+        ids.push_back(file.id);
+    });
+
+    return ids;
+}
+
+serialization::DeleteOptions get_delete_options_(const DeleteParameters &params)
+{
+    serialization::DeleteOptions options;
+
+    if (params.concurrency) {
+        options.concurrency = utils::string_to_int(params.concurrency.value());
+
+        if (options.concurrency < 1) {
+            throw std::runtime_error("Concurrency must be at least 1");
+        }
+    }
+
+    if (params.retries) {
+        options.retries = utils::string_to_int(params.retries.value());
+
+        if (options.retries < 0) {
+            throw std::runtime_error("Number of retries must not be negative");
+        }
+    }
+
+    return options;
+}
+
+bool delete_files_(const std::vector<std::string> &ids, const serialization::DeleteOptions &options)
+{
+    const auto start = std::chrono::steady_clock::now();
+
+    int num_deleted = 0;
+    int num_failed = 0;
+    int num_retries = 0;
+
+    serialization::delete_files(ids, options, [&](const serialization::DeleteResult &result) {
+        num_retries += result.attempts - 1;
+
+        if (not result.error.empty()) {
+            fmt::print(stderr, "Failed to delete file with ID: {}. The error was: \"{}\"\n", result.id, result.error);
+            num_failed++;
+        } else if (result.deleted) {
+            fmt::print("Success! Deleted file with ID: {}\n", result.id);
+            num_deleted++;
         } else {
-            fmt::print("Warning! Did not delete file with ID: {}\n", id);
+            fmt::print("Warning! Did not delete file with ID: {}\n", result.id);
         }
+    });
+
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    if (ids.size() > 1) {
+        fmt::print("Deleted {} of {} files in {:.2f} s ({} failed, {} retries)\n", num_deleted, ids.size(), elapsed.count(), num_failed, num_retries);
     }
 
-    return success;
+    return num_failed == 0;
 }
 
 void delete_uploaded_files_(const int argc, char **argv)
 {
-    if (argc == 3) {
+    const DeleteParameters params = read_cli_delete_(argc, argv);
+
+    if (params.ids.empty() and not has_selection_(params)) {
         throw std::runtime_error("One or more file IDs need to be provided");
     }
 
-    std::vector<std::string> args_or_ids;
+    const serialization::DeleteOptions options = get_delete_options_(params);
+
+    bool success = true;
+    std::vector<std::string> ids;
+
+    for (const auto &id: params.ids) {
+        if (id.empty()) {
+            fmt::print(stderr, "Cannot delete file. ID is empty\n");
+            success = false;
+            continue;
+        }
+
+        ids.push_back(id);
+    }
+
+    if (has_selection_(params)) {
+        const std::vector<std::string> selected = select_files_to_delete_(params);
+        ids.insert(ids.end(), selected.begin(), selected.end());
 
-    for (int i = 3; i < argc; i++) {
-        args_or_ids.push_back(argv[i]);
+        fmt::print("Selected {} files\n", selected.size());
     }
 
-    if (args_or_ids[0] == "-h" or args_or_ids[0] == "--help") {
-        help_files_delete_();
+    if (params.dry_run) {
         return;
     }
 
-    if (not loop_over_file_ids_to_delete_(args_or_ids)) {
+    if (not delete_files_(ids, options)) {
+        success = false;
+    }
+
+    if (not success) {
         throw std::runtime_error("One or more failures occurred when deleting files");
     }
 }
 
+// Download files -------------------------------------------------------------------------------------------
+
+struct DownloadParameters {
+    std::optional<std::string> concurrency;
+    std::optional<std::string> output_dir;
+    std::optional<std::string> retries;
+    std::vector<std::string> ids;
+};
+
+DownloadParameters read_cli_download_(const int argc, char **argv)
+{
+    DownloadParameters params;
+
+    while (true) {
+        static struct option long_options[] = {
+            { "concurrency", required_argument, 0, 'c' },
+            { "help", no_argument, 0, 'h' },
+            { "output-dir", required_argument, 0, 'o' },
+            { "retries", required_argument, 0, 'r' },
+            { 0, 0, 0, 0 }
+        };
+
+        int option_index = 0;
+        const int c = getopt_long(argc, argv, "c:ho:r:", long_options, &option_index);
+
+        if (c == -1) {
+            break;
+        }
+
+        switch (c) {
+            case 'c':
+                params.concurrency = optarg;
+                break;
+            case 'h':
+                help_files_download_();
+                exit(EXIT_SUCCESS);
+            case 'o':
+                params.output_dir = optarg;
+                break;
+            case 'r':
+                params.retries = optarg;
+                break;
+            default:
+                utils::exit_on_failure();
+        }
+    }
+
+    // Non-option arguments are permuted to the end, i.e. "files" "download" FILE-ID...
+    for (int i = optind + 2; i < argc; ++i) {
+        params.ids.push_back(argv[i]);
+    }
+
+    return params;
+}
+
+serialization::DownloadOptions get_download_options_(const DownloadParameters &params)
+{
+    serialization::DownloadOptions options;
+
+    if (params.concurrency) {
+        options.concurrency = utils::string_to_int(params.concurrency.value());
+
+        if (options.concurrency < 1) {
+            throw std::runtime_error("Concurrency must be at least 1");
+        }
+    }
+
+    if (params.retries) {
+        options.retries = utils::string_to_int(params.retries.value());
+
+        if (options.retries < 0) {
+            throw std::runtime_error("Number of retries must not be negative");
+        }
+    }
+
+    if (params.output_dir) {
+        if (params.output_dir.value().empty()) {
+            throw std::runtime_error("Output directory is empty");
+        }
+
+        options.output_dir = params.output_dir.value();
+    }
+
+    return options;
+}
+
+double to_mib_(const std::size_t bytes)
+{
+    return static_cast<double>(bytes) / (1024 * 1024);
+}
+
+void download_uploaded_files_(const int argc, char **argv)
+{
+    const DownloadParameters params = read_cli_download_(argc, argv);
+
+    if (params.ids.empty()) {
+        throw std::runtime_error("One or more file IDs need to be provided");
+    }
+
+    for (const auto &id: params.ids) {
+        if (id.empty()) {
+            throw std::runtime_error("Cannot download file. ID is empty");
+        }
+    }
+
+    const serialization::DownloadOptions options = get_download_options_(params);
+    const auto start = std::chrono::steady_clock::now();
+
+    int num_downloaded = 0;
+    std::size_t total_bytes = 0;
+
+    serialization::download_files(params.ids, options, [&](const serialization::DownloadResult &result) {
+        if (not result.error.empty()) {
+            fmt::print(stderr, "Failed to download file with ID: {}. The error was: \"{}\"\n", result.id, result.error);
+            return;
+        }
+
+        const double seconds = std::max(result.seconds, 1e-6);
+        fmt::print("Downloaded {} to {} ({:.2f} MiB in {:.2f} s, {:.2f} MiB/s", result.id, result.path, to_mib_(result.bytes_downloaded), result.seconds, to_mib_(result.bytes_downloaded) / seconds);
+
+        if (result.resumed_from > 0) {
+            fmt::print(", resumed at {:.2f} MiB", to_mib_(result.resumed_from));
+        }
+
+        fmt::print(")\n");
+
+        num_downloaded++;
+        total_bytes += result.bytes_downloaded;
+    });
+
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    if (params.ids.size() > 1) {
+        const double seconds = std::max(elapsed.count(), 1e-6);
+        fmt::print("Downloaded {} of {} files, {:.2f} MiB in {:.2f} s ({:.2f} MiB/s)\n", num_downloaded, params.ids.size(), to_mib_(total_bytes), elapsed.count(), to_mib_(total_bytes) / seconds);
+    }
+
+    if (num_downloaded < static_cast<int>(params.ids.size())) {
+        throw std::runtime_error("One or more failures occurred when downloading files");
+    }
+}
+
 } // namespace
 
 namespace commands {
@@ -190,6 +623,8 @@ void command_files(const int argc, char **argv)
         list_uploaded_files_(argc, argv);
     } else if (subcommand == "delete") {
         delete_uploaded_files_(argc, argv);
+    } else if (subcommand == "download") {
+        download_uploaded_files_(argc, argv);
     } else {
         help_files_();
         exit(EXIT_FAILURE);
@@ -1,17 +1,22 @@
 #include "command_fine_tune.hpp"
 
 #include "api_openai_user.hpp"
+#include "configs.hpp"
+#include "datasets.hpp"
 #include "files.hpp"
 #include "fine_tuning.hpp"
 #include "models.hpp"
+#include "uploads.hpp"
 #include "utils.hpp"
 
 #include <algorithm>
+#include <chrono>
 #include <fmt/core.h>
 #include <getopt.h>
 #include <optional>
 #include <stdexcept>
 #include <string>
+#include <thread>
 #include <utility>
 
 namespace {
@@ -27,6 +32,7 @@ Options:
   -h, --help  Print help information and exit
 
 Commands:
+  validate      Check a fine-tuning file for errors before uploading it
   upload-file   Upload a fine-tuning file
   create-job    Create a fine-tuning job
   delete-model  Delete a fine-tuned model
@@ -44,12 +50,190 @@ Usage:
   gpt fine-tune upload-file [OPTIONS] FILE
 
 Options:
-  -h, --help  Print help information and exit
+  -h, --help               Print help information and exit
+  -c, --concurrency=<n>    Upload up to n parts at once (default 4)
+  -r, --retries=<n>        Retry rate limited or failed requests up to n times (default 3)
+  -s, --part-size=<MiB>    Split the file into parts of this many MiB (between 1 and 64, default 16)
+  -m, --multipart          Upload in parts even if the file is small
+
+Files of 64 MiB or more are uploaded in parts. An interrupted upload resumes
+from the missing parts when the same file is uploaded again within the hour.
+Run 'gpt fine-tune validate FILE' first to catch format errors before uploading
+)";
+
+    fmt::print("{}\n", messages);
+}
+
+void help_fine_tune_validate_()
+{
+    const std::string messages = R"(Check a chat formatted fine-tuning file for errors and print statistics
+about it, i.e. the number of examples and estimated training tokens.
+
+Usage:
+  gpt fine-tune validate [OPTIONS] FILE
+
+Options:
+  -h, --help              Print help information and exit
+  -j, --jobs=JOBS         Use up to JOBS threads (default: one per core)
+  -e, --max-errors=<n>    Print at most n errors (default 20)
+  -t, --max-tokens=<n>    Warn about examples longer than n tokens (default 65536)
+
+Token counts are estimates. Exits with an error if any line is invalid or
+the file holds no examples
 )";
 
     fmt::print("{}\n", messages);
 }
 
+// Validate fine tuning file --------------------------------------------------------------------------------
+
+struct ValidateParameters {
+    std::optional<std::string> jobs;
+    std::optional<std::string> max_errors;
+    std::optional<std::string> max_tokens;
+    std::string filename;
+};
+
+ValidateParameters read_cli_validate_(const int argc, char **argv)
+{
+    ValidateParameters params;
+
+    while (true) {
+        static struct option long_options[] = {
+            { "help", no_argument, 0, 'h' },
+            { "jobs", required_argument, 0, 'j' },
+            { "max-errors", required_argument, 0, 'e' },
+            { "max-tokens", required_argument, 0, 't' },
+            { 0, 0, 0, 0 }
+        };
+
+        int option_index = 0;
+        const int c = getopt_long(argc, argv, "e:hj:t:", long_options, &option_index);
+
+        if (c == -1) {
+            break;
+        }
+
+        switch (c) {
+            case 'e':
+                params.max_errors = optarg;
+                break;
+            case 'h':
+                help_fine_tune_validate_();
+                exit(EXIT_SUCCESS);
+            case 'j':
+                params.jobs = optarg;
+                break;
+            case 't':
+                params.max_tokens = optarg;
+                break;
+            default:
+                utils::exit_on_failure();
+        }
+    }
+
+    // Non-option arguments are permuted to the end, i.e. "fine-tune" "validate" FILE
+    if (optind + 2 >= argc) {
+        throw std::runtime_error("A fine tuning file needs to be provided");
+    }
+
+    params.filename = argv[optind + 2];
+    return params;
+}
+
+serialization::DatasetOptions get_dataset_options_(const ValidateParameters &params)
+{
+    serialization::DatasetOptions options;
+    options.jobs = std::max<int>(1, std::thread::hardware_concurrency());
+
+    if (params.jobs) {
+        options.jobs = utils::string_to_int(params.jobs.value());
+
+        if (options.jobs < 1) {
+            throw std::runtime_error("Number of jobs must be positive");
+        }
+    }
+
+    if (params.max_errors) {
+        const int max_errors = utils::string_to_int(params.max_errors.value());
+
+        if (max_errors < 0) {
+            throw std::runtime_error("Max errors must not be negative");
+        }
+
+        options.max_errors = static_cast<std::size_t>(max_errors);
+    }
+
+    if (params.max_tokens) {
+        options.max_tokens_per_example = utils::string_to_int(params.max_tokens.value());
+
+        if (options.max_tokens_per_example < 1) {
+            throw std::runtime_error("Max tokens must be positive");
+        }
+    }
+
+    return options;
+}
+
+void print_dataset_report_(const serialization::DatasetReport &report, const serialization::DatasetOptions &options)
+{
+    for (const auto &error: report.errors) {
+        fmt::print(stderr, "Line {}: {}\n", error.line, error.message);
+    }
+
+    if (report.num_errors > report.errors.size()) {
+        fmt::print(stderr, "... and {} more invalid lines\n", report.num_errors - report.errors.size());
+    }
+
+    if (report.num_errors > 0) {
+        fmt::print(stderr, "\n");
+    }
+
+    const serialization::TokenDistribution &tokens = report.tokens;
+
+    fmt::print("{:<28}{}\n", "Examples:", report.num_examples);
+    fmt::print("{:<28}{}\n", "Invalid lines:", report.num_errors);
+    fmt::print("{:<28}{}\n", "Messages:", report.num_messages);
+    fmt::print("{:<28}min {}, mean {:.1f}, p50 {}, p90 {}, p99 {}, max {}\n", "Tokens per example:", tokens.min, tokens.mean, tokens.p50, tokens.p90, tokens.p99, tokens.max);
+    fmt::print("{:<28}{}\n", fmt::format("Over {} tokens:", options.max_tokens_per_example), report.num_truncated);
+    fmt::print("{:<28}{}\n", "Assistant tokens:", report.assistant_tokens);
+    fmt::print("{:<28}{}\n", "Training tokens per epoch:", report.tokens_per_epoch);
+    fmt::print("{:<28}{} ({} training tokens)\n", "Default epochs:", report.default_epochs, report.tokens_per_epoch * report.default_epochs);
+
+    if (report.num_truncated > 0) {
+        fmt::print("\nWarning! Examples over {} tokens will be truncated during training\n", options.max_tokens_per_example);
+    }
+}
+
+void validate_fine_tuning_file_(const int argc, char **argv)
+{
+    const ValidateParameters params = read_cli_validate_(argc, argv);
+
+    if (params.filename.empty()) {
+        throw std::runtime_error("Filename is empty");
+    }
+
+    const serialization::DatasetOptions options = get_dataset_options_(params);
+
+    const auto start = std::chrono::steady_clock::now();
+    const serialization::DatasetReport report = serialization::validate_fine_tuning_file(params.filename, options);
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    print_dataset_report_(report, options);
+
+    const double mib = static_cast<double>(report.bytes) / (1024 * 1024);
+    fmt::print("\nValidated {} lines ({:.2f} MiB) in {:.2f} s\n", report.num_lines, mib, elapsed.count());
+
+    if (report.num_errors > 0) {
+        throw std::runtime_error(fmt::format("Found {} invalid lines in '{}'", report.num_errors, params.filename));
+    }
+
+    // Fine-tuning jobs reject datasets without any examples
+    if (report.num_examples == 0) {
+        throw std::runtime_error(fmt::format("Found no examples in '{}'", params.filename));
+    }
+}
+
 void help_fine_tune_create_job_()
 {
     const std::string messages = R"(Create a fine-tuning job. Command will fine-tune a model named
@@ -97,6 +281,10 @@ Options:
   -j, --json         Print raw JSON response from OpenAI
   -l, --limit=LIMIT  Show LIMIT number of fine-tuning jobs. LIMIT will
                      be clamped to list between 1 and 100 jobs
+  -s, --sync         Sync the local mirror with OpenAI before listing
+
+Jobs are listed from a local mirror which is refreshed in the background once it is older
+than the configured TTL. Use --sync when tracking the progress of a running job
 )";
 
     fmt::print("{}\n", messages);
@@ -104,25 +292,119 @@ Options:
 
 // Upload fine tuning file ----------------------------------------------------------------------------------
 
-void upload_fine_tuning_file_(const int argc, char **argv)
+struct UploadParameters {
+    bool multipart = false;
+    std::optional<std::string> concurrency;
+    std::optional<std::string> part_size;
+    std::optional<std::string> retries;
+    std::string filename;
+};
+
+UploadParameters read_cli_upload_(const int argc, char **argv)
 {
-    if (argc == 3) {
+    UploadParameters params;
+
+    while (true) {
+        static struct option long_options[] = {
+            { "concurrency", required_argument, 0, 'c' },
+            { "help", no_argument, 0, 'h' },
+            { "multipart", no_argument, 0, 'm' },
+            { "part-size", required_argument, 0, 's' },
+            { "retries", required_argument, 0, 'r' },
+            { 0, 0, 0, 0 }
+        };
+
+        int option_index = 0;
+        const int c = getopt_long(argc, argv, "c:hmr:s:", long_options, &option_index);
+
+        if (c == -1) {
+            break;
+        }
+
+        switch (c) {
+            case 'c':
+                params.concurrency = optarg;
+                break;
+            case 'h':
+                help_fine_tune_upload_file_();
+                exit(EXIT_SUCCESS);
+            case 'm':
+                params.multipart = true;
+                break;
+            case 'r':
+                params.retries = optarg;
+                break;
+            case 's':
+                params.part_size = optarg;
+                break;
+            default:
+                utils::exit_on_failure();
+        }
+    }
+
+    // Non-option arguments are permuted to the end, i.e. "fine-tune" "upload-file" FILE
+    if (optind + 2 >= argc) {
         throw std::runtime_error("A fine tuning file needs to be provided");
     }
 
-    const std::string opt_or_filename = argv[3];
+    params.filename = argv[optind + 2];
+    return params;
+}
 
-    if (opt_or_filename == "-h" or opt_or_filename == "--help") {
-        help_fine_tune_upload_file_();
-        return;
+serialization::UploadOptions get_upload_options_(const UploadParameters &params)
+{
+    serialization::UploadOptions options;
+    options.force_multipart = params.multipart;
+
+    if (params.concurrency) {
+        options.concurrency = utils::string_to_int(params.concurrency.value());
+
+        if (options.concurrency < 1 or options.concurrency > 32) {
+            throw std::runtime_error("Concurrency must be between 1 and 32");
+        }
     }
 
-    if (opt_or_filename.empty()) {
+    if (params.retries) {
+        options.retries = utils::string_to_int(params.retries.value());
+
+        if (options.retries < 0) {
+            throw std::runtime_error("Retries must not be negative");
+        }
+    }
+
+    if (params.part_size) {
+        // OpenAI caps parts at 64 MB
+        const int mib = utils::string_to_int(params.part_size.value());
+
+        if (mib < 1 or mib > 64) {
+            throw std::runtime_error("Part size must be between 1 and 64 MiB");
+        }
+
+        options.part_size = static_cast<std::size_t>(mib) * 1024 * 1024;
+    }
+
+    return options;
+}
+
+void upload_fine_tuning_file_(const int argc, char **argv)
+{
+    const UploadParameters params = read_cli_upload_(argc, argv);
+
+    if (params.filename.empty()) {
         throw std::runtime_error("Filename is empty");
     }
 
-    const std::string id = serialization::upload_file(opt_or_filename);
-    fmt::print("Success!\nUploaded file: {}\nWith ID: {}\n", opt_or_filename, id);
+    const serialization::UploadOptions options = get_upload_options_(params);
+
+    const std::string id = serialization::upload_file(params.filename, options, [](const serialization::UploadProgress &progress) {
+        if (progress.parts_done == progress.parts_resumed and progress.parts_resumed > 0) {
+            fmt::print("Resuming upload. {} of {} parts already uploaded\n", progress.parts_resumed, progress.num_parts);
+        } else if (progress.parts_done > progress.parts_resumed) {
+            fmt::print("Uploaded part {}/{}\n", progress.parts_done, progress.num_parts);
+        }
+    });
+
+    fmt::print("Success!\nUploaded file: {}\nWith ID: {}\n", params.filename, id);
 }
 
 // Create fine tuning job -----------------------------------------------------------------------------------
@@ -206,6 +488,7 @@ void print_fine_tuning_jobs_(const VecFineTuningJobs &jobs)
 void list_fine_tuning_jobs_(const int argc, char **argv)
 {
     bool print_raw_json = false;
+    bool sync = false;
     std::optional<std::string> limit;
 
     while (true) {
@@ -213,11 +496,12 @@ void list_fine_tuning_jobs_(const int argc, char **argv)
             { "help", no_argument, 0, 'h' },
             { "json", no_argument, 0, 'j' },
             { "limit", required_argument, 0, 'l' },
+            { "sync", no_argument, 0, 's' },
             { 0, 0, 0, 0 },
         };
 
         int option_index = 0;
-        const int c = getopt_long(argc, argv, "hjl:", long_options, &option_index);
+        const int c = getopt_long(argc, argv, "hjl:s", long_options, &option_index);
 
         if (c == -1) {
             break;
@@ -233,6 +517,9 @@ void list_fine_tuning_jobs_(const int argc, char **argv)
             case 'l':
                 limit = optarg;
                 break;
+            case 's':
+                sync = true;
+                break;
             default:
                 utils::exit_on_failure();
         }
@@ -244,8 +531,12 @@ void list_fine_tuning_jobs_(const int argc, char **argv)
         }
     }
 
-    const FineTuningJobs response = serialization::get_fine_tuning_jobs(
-        utils::string_to_int(limit.value_or("20")));
+    serialization::MirrorOptions options;
+    options.sync = sync;
+    options.ttl = configs.mirror_ttl.value();
+
+    const FineTuningJobs response = serialization::get_mirrored_fine_tuning_jobs(
+        utils::string_to_int(limit.value_or("20")), options, print_raw_json);
 
     if (print_raw_json) {
         fmt::print("{}\n", response.raw_response);
@@ -280,7 +571,9 @@ void command_fine_tune(const int argc, char **argv)
         exit(EXIT_SUCCESS);
     }
 
-    if (subcommand == "upload-file") {
+    if (subcommand == "validate") {
+        validate_fine_tuning_file_(argc, argv);
+    } else if (subcommand == "upload-file") {
         upload_fine_tuning_file_(argc, argv);
     } else if (subcommand == "create-job") {
         create_fine_tuning_job_(argc, argv);
@@ -89,40 +89,11 @@ std::string get_filename_from_created_(const std::time_t &timestamp)
     return buffer;
 }
 
-std::string base64_decode_(const std::string &str_encoded)
-{
-    std::vector<int> T(256, -1);
-
-    for (int i = 0; i < 64; i++) {
-        T["ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/"[i]] = i;
-    }
-
-    int val = 0;
-    int valb = -8;
-    std::string str_decoded;
-
-    for (unsigned char c: str_encoded) {
-        if (T[c] == -1) {
-            break; // i.e. non-base64 character is found
-        }
-
-        val = (val << 6) + T[c];
-        valb += 6;
-
-        if (valb >= 0) {
-            str_decoded.push_back(char((val >> valb) & 0xFF));
-            valb -= 8;
-        }
-    }
-
-    return str_decoded;
-}
-
 using serialization::Image;
 
 void export_image_(const Image &image, const std::string &filename_png)
 {
-    const std::string b64_decoded = base64_decode_(image.b64_json);
+    const std::string b64_decoded = utils::base64_decode(image.b64_json);
     utils::write_to_png(filename_png, b64_decoded);
     fmt::print("Exported image to {}\n", filename_png);
 }
@@ -1,5 +1,6 @@
 #include "command_models.hpp"
 
+#include "configs.hpp"
 #include "models.hpp"
 #include "utils.hpp"
 
@@ -24,6 +25,10 @@ Options:
   -h, --help  Print help information and exit
   -j, --json  Print raw JSON response from OpenAI
   -u, --user  List user models if they exist. Command defaults to listing OpenAI owned models
+  -s, --sync  Sync the local mirror with OpenAI before listing
+
+Models are listed from a local mirror which is refreshed in the background once it is older
+than the configured TTL
 )";
 
     fmt::print("{}\n", messages);
@@ -32,6 +37,7 @@ Options:
 struct Parameters {
     bool print_raw_json = false;
     bool print_user_models = false;
+    bool sync = false;
 };
 
 Parameters read_cli_(const int argc, char **argv)
@@ -42,12 +48,13 @@ Parameters read_cli_(const int argc, char **argv)
         static struct option long_options[] = {
             { "help", no_argument, 0, 'h' },
             { "json", no_argument, 0, 'j' },
+            { "sync", no_argument, 0, 's' },
             { "user", no_argument, 0, 'u' },
             { 0, 0, 0, 0 }
         };
 
         int option_index = 0;
-        const int c = getopt_long(argc, argv, "hju", long_options, &option_index);
+        const int c = getopt_long(argc, argv, "hjsu", long_options, &option_index);
 
         if (c == -1) {
             break;
@@ -60,6 +67,9 @@ Parameters read_cli_(const int argc, char **argv)
             case 'j':
                 params.print_raw_json = true;
                 break;
+            case 's':
+                params.sync = true;
+                break;
             case 'u':
                 params.print_user_models = true;
                 break;
@@ -91,7 +101,12 @@ namespace commands {
 void command_models(const int argc, char **argv)
 {
     const Parameters params = read_cli_(argc, argv);
-    const serialization::Models response = serialization::get_models();
+
+    serialization::MirrorOptions options;
+    options.sync = params.sync;
+    options.ttl = configs.mirror_ttl.value();
+
+    const serialization::Models response = serialization::get_mirrored_models(options, params.print_raw_json);
 
     if (params.print_raw_json) {
         fmt::print("{}\n", response.raw_response);
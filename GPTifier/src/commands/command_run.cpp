@@ -1,10 +1,13 @@
 #include "command_run.hpp"
 
 #include "configs.hpp"
+#include "context.hpp"
 #include "datadir.hpp"
+#include "parallel.hpp"
 #include "responses.hpp"
 #include "utils.hpp"
 
+#include <algorithm>
 #include <array>
 #include <atomic>
 #include <chrono>
@@ -16,6 +19,7 @@
 #include <stdexcept>
 #include <string>
 #include <thread>
+#include <vector>
 
 namespace {
 
@@ -41,12 +45,24 @@ Options:
   -r, --read-from-file=FILENAME  Read prompt from a custom file named FILENAME
   -t, --temperature=TEMPERATURE  Provide a sampling temperature between 0 and 2. Note that
                                  temperature will be clamped between 0 and 2
+  -c, --context-from=STORE       Prepend the chunks of STORE (see "gpt embed ingest") most
+                                 relevant to the prompt
+  -k, --top-k=K                  Consider the K most relevant chunks (default 5)
+  -b, --context-budget=TOKENS    Spend at most roughly TOKENS tokens on context (default 2000)
+  -M, --models=MODELS            Send the prompt to each of the comma separated MODELS at once and
+                                 compare their latency, time to first token and throughput. Prefix
+                                 Ollama models with "ollama:". The outputs are exported to FILE (see
+                                 -o) or to ~/.gptifier/comparison.gpt
 
 Examples:
   > Run an interaction session:
     $ gpt run
   > Run a query non-interactively and export results
     $ gpt run --prompt="What is 3 + 5?" --file="/tmp/results.json"
+  > Ask a question about a repository ingested into store "myrepo":
+    $ gpt run --context-from=myrepo --prompt="How are stores locked?"
+  > Compare an OpenAI model with an Ollama model:
+    $ gpt run --models=gpt-4o-mini,ollama:gemma3:latest --prompt="What is 3 + 5?"
 )";
 
     fmt::print("{}\n", messages);
@@ -54,11 +70,15 @@ Examples:
 
 struct Parameters {
     bool use_local = false;
+    std::optional<std::string> context_budget;
+    std::optional<std::string> context_store;
     std::optional<std::string> json_dump_file;
     std::optional<std::string> model;
+    std::optional<std::string> models;
     std::optional<std::string> prompt;
     std::optional<std::string> prompt_file;
     std::optional<std::string> temperature;
+    std::optional<std::string> top_k;
 };
 
 Parameters read_cli_(const int argc, char **argv)
@@ -74,11 +94,15 @@ Parameters read_cli_(const int argc, char **argv)
             { "prompt", required_argument, 0, 'p' },
             { "read-from-file", required_argument, 0, 'r' },
             { "temperature", required_argument, 0, 't' },
+            { "context-from", required_argument, 0, 'c' },
+            { "top-k", required_argument, 0, 'k' },
+            { "context-budget", required_argument, 0, 'b' },
+            { "models", required_argument, 0, 'M' },
             { 0, 0, 0, 0 },
         };
 
         int option_index = 0;
-        const int c = getopt_long(argc, argv, "ho:m:lp:r:t:", long_options, &option_index);
+        const int c = getopt_long(argc, argv, "ho:m:lp:r:t:c:k:b:M:", long_options, &option_index);
 
         if (c == -1) {
             break;
@@ -106,6 +130,18 @@ Parameters read_cli_(const int argc, char **argv)
             case 'l':
                 params.use_local = true;
                 break;
+            case 'c':
+                params.context_store = optarg;
+                break;
+            case 'k':
+                params.top_k = optarg;
+                break;
+            case 'b':
+                params.context_budget = optarg;
+                break;
+            case 'M':
+                params.models = optarg;
+                break;
             default:
                 utils::exit_on_failure();
         }
@@ -129,6 +165,14 @@ Parameters read_cli_(const int argc, char **argv)
         }
     }
 
+    if (params.models and (params.model or params.use_local)) {
+        throw std::runtime_error("Cannot combine --models with --model or --use-local");
+    }
+
+    if ((params.top_k or params.context_budget) and not params.context_store) {
+        throw std::runtime_error("Top k and context budget can only be used alongside --context-from");
+    }
+
     return params;
 }
 
@@ -159,6 +203,29 @@ std::string get_prompt_(const Parameters &params)
     return prompt;
 }
 
+// Retrieval ------------------------------------------------------------------------------------------------
+
+retrieval::Context add_context_(const Parameters &params, const std::string &prompt)
+{
+    retrieval::ContextOptions options;
+
+    if (params.top_k) {
+        options.search_options.top_k = utils::string_to_int(params.top_k.value());
+    }
+
+    if (params.context_budget) {
+        options.token_budget = utils::string_to_int(params.context_budget.value());
+    }
+
+    const retrieval::Context context = retrieval::build_context(params.context_store.value(), prompt, options);
+
+    fmt::print("Retrieved {} chunks (~{} tokens) from store '{}' in {:.3f} s\n",
+        context.num_chunks, context.num_tokens, params.context_store.value(), context.retrieval_time.count());
+    utils::separator();
+
+    return context;
+}
+
 // Completion -----------------------------------------------------------------------------------------------
 
 using serialization::Response;
@@ -238,7 +305,9 @@ Response create_ollama_response_(const std::string &model, const std::string &pr
 
 // Output ---------------------------------------------------------------------------------------------------
 
-void dump_response_to_json_file_(const Response &response, const std::string &json_dump_file)
+using Seconds = std::chrono::duration<float>;
+
+void dump_response_to_json_file_(const Response &response, const Seconds &retrieval_time, const std::string &json_dump_file)
 {
     const nlohmann::json json = {
         { "created", response.created },
@@ -247,6 +316,7 @@ void dump_response_to_json_file_(const Response &response, const std::string &js
         { "model", response.model },
         { "output", response.output },
         { "output_tokens", response.output_tokens },
+        { "retrieval_time", retrieval_time.count() },
         { "rtt", response.rtt.count() },
         { "source", response.source },
     };
@@ -282,13 +352,18 @@ void print_token_to_word_count_ratio_(int num_tokens, int num_words)
     }
 }
 
-void print_inference_usage_statistics_(const Response &response)
+void print_inference_usage_statistics_(const Response &response, const Seconds &retrieval_time)
 {
     const int wc_input = utils::get_word_count(response.input);
     const int wc_output = utils::get_word_count(response.output);
 
     fmt::print(fg(white), "Usage:\n");
     fmt::print("Model: {}\n", response.model);
+
+    if (retrieval_time.count() > 0) {
+        fmt::print("Retrieval time: {} s\n", retrieval_time.count());
+    }
+
     fmt::print("RTT: {} s\n", response.rtt.count());
     fmt::print("\n");
 
@@ -353,9 +428,9 @@ void dump_response_to_completions_file_(const Response &response)
 
 #pragma GCC diagnostic pop
 
-void process_outgoing_response_(const Response &response)
+void process_outgoing_response_(const Response &response, const Seconds &retrieval_time)
 {
-    print_inference_usage_statistics_(response);
+    print_inference_usage_statistics_(response, retrieval_time);
     utils::separator();
 
     print_completion_to_stdout_(response.output);
@@ -369,7 +444,7 @@ void process_outgoing_response_(const Response &response)
 
 // OpenAI / Ollama ------------------------------------------------------------------------------------------
 
-void run_ollama_query_(const Parameters &params, const std::string &prompt)
+void run_ollama_query_(const Parameters &params, const std::string &prompt, const Seconds &retrieval_time)
 {
     std::string model;
 
@@ -386,13 +461,13 @@ void run_ollama_query_(const Parameters &params, const std::string &prompt)
     const Response response = create_ollama_response_(model, prompt);
 
     if (params.json_dump_file) {
-        dump_response_to_json_file_(response, params.json_dump_file.value());
+        dump_response_to_json_file_(response, retrieval_time, params.json_dump_file.value());
     } else {
-        process_outgoing_response_(response);
+        process_outgoing_response_(response, retrieval_time);
     }
 }
 
-void run_openai_query_(const Parameters &params, const std::string &prompt)
+void run_openai_query_(const Parameters &params, const std::string &prompt, const Seconds &retrieval_time)
 {
     std::string model;
 
@@ -414,12 +489,164 @@ void run_openai_query_(const Parameters &params, const std::string &prompt)
     const Response response = create_openai_response_(model, prompt, temperature);
 
     if (params.json_dump_file) {
-        dump_response_to_json_file_(response, params.json_dump_file.value());
+        dump_response_to_json_file_(response, retrieval_time, params.json_dump_file.value());
     } else {
-        process_outgoing_response_(response);
+        process_outgoing_response_(response, retrieval_time);
     }
 }
 
+// Comparison -----------------------------------------------------------------------------------------------
+
+struct Contender {
+    bool use_local = false;
+    std::string model;
+    std::optional<Response> response;
+    std::string error;
+};
+
+std::vector<Contender> get_contenders_(const std::string &models)
+{
+    static const std::string prefix_ollama = "ollama:";
+    static const std::string prefix_openai = "openai:";
+
+    std::vector<Contender> contenders;
+    std::size_t start = 0;
+
+    while (start <= models.size()) {
+        std::size_t end = models.find(',', start);
+
+        if (end == std::string::npos) {
+            end = models.size();
+        }
+
+        Contender contender;
+        contender.model = models.substr(start, end - start);
+        start = end + 1;
+
+        if (contender.model.starts_with(prefix_ollama)) {
+            contender.use_local = true;
+            contender.model.erase(0, prefix_ollama.size());
+        } else if (contender.model.starts_with(prefix_openai)) {
+            contender.model.erase(0, prefix_openai.size());
+        }
+
+        if (contender.model.empty()) {
+            throw std::runtime_error("Models must be a comma separated list of model names");
+        }
+
+        contenders.push_back(std::move(contender));
+    }
+
+    return contenders;
+}
+
+float get_tokens_per_second_(const Response &response)
+{
+    // Only count the time spent generating, since the time to the first token is reported separately
+    const float generation_time = response.rtt.count() - response.ttft.count();
+
+    if (generation_time <= 0.0) {
+        return 0.0;
+    }
+
+    return response.output_tokens / generation_time;
+}
+
+void print_comparison_(const std::vector<Contender> &contenders)
+{
+    std::size_t width = 5;
+
+    for (const auto &contender: contenders) {
+        width = std::max(width, contender.model.size());
+    }
+
+    fmt::print(fg(white), "{:<{}}  {:<6}  {:>8}  {:>8}  {:>8}  {:>8}  {:>10}",
+        "Model", width, "Source", "RTT (s)", "TTFT (s)", "Input", "Output", "Tokens/s");
+    fmt::print("\n");
+
+    for (const auto &contender: contenders) {
+        const std::string source = contender.use_local ? "Ollama" : "OpenAI";
+
+        if (not contender.response) {
+            fmt::print("{:<{}}  {:<6}  ", contender.model, width, source);
+            fmt::print(fg(red), "{}", contender.error);
+            fmt::print("\n");
+            continue;
+        }
+
+        const Response &response = contender.response.value();
+
+        fmt::print("{:<{}}  {:<6}  {:>8.3f}  {:>8.3f}  {:>8}  {:>8}  {:>10.1f}\n",
+            contender.model, width, source, response.rtt.count(), response.ttft.count(),
+            response.input_tokens, response.output_tokens, get_tokens_per_second_(response));
+    }
+}
+
+void export_comparison_(const std::string &prompt, const std::vector<Contender> &contenders, const std::string &filename)
+{
+    nlohmann::json results = nlohmann::json::array();
+
+    for (const auto &contender: contenders) {
+        nlohmann::json result = {
+            { "model", contender.model },
+            { "source", contender.use_local ? "Ollama" : "OpenAI" },
+        };
+
+        if (contender.response) {
+            const Response &response = contender.response.value();
+
+            result["created"] = response.created;
+            result["input_tokens"] = response.input_tokens;
+            result["output"] = response.output;
+            result["output_tokens"] = response.output_tokens;
+            result["rtt"] = response.rtt.count();
+            result["tokens_per_second"] = get_tokens_per_second_(response);
+            result["ttft"] = response.ttft.count();
+        } else {
+            result["error"] = contender.error;
+        }
+
+        results.push_back(std::move(result));
+    }
+
+    const nlohmann::json json = {
+        { "prompt", prompt },
+        { "results", results },
+    };
+
+    fmt::print("Dumping results to '{}'\n", filename);
+    utils::write_to_file(filename, json.dump(2));
+}
+
+void run_comparison_(const Parameters &params, const std::string &prompt)
+{
+    std::vector<Contender> contenders = get_contenders_(params.models.value());
+    const float temperature = utils::string_to_float(params.temperature.value_or("1.00"));
+
+    fmt::print("Sending prompt to {} models\n", contenders.size());
+
+    // Every model gets its own thread so that all requests are in flight at the same time
+    parallel::for_each_index(contenders.size(), contenders.size(), [&](const std::size_t i) {
+        Contender &contender = contenders[i];
+
+        try {
+            if (contender.use_local) {
+                contender.response = serialization::stream_ollama_response(prompt, contender.model);
+            } else {
+                contender.response = serialization::stream_openai_response(prompt, contender.model, temperature);
+            }
+        } catch (const std::runtime_error &e) {
+            contender.error = e.what();
+        }
+    });
+
+    utils::separator();
+    print_comparison_(contenders);
+    utils::separator();
+
+    export_comparison_(prompt, contenders, params.json_dump_file.value_or(datadir::GPT_COMPARISON.string()));
+}
+
 } // namespace
 
 namespace commands {
@@ -429,16 +656,26 @@ void command_run(const int argc, char **argv)
     const Parameters params = read_cli_(argc, argv);
 
     utils::separator();
-    const std::string prompt = get_prompt_(params);
+    std::string prompt = get_prompt_(params);
 
     if (prompt.empty()) {
         throw std::runtime_error("Prompt is empty");
     }
 
-    if (params.use_local) {
-        run_ollama_query_(params, prompt);
+    Seconds retrieval_time(0);
+
+    if (params.context_store) {
+        retrieval::Context context = add_context_(params, prompt);
+        prompt = std::move(context.prompt);
+        retrieval_time = context.retrieval_time;
+    }
+
+    if (params.models) {
+        run_comparison_(params, prompt);
+    } else if (params.use_local) {
+        run_ollama_query_(params, prompt, retrieval_time);
     } else {
-        run_openai_query_(params, prompt);
+        run_openai_query_(params, prompt, retrieval_time);
     }
 }
 
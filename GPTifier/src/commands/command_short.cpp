@@ -1,13 +1,21 @@
 #include "command_short.hpp"
 
 #include "configs.hpp"
+#include "context.hpp"
+#include "datadir.hpp"
+#include "hedging.hpp"
+#include "response_cache.hpp"
 #include "responses.hpp"
+#include "router.hpp"
 #include "utils.hpp"
 
+#include <chrono>
+#include <exception>
 #include <fmt/core.h>
 #include <getopt.h>
 #include <optional>
 #include <string>
+#include <vector>
 
 namespace {
 
@@ -26,10 +34,31 @@ Options:
   -m, --model                    Select model
   -t, --temperature=TEMPERATURE  Provide a sampling temperature between 0 and 2. Note that
                                  temperature will be clamped between 0 and 2
+  -c, --context-from=STORE       Prepend the chunks of STORE (see "gpt embed ingest") most
+                                 relevant to the prompt. Timings are printed to stderr
+  -k, --top-k=K                  Consider the K most relevant chunks (default 5)
+  -b, --context-budget=TOKENS    Spend at most roughly TOKENS tokens on context (default 2000)
+  -C, --cache                    Reuse the cached response of a previous prompt that is similar
+                                 enough to PROMPT and was answered by the same model. Prompts are
+                                 compared by embedding. Cache hits are reported on stderr. The
+                                 cache is not used when a temperature is given
+  -N, --no-cache                 Do not use the cache even if enabled in the configuration file
+  -T, --cache-threshold=COSINE   Minimum similarity between prompts for a cache hit (default 0.95)
+  -H, --hedge                    Send a duplicate request if the response is slower than usual and
+                                 use whichever returns first. Hedges fired are reported on stderr
+  -P, --hedge-percentile=P       Hedge once a request takes longer than the P-th percentile of
+                                 recent latencies (default 95)
+  -B, --hedge-budget=FRACTION    Hedge at most FRACTION of requests (default 0.1)
+  -R, --route                    Pick OpenAI or Ollama based on the length of the prompt and the
+                                 recent latency and error rate of each, falling back to the other
+                                 if the request fails. See the [router] section of the configuration
+                                 file for the limits. Cannot be used with --use-local or --model
 
 Examples:
   > Create a chat completion:
     $ gpt short "What is 2 + 2?"
+  > Ask a question about a repository ingested into store "myrepo":
+    $ gpt short --context-from=myrepo "Where are stores saved?"
 )";
 
     fmt::print("{}\n", messages);
@@ -38,9 +67,18 @@ Examples:
 struct Parameters {
     bool print_raw_json = false;
     bool use_local = false;
+    std::optional<bool> use_cache;
+    std::optional<bool> use_hedging;
+    std::optional<bool> use_routing;
+    std::optional<std::string> cache_threshold;
+    std::optional<std::string> context_budget;
+    std::optional<std::string> context_store;
+    std::optional<std::string> hedge_budget;
+    std::optional<std::string> hedge_percentile;
     std::optional<std::string> model;
     std::optional<std::string> prompt;
     std::optional<std::string> temperature;
+    std::optional<std::string> top_k;
 };
 
 Parameters read_cli_(const int argc, char **argv)
@@ -54,11 +92,21 @@ Parameters read_cli_(const int argc, char **argv)
             { "model", required_argument, 0, 'm' },
             { "temperature", required_argument, 0, 't' },
             { "use-local", no_argument, 0, 'l' },
+            { "context-from", required_argument, 0, 'c' },
+            { "top-k", required_argument, 0, 'k' },
+            { "context-budget", required_argument, 0, 'b' },
+            { "cache", no_argument, 0, 'C' },
+            { "no-cache", no_argument, 0, 'N' },
+            { "cache-threshold", required_argument, 0, 'T' },
+            { "hedge", no_argument, 0, 'H' },
+            { "hedge-percentile", required_argument, 0, 'P' },
+            { "hedge-budget", required_argument, 0, 'B' },
+            { "route", no_argument, 0, 'R' },
             { 0, 0, 0, 0 }
         };
 
         int option_index = 0;
-        const int c = getopt_long(argc, argv, "hjm:t:l", long_options, &option_index);
+        const int c = getopt_long(argc, argv, "hjm:t:lc:k:b:CNT:HP:B:R", long_options, &option_index);
 
         if (c == -1) {
             break;
@@ -80,6 +128,36 @@ Parameters read_cli_(const int argc, char **argv)
             case 'l':
                 params.use_local = true;
                 break;
+            case 'c':
+                params.context_store = optarg;
+                break;
+            case 'k':
+                params.top_k = optarg;
+                break;
+            case 'b':
+                params.context_budget = optarg;
+                break;
+            case 'C':
+                params.use_cache = true;
+                break;
+            case 'N':
+                params.use_cache = false;
+                break;
+            case 'T':
+                params.cache_threshold = optarg;
+                break;
+            case 'H':
+                params.use_hedging = true;
+                break;
+            case 'P':
+                params.hedge_percentile = optarg;
+                break;
+            case 'B':
+                params.hedge_budget = optarg;
+                break;
+            case 'R':
+                params.use_routing = true;
+                break;
             default:
                 utils::exit_on_failure();
         }
@@ -98,22 +176,57 @@ Parameters read_cli_(const int argc, char **argv)
         }
     }
 
+    if (params.use_routing and (params.use_local or params.model)) {
+        throw std::runtime_error("Routing cannot be combined with --use-local or --model");
+    }
+
+    if ((params.top_k or params.context_budget) and not params.context_store) {
+        throw std::runtime_error("Top k and context budget can only be used alongside --context-from");
+    }
+
     return params;
 }
 
-void create_ollama_response_(const Parameters &params)
+std::string add_context_(const Parameters &params)
 {
-    std::string model;
+    retrieval::ContextOptions options;
 
-    if (params.model) {
-        model = params.model.value();
-    } else {
-        model = configs.model_short_ollama.value();
+    if (params.top_k) {
+        const int top_k = utils::string_to_int(params.top_k.value());
+
+        if (top_k < 1) {
+            throw std::runtime_error("Top k must be positive");
+        }
+
+        options.search_options.top_k = static_cast<std::size_t>(top_k);
+    }
+
+    if (params.context_budget) {
+        options.token_budget = utils::string_to_int(params.context_budget.value());
+
+        if (options.token_budget < 1) {
+            throw std::runtime_error("Context budget must be positive");
+        }
     }
 
-    const serialization::Response response = serialization::create_ollama_response(
-        params.prompt.value(), model);
+    retrieval::Context context = retrieval::build_context(params.context_store.value(), params.prompt.value(), options);
+
+    // Keep stdout limited to the response so that the output can still be piped
+    fmt::print(stderr, "Retrieval: {:.3f} s ({} chunks, ~{} tokens)\n",
+        context.retrieval_time.count(), context.num_chunks, context.num_tokens);
+
+    return std::move(context.prompt);
+}
+
+void print_generation_time_(const Parameters &params, const serialization::Response &response)
+{
+    if (params.context_store) {
+        fmt::print(stderr, "Generation: {:.3f} s\n", response.rtt.count());
+    }
+}
 
+void print_response_(const Parameters &params, const serialization::Response &response)
+{
     if (params.print_raw_json) {
         fmt::print("{}\n", response.raw_response);
         return;
@@ -122,27 +235,137 @@ void create_ollama_response_(const Parameters &params)
     fmt::print("{}\n", response.output);
 }
 
-void create_openai_response_(const Parameters &params)
+std::optional<retrieval::ResponseCache> open_cache_(const Parameters &params, const bool use_local)
 {
-    std::string model;
+    if (not params.use_cache.value_or(configs.cache_short.value_or(false))) {
+        return std::nullopt;
+    }
+
+    // Cached responses are not keyed by temperature, so a response sampled differently may not be reused
+    if (params.temperature) {
+        return std::nullopt;
+    }
+
+    retrieval::CacheOptions options;
+    options.embed_options.use_local = use_local;
 
-    if (params.model) {
-        model = params.model.value();
+    if (use_local) {
+        options.embed_options.model = configs.model_embed_ollama.value();
     } else {
-        model = configs.model_short_openai.value();
+        options.embed_options.model = configs.model_embed_openai.value();
     }
 
-    const float temperature = utils::string_to_float(params.temperature.value_or("1.00"));
+    if (params.cache_threshold) {
+        options.threshold = utils::string_to_float(params.cache_threshold.value());
+    } else {
+        options.threshold = configs.cache_threshold_short.value_or(options.threshold);
+    }
 
-    const serialization::Response response = serialization::create_openai_response(
-        params.prompt.value(), model, temperature);
+    return retrieval::ResponseCache(datadir::GPT_CACHE, options);
+}
 
-    if (params.print_raw_json) {
-        fmt::print("{}\n", response.raw_response);
-        return;
+void set_hedge_policy_(const Parameters &params)
+{
+    networking::HedgePolicy policy;
+    policy.enabled = params.use_hedging.value_or(configs.hedge_short.value_or(false));
+
+    if (params.hedge_percentile) {
+        policy.percentile = utils::string_to_float(params.hedge_percentile.value());
+    } else {
+        policy.percentile = configs.hedge_percentile_short.value_or(policy.percentile);
     }
 
-    fmt::print("{}\n", response.output);
+    if (params.hedge_budget) {
+        policy.budget = utils::string_to_float(params.hedge_budget.value());
+    } else {
+        policy.budget = configs.hedge_budget_short.value_or(policy.budget);
+    }
+
+    networking::set_hedge_policy(policy);
+}
+
+void print_hedges_fired_()
+{
+    const int hedges_fired = networking::get_hedges_fired();
+
+    if (hedges_fired > 0) {
+        fmt::print(stderr, "Hedges fired: {}\n", hedges_fired);
+    }
+}
+
+std::vector<routing::Route> get_routes_(const Parameters &params, const std::string &prompt, const routing::RouterOptions &options)
+{
+    if (params.use_routing.value_or(configs.route_short.value_or(false) and not params.use_local and not params.model)) {
+        return routing::plan_routes(prompt, options);
+    }
+
+    routing::Route route;
+    route.backend = params.use_local ? routing::Backend::Ollama : routing::Backend::OpenAI;
+    route.model = params.model.value_or(params.use_local ? options.model_ollama : options.model_openai);
+
+    return { route };
+}
+
+routing::RouterOptions get_router_options_(const Parameters &params)
+{
+    routing::RouterOptions options;
+
+    options.cooldown = configs.router_cooldown.value_or(options.cooldown);
+    options.local_token_limit = configs.router_local_token_limit.value_or(options.local_token_limit);
+    options.limits_ollama.max_error_rate = configs.router_max_error_rate_ollama.value_or(options.limits_ollama.max_error_rate);
+    options.limits_ollama.max_latency = configs.router_max_latency_ollama.value_or(options.limits_ollama.max_latency);
+    options.limits_openai.max_error_rate = configs.router_max_error_rate_openai.value_or(options.limits_openai.max_error_rate);
+    options.limits_openai.max_latency = configs.router_max_latency_openai.value_or(options.limits_openai.max_latency);
+    options.model_ollama = configs.model_short_ollama.value();
+    options.model_openai = configs.model_short_openai.value();
+    options.temperature = utils::string_to_float(params.temperature.value_or("1.00"));
+
+    return options;
+}
+
+void create_response_(const Parameters &params, const std::string &prompt)
+{
+    const routing::RouterOptions options = get_router_options_(params);
+    const std::vector<routing::Route> routes = get_routes_(params, prompt, options);
+
+    // The cache is looked up for the route expected to serve the prompt
+    const routing::Route &route = routes.front();
+    const std::string source = routing::get_backend_name(route.backend);
+
+    std::optional<retrieval::ResponseCache> cache = open_cache_(params, route.backend == routing::Backend::Ollama);
+
+    if (cache) {
+        const auto start = std::chrono::steady_clock::now();
+        const std::optional<retrieval::CacheHit> hit = cache->find(prompt, route.model, source);
+        const std::chrono::duration<float> elapsed = std::chrono::steady_clock::now() - start;
+
+        if (hit) {
+            fmt::print(stderr, "Cache hit: {:.3f} s (similarity {:.3f})\n", elapsed.count(), hit->similarity);
+            print_response_(params, hit->response);
+            return;
+        }
+    }
+
+    routing::RouterCallbacks callbacks;
+    callbacks.on_fallback = [](const routing::Route &failed, const std::string &error) {
+        fmt::print(stderr, "{} failed: {}\nFalling back to the next backend\n", routing::get_backend_name(failed.backend), error);
+    };
+
+    const serialization::Response response = routing::create_routed_response(prompt, routes, options, callbacks);
+
+    print_generation_time_(params, response);
+    print_hedges_fired_();
+    print_response_(params, response);
+
+    // Only cache once the response is out, so that a failure to cache never costs the response itself. A
+    // response from a fallback route is not cached since it was not looked up for that route
+    if (cache and response.source == source) {
+        try {
+            cache->insert(route.model, response);
+        } catch (const std::exception &e) {
+            fmt::print(stderr, "Warning! Failed to cache response: {}\n", e.what());
+        }
+    }
 }
 
 } // namespace
@@ -161,11 +384,14 @@ void command_short(const int argc, char **argv)
         throw std::runtime_error("Prompt is empty");
     }
 
-    if (params.use_local) {
-        create_ollama_response_(params);
-    } else {
-        create_openai_response_(params);
+    set_hedge_policy_(params);
+    std::string prompt = params.prompt.value();
+
+    if (params.context_store) {
+        prompt = add_context_(params);
     }
+
+    create_response_(params, prompt);
 }
 
 } // namespace commands
@@ -23,6 +23,10 @@ void Configs::load_configs_from_config_file()
     // ollama
     this->host_ollama = table["ollama"]["host"].value_or<std::string>("localhost");
     this->port_ollama = table["ollama"]["port"].value_or<int>(11434);
+    this->base_url_ollama = table["ollama"]["base_url"].value<std::string>();
+
+    // openai
+    this->base_url_openai = table["openai"]["base_url"].value_or<std::string>("https://api.openai.com/v1");
 
     // run command
     this->model_run_openai = table["command"]["run"]["model"].value_or<std::string>("gpt-4o");
@@ -31,6 +35,23 @@ void Configs::load_configs_from_config_file()
     // short command
     this->model_short_openai = table["command"]["short"]["model"].value_or<std::string>("gpt-4o");
     this->model_short_ollama = table["command"]["short"]["model_ollama"].value_or<std::string>("gemma3:latest");
+    this->cache_short = table["command"]["short"]["cache"].value_or<bool>(false);
+    this->cache_threshold_short = table["command"]["short"]["cache_threshold"].value_or<double>(0.95);
+    this->hedge_short = table["command"]["short"]["hedge"].value_or<bool>(false);
+    this->hedge_percentile_short = table["command"]["short"]["hedge_percentile"].value_or<double>(95.0);
+    this->hedge_budget_short = table["command"]["short"]["hedge_budget"].value_or<double>(0.1);
+    this->route_short = table["command"]["short"]["route"].value_or<bool>(false);
+
+    // routing between OpenAI and Ollama
+    this->router_local_token_limit = table["router"]["local_token_limit"].value_or<int>(1000);
+    this->router_cooldown = table["router"]["cooldown"].value_or<int>(60);
+    this->router_max_latency_openai = table["router"]["openai"]["max_latency"].value_or<double>(30.0);
+    this->router_max_latency_ollama = table["router"]["ollama"]["max_latency"].value_or<double>(30.0);
+    this->router_max_error_rate_openai = table["router"]["openai"]["max_error_rate"].value_or<double>(0.5);
+    this->router_max_error_rate_ollama = table["router"]["ollama"]["max_error_rate"].value_or<double>(0.5);
+
+    // local mirror of files, models and fine-tuning jobs
+    this->mirror_ttl = table["mirror"]["ttl"].value_or<int>(300);
 
     // embed command
     this->model_embed_openai = table["command"]["embed"]["model"].value_or<std::string>("text-embedding-3-small");
@@ -6,7 +6,22 @@
 struct Configs {
     void load_configs_from_config_file();
 
+    std::optional<bool> cache_short;
+    std::optional<float> cache_threshold_short;
+    std::optional<bool> hedge_short;
+    std::optional<bool> route_short;
+    std::optional<float> hedge_budget_short;
+    std::optional<float> hedge_percentile_short;
+    std::optional<float> router_max_error_rate_ollama;
+    std::optional<float> router_max_error_rate_openai;
+    std::optional<float> router_max_latency_ollama;
+    std::optional<float> router_max_latency_openai;
+    std::optional<int> mirror_ttl;
+    std::optional<int> router_cooldown;
+    std::optional<int> router_local_token_limit;
     std::optional<int> port_ollama;
+    std::optional<std::string> base_url_ollama;
+    std::optional<std::string> base_url_openai;
     std::optional<std::string> host_ollama;
     std::optional<std::string> model_embed_ollama;
     std::optional<std::string> model_embed_openai;
@@ -34,5 +34,13 @@ const fs::path GPT_DATADIR = get_project_data_dir_();
 const fs::path GPT_CONFIG = GPT_DATADIR / "gptifier.toml";
 const fs::path GPT_COMPLETIONS = GPT_DATADIR / "completions.gpt";
 const fs::path GPT_EMBEDDINGS = GPT_DATADIR / "embeddings.gpt";
+const fs::path GPT_CLUSTERS = GPT_DATADIR / "clusters.gpt";
+const fs::path GPT_DUPLICATES = GPT_DATADIR / "duplicates.gpt";
+const fs::path GPT_COMPARISON = GPT_DATADIR / "comparison.gpt";
+const fs::path GPT_BENCH = GPT_DATADIR / "bench.gpt";
+const fs::path GPT_STORES = GPT_DATADIR / "stores";
+const fs::path GPT_CACHE = GPT_DATADIR / "cache";
+const fs::path GPT_UPLOADS = GPT_DATADIR / "uploads";
+const fs::path GPT_MIRROR = GPT_DATADIR / "mirror";
 
 } // namespace datadir
@@ -5,8 +5,16 @@
 namespace datadir {
 
 extern const std::filesystem::path GPT_DATADIR;
+extern const std::filesystem::path GPT_BENCH;
+extern const std::filesystem::path GPT_CACHE;
+extern const std::filesystem::path GPT_CLUSTERS;
+extern const std::filesystem::path GPT_COMPARISON;
 extern const std::filesystem::path GPT_COMPLETIONS;
 extern const std::filesystem::path GPT_CONFIG;
+extern const std::filesystem::path GPT_DUPLICATES;
 extern const std::filesystem::path GPT_EMBEDDINGS;
+extern const std::filesystem::path GPT_MIRROR;
+extern const std::filesystem::path GPT_STORES;
+extern const std::filesystem::path GPT_UPLOADS;
 
 } // namespace datadir
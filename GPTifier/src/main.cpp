@@ -1,3 +1,4 @@
+#include "command_bench.hpp"
 #include "command_costs.hpp"
 #include "command_embed.hpp"
 #include "command_files.hpp"
@@ -39,6 +40,7 @@ Commands:
   fine-tune      Manage fine tuning operations
   costs          Get OpenAI usage details
   img            Generate an image from a prompt
+  bench          Measure latency and throughput of a backend under load
 
 Try 'gpt <subcommand> [-h | --help]' for subcommand specific help.
 )";
@@ -107,6 +109,8 @@ int main(int argc, char **argv)
             commands::command_test(argc, argv);
         } else if (command == "img") {
             commands::command_img(argc, argv);
+        } else if (command == "bench") {
+            commands::command_bench(argc, argv);
         } else {
             throw std::runtime_error("Received unknown command. Re-run with -h or --help");
         }
@@ -0,0 +1,151 @@
+#include "md5.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fmt/core.h>
+
+namespace utils {
+
+namespace {
+
+const std::uint32_t MD5_SHIFTS[64] = {
+    7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22,
+    5, 9, 14, 20, 5, 9, 14, 20, 5, 9, 14, 20, 5, 9, 14, 20,
+    4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23,
+    6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21
+};
+
+// floor(abs(sin(i + 1)) * 2^32)
+const std::uint32_t MD5_CONSTANTS[64] = {
+    0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+    0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be, 0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+    0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+    0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+    0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+    0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+    0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+    0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391
+};
+
+std::uint32_t rotate_left_(const std::uint32_t value, const std::uint32_t shift)
+{
+    return (value << shift) | (value >> (32 - shift));
+}
+
+} // namespace
+
+Md5::Md5() :
+    state_({ 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476 })
+{
+}
+
+void Md5::transform_(const unsigned char *block)
+{
+    std::uint32_t words[16];
+
+    for (int i = 0; i < 16; ++i) {
+        words[i] = std::uint32_t(block[i * 4]) | std::uint32_t(block[i * 4 + 1]) << 8 | std::uint32_t(block[i * 4 + 2]) << 16 | std::uint32_t(block[i * 4 + 3]) << 24;
+    }
+
+    std::uint32_t a = this->state_[0];
+    std::uint32_t b = this->state_[1];
+    std::uint32_t c = this->state_[2];
+    std::uint32_t d = this->state_[3];
+
+    for (int i = 0; i < 64; ++i) {
+        std::uint32_t f = 0;
+        int g = 0;
+
+        if (i < 16) {
+            f = (b & c) | (~b & d);
+            g = i;
+        } else if (i < 32) {
+            f = (d & b) | (~d & c);
+            g = (5 * i + 1) % 16;
+        } else if (i < 48) {
+            f = b ^ c ^ d;
+            g = (3 * i + 5) % 16;
+        } else {
+            f = c ^ (b | ~d);
+            g = (7 * i) % 16;
+        }
+
+        const std::uint32_t temp = d;
+        d = c;
+        c = b;
+        b = b + rotate_left_(a + f + MD5_CONSTANTS[i] + words[g], MD5_SHIFTS[i]);
+        a = temp;
+    }
+
+    this->state_[0] += a;
+    this->state_[1] += b;
+    this->state_[2] += c;
+    this->state_[3] += d;
+}
+
+void Md5::update(const std::string_view data)
+{
+    const unsigned char *ptr = reinterpret_cast<const unsigned char *>(data.data());
+    std::size_t remaining = data.size();
+    std::size_t buffered = this->length_ % 64;
+
+    this->length_ += data.size();
+
+    if (buffered > 0) {
+        const std::size_t take = std::min(remaining, 64 - buffered);
+        std::memcpy(this->buffer_.data() + buffered, ptr, take);
+
+        ptr += take;
+        remaining -= take;
+        buffered += take;
+
+        if (buffered < 64) {
+            return;
+        }
+
+        this->transform_(this->buffer_.data());
+    }
+
+    for (; remaining >= 64; ptr += 64, remaining -= 64) {
+        this->transform_(ptr);
+    }
+
+    std::memcpy(this->buffer_.data(), ptr, remaining);
+}
+
+std::string Md5::hex_digest()
+{
+    const std::uint64_t length_bits = this->length_ * 8;
+
+    // Pad with a single 1 bit and zeros up to 56 bytes (mod 64), then append the length in bits
+    const std::size_t buffered = this->length_ % 64;
+    const std::size_t padding = buffered < 56 ? 56 - buffered : 120 - buffered;
+
+    std::string tail(padding + 8, '\0');
+    tail[0] = static_cast<char>(0x80);
+
+    for (int i = 0; i < 8; ++i) {
+        tail[padding + i] = static_cast<char>((length_bits >> (8 * i)) & 0xff);
+    }
+
+    this->update(tail);
+
+    std::string digest;
+
+    for (const std::uint32_t word: this->state_) {
+        for (int i = 0; i < 4; ++i) {
+            digest += fmt::format("{:02x}", (word >> (8 * i)) & 0xff);
+        }
+    }
+
+    return digest;
+}
+
+std::string md5_hex(const std::string_view data)
+{
+    Md5 md5;
+    md5.update(data);
+    return md5.hex_digest();
+}
+
+} // namespace utils
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace utils {
+
+// Incremental MD5 (RFC 1321). Used to let OpenAI verify uploaded bytes and to detect local changes to parts of
+// a resumed upload. It is not meant for anything security related
+class Md5 {
+public:
+    Md5();
+
+    void update(std::string_view data);
+
+    // Finalizes the digest. The object must not be updated afterwards
+    std::string hex_digest();
+
+private:
+    void transform_(const unsigned char *block);
+
+    std::array<std::uint32_t, 4> state_;
+    std::array<unsigned char, 64> buffer_ = {};
+    std::uint64_t length_ = 0;
+};
+
+std::string md5_hex(std::string_view data);
+
+} // namespace utils
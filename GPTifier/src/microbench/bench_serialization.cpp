@@ -0,0 +1,430 @@
+#include "costs.hpp"
+#include "datasets.hpp"
+#include "embeddings.hpp"
+#include "files.hpp"
+#include "fine_tuning.hpp"
+#include "images.hpp"
+#include "models.hpp"
+#include "responses.hpp"
+#include "ser_utils.hpp"
+#include "utils.hpp"
+
+#include <atomic>
+#include <benchmark/benchmark.h>
+#include <cstdlib>
+#include <filesystem>
+#include <fmt/core.h>
+#include <fstream>
+#include <json.hpp>
+#include <new>
+#include <random>
+#include <string>
+#include <thread>
+#include <unistd.h>
+
+// Count heap allocations so that each benchmark can report allocations per operation -----------------------
+
+namespace {
+
+std::atomic<std::size_t> num_allocations = 0;
+
+} // namespace
+
+void *operator new(std::size_t size)
+{
+    num_allocations.fetch_add(1, std::memory_order_relaxed);
+
+    if (void *ptr = std::malloc(size == 0 ? 1 : size)) {
+        return ptr;
+    }
+
+    throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+
+namespace {
+
+using json = nlohmann::json;
+
+// Fixtures -------------------------------------------------------------------------------------------------
+
+// Roughly the shapes returned by OpenAI and Ollama. Small, medium and huge sizes are selected by the
+// benchmark argument (i.e. the number of words, list entries or embedding inputs)
+const std::time_t CREATED_AT = 1735689600;
+const int EMBEDDING_DIMENSIONS = 1536;
+
+std::string make_text_(const int num_words)
+{
+    static const std::vector<std::string> words = { "The", "model", "returned", "a", "fairly", "long", "answer", "with",
+        "code,", "punctuation", "and", "numbers", "like", "42." };
+    std::string text;
+
+    for (int i = 0; i < num_words; ++i) {
+        text += words[i % words.size()];
+        text += i % 12 == 11 ? '\n' : ' ';
+    }
+
+    return text;
+}
+
+std::vector<float> make_embedding_(const int seed)
+{
+    std::mt19937 rng(seed);
+    std::normal_distribution<float> distribution(0.0, 0.05);
+    std::vector<float> embedding(EMBEDDING_DIMENSIONS);
+
+    for (float &value: embedding) {
+        value = distribution(rng);
+    }
+
+    return embedding;
+}
+
+std::string make_openai_response_(const int num_words)
+{
+    const json response = {
+        { "id", "resp_67ccd2bed1ec8190b14f964abc0542670bb6a6b452d3795b" },
+        { "object", "response" },
+        { "created_at", CREATED_AT },
+        { "status", "completed" },
+        { "model", "gpt-4o-2024-08-06" },
+        { "output", json::array({ {
+                        { "type", "message" },
+                        { "id", "msg_67ccd2bf17f0819081ff3bb2cf6508e60bb6a6b452d3795b" },
+                        { "status", "completed" },
+                        { "role", "assistant" },
+                        { "content", json::array({ { { "type", "output_text" }, { "text", make_text_(num_words) }, { "annotations", json::array() } } }) },
+                    } }) },
+        { "temperature", 1.0 },
+        { "usage", { { "input_tokens", 36 }, { "output_tokens", num_words }, { "total_tokens", 36 + num_words } } },
+    };
+
+    return response.dump();
+}
+
+std::string make_ollama_response_(const int num_words)
+{
+    const json response = {
+        { "model", "gemma3:latest" },
+        { "created_at", "2025-01-01T00:00:00.000000Z" },
+        { "response", make_text_(num_words) },
+        { "done", true },
+        { "done_reason", "stop" },
+        { "context", std::vector<int>(num_words, 1234) },
+        { "total_duration", 5043500667 },
+        { "prompt_eval_count", 26 },
+        { "eval_count", num_words },
+    };
+
+    return response.dump();
+}
+
+std::string make_costs_response_(const int num_buckets)
+{
+    json data = json::array();
+
+    for (int i = 0; i < num_buckets; ++i) {
+        data.push_back({
+            { "object", "bucket" },
+            { "start_time", CREATED_AT + i * 86400 },
+            { "end_time", CREATED_AT + (i + 1) * 86400 },
+            { "results", json::array({ {
+                             { "object", "organization.costs.result" },
+                             { "amount", { { "value", 0.06 + i * 0.001 }, { "currency", "usd" } } },
+                             { "line_item", nullptr },
+                             { "project_id", nullptr },
+                             { "organization_id", "org-abcdefghijklmnopqrstuvwx" },
+                         } }) },
+        });
+    }
+
+    return json({ { "object", "page" }, { "data", data }, { "has_more", false }, { "next_page", nullptr } }).dump();
+}
+
+std::string make_models_response_(const int num_models)
+{
+    json data = json::array();
+
+    for (int i = 0; i < num_models; ++i) {
+        data.push_back({
+            { "id", fmt::format("ft:gpt-4o-mini-2024-07-18:personal::{:08x}", i) },
+            { "object", "model" },
+            { "created", CREATED_AT + i },
+            { "owned_by", i % 4 == 0 ? "user-abcdefghijklmnopqrstuvwx" : "system" },
+        });
+    }
+
+    return json({ { "object", "list" }, { "data", data } }).dump();
+}
+
+std::string make_files_response_(const int num_files)
+{
+    json data = json::array();
+
+    for (int i = 0; i < num_files; ++i) {
+        data.push_back({
+            { "object", "file" },
+            { "id", fmt::format("file-{:024x}", i) },
+            { "purpose", "fine-tune" },
+            { "filename", fmt::format("training_data_{}.jsonl", i) },
+            { "bytes", 120000 + i },
+            { "created_at", CREATED_AT + i },
+            { "expires_at", nullptr },
+            { "status", "processed" },
+            { "status_details", nullptr },
+        });
+    }
+
+    return json({ { "object", "list" }, { "data", data }, { "has_more", false } }).dump();
+}
+
+std::string make_fine_tuning_jobs_response_(const int num_jobs)
+{
+    json data = json::array();
+
+    for (int i = 0; i < num_jobs; ++i) {
+        const bool finished = i % 3 != 0;
+
+        data.push_back({
+            { "object", "fine_tuning.job" },
+            { "id", fmt::format("ftjob-{:024x}", i) },
+            { "model", "gpt-4o-mini-2024-07-18" },
+            { "created_at", CREATED_AT + i },
+            { "finished_at", finished ? json(CREATED_AT + i + 3600) : json(nullptr) },
+            { "estimated_finish", finished ? json(nullptr) : json(CREATED_AT + i + 7200) },
+            { "fine_tuned_model", finished ? json(fmt::format("ft:gpt-4o-mini:personal::{:08x}", i)) : json(nullptr) },
+            { "organization_id", "org-abcdefghijklmnopqrstuvwx" },
+            { "status", finished ? "succeeded" : "running" },
+            { "training_file", fmt::format("file-{:024x}", i) },
+            { "hyperparameters", { { "n_epochs", 3 }, { "batch_size", 1 }, { "learning_rate_multiplier", 1.8 } } },
+            { "trained_tokens", 5768 },
+        });
+    }
+
+    return json({ { "object", "list" }, { "data", data }, { "has_more", false } }).dump();
+}
+
+std::string make_openai_embeddings_response_(const int num_inputs)
+{
+    json data = json::array();
+
+    for (int i = 0; i < num_inputs; ++i) {
+        data.push_back({ { "object", "embedding" }, { "index", i }, { "embedding", make_embedding_(i) } });
+    }
+
+    return json({
+                    { "object", "list" },
+                    { "data", data },
+                    { "model", "text-embedding-3-small" },
+                    { "usage", { { "prompt_tokens", 8 * num_inputs }, { "total_tokens", 8 * num_inputs } } },
+                })
+        .dump();
+}
+
+std::string make_ollama_embeddings_response_(const int num_inputs)
+{
+    json embeddings = json::array();
+
+    for (int i = 0; i < num_inputs; ++i) {
+        embeddings.push_back(make_embedding_(i));
+    }
+
+    return json({ { "model", "nomic-embed-text" }, { "embeddings", embeddings }, { "total_duration", 14143917 } }).dump();
+}
+
+std::string make_base64_(const int num_bytes)
+{
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string encoded((num_bytes + 2) / 3 * 4, 'A');
+
+    for (std::size_t i = 0; i < encoded.size(); ++i) {
+        encoded[i] = alphabet[(i * 2654435761u) % 64];
+    }
+
+    return encoded;
+}
+
+std::string make_fine_tuning_dataset_(const int num_examples)
+{
+    std::string dataset;
+
+    for (int i = 0; i < num_examples; ++i) {
+        const json messages = json::array({
+            { { "role", "system" }, { "content", "You are a helpful assistant." } },
+            { { "role", "user" }, { "content", make_text_(20 + i % 50) } },
+            { { "role", "assistant" }, { "content", make_text_(40 + i % 200) } },
+        });
+
+        dataset += json({ { "messages", messages } }).dump();
+        dataset += '\n';
+    }
+
+    return dataset;
+}
+
+std::string make_image_response_(const int num_bytes)
+{
+    const json response = {
+        { "created", CREATED_AT },
+        { "data", json::array({ {
+                      { "b64_json", make_base64_(num_bytes) },
+                      { "revised_prompt", "A watercolor painting of a lighthouse on a cliff at dusk" },
+                  } }) },
+    };
+
+    return response.dump();
+}
+
+// Harness --------------------------------------------------------------------------------------------------
+
+template<typename Func>
+void run_(benchmark::State &state, const std::string &payload, const Func &func)
+{
+    const std::size_t allocations_before = num_allocations.load();
+
+    for (auto _: state) {
+        benchmark::DoNotOptimize(func(payload));
+    }
+
+    const double allocations = num_allocations.load() - allocations_before;
+
+    state.SetBytesProcessed(state.iterations() * payload.size());
+    state.counters["allocs/op"] = benchmark::Counter(allocations, benchmark::Counter::kAvgIterations);
+    state.counters["payload_bytes"] = payload.size();
+}
+
+// Benchmarks -----------------------------------------------------------------------------------------------
+
+void bm_unpack_openai_response(benchmark::State &state)
+{
+    run_(state, make_openai_response_(state.range(0)), serialization::unpack_openai_response);
+}
+
+void bm_unpack_ollama_response(benchmark::State &state)
+{
+    run_(state, make_ollama_response_(state.range(0)), serialization::unpack_ollama_response);
+}
+
+void bm_unpack_costs_response(benchmark::State &state)
+{
+    run_(state, make_costs_response_(state.range(0)), serialization::unpack_costs_response);
+}
+
+void bm_unpack_models_response(benchmark::State &state)
+{
+    run_(state, make_models_response_(state.range(0)), serialization::unpack_models_response);
+}
+
+void bm_unpack_files_response(benchmark::State &state)
+{
+    run_(state, make_files_response_(state.range(0)), serialization::unpack_files_response);
+}
+
+void bm_unpack_fine_tuning_jobs(benchmark::State &state)
+{
+    run_(state, make_fine_tuning_jobs_response_(state.range(0)), serialization::unpack_fine_tuning_jobs);
+}
+
+void bm_unpack_openai_embeddings(benchmark::State &state)
+{
+    const std::size_t num_inputs = state.range(0);
+
+    run_(state, make_openai_embeddings_response_(num_inputs), [num_inputs](const std::string &payload) {
+        return serialization::unpack_openai_embeddings(payload, num_inputs);
+    });
+}
+
+void bm_unpack_ollama_embeddings(benchmark::State &state)
+{
+    const std::size_t num_inputs = state.range(0);
+
+    run_(state, make_ollama_embeddings_response_(num_inputs), [num_inputs](const std::string &payload) {
+        return serialization::unpack_ollama_embeddings(payload, num_inputs);
+    });
+}
+
+void bm_unpack_image_response(benchmark::State &state)
+{
+    run_(state, make_image_response_(state.range(0)), serialization::unpack_image_response);
+}
+
+void bm_base64_decode(benchmark::State &state)
+{
+    run_(state, make_base64_(state.range(0)), utils::base64_decode);
+}
+
+void bm_get_word_count(benchmark::State &state)
+{
+    run_(state, make_text_(state.range(0)), utils::get_word_count);
+}
+
+void bm_estimate_token_count(benchmark::State &state)
+{
+    run_(state, make_text_(state.range(0)), utils::estimate_token_count);
+}
+
+void bm_validate_fine_tuning_file(benchmark::State &state)
+{
+    const std::filesystem::path path = std::filesystem::temp_directory_path() / fmt::format("gptifier_bench_{}.jsonl", getpid());
+
+    {
+        std::ofstream file(path);
+        file << make_fine_tuning_dataset_(state.range(0));
+    }
+
+    serialization::DatasetOptions options;
+    options.jobs = std::max<int>(1, std::thread::hardware_concurrency());
+
+    const std::size_t allocations_before = num_allocations.load();
+
+    for (auto _: state) {
+        benchmark::DoNotOptimize(serialization::validate_fine_tuning_file(path, options));
+    }
+
+    const double allocations = num_allocations.load() - allocations_before;
+    const std::size_t bytes = std::filesystem::file_size(path);
+
+    state.SetBytesProcessed(state.iterations() * bytes);
+    state.counters["allocs/op"] = benchmark::Counter(allocations, benchmark::Counter::kAvgIterations);
+    state.counters["payload_bytes"] = bytes;
+
+    std::filesystem::remove(path);
+}
+
+void bm_datetime_from_unix_timestamp(benchmark::State &state)
+{
+    std::time_t timestamp = CREATED_AT;
+
+    for (auto _: state) {
+        benchmark::DoNotOptimize(serialization::datetime_from_unix_timestamp(timestamp));
+        timestamp += 61;
+    }
+}
+
+} // namespace
+
+BENCHMARK(bm_unpack_openai_response)->ArgName("words")->Arg(16)->Arg(1000)->Arg(100000);
+BENCHMARK(bm_unpack_ollama_response)->ArgName("words")->Arg(16)->Arg(1000)->Arg(100000);
+BENCHMARK(bm_unpack_costs_response)->ArgName("buckets")->Arg(7)->Arg(90)->Arg(10000);
+BENCHMARK(bm_unpack_models_response)->ArgName("models")->Arg(10)->Arg(100)->Arg(10000);
+BENCHMARK(bm_unpack_files_response)->ArgName("files")->Arg(10)->Arg(1000)->Arg(100000);
+BENCHMARK(bm_unpack_fine_tuning_jobs)->ArgName("jobs")->Arg(10)->Arg(100)->Arg(10000);
+BENCHMARK(bm_unpack_openai_embeddings)->ArgName("inputs")->Arg(1)->Arg(16)->Arg(512);
+BENCHMARK(bm_unpack_ollama_embeddings)->ArgName("inputs")->Arg(1)->Arg(16)->Arg(512);
+BENCHMARK(bm_unpack_image_response)->ArgName("bytes")->Arg(1 << 10)->Arg(1 << 17)->Arg(1 << 22);
+BENCHMARK(bm_base64_decode)->ArgName("bytes")->Arg(1 << 10)->Arg(1 << 17)->Arg(1 << 22);
+BENCHMARK(bm_get_word_count)->ArgName("words")->Arg(16)->Arg(1000)->Arg(100000);
+BENCHMARK(bm_estimate_token_count)->ArgName("words")->Arg(16)->Arg(1000)->Arg(100000);
+BENCHMARK(bm_validate_fine_tuning_file)->ArgName("examples")->Arg(100)->Arg(10000)->Arg(100000)->UseRealTime();
+BENCHMARK(bm_datetime_from_unix_timestamp);
+
+BENCHMARK_MAIN();
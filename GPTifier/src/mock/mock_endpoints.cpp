@@ -0,0 +1,486 @@
+#include "mock_endpoints.hpp"
+
+#include "utils.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <ctime>
+#include <fmt/core.h>
+#include <functional>
+#include <json.hpp>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace mock {
+
+namespace {
+
+using json = nlohmann::json;
+
+const std::string CONTENT_JSON = "application/json";
+const std::string CONTENT_NDJSON = "application/x-ndjson";
+const std::string CONTENT_SSE = "text/event-stream";
+
+const std::vector<std::string> WORDS = {
+    "the", "quick", "brown", "fox", "jumps", "over", "a", "lazy", "dog", "while", "mock", "server", "answers",
+    "every", "prompt", "with", "plausible", "filler", "text",
+};
+
+std::mt19937_64 &get_rng_(const MockOptions &options)
+{
+    // One generator per connection thread so that nothing needs to be locked. With a fixed seed, each thread
+    // still draws a distinct but reproducible sequence
+    static std::atomic<std::uint64_t> next_stream = 0;
+    thread_local std::mt19937_64 rng(options.seed == 0 ? std::random_device {}() : options.seed + next_stream++);
+    return rng;
+}
+
+void sleep_ms_(const int ms)
+{
+    if (ms > 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+    }
+}
+
+void simulate_latency_(const MockOptions &options)
+{
+    int delay_ms = options.latency_ms;
+
+    if (options.jitter_ms > 0) {
+        delay_ms += std::uniform_int_distribution<int>(0, options.jitter_ms)(get_rng_(options));
+    }
+
+    sleep_ms_(delay_ms);
+}
+
+bool should_fail_(const MockOptions &options)
+{
+    if (options.error_rate <= 0.0) {
+        return false;
+    }
+
+    return std::uniform_real_distribution<float>(0.0, 1.0)(get_rng_(options)) < options.error_rate;
+}
+
+std::time_t now_()
+{
+    return std::time(nullptr);
+}
+
+std::string get_timestamp_()
+{
+    const std::time_t now = now_();
+    char buffer[32];
+    std::strftime(buffer, sizeof(buffer), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+    return buffer;
+}
+
+std::vector<std::string> generate_words_(const int count)
+{
+    std::vector<std::string> words;
+
+    for (int i = 0; i < count; ++i) {
+        words.push_back((i == 0 ? "" : " ") + WORDS[i % WORDS.size()]);
+    }
+
+    return words;
+}
+
+std::string join_(const std::vector<std::string> &words)
+{
+    std::string text;
+
+    for (const auto &word: words) {
+        text += word;
+    }
+
+    return text;
+}
+
+std::vector<float> generate_embedding_(const std::string &input, const int dimensions)
+{
+    // Seeded from the input so that the same text always maps to the same unit vector
+    std::mt19937_64 rng(std::hash<std::string> {}(input));
+    std::normal_distribution<float> distribution(0.0, 1.0);
+
+    std::vector<float> embedding(dimensions);
+    float norm = 0.0;
+
+    for (float &value: embedding) {
+        value = distribution(rng);
+        norm += value * value;
+    }
+
+    norm = std::sqrt(norm);
+
+    for (float &value: embedding) {
+        value /= norm;
+    }
+
+    return embedding;
+}
+
+std::string encode_base64_(const std::string &data)
+{
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string encoded;
+    encoded.reserve((data.size() + 2) / 3 * 4);
+
+    for (std::size_t i = 0; i < data.size(); i += 3) {
+        std::uint32_t group = static_cast<unsigned char>(data[i]) << 16;
+
+        if (i + 1 < data.size()) {
+            group |= static_cast<unsigned char>(data[i + 1]) << 8;
+        }
+
+        if (i + 2 < data.size()) {
+            group |= static_cast<unsigned char>(data[i + 2]);
+        }
+
+        encoded += alphabet[(group >> 18) & 0x3f];
+        encoded += alphabet[(group >> 12) & 0x3f];
+        encoded += i + 1 < data.size() ? alphabet[(group >> 6) & 0x3f] : '=';
+        encoded += i + 2 < data.size() ? alphabet[group & 0x3f] : '=';
+    }
+
+    return encoded;
+}
+
+std::vector<std::string> get_inputs_(const json &input)
+{
+    if (input.is_array()) {
+        return input.get<std::vector<std::string>>();
+    }
+
+    return { input.get<std::string>() };
+}
+
+void send_json_(Connection &connection, const json &body, const int status = 200)
+{
+    connection.send_response(status, CONTENT_JSON, body.dump());
+}
+
+void send_openai_error_(Connection &connection, const int status, const std::string &message)
+{
+    send_json_(connection, { { "error", { { "message", message }, { "type", "mock_error" } } } }, status);
+}
+
+void send_ollama_error_(Connection &connection, const int status, const std::string &message)
+{
+    send_json_(connection, { { "error", message } }, status);
+}
+
+// Stream the words of a response in groups of options.chunk_tokens
+void stream_words_(const std::vector<std::string> &words, const MockOptions &options, const std::function<void(const std::string &)> &send)
+{
+    const std::size_t step = std::max(1, options.chunk_tokens);
+
+    for (std::size_t i = 0; i < words.size(); i += step) {
+        if (i > 0) {
+            sleep_ms_(options.chunk_delay_ms);
+        }
+
+        std::string delta;
+
+        for (std::size_t j = i; j < std::min(words.size(), i + step); ++j) {
+            delta += words[j];
+        }
+
+        send(delta);
+    }
+}
+
+// OpenAI ---------------------------------------------------------------------------------------------------
+
+void handle_responses_(const Request &request, Connection &connection, const MockOptions &options)
+{
+    const json body = json::parse(request.body);
+    const std::string input = body.value("input", "");
+    const std::vector<std::string> words = generate_words_(options.output_tokens);
+
+    json response = {
+        { "object", "response" },
+        { "id", fmt::format("resp_mock_{}", now_()) },
+        { "created_at", now_() },
+        { "model", body.value("model", "mock") },
+        { "status", "completed" },
+        { "output", json::array() },
+        { "usage", { { "input_tokens", utils::estimate_token_count(input) }, { "output_tokens", words.size() } } },
+    };
+
+    const auto add_output = [&response](const std::string &text) {
+        response["output"] = json::array({ {
+            { "type", "message" },
+            { "status", "completed" },
+            { "role", "assistant" },
+            { "content", json::array({ { { "type", "output_text" }, { "text", text } } }) },
+        } });
+    };
+
+    if (not body.value("stream", false)) {
+        add_output(join_(words));
+        send_json_(connection, response);
+        return;
+    }
+
+    const auto send_event = [&connection](const std::string &type, json event) {
+        event["type"] = type;
+        connection.send_chunk(fmt::format("event: {}\ndata: {}\n\n", type, event.dump()));
+    };
+
+    connection.begin_stream(200, CONTENT_SSE);
+
+    json created = response;
+    created["status"] = "in_progress";
+    send_event("response.created", { { "response", created } });
+
+    stream_words_(words, options, [&send_event](const std::string &delta) {
+        send_event("response.output_text.delta", { { "delta", delta } });
+    });
+
+    add_output(join_(words));
+    send_event("response.completed", { { "response", response } });
+    connection.end_stream();
+}
+
+void handle_embeddings_(const Request &request, Connection &connection, const MockOptions &options)
+{
+    const json body = json::parse(request.body);
+    const std::vector<std::string> inputs = get_inputs_(body.at("input"));
+    const int dimensions = body.value("dimensions", options.dimensions);
+
+    json data = json::array();
+    int num_tokens = 0;
+
+    for (std::size_t i = 0; i < inputs.size(); ++i) {
+        data.push_back({ { "object", "embedding" }, { "index", i }, { "embedding", generate_embedding_(inputs[i], dimensions) } });
+        num_tokens += utils::estimate_token_count(inputs[i]);
+    }
+
+    send_json_(connection, {
+                               { "object", "list" },
+                               { "data", data },
+                               { "model", body.value("model", "mock") },
+                               { "usage", { { "prompt_tokens", num_tokens }, { "total_tokens", num_tokens } } },
+                           });
+}
+
+void handle_files_(const Request &request, Connection &connection, const MockOptions &options)
+{
+    if (request.method == "POST") {
+        send_json_(connection, { { "object", "file" }, { "id", fmt::format("file-mock{}", now_()) }, { "bytes", request.body.size() }, { "created_at", now_() } });
+        return;
+    }
+
+    if (request.method == "DELETE") {
+        send_json_(connection, { { "object", "file" }, { "id", request.path.substr(request.path.rfind('/') + 1) }, { "deleted", true } });
+        return;
+    }
+
+    // Paginated like the real endpoint, with file IDs sorting in order of creation
+    const bool ascending = request.query.contains("order") and request.query.at("order") == "asc";
+    const int limit = request.query.contains("limit") ? std::stoi(request.query.at("limit")) : 10000;
+    const bool purpose_matches = not request.query.contains("purpose") or request.query.at("purpose") == "fine-tune";
+
+    std::vector<int> indices;
+
+    for (int i = 0; i < options.num_files and purpose_matches; ++i) {
+        indices.push_back(ascending ? i : options.num_files - 1 - i);
+    }
+
+    std::size_t start = 0;
+
+    if (request.query.contains("after")) {
+        const std::string &after = request.query.at("after");
+
+        while (start < indices.size() and fmt::format("file-mock{:06}", indices[start]) != after) {
+            ++start;
+        }
+
+        start = std::min(start + 1, indices.size());
+    }
+
+    const std::size_t end = std::min(indices.size(), start + std::max(limit, 1));
+    json data = json::array();
+
+    for (std::size_t j = start; j < end; ++j) {
+        const int i = indices[j];
+
+        data.push_back({
+            { "object", "file" },
+            { "id", fmt::format("file-mock{:06}", i) },
+            { "bytes", 1024 * (i + 1) },
+            { "created_at", now_() - 3600 * (options.num_files - i) },
+            { "filename", fmt::format("mock_{}.jsonl", i) },
+            { "purpose", "fine-tune" },
+        });
+    }
+
+    send_json_(connection, { { "object", "list" }, { "data", data }, { "has_more", end < indices.size() } });
+}
+
+void handle_images_(const Request &request, Connection &connection, const MockOptions &options)
+{
+    const json body = json::parse(request.body);
+    std::string image(options.image_bytes, '\0');
+
+    std::uniform_int_distribution<int> distribution(0, 255);
+
+    for (char &c: image) {
+        c = static_cast<char>(distribution(get_rng_(options)));
+    }
+
+    send_json_(connection, {
+                               { "created", now_() },
+                               { "data", json::array({ { { "b64_json", encode_base64_(image) }, { "revised_prompt", body.value("prompt", "") } } }) },
+                           });
+}
+
+void handle_costs_(const Request &request, Connection &connection, const MockOptions &options)
+{
+    const int seconds_per_day = 86400;
+    std::time_t start_time = now_() - options.cost_buckets * seconds_per_day;
+    int num_buckets = options.cost_buckets;
+
+    if (request.query.contains("start_time")) {
+        start_time = std::stol(request.query.at("start_time"));
+    }
+
+    if (request.query.contains("limit")) {
+        num_buckets = std::min(num_buckets, std::stoi(request.query.at("limit")));
+    }
+
+    json data = json::array();
+
+    for (int i = 0; i < num_buckets; ++i) {
+        const std::time_t bucket_start = start_time + i * seconds_per_day;
+
+        data.push_back({
+            { "object", "bucket" },
+            { "start_time", bucket_start },
+            { "end_time", bucket_start + seconds_per_day },
+            { "results", json::array({ { { "object", "organization.costs.result" }, { "amount", { { "value", 0.01 * (i + 1) }, { "currency", "usd" } } }, { "organization_id", "org-mock" } } }) },
+        });
+    }
+
+    send_json_(connection, { { "object", "page" }, { "data", data }, { "has_more", false } });
+}
+
+void handle_models_(Connection &connection)
+{
+    json data = json::array();
+
+    for (const char *id: { "gpt-4o", "gpt-4o-mini", "text-embedding-3-small" }) {
+        data.push_back({ { "object", "model" }, { "id", id }, { "created", 1700000000 }, { "owned_by", "system" } });
+    }
+
+    send_json_(connection, { { "object", "list" }, { "data", data } });
+}
+
+// Ollama ---------------------------------------------------------------------------------------------------
+
+void handle_generate_(const Request &request, Connection &connection, const MockOptions &options)
+{
+    const json body = json::parse(request.body);
+    const std::string model = body.value("model", "mock");
+    const std::vector<std::string> words = generate_words_(options.output_tokens);
+
+    json response = {
+        { "model", model },
+        { "created_at", get_timestamp_() },
+        { "response", "" },
+        { "done", true },
+        { "prompt_eval_count", utils::estimate_token_count(body.value("prompt", "")) },
+        { "eval_count", words.size() },
+    };
+
+    // Ollama streams unless explicitly told not to
+    if (not body.value("stream", true)) {
+        response["response"] = join_(words);
+        send_json_(connection, response);
+        return;
+    }
+
+    connection.begin_stream(200, CONTENT_NDJSON);
+
+    stream_words_(words, options, [&](const std::string &delta) {
+        const json chunk = { { "model", model }, { "created_at", get_timestamp_() }, { "response", delta }, { "done", false } };
+        connection.send_chunk(chunk.dump() + "\n");
+    });
+
+    connection.send_chunk(response.dump() + "\n");
+    connection.end_stream();
+}
+
+void handle_embed_(const Request &request, Connection &connection, const MockOptions &options)
+{
+    const json body = json::parse(request.body);
+    json embeddings = json::array();
+
+    for (const auto &input: get_inputs_(body.at("input"))) {
+        embeddings.push_back(generate_embedding_(input, body.value("dimensions", options.dimensions)));
+    }
+
+    send_json_(connection, { { "model", body.value("model", "mock") }, { "embeddings", embeddings } });
+}
+
+} // namespace
+
+void handle_request(const Request &request, Connection &connection, const MockOptions &options)
+{
+    const bool is_ollama = request.path.starts_with("/api/");
+
+    if (request.path == "/") {
+        connection.send_response(200, "text/plain", "Ollama is running");
+        return;
+    }
+
+    simulate_latency_(options);
+
+    if (should_fail_(options)) {
+        if (is_ollama) {
+            send_ollama_error_(connection, options.error_status, "Injected error");
+        } else {
+            send_openai_error_(connection, options.error_status, "Injected error");
+        }
+        return;
+    }
+
+    const std::string route = request.method + " " + request.path;
+
+    try {
+        if (route == "POST /v1/responses") {
+            handle_responses_(request, connection, options);
+        } else if (route == "POST /v1/embeddings") {
+            handle_embeddings_(request, connection, options);
+        } else if (request.path == "/v1/files" or request.path.starts_with("/v1/files/")) {
+            handle_files_(request, connection, options);
+        } else if (route == "POST /v1/images/generations") {
+            handle_images_(request, connection, options);
+        } else if (route == "GET /v1/organization/costs") {
+            handle_costs_(request, connection, options);
+        } else if (route == "GET /v1/models") {
+            handle_models_(connection);
+        } else if (route == "POST /api/generate") {
+            handle_generate_(request, connection, options);
+        } else if (route == "POST /api/embed") {
+            handle_embed_(request, connection, options);
+        } else if (is_ollama) {
+            send_ollama_error_(connection, 404, fmt::format("Unknown route '{}'", route));
+        } else {
+            send_openai_error_(connection, 404, fmt::format("Unknown route '{}'", route));
+        }
+    } catch (const json::exception &e) {
+        if (is_ollama) {
+            send_ollama_error_(connection, 400, e.what());
+        } else {
+            send_openai_error_(connection, 400, e.what());
+        }
+    }
+}
+
+} // namespace mock
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "mock_http.hpp"
+
+#include <cstdint>
+
+namespace mock {
+
+struct MockOptions {
+    float error_rate = 0.0;
+    int chunk_delay_ms = 0;
+    int chunk_tokens = 1;
+    int cost_buckets = 7;
+    int dimensions = 1536;
+    int error_status = 500;
+    int image_bytes = 4096;
+    int jitter_ms = 0;
+    int latency_ms = 0;
+    int num_files = 3;
+    int output_tokens = 16;
+    std::uint64_t seed = 0;
+};
+
+void handle_request(const Request &request, Connection &connection, const MockOptions &options);
+
+} // namespace mock
@@ -0,0 +1,308 @@
+#include "mock_http.hpp"
+
+#include <arpa/inet.h>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <fmt/core.h>
+#include <netinet/in.h>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+namespace mock {
+
+namespace {
+
+std::string to_lower_(std::string text)
+{
+    for (char &c: text) {
+        c = std::tolower(static_cast<unsigned char>(c));
+    }
+
+    return text;
+}
+
+std::string trim_(const std::string &text)
+{
+    const std::size_t begin = text.find_first_not_of(" \t");
+
+    if (begin == std::string::npos) {
+        return "";
+    }
+
+    return text.substr(begin, text.find_last_not_of(" \t") - begin + 1);
+}
+
+std::map<std::string, std::string> parse_query_(const std::string &query)
+{
+    std::map<std::string, std::string> params;
+    std::size_t start = 0;
+
+    while (start < query.size()) {
+        std::size_t end = query.find('&', start);
+
+        if (end == std::string::npos) {
+            end = query.size();
+        }
+
+        const std::string pair = query.substr(start, end - start);
+        const std::size_t equals = pair.find('=');
+
+        if (equals == std::string::npos) {
+            params[pair] = "";
+        } else {
+            params[pair.substr(0, equals)] = pair.substr(equals + 1);
+        }
+
+        start = end + 1;
+    }
+
+    return params;
+}
+
+std::string get_reason_(const int status)
+{
+    switch (status) {
+        case 200:
+            return "OK";
+        case 400:
+            return "Bad Request";
+        case 404:
+            return "Not Found";
+        case 429:
+            return "Too Many Requests";
+        case 500:
+            return "Internal Server Error";
+        case 503:
+            return "Service Unavailable";
+        default:
+            return "Unknown";
+    }
+}
+
+} // namespace
+
+Connection::Connection(const int fd) :
+    fd_(fd)
+{
+}
+
+Connection::~Connection()
+{
+    close(this->fd_);
+}
+
+bool Connection::fill_buffer_()
+{
+    char chunk[16 * 1024];
+    const ssize_t count = recv(this->fd_, chunk, sizeof(chunk), 0);
+
+    if (count <= 0) {
+        return false;
+    }
+
+    this->buffer_.append(chunk, count);
+    return true;
+}
+
+bool Connection::read_line_(std::string &line)
+{
+    std::size_t end = std::string::npos;
+
+    while ((end = this->buffer_.find("\r\n")) == std::string::npos) {
+        if (not this->fill_buffer_()) {
+            return false;
+        }
+    }
+
+    line = this->buffer_.substr(0, end);
+    this->buffer_.erase(0, end + 2);
+    return true;
+}
+
+bool Connection::read_bytes_(const std::size_t count, std::string &out)
+{
+    while (this->buffer_.size() < count) {
+        if (not this->fill_buffer_()) {
+            return false;
+        }
+    }
+
+    out.append(this->buffer_, 0, count);
+    this->buffer_.erase(0, count);
+    return true;
+}
+
+bool Connection::read_request(Request &request)
+{
+    request = Request();
+    std::string line;
+
+    if (not this->read_line_(line)) {
+        return false;
+    }
+
+    const std::size_t first_space = line.find(' ');
+    const std::size_t second_space = line.find(' ', first_space + 1);
+
+    if (first_space == std::string::npos or second_space == std::string::npos) {
+        return false;
+    }
+
+    request.method = line.substr(0, first_space);
+    const std::string target = line.substr(first_space + 1, second_space - first_space - 1);
+    const std::size_t question_mark = target.find('?');
+
+    request.path = target.substr(0, question_mark);
+
+    if (question_mark != std::string::npos) {
+        request.query = parse_query_(target.substr(question_mark + 1));
+    }
+
+    while (true) {
+        if (not this->read_line_(line)) {
+            return false;
+        }
+
+        if (line.empty()) {
+            break;
+        }
+
+        const std::size_t colon = line.find(':');
+
+        if (colon != std::string::npos) {
+            request.headers[to_lower_(line.substr(0, colon))] = trim_(line.substr(colon + 1));
+        }
+    }
+
+    // libcurl waits for this before sending large bodies such as file uploads
+    if (to_lower_(request.headers["expect"]) == "100-continue") {
+        this->write_("HTTP/1.1 100 Continue\r\n\r\n");
+    }
+
+    if (to_lower_(request.headers["transfer-encoding"]) == "chunked") {
+        while (true) {
+            if (not this->read_line_(line)) {
+                return false;
+            }
+
+            const std::size_t size = std::stoul(line, nullptr, 16);
+
+            if (not this->read_bytes_(size, request.body) or not this->read_line_(line)) {
+                return false;
+            }
+
+            if (size == 0) {
+                break;
+            }
+        }
+
+        return true;
+    }
+
+    if (request.headers.contains("content-length")) {
+        return this->read_bytes_(std::stoul(request.headers["content-length"]), request.body);
+    }
+
+    return true;
+}
+
+void Connection::write_(const std::string &data)
+{
+    std::size_t sent = 0;
+
+    while (sent < data.size()) {
+        const ssize_t count = send(this->fd_, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+
+        if (count <= 0) {
+            throw std::runtime_error("Client went away");
+        }
+
+        sent += count;
+    }
+}
+
+void Connection::send_response(const int status, const std::string &content_type, const std::string &body)
+{
+    this->write_(fmt::format("HTTP/1.1 {} {}\r\nContent-Type: {}\r\nContent-Length: {}\r\n\r\n{}",
+        status, get_reason_(status), content_type, body.size(), body));
+}
+
+void Connection::begin_stream(const int status, const std::string &content_type)
+{
+    this->write_(fmt::format("HTTP/1.1 {} {}\r\nContent-Type: {}\r\nTransfer-Encoding: chunked\r\n\r\n",
+        status, get_reason_(status), content_type));
+}
+
+void Connection::send_chunk(const std::string &data)
+{
+    if (not data.empty()) {
+        this->write_(fmt::format("{:x}\r\n{}\r\n", data.size(), data));
+    }
+}
+
+void Connection::end_stream()
+{
+    this->write_("0\r\n\r\n");
+}
+
+void serve(const std::string &host, const int port, const Handler &handler)
+{
+    const int server = socket(AF_INET, SOCK_STREAM, 0);
+
+    if (server == -1) {
+        throw std::runtime_error(fmt::format("Failed to create socket: {}", std::strerror(errno)));
+    }
+
+    const int enable = 1;
+    setsockopt(server, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+
+    sockaddr_in address {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+
+    if (inet_pton(AF_INET, host.c_str(), &address.sin_addr) != 1) {
+        throw std::runtime_error(fmt::format("Invalid IPv4 address '{}'", host));
+    }
+
+    if (bind(server, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == -1) {
+        throw std::runtime_error(fmt::format("Failed to bind to {}:{}: {}", host, port, std::strerror(errno)));
+    }
+
+    if (listen(server, SOMAXCONN) == -1) {
+        throw std::runtime_error(fmt::format("Failed to listen: {}", std::strerror(errno)));
+    }
+
+    while (true) {
+        const int client = accept(server, nullptr, nullptr);
+
+        if (client == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            throw std::runtime_error(fmt::format("Failed to accept connection: {}", std::strerror(errno)));
+        }
+
+        std::thread([client, &handler]() {
+            Connection connection(client);
+            Request request;
+
+            try {
+                while (connection.read_request(request)) {
+                    handler(request, connection);
+
+                    if (to_lower_(request.headers["connection"]) == "close") {
+                        break;
+                    }
+                }
+            } catch (const std::exception &e) {
+                // The client went away or sent garbage. Either way, drop the connection
+            }
+        }).detach();
+    }
+}
+
+} // namespace mock
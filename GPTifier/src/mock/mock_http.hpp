@@ -0,0 +1,50 @@
+#pragma once
+
+#include <functional>
+#include <map>
+#include <string>
+
+namespace mock {
+
+struct Request {
+    std::map<std::string, std::string> headers; // Names are lower case
+    std::map<std::string, std::string> query;
+    std::string body;
+    std::string method;
+    std::string path;
+};
+
+class Connection {
+public:
+    explicit Connection(const int fd);
+    ~Connection();
+
+    Connection(const Connection &) = delete;
+    Connection &operator=(const Connection &) = delete;
+
+    // Returns false once the client has closed the connection
+    bool read_request(Request &request);
+
+    void send_response(const int status, const std::string &content_type, const std::string &body);
+
+    // Send a response piece by piece using chunked transfer encoding
+    void begin_stream(const int status, const std::string &content_type);
+    void send_chunk(const std::string &data);
+    void end_stream();
+
+private:
+    bool fill_buffer_();
+    bool read_line_(std::string &line);
+    bool read_bytes_(std::size_t count, std::string &out);
+    void write_(const std::string &data);
+
+    int fd_ = -1;
+    std::string buffer_;
+};
+
+using Handler = std::function<void(const Request &request, Connection &connection)>;
+
+// Accept connections on host:port forever, serving each on its own thread
+void serve(const std::string &host, const int port, const Handler &handler);
+
+} // namespace mock
@@ -0,0 +1,250 @@
+#include "mock_endpoints.hpp"
+#include "mock_http.hpp"
+#include "utils.hpp"
+
+#include <cstdlib>
+#include <fmt/core.h>
+#include <getopt.h>
+#include <optional>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+void help_mock_()
+{
+    const std::string messages = R"(A stand-in for the OpenAI and Ollama APIs which returns synthetic payloads. Point
+GPTifier at it by setting base_url under [openai] and/or [ollama] in the configuration file, or pass
+--url to the bench command.
+
+Usage:
+  gpt-mock [OPTIONS]
+
+Options:
+  -h, --help                 Print help information and exit
+  -a, --host=HOST            Listen on HOST (default 127.0.0.1)
+  -p, --port=PORT            Listen on PORT (default 8080)
+  -l, --latency=MS           Wait MS milliseconds before answering each request (default 0)
+  -j, --jitter=MS            Add up to MS milliseconds of random delay on top of --latency (default 0)
+  -e, --error-rate=RATE      Fail a fraction RATE of requests, between 0 and 1 (default 0)
+  -s, --error-status=CODE    Fail requests with HTTP status CODE (default 500)
+  -t, --output-tokens=N      Answer prompts with N words (default 16)
+  -c, --chunk-tokens=N       Send N words per chunk when streaming (default 1)
+  -d, --chunk-delay=MS       Wait MS milliseconds between streamed chunks (default 0)
+  -D, --dimensions=N         Return embeddings with N dimensions unless requested otherwise (default 1536)
+  -f, --files=N              List N files (default 3)
+  -i, --image-bytes=N        Return images of N bytes (default 4096)
+  -b, --cost-buckets=N       Return up to N days of costs (default 7)
+  -S, --seed=SEED            Seed jitter and error injection for reproducible runs
+
+Routes:
+  POST /v1/responses, /v1/embeddings, /v1/files, /v1/images/generations
+  GET  /v1/files, /v1/models, /v1/organization/costs
+  DELETE /v1/files/{id}
+  POST /api/generate, /api/embed
+
+Examples:
+  > Mimic a slow and flaky backend:
+    $ gpt-mock --latency=200 --jitter=100 --error-rate=0.05 --error-status=429
+  > Stream long responses in small pieces:
+    $ gpt-mock --output-tokens=500 --chunk-tokens=4 --chunk-delay=20
+)";
+
+    fmt::print("{}\n", messages);
+}
+
+struct Parameters {
+    std::optional<std::string> chunk_delay;
+    std::optional<std::string> chunk_tokens;
+    std::optional<std::string> cost_buckets;
+    std::optional<std::string> dimensions;
+    std::optional<std::string> error_rate;
+    std::optional<std::string> error_status;
+    std::optional<std::string> image_bytes;
+    std::optional<std::string> jitter;
+    std::optional<std::string> latency;
+    std::optional<std::string> num_files;
+    std::optional<std::string> output_tokens;
+    std::optional<std::string> port;
+    std::optional<std::string> seed;
+    std::string host = "127.0.0.1";
+};
+
+Parameters read_cli_(const int argc, char **argv)
+{
+    Parameters params;
+
+    while (true) {
+        static struct option long_options[] = {
+            { "help", no_argument, 0, 'h' },
+            { "host", required_argument, 0, 'a' },
+            { "port", required_argument, 0, 'p' },
+            { "latency", required_argument, 0, 'l' },
+            { "jitter", required_argument, 0, 'j' },
+            { "error-rate", required_argument, 0, 'e' },
+            { "error-status", required_argument, 0, 's' },
+            { "output-tokens", required_argument, 0, 't' },
+            { "chunk-tokens", required_argument, 0, 'c' },
+            { "chunk-delay", required_argument, 0, 'd' },
+            { "dimensions", required_argument, 0, 'D' },
+            { "files", required_argument, 0, 'f' },
+            { "image-bytes", required_argument, 0, 'i' },
+            { "cost-buckets", required_argument, 0, 'b' },
+            { "seed", required_argument, 0, 'S' },
+            { 0, 0, 0, 0 },
+        };
+
+        int option_index = 0;
+        const int c = getopt_long(argc, argv, "ha:p:l:j:e:s:t:c:d:D:f:i:b:S:", long_options, &option_index);
+
+        if (c == -1) {
+            break;
+        }
+
+        switch (c) {
+            case 'h':
+                help_mock_();
+                exit(EXIT_SUCCESS);
+            case 'a':
+                params.host = optarg;
+                break;
+            case 'p':
+                params.port = optarg;
+                break;
+            case 'l':
+                params.latency = optarg;
+                break;
+            case 'j':
+                params.jitter = optarg;
+                break;
+            case 'e':
+                params.error_rate = optarg;
+                break;
+            case 's':
+                params.error_status = optarg;
+                break;
+            case 't':
+                params.output_tokens = optarg;
+                break;
+            case 'c':
+                params.chunk_tokens = optarg;
+                break;
+            case 'd':
+                params.chunk_delay = optarg;
+                break;
+            case 'D':
+                params.dimensions = optarg;
+                break;
+            case 'f':
+                params.num_files = optarg;
+                break;
+            case 'i':
+                params.image_bytes = optarg;
+                break;
+            case 'b':
+                params.cost_buckets = optarg;
+                break;
+            case 'S':
+                params.seed = optarg;
+                break;
+            default:
+                utils::exit_on_failure();
+        }
+    }
+
+    return params;
+}
+
+int get_non_negative_(const std::optional<std::string> &value, const int fallback, const std::string &name)
+{
+    if (not value) {
+        return fallback;
+    }
+
+    const int number = utils::string_to_int(value.value());
+
+    if (number < 0) {
+        throw std::runtime_error(fmt::format("{} must not be negative", name));
+    }
+
+    return number;
+}
+
+mock::MockOptions get_mock_options_(const Parameters &params)
+{
+    mock::MockOptions options;
+
+    options.latency_ms = get_non_negative_(params.latency, options.latency_ms, "Latency");
+    options.jitter_ms = get_non_negative_(params.jitter, options.jitter_ms, "Jitter");
+    options.chunk_delay_ms = get_non_negative_(params.chunk_delay, options.chunk_delay_ms, "Chunk delay");
+    options.output_tokens = get_non_negative_(params.output_tokens, options.output_tokens, "Output tokens");
+    options.num_files = get_non_negative_(params.num_files, options.num_files, "Number of files");
+    options.image_bytes = get_non_negative_(params.image_bytes, options.image_bytes, "Image size");
+    options.cost_buckets = get_non_negative_(params.cost_buckets, options.cost_buckets, "Number of cost buckets");
+    options.seed = get_non_negative_(params.seed, 0, "Seed");
+
+    if (params.chunk_tokens) {
+        options.chunk_tokens = utils::string_to_int(params.chunk_tokens.value());
+
+        if (options.chunk_tokens < 1) {
+            throw std::runtime_error("Chunk tokens must be a positive number");
+        }
+    }
+
+    if (params.dimensions) {
+        options.dimensions = utils::string_to_int(params.dimensions.value());
+
+        if (options.dimensions < 1) {
+            throw std::runtime_error("Dimensions must be a positive number");
+        }
+    }
+
+    if (params.error_rate) {
+        options.error_rate = utils::string_to_float(params.error_rate.value());
+
+        if (options.error_rate < 0.0 or options.error_rate > 1.0) {
+            throw std::runtime_error("Error rate must be between 0 and 1");
+        }
+    }
+
+    if (params.error_status) {
+        options.error_status = utils::string_to_int(params.error_status.value());
+
+        if (options.error_status < 400 or options.error_status > 599) {
+            throw std::runtime_error("Error status must be between 400 and 599");
+        }
+    }
+
+    return options;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    try {
+        const Parameters params = read_cli_(argc, argv);
+        const mock::MockOptions options = get_mock_options_(params);
+        int port = 8080;
+
+        if (params.port) {
+            port = utils::string_to_int(params.port.value());
+
+            if (port < 1 or port > 65535) {
+                throw std::runtime_error("Port must be between 1 and 65535");
+            }
+        }
+
+        fmt::print("Listening on http://{}:{}\n", params.host, port);
+        std::fflush(stdout);
+
+        mock::serve(params.host, port, [&options](const mock::Request &request, mock::Connection &connection) {
+            mock::handle_request(request, connection, options);
+        });
+    } catch (const std::runtime_error &e) {
+        fmt::print(stderr, "{}\n", e.what());
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
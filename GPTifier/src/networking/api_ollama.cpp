@@ -1,6 +1,8 @@
 #include "api_ollama.hpp"
 
 #include "configs.hpp"
+#include "hedging.hpp"
+#include "single_flight.hpp"
 
 #include <fmt/core.h>
 
@@ -11,6 +13,11 @@ std::string get_ollama_base_url_()
     static const std::string host = configs.host_ollama.value();
     static const int port = configs.port_ollama.value();
 
+    if (configs.base_url_ollama) {
+        static const std::string base_url = fmt::format("{}/api", configs.base_url_ollama.value());
+        return base_url;
+    }
+
     static std::string base_url = fmt::format("http://{}:{}/api", host, port);
     return base_url;
 }
@@ -21,42 +28,47 @@ namespace networking {
 
 CurlResult generate_ollama_response(const std::string &post_fields)
 {
-    Curl curl;
-    CURL *handle = curl.get_handle();
-
-    curl.append_header("Content-Type: application/json");
-    curl_easy_setopt(handle, CURLOPT_HTTPHEADER, curl.get_headers());
-
     const std::string url_generate = fmt::format("{}/generate", get_ollama_base_url_());
-    curl_easy_setopt(handle, CURLOPT_URL, url_generate.c_str());
-    curl_easy_setopt(handle, CURLOPT_POST, 1L);
-    curl_easy_setopt(handle, CURLOPT_POSTFIELDS, post_fields.c_str());
 
-    std::string response;
-    curl_easy_setopt(handle, CURLOPT_WRITEDATA, &response);
+    return single_flight("POST", url_generate, post_fields, "", [&]() {
+        return perform_hedged(url_generate, [&](Curl &curl) {
+            curl.append_header("Content-Type: application/json");
+            curl_easy_setopt(curl.get_handle(), CURLOPT_HTTPHEADER, curl.get_headers());
 
-    const CURLcode code = curl_easy_perform(handle);
-    return check_curl_code(handle, code, response);
+            curl.set_url(url_generate);
+            curl.set_post_fields(post_fields);
+        });
+    });
 }
 
-CurlResult create_ollama_embedding(const std::string &post_fields)
+CurlResult stream_ollama_response(const std::string &post_fields, const StreamCallback &on_chunk)
 {
+    const std::string url_generate = fmt::format("{}/generate", get_ollama_base_url_());
+
     Curl curl;
-    CURL *handle = curl.get_handle();
 
     curl.append_header("Content-Type: application/json");
-    curl_easy_setopt(handle, CURLOPT_HTTPHEADER, curl.get_headers());
+    curl_easy_setopt(curl.get_handle(), CURLOPT_HTTPHEADER, curl.get_headers());
+
+    curl.set_url(url_generate);
+    curl.set_post_fields(post_fields);
+    return curl.perform(on_chunk);
+}
 
+CurlResult create_ollama_embedding(const std::string &post_fields)
+{
     const std::string url_embed = fmt::format("{}/embed", get_ollama_base_url_());
-    curl_easy_setopt(handle, CURLOPT_URL, url_embed.c_str());
-    curl_easy_setopt(handle, CURLOPT_POST, 1L);
-    curl_easy_setopt(handle, CURLOPT_POSTFIELDS, post_fields.c_str());
 
-    std::string response;
-    curl_easy_setopt(handle, CURLOPT_WRITEDATA, &response);
+    return single_flight("POST", url_embed, post_fields, "", [&]() {
+        Curl curl;
+
+        curl.append_header("Content-Type: application/json");
+        curl_easy_setopt(curl.get_handle(), CURLOPT_HTTPHEADER, curl.get_headers());
 
-    const CURLcode code = curl_easy_perform(handle);
-    return check_curl_code(handle, code, response);
+        curl.set_url(url_embed);
+        curl.set_post_fields(post_fields);
+        return curl.perform();
+    });
 }
 
 } // namespace networking
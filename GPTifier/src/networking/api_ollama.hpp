@@ -6,5 +6,6 @@
 
 namespace networking {
 CurlResult generate_ollama_response(const std::string &post_fields);
+CurlResult stream_ollama_response(const std::string &post_fields, const StreamCallback &on_chunk);
 CurlResult create_ollama_embedding(const std::string &post_fields);
 } // namespace networking
@@ -1,5 +1,8 @@
 #include "api_openai_admin.hpp"
 
+#include "cassette.hpp"
+#include "configs.hpp"
+
 #include <cstdlib>
 #include <fmt/core.h>
 #include <stdexcept>
@@ -7,8 +10,6 @@
 
 namespace {
 
-const std::string URL_ORGANIZATION = "https://api.openai.com/v1/organization";
-
 std::string get_openai_admin_api_key_()
 {
     static std::string api_key;
@@ -16,6 +17,10 @@ std::string get_openai_admin_api_key_()
     if (api_key.empty()) {
         const char *env_api_key = std::getenv("OPENAI_ADMIN_KEY");
 
+        if (env_api_key == nullptr and networking::is_replaying()) {
+            return "";
+        }
+
         if (env_api_key == nullptr) {
             throw std::runtime_error("OPENAI_ADMIN_KEY environment variable not set");
         }
@@ -32,22 +37,13 @@ namespace networking {
 CurlResult get_costs(const std::time_t start_time, const int limit)
 {
     Curl curl;
-    CURL *handle = curl.get_handle();
 
     curl.append_header("Authorization: Bearer " + get_openai_admin_api_key_());
     curl.append_header("Content-Type: application/json");
-    curl_easy_setopt(handle, CURLOPT_HTTPHEADER, curl.get_headers());
-
-    const std::string endpoint = fmt::format("{}/{}?start_time={}&limit={}", URL_ORGANIZATION, "costs", start_time, limit);
-    curl_easy_setopt(handle, CURLOPT_URL, endpoint.c_str());
-
-    curl_easy_setopt(handle, CURLOPT_HTTPGET, 1L);
-
-    std::string response;
-    curl_easy_setopt(handle, CURLOPT_WRITEDATA, &response);
+    curl_easy_setopt(curl.get_handle(), CURLOPT_HTTPHEADER, curl.get_headers());
 
-    const CURLcode code = curl_easy_perform(handle);
-    return check_curl_code(handle, code, response);
+    curl.set_url(fmt::format("{}/organization/costs?start_time={}&limit={}", configs.base_url_openai.value(), start_time, limit));
+    return curl.perform();
 }
 
 } // namespace networking
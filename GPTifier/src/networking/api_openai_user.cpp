@@ -1,18 +1,33 @@
 #include "api_openai_user.hpp"
 
+#include "cassette.hpp"
+#include "configs.hpp"
+#include "hedging.hpp"
+#include "single_flight.hpp"
+
 #include <cstdlib>
 #include <expected>
 #include <fmt/core.h>
 #include <stdexcept>
+#include <string_view>
+#include <strings.h>
+#include <vector>
 
 namespace {
 
-const std::string URL_EMBEDDINGS = "https://api.openai.com/v1/embeddings";
-const std::string URL_FILES = "https://api.openai.com/v1/files";
-const std::string URL_FINE_TUNING = "https://api.openai.com/v1/fine_tuning";
-const std::string URL_IMAGES = "https://api.openai.com/v1/images";
-const std::string URL_MODELS = "https://api.openai.com/v1/models";
-const std::string URL_RESPONSES = "https://api.openai.com/v1/responses";
+std::string get_url_(const std::string &endpoint)
+{
+    static const std::string base_url = configs.base_url_openai.value();
+    return fmt::format("{}/{}", base_url, endpoint);
+}
+
+std::string escape_(CURL *handle, const std::string &value)
+{
+    char *escaped = curl_easy_escape(handle, value.c_str(), value.size());
+    const std::string result = escaped;
+    curl_free(escaped);
+    return result;
+}
 
 std::string get_openai_user_api_key_()
 {
@@ -21,6 +36,11 @@ std::string get_openai_user_api_key_()
     if (api_key.empty()) {
         const char *env_api_key = std::getenv("OPENAI_API_KEY");
 
+        // Nothing goes over the wire when replaying so the key is not needed
+        if (env_api_key == nullptr and networking::is_replaying()) {
+            return "";
+        }
+
         if (env_api_key == nullptr) {
             throw std::runtime_error("OPENAI_API_KEY environment variable not set");
         }
@@ -30,85 +50,127 @@ std::string get_openai_user_api_key_()
     return api_key;
 }
 
+void append_validators_(networking::Curl &curl, const networking::Validators &validators)
+{
+    if (not validators.etag.empty()) {
+        curl.append_header("If-None-Match: " + validators.etag);
+    }
+
+    if (not validators.last_modified.empty()) {
+        curl.append_header("If-Modified-Since: " + validators.last_modified);
+    }
+}
+
+std::string get_header_value_(const std::string &line, const std::string_view name)
+{
+    // Header names are case insensitive
+    if (line.size() <= name.size() or line[name.size()] != ':' or strncasecmp(line.c_str(), name.data(), name.size()) != 0) {
+        return "";
+    }
+
+    const std::size_t start = line.find_first_not_of(' ', name.size() + 1);
+    return start == std::string::npos ? "" : line.substr(start);
+}
+
+void read_validators_(const std::vector<std::string> &headers, networking::Validators &validators)
+{
+    validators = {};
+
+    for (const auto &line: headers) {
+        if (const std::string etag = get_header_value_(line, "ETag"); not etag.empty()) {
+            validators.etag = etag;
+        } else if (const std::string last_modified = get_header_value_(line, "Last-Modified"); not last_modified.empty()) {
+            validators.last_modified = last_modified;
+        }
+    }
+}
+
 } // namespace
 
 namespace networking {
 
-CurlResult get_models()
+CurlResult get_models(const StreamCallback &on_chunk, Validators *validators)
 {
     Curl curl;
-    CURL *handle = curl.get_handle();
+    std::vector<std::string> headers;
 
     curl.append_header("Authorization: Bearer " + get_openai_user_api_key_());
-    curl_easy_setopt(handle, CURLOPT_HTTPHEADER, curl.get_headers());
 
-    curl_easy_setopt(handle, CURLOPT_URL, URL_MODELS.c_str());
-    curl_easy_setopt(handle, CURLOPT_HTTPGET, 1L);
+    if (validators) {
+        append_validators_(curl, *validators);
+        curl.set_response_headers(&headers);
+    }
+
+    curl_easy_setopt(curl.get_handle(), CURLOPT_HTTPHEADER, curl.get_headers());
 
-    std::string response;
-    curl_easy_setopt(handle, CURLOPT_WRITEDATA, &response);
+    curl.set_url(get_url_("models"));
+    curl.set_stream_only();
 
-    const CURLcode code = curl_easy_perform(handle);
-    return check_curl_code(handle, code, response);
+    const CurlResult result = curl.perform(on_chunk);
+
+    if (validators and result) {
+        read_validators_(headers, *validators);
+    }
+
+    return result;
 }
 
 CurlResult delete_model(const std::string &model_id)
 {
     Curl curl;
-    CURL *handle = curl.get_handle();
 
     curl.append_header("Authorization: Bearer " + get_openai_user_api_key_());
-    curl_easy_setopt(handle, CURLOPT_HTTPHEADER, curl.get_headers());
+    curl_easy_setopt(curl.get_handle(), CURLOPT_HTTPHEADER, curl.get_headers());
 
-    const std::string endpoint = fmt::format("{}/{}", URL_MODELS, model_id);
-    curl_easy_setopt(handle, CURLOPT_URL, endpoint.c_str());
-    curl_easy_setopt(handle, CURLOPT_CUSTOMREQUEST, "DELETE");
-
-    std::string response;
-    curl_easy_setopt(handle, CURLOPT_WRITEDATA, &response);
-
-    const CURLcode code = curl_easy_perform(handle);
-    return check_curl_code(handle, code, response);
+    curl.set_url(fmt::format("{}/{}", get_url_("models"), model_id));
+    curl.set_custom_request("DELETE");
+    return curl.perform();
 }
 
 CurlResult create_openai_response(const std::string &post_fields)
+{
+    const std::string endpoint = get_url_("responses");
+
+    return single_flight("POST", endpoint, post_fields, get_openai_user_api_key_(), [&]() {
+        return perform_hedged(endpoint, [&](Curl &curl) {
+            curl.append_header("Authorization: Bearer " + get_openai_user_api_key_());
+            curl.append_header("Content-Type: application/json");
+            curl_easy_setopt(curl.get_handle(), CURLOPT_HTTPHEADER, curl.get_headers());
+
+            curl.set_url(endpoint);
+            curl.set_post_fields(post_fields);
+        });
+    });
+}
+
+CurlResult stream_openai_response(const std::string &post_fields, const StreamCallback &on_chunk)
 {
     Curl curl;
-    CURL *handle = curl.get_handle();
 
     curl.append_header("Authorization: Bearer " + get_openai_user_api_key_());
     curl.append_header("Content-Type: application/json");
-    curl_easy_setopt(handle, CURLOPT_HTTPHEADER, curl.get_headers());
+    curl_easy_setopt(curl.get_handle(), CURLOPT_HTTPHEADER, curl.get_headers());
 
-    curl_easy_setopt(handle, CURLOPT_URL, URL_RESPONSES.c_str());
-    curl_easy_setopt(handle, CURLOPT_POST, 1L);
-    curl_easy_setopt(handle, CURLOPT_POSTFIELDS, post_fields.c_str());
-
-    std::string response;
-    curl_easy_setopt(handle, CURLOPT_WRITEDATA, &response);
-
-    const CURLcode code = curl_easy_perform(handle);
-    return check_curl_code(handle, code, response);
+    curl.set_url(get_url_("responses"));
+    curl.set_post_fields(post_fields);
+    return curl.perform(on_chunk);
 }
 
 CurlResult create_openai_embedding(const std::string &post_fields)
 {
-    Curl curl;
-    CURL *handle = curl.get_handle();
+    const std::string endpoint = get_url_("embeddings");
 
-    curl.append_header("Authorization: Bearer " + get_openai_user_api_key_());
-    curl.append_header("Content-Type: application/json");
-    curl_easy_setopt(handle, CURLOPT_HTTPHEADER, curl.get_headers());
+    return single_flight("POST", endpoint, post_fields, get_openai_user_api_key_(), [&]() {
+        Curl curl;
 
-    curl_easy_setopt(handle, CURLOPT_URL, URL_EMBEDDINGS.c_str());
-    curl_easy_setopt(handle, CURLOPT_POST, 1L);
-    curl_easy_setopt(handle, CURLOPT_POSTFIELDS, post_fields.c_str());
+        curl.append_header("Authorization: Bearer " + get_openai_user_api_key_());
+        curl.append_header("Content-Type: application/json");
+        curl_easy_setopt(curl.get_handle(), CURLOPT_HTTPHEADER, curl.get_headers());
 
-    std::string response;
-    curl_easy_setopt(handle, CURLOPT_WRITEDATA, &response);
-
-    const CURLcode code = curl_easy_perform(handle);
-    return check_curl_code(handle, code, response);
+        curl.set_url(endpoint);
+        curl.set_post_fields(post_fields);
+        return curl.perform();
+    });
 }
 
 CurlResult upload_file(const std::string &filename, const std::string &purpose)
@@ -120,7 +182,7 @@ CurlResult upload_file(const std::string &filename, const std::string &purpose)
     curl.append_header("Content-Type: multipart/form-data");
     curl_easy_setopt(handle, CURLOPT_HTTPHEADER, curl.get_headers());
 
-    curl_easy_setopt(handle, CURLOPT_URL, URL_FILES.c_str());
+    curl.set_url(get_url_("files"));
 
     curl_mime *form = curl_mime_init(handle);
     curl_mimepart *field = NULL;
@@ -133,115 +195,185 @@ CurlResult upload_file(const std::string &filename, const std::string &purpose)
     curl_mime_name(field, "file");
     curl_mime_filedata(field, filename.c_str());
 
-    curl_easy_setopt(handle, CURLOPT_MIMEPOST, form);
+    curl.set_mime_post(form, fmt::format("purpose={}&file={}", purpose, filename));
+
+    try {
+        const CurlResult result = curl.perform();
+        curl_mime_free(form);
+        return result;
+    } catch (...) {
+        curl_mime_free(form);
+        throw;
+    }
+}
 
-    std::string response;
-    curl_easy_setopt(handle, CURLOPT_WRITEDATA, &response);
+CurlResult create_upload(const std::string &post_fields)
+{
+    Curl curl;
 
-    const CURLcode code = curl_easy_perform(handle);
-    curl_mime_free(form);
-    return check_curl_code(handle, code, response);
+    curl.append_header("Authorization: Bearer " + get_openai_user_api_key_());
+    curl.append_header("Content-Type: application/json");
+    curl_easy_setopt(curl.get_handle(), CURLOPT_HTTPHEADER, curl.get_headers());
+
+    curl.set_url(get_url_("uploads"));
+    curl.set_post_fields(post_fields);
+    return curl.perform();
 }
 
-CurlResult get_uploaded_files(const bool sort_asc)
+CurlResult add_upload_part(const std::string &upload_id, const std::string &data, const std::string &description)
 {
     Curl curl;
     CURL *handle = curl.get_handle();
 
     curl.append_header("Authorization: Bearer " + get_openai_user_api_key_());
+    curl.append_header("Content-Type: multipart/form-data");
     curl_easy_setopt(handle, CURLOPT_HTTPHEADER, curl.get_headers());
 
-    const std::string order = sort_asc ? "asc" : "desc";
-    const std::string endpoint = fmt::format("{}?order={}", URL_FILES, order);
-    curl_easy_setopt(handle, CURLOPT_URL, endpoint.c_str());
+    curl.set_url(fmt::format("{}/{}/parts", get_url_("uploads"), upload_id));
+
+    // libcurl copies the data into the form so the part does not need to outlive this call
+    curl_mime *form = curl_mime_init(handle);
+    curl_mimepart *field = curl_mime_addpart(form);
+    curl_mime_name(field, "data");
+    curl_mime_filename(field, "part");
+    curl_mime_data(field, data.data(), data.size());
+
+    curl.set_mime_post(form, description);
+
+    try {
+        const CurlResult result = curl.perform();
+        curl_mime_free(form);
+        return result;
+    } catch (...) {
+        curl_mime_free(form);
+        throw;
+    }
+}
 
-    curl_easy_setopt(handle, CURLOPT_HTTPGET, 1L);
+CurlResult complete_upload(const std::string &upload_id, const std::string &post_fields)
+{
+    Curl curl;
 
-    std::string response;
-    curl_easy_setopt(handle, CURLOPT_WRITEDATA, &response);
+    curl.append_header("Authorization: Bearer " + get_openai_user_api_key_());
+    curl.append_header("Content-Type: application/json");
+    curl_easy_setopt(curl.get_handle(), CURLOPT_HTTPHEADER, curl.get_headers());
 
-    const CURLcode code = curl_easy_perform(handle);
-    return check_curl_code(handle, code, response);
+    curl.set_url(fmt::format("{}/{}/complete", get_url_("uploads"), upload_id));
+    curl.set_post_fields(post_fields);
+    return curl.perform();
 }
 
-CurlResult delete_file(const std::string &file_id)
+CurlResult get_uploaded_files(const std::string &after, const int limit, const std::string &purpose, const StreamCallback &on_chunk)
 {
     Curl curl;
-    CURL *handle = curl.get_handle();
 
     curl.append_header("Authorization: Bearer " + get_openai_user_api_key_());
-    curl_easy_setopt(handle, CURLOPT_HTTPHEADER, curl.get_headers());
+    curl_easy_setopt(curl.get_handle(), CURLOPT_HTTPHEADER, curl.get_headers());
+
+    // Oldest first so that the cursor (the ID of the last file seen) always moves forward
+    std::string url = fmt::format("{}?order=asc&limit={}", get_url_("files"), limit);
 
-    const std::string endpoint = fmt::format("{}/{}", URL_FILES, file_id);
-    curl_easy_setopt(handle, CURLOPT_URL, endpoint.c_str());
-    curl_easy_setopt(handle, CURLOPT_CUSTOMREQUEST, "DELETE");
+    if (not after.empty()) {
+        url += "&after=" + escape_(curl.get_handle(), after);
+    }
 
-    std::string response;
-    curl_easy_setopt(handle, CURLOPT_WRITEDATA, &response);
+    if (not purpose.empty()) {
+        url += "&purpose=" + escape_(curl.get_handle(), purpose);
+    }
 
-    const CURLcode code = curl_easy_perform(handle);
-    return check_curl_code(handle, code, response);
+    curl.set_url(url);
+    curl.set_stream_only();
+    return curl.perform(on_chunk);
 }
 
-CurlResult create_fine_tuning_job(const std::string &post_fields)
+CurlResult get_uploaded_file(const std::string &file_id)
 {
     Curl curl;
-    CURL *handle = curl.get_handle();
 
     curl.append_header("Authorization: Bearer " + get_openai_user_api_key_());
-    curl.append_header("Content-Type: application/json");
-    curl_easy_setopt(handle, CURLOPT_HTTPHEADER, curl.get_headers());
+    curl_easy_setopt(curl.get_handle(), CURLOPT_HTTPHEADER, curl.get_headers());
 
-    const std::string endpoint = fmt::format("{}/{}", URL_FINE_TUNING, "jobs");
-    curl_easy_setopt(handle, CURLOPT_URL, endpoint.c_str());
-    curl_easy_setopt(handle, CURLOPT_POST, 1L);
-    curl_easy_setopt(handle, CURLOPT_POSTFIELDS, post_fields.c_str());
+    curl.set_url(fmt::format("{}/{}", get_url_("files"), file_id));
+    return curl.perform();
+}
 
-    std::string response;
-    curl_easy_setopt(handle, CURLOPT_WRITEDATA, &response);
+CurlResult download_file(const std::string &file_id, const curl_off_t offset, const StreamCallback &on_chunk)
+{
+    Curl curl;
 
-    const CURLcode code = curl_easy_perform(handle);
-    return check_curl_code(handle, code, response);
+    curl.append_header("Authorization: Bearer " + get_openai_user_api_key_());
+    curl_easy_setopt(curl.get_handle(), CURLOPT_HTTPHEADER, curl.get_headers());
+
+    curl.set_url(fmt::format("{}/{}/content", get_url_("files"), file_id));
+    curl.set_resume_from(offset);
+    curl.set_stream_only();
+
+    try {
+        return curl.perform(on_chunk);
+    } catch (const std::runtime_error &e) {
+        // Report a server that cannot resume the same way as one that rejects the range outright
+        if (offset > 0 and std::string_view(e.what()) == curl_easy_strerror(CURLE_RANGE_ERROR)) {
+            return std::unexpected(Err { 416, R"({"error": {"message": "The server does not support resuming downloads"}})" });
+        }
+
+        throw;
+    }
 }
 
-CurlResult get_fine_tuning_jobs(const int limit)
+CurlResult delete_file(const std::string &file_id)
 {
     Curl curl;
-    CURL *handle = curl.get_handle();
 
     curl.append_header("Authorization: Bearer " + get_openai_user_api_key_());
-    curl_easy_setopt(handle, CURLOPT_HTTPHEADER, curl.get_headers());
+    curl_easy_setopt(curl.get_handle(), CURLOPT_HTTPHEADER, curl.get_headers());
 
-    const std::string endpoint = fmt::format("{}/{}?limit={}", URL_FINE_TUNING, "jobs", limit);
-    curl_easy_setopt(handle, CURLOPT_URL, endpoint.c_str());
-    curl_easy_setopt(handle, CURLOPT_HTTPGET, 1L);
+    curl.set_url(fmt::format("{}/{}", get_url_("files"), file_id));
+    curl.set_custom_request("DELETE");
+    return curl.perform();
+}
 
-    std::string response;
-    curl_easy_setopt(handle, CURLOPT_WRITEDATA, &response);
+CurlResult create_fine_tuning_job(const std::string &post_fields)
+{
+    Curl curl;
+
+    curl.append_header("Authorization: Bearer " + get_openai_user_api_key_());
+    curl.append_header("Content-Type: application/json");
+    curl_easy_setopt(curl.get_handle(), CURLOPT_HTTPHEADER, curl.get_headers());
 
-    const CURLcode code = curl_easy_perform(handle);
-    return check_curl_code(handle, code, response);
+    curl.set_url(get_url_("fine_tuning/jobs"));
+    curl.set_post_fields(post_fields);
+    return curl.perform();
 }
 
-CurlResult create_image(const std::string &post_fields)
+CurlResult get_fine_tuning_jobs(const std::string &after, const int limit, const StreamCallback &on_chunk)
 {
     Curl curl;
-    CURL *handle = curl.get_handle();
 
     curl.append_header("Authorization: Bearer " + get_openai_user_api_key_());
-    curl.append_header("Content-Type: application/json");
-    curl_easy_setopt(handle, CURLOPT_HTTPHEADER, curl.get_headers());
+    curl_easy_setopt(curl.get_handle(), CURLOPT_HTTPHEADER, curl.get_headers());
+
+    std::string url = fmt::format("{}?limit={}", get_url_("fine_tuning/jobs"), limit);
 
-    const std::string endpoint = fmt::format("{}/{}", URL_IMAGES, "generations");
-    curl_easy_setopt(handle, CURLOPT_URL, endpoint.c_str());
-    curl_easy_setopt(handle, CURLOPT_POST, 1L);
-    curl_easy_setopt(handle, CURLOPT_POSTFIELDS, post_fields.c_str());
+    if (not after.empty()) {
+        url += "&after=" + escape_(curl.get_handle(), after);
+    }
+
+    curl.set_url(url);
+    curl.set_stream_only();
+    return curl.perform(on_chunk);
+}
 
-    std::string response;
-    curl_easy_setopt(handle, CURLOPT_WRITEDATA, &response);
+CurlResult create_image(const std::string &post_fields)
+{
+    Curl curl;
+
+    curl.append_header("Authorization: Bearer " + get_openai_user_api_key_());
+    curl.append_header("Content-Type: application/json");
+    curl_easy_setopt(curl.get_handle(), CURLOPT_HTTPHEADER, curl.get_headers());
 
-    const CURLcode code = curl_easy_perform(handle);
-    return check_curl_code(handle, code, response);
+    curl.set_url(get_url_("images/generations"));
+    curl.set_post_fields(post_fields);
+    return curl.perform();
 }
 
 } // namespace networking
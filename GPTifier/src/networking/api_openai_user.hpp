@@ -5,14 +5,31 @@
 #include <string>
 
 namespace networking {
-CurlResult get_models();
+
+// What a previous response was tagged with. Sent along so that the server can answer 304 (Not Modified)
+// instead of the same response all over again, and updated from the new response otherwise
+struct Validators {
+    std::string etag;
+    std::string last_modified;
+};
+
+CurlResult get_models(const StreamCallback &on_chunk, Validators *validators = nullptr);
 CurlResult delete_model(const std::string &model_id);
 CurlResult create_openai_response(const std::string &post_fields);
+CurlResult stream_openai_response(const std::string &post_fields, const StreamCallback &on_chunk);
 CurlResult create_openai_embedding(const std::string &post_fields);
 CurlResult upload_file(const std::string &filename, const std::string &purpose);
-CurlResult get_uploaded_files(const bool sort_asc = true);
+CurlResult create_upload(const std::string &post_fields);
+CurlResult add_upload_part(const std::string &upload_id, const std::string &data, const std::string &description);
+CurlResult complete_upload(const std::string &upload_id, const std::string &post_fields);
+CurlResult get_uploaded_files(const std::string &after, const int limit, const std::string &purpose, const StreamCallback &on_chunk);
+CurlResult get_uploaded_file(const std::string &file_id);
+
+// Stream the contents of a file from byte `offset` onwards. Fails with 416 if the server cannot serve the range
+CurlResult download_file(const std::string &file_id, const curl_off_t offset, const StreamCallback &on_chunk);
 CurlResult delete_file(const std::string &file_id);
 CurlResult create_fine_tuning_job(const std::string &post_fields);
-CurlResult get_fine_tuning_jobs(const int limit);
+CurlResult get_fine_tuning_jobs(const std::string &after, const int limit, const StreamCallback &on_chunk);
 CurlResult create_image(const std::string &post_fields);
+
 } // namespace networking
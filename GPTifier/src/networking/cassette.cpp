@@ -0,0 +1,344 @@
+#include "cassette.hpp"
+
+#include "utils.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fmt/core.h>
+#include <fstream>
+#include <json.hpp>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+
+namespace {
+
+using json = nlohmann::json;
+
+struct Settings {
+    float latency_scale = 1.0;
+    std::string record_path;
+    std::string replay_path;
+};
+
+struct Tape {
+    std::size_t next = 0;
+    std::vector<networking::Interaction> interactions;
+};
+
+std::mutex mutex_cassette;
+
+Settings load_settings_()
+{
+    Settings settings;
+
+    if (const char *path = std::getenv("GPTIFIER_RECORD")) {
+        settings.record_path = path;
+    }
+
+    if (const char *path = std::getenv("GPTIFIER_REPLAY")) {
+        settings.replay_path = path;
+    }
+
+    if (not settings.record_path.empty() and not settings.replay_path.empty()) {
+        throw std::runtime_error("GPTIFIER_RECORD and GPTIFIER_REPLAY cannot both be set");
+    }
+
+    if (const char *scale = std::getenv("GPTIFIER_REPLAY_LATENCY")) {
+        settings.latency_scale = utils::string_to_float(scale);
+
+        if (settings.latency_scale < 0.0) {
+            throw std::runtime_error("GPTIFIER_REPLAY_LATENCY must not be negative");
+        }
+    }
+
+    return settings;
+}
+
+const Settings &get_settings_()
+{
+    static const Settings settings = load_settings_();
+    return settings;
+}
+
+std::string get_key_(const networking::HttpRequest &request)
+{
+    // Ranged requests for the same URL ask for different bytes
+    std::string range;
+
+    for (const auto &header: request.headers) {
+        if (header.starts_with("Range:")) {
+            range = header;
+        }
+    }
+
+    return fmt::format("{} {}\n{}\n{}", request.method, request.url, range, request.body);
+}
+
+std::vector<std::string> redact_headers_(const std::vector<std::string> &headers)
+{
+    std::vector<std::string> redacted;
+
+    for (const auto &header: headers) {
+        if (header.starts_with("Authorization:")) {
+            redacted.push_back("Authorization: <redacted>");
+        } else {
+            redacted.push_back(header);
+        }
+    }
+
+    return redacted;
+}
+
+json chunk_to_json_(const networking::Chunk &chunk)
+{
+    // A chunk may end mid character and downloads may be binary, neither of which a JSON string can hold
+    try {
+        json(chunk.data).dump();
+        return json::array({ chunk.offset_ms, chunk.data });
+    } catch (const json::type_error &) {
+        return json::array({ chunk.offset_ms, json::object({ { "data_b64", utils::base64_encode(chunk.data) } }) });
+    }
+}
+
+networking::Chunk chunk_from_json_(const json &chunk)
+{
+    const json &data = chunk.at(1);
+
+    if (data.is_object()) {
+        return { chunk.at(0), utils::base64_decode(data.at("data_b64")) };
+    }
+
+    return { chunk.at(0), data };
+}
+
+std::string dump_(const json &value)
+{
+    // Only request bodies and headers can still hold invalid UTF-8 here, and are never replayed byte for byte
+    return value.dump(-1, ' ', false, json::error_handler_t::replace);
+}
+
+json to_json_(const networking::Interaction &interaction)
+{
+    json chunks = json::array();
+
+    for (const auto &chunk: interaction.chunks) {
+        chunks.push_back(chunk_to_json_(chunk));
+    }
+
+    return {
+        { "request", {
+                         { "method", interaction.request.method },
+                         { "url", interaction.request.url },
+                         { "headers", redact_headers_(interaction.request.headers) },
+                         { "body", interaction.request.body },
+                     } },
+        { "response", {
+                          { "status", interaction.status },
+                          { "headers", interaction.headers },
+                          { "elapsed_ms", interaction.elapsed_ms },
+                          { "chunks", chunks },
+                      } },
+    };
+}
+
+networking::Interaction from_json_(const json &line)
+{
+    networking::Interaction interaction;
+
+    const json &request = line.at("request");
+    interaction.request.method = request.at("method");
+    interaction.request.url = request.at("url");
+    interaction.request.body = request.at("body");
+
+    if (request.contains("headers")) {
+        interaction.request.headers = request.at("headers").get<std::vector<std::string>>();
+    }
+
+    const json &response = line.at("response");
+    interaction.status = response.at("status");
+    interaction.elapsed_ms = response.at("elapsed_ms");
+
+    if (response.contains("headers")) {
+        interaction.headers = response.at("headers").get<std::vector<std::string>>();
+    }
+
+    for (const auto &chunk: response.at("chunks")) {
+        interaction.chunks.push_back(chunk_from_json_(chunk));
+    }
+
+    return interaction;
+}
+
+std::unordered_map<std::string, Tape> load_cassette_(const std::string &filename)
+{
+    std::ifstream file(filename);
+
+    if (not file.is_open()) {
+        throw std::runtime_error(fmt::format("Unable to open cassette '{}'", filename));
+    }
+
+    std::unordered_map<std::string, Tape> tapes;
+    std::string line;
+    int line_number = 0;
+
+    while (std::getline(file, line)) {
+        line_number++;
+
+        if (line.empty()) {
+            continue;
+        }
+
+        try {
+            networking::Interaction interaction = from_json_(json::parse(line));
+            tapes[get_key_(interaction.request)].interactions.push_back(std::move(interaction));
+        } catch (const json::exception &e) {
+            throw std::runtime_error(fmt::format("Line {} of cassette '{}' is malformed: {}", line_number, filename, e.what()));
+        }
+    }
+
+    return tapes;
+}
+
+void sleep_until_(const std::chrono::steady_clock::time_point start, const double offset_ms)
+{
+    const double scaled_ms = offset_ms * get_settings_().latency_scale;
+
+    if (scaled_ms > 0.0) {
+        std::this_thread::sleep_until(start + std::chrono::duration<double, std::milli>(scaled_ms));
+    }
+}
+
+} // namespace
+
+namespace networking {
+
+bool is_recording()
+{
+    return not get_settings_().record_path.empty();
+}
+
+bool is_replaying()
+{
+    return not get_settings_().replay_path.empty();
+}
+
+std::string get_replay_path()
+{
+    return get_settings_().replay_path;
+}
+
+ChunkSpool::ChunkSpool()
+{
+    static std::atomic<int> count = 0;
+    this->filename_ = fmt::format("{}.{}.{}.spool", get_settings_().record_path, getpid(), count++);
+    this->file_.open(this->filename_, std::ios::binary | std::ios::trunc);
+
+    if (not this->file_.is_open()) {
+        throw std::runtime_error(fmt::format("Unable to open '{}'", this->filename_));
+    }
+}
+
+ChunkSpool::~ChunkSpool()
+{
+    this->file_.close();
+
+    std::error_code ec;
+    std::filesystem::remove(this->filename_, ec);
+}
+
+void ChunkSpool::append(const Chunk &chunk)
+{
+    this->file_ << (this->empty_ ? "" : ",") << chunk_to_json_(chunk).dump();
+    this->empty_ = false;
+
+    if (not this->file_) {
+        throw std::runtime_error(fmt::format("Unable to write to '{}'", this->filename_));
+    }
+}
+
+void record_interaction(const Interaction &interaction, ChunkSpool *spool)
+{
+    const json line = to_json_(interaction);
+
+    if (spool == nullptr) {
+        const std::lock_guard<std::mutex> lock(mutex_cassette);
+        utils::append_to_file(get_settings_().record_path, dump_(line) + "\n");
+        return;
+    }
+
+    // Keys are sorted, so the chunks open the response and the spooled chunks can be copied in between
+    json response = line.at("response");
+    response.erase("chunks");
+
+    const std::string head = fmt::format("{{\"request\":{},\"response\":{{\"chunks\":[", dump_(line.at("request")));
+    const std::string tail = fmt::format("],{}}}\n", dump_(response).substr(1));
+
+    spool->file_.close();
+    std::ifstream chunks(spool->filename_, std::ios::binary);
+
+    const std::lock_guard<std::mutex> lock(mutex_cassette);
+    std::ofstream file(get_settings_().record_path, std::ios::binary | std::ios::app);
+
+    if (not file.is_open() or not chunks.is_open()) {
+        throw std::runtime_error(fmt::format("Unable to record to '{}'", get_settings_().record_path));
+    }
+
+    file << head;
+
+    if (not spool->empty_) {
+        file << chunks.rdbuf();
+    }
+
+    file << tail;
+}
+
+CurlResult replay_interaction(const HttpRequest &request, const StreamCallback &on_chunk, const bool stream_only, std::vector<std::string> *headers)
+{
+    const auto start = std::chrono::steady_clock::now();
+    Interaction interaction;
+
+    {
+        const std::lock_guard<std::mutex> lock(mutex_cassette);
+        static std::unordered_map<std::string, Tape> tapes = load_cassette_(get_settings_().replay_path);
+
+        const auto it = tapes.find(get_key_(request));
+
+        if (it == tapes.end()) {
+            throw std::runtime_error(fmt::format("No recorded response for {} {} in cassette '{}'", request.method, request.url, get_settings_().replay_path));
+        }
+
+        Tape &tape = it->second;
+        interaction = tape.interactions[tape.next];
+        tape.next = (tape.next + 1) % tape.interactions.size();
+    }
+
+    std::string response;
+    const bool buffer = not stream_only or not is_success_status(interaction.status);
+
+    for (const auto &chunk: interaction.chunks) {
+        sleep_until_(start, chunk.offset_ms);
+
+        if (buffer) {
+            response += chunk.data;
+        }
+
+        if (on_chunk and not(stream_only and buffer)) {
+            on_chunk(chunk.data);
+        }
+    }
+
+    sleep_until_(start, interaction.elapsed_ms);
+
+    if (headers) {
+        *headers = interaction.headers;
+    }
+
+    return get_curl_result(interaction.status, response);
+}
+
+} // namespace networking
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "curl_base.hpp"
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace networking {
+
+// Every transfer is appended to the cassette named by the GPTIFIER_RECORD environment variable, or served
+// from the cassette named by GPTIFIER_REPLAY instead of going over the network. Replayed responses arrive
+// after the recorded latency times GPTIFIER_REPLAY_LATENCY (default 1, use 0 to skip waiting)
+bool is_recording();
+bool is_replaying();
+std::string get_replay_path();
+
+struct Chunk {
+    double offset_ms = 0.0;
+    std::string data;
+};
+
+struct Interaction {
+    HttpRequest request;
+    double elapsed_ms = 0.0;
+    long status = -1;
+    std::vector<Chunk> chunks;
+    std::vector<std::string> headers;
+};
+
+// Stream only transfers (i.e. file downloads) may not fit in memory, so while recording their chunks are
+// spooled to a file next to the cassette as they arrive and copied into the cassette once done
+class ChunkSpool {
+public:
+    ChunkSpool();
+    ~ChunkSpool();
+
+    ChunkSpool(const ChunkSpool &) = delete;
+    ChunkSpool &operator=(const ChunkSpool &) = delete;
+
+    void append(const Chunk &chunk);
+
+private:
+    friend void record_interaction(const Interaction &interaction, ChunkSpool *spool);
+
+    bool empty_ = true;
+    std::ofstream file_;
+    std::string filename_;
+};
+
+// Chunks are taken from `spool` instead of `interaction.chunks` if given
+void record_interaction(const Interaction &interaction, ChunkSpool *spool = nullptr);
+
+// Identical requests are served their recorded responses in order, starting over once all have been used.
+// See Curl::set_stream_only for `stream_only` and Curl::set_response_headers for `headers`
+CurlResult replay_interaction(const HttpRequest &request, const StreamCallback &on_chunk, const bool stream_only = false, std::vector<std::string> *headers = nullptr);
+
+} // namespace networking
@@ -1,23 +1,125 @@
 #include "curl_base.hpp"
 
+#include "cassette.hpp"
+
+#include <chrono>
+#include <exception>
+#include <optional>
+
 namespace {
 
+using Clock = std::chrono::steady_clock;
+
+struct Transfer {
+    Clock::time_point start = Clock::now();
+    CURL *handle = nullptr;
+    bool record = false;
+    bool stream_only = false;
+    networking::Interaction interaction;
+    networking::StreamCallback on_chunk;
+    std::optional<networking::ChunkSpool> spool;
+    std::exception_ptr error;
+    std::string response;
+};
+
+double get_elapsed_ms_(const Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
 size_t write_callback_(char *ptr, size_t size, size_t nmemb, std::string *data)
 {
     data->append(ptr, size * nmemb);
     return size * nmemb;
 }
 
+size_t transfer_callback_(char *ptr, size_t size, size_t nmemb, Transfer *transfer)
+{
+    const std::string_view chunk(ptr, size * nmemb);
+
+    if (transfer->spool) {
+        try {
+            transfer->spool->append({ get_elapsed_ms_(transfer->start), std::string(chunk) });
+        } catch (...) {
+            transfer->error = std::current_exception();
+            return 0;
+        }
+    } else if (transfer->record) {
+        transfer->interaction.chunks.push_back({ get_elapsed_ms_(transfer->start), std::string(chunk) });
+    }
+
+    bool buffer = true;
+
+    if (transfer->stream_only) {
+        // The status line has always been received by the time the body starts arriving
+        long http_status_code = -1;
+        curl_easy_getinfo(transfer->handle, CURLINFO_RESPONSE_CODE, &http_status_code);
+        buffer = not networking::is_success_status(http_status_code);
+    }
+
+    if (buffer) {
+        transfer->response.append(chunk);
+    }
+
+    if (transfer->on_chunk and not(transfer->stream_only and buffer)) {
+        // Exceptions must not unwind through libcurl, so abort the transfer and rethrow once it returns
+        try {
+            transfer->on_chunk(chunk);
+        } catch (...) {
+            transfer->error = std::current_exception();
+            return 0;
+        }
+    }
+
+    return size * nmemb;
+}
+
+size_t header_callback_(char *ptr, size_t size, size_t nmemb, Transfer *transfer)
+{
+    std::string header(ptr, size * nmemb);
+
+    while (not header.empty() and (header.back() == '\r' or header.back() == '\n')) {
+        header.pop_back();
+    }
+
+    if (not header.empty()) {
+        transfer->interaction.headers.push_back(std::move(header));
+    }
+
+    return size * nmemb;
+}
+
+// curl_global_init is not thread safe, so initialize libcurl exactly once per process rather than once
+// per handle. Function local statics are initialized in a thread safe manner
+struct CurlGlobal {
+    CurlGlobal()
+    {
+        if (curl_global_init(CURL_GLOBAL_DEFAULT) != 0) {
+            throw std::runtime_error("Something went wrong when initializing libcurl");
+        }
+    }
+
+    ~CurlGlobal()
+    {
+        curl_global_cleanup();
+    }
+
+    CurlGlobal(const CurlGlobal &) = delete;
+    CurlGlobal &operator=(const CurlGlobal &) = delete;
+};
+
+void init_curl_global_()
+{
+    static const CurlGlobal curl_global;
+}
+
 } // namespace
 
 namespace networking {
 
 Curl::Curl()
 {
-    if (curl_global_init(CURL_GLOBAL_DEFAULT) != 0) {
-        throw std::runtime_error("Something went wrong when initializing libcurl");
-    }
-
+    init_curl_global_();
     this->curl_ = curl_easy_init();
 
     if (this->curl_ == nullptr) {
@@ -25,6 +127,9 @@ Curl::Curl()
     }
 
     curl_easy_setopt(this->curl_, CURLOPT_WRITEFUNCTION, write_callback_);
+
+    // Handles may be used from worker threads where libcurl must not rely on signals for timeouts
+    curl_easy_setopt(this->curl_, CURLOPT_NOSIGNAL, 1L);
 }
 
 Curl::~Curl()
@@ -36,8 +141,6 @@ Curl::~Curl()
     if (this->curl_) {
         curl_easy_cleanup(this->curl_);
     }
-
-    curl_global_cleanup();
 }
 
 CURL *Curl::get_handle()
@@ -53,6 +156,104 @@ curl_slist *Curl::get_headers()
 void Curl::append_header(const std::string &header)
 {
     this->headers_ = curl_slist_append(this->headers_, header.c_str());
+    this->request_.headers.push_back(header);
+}
+
+void Curl::set_url(const std::string &url)
+{
+    this->request_.url = url;
+    curl_easy_setopt(this->curl_, CURLOPT_URL, this->request_.url.c_str());
+}
+
+void Curl::set_post_fields(const std::string &post_fields)
+{
+    // libcurl does not copy the body so point it at the copy owned by this handle
+    this->request_.method = "POST";
+    this->request_.body = post_fields;
+
+    curl_easy_setopt(this->curl_, CURLOPT_POST, 1L);
+    curl_easy_setopt(this->curl_, CURLOPT_POSTFIELDSIZE, static_cast<long>(this->request_.body.size()));
+    curl_easy_setopt(this->curl_, CURLOPT_POSTFIELDS, this->request_.body.c_str());
+}
+
+void Curl::set_custom_request(const std::string &method)
+{
+    this->request_.method = method;
+    curl_easy_setopt(this->curl_, CURLOPT_CUSTOMREQUEST, this->request_.method.c_str());
+}
+
+void Curl::set_mime_post(curl_mime *form, const std::string &description)
+{
+    this->request_.method = "POST";
+    this->request_.body = description;
+    curl_easy_setopt(this->curl_, CURLOPT_MIMEPOST, form);
+}
+
+void Curl::set_stream_only()
+{
+    this->stream_only_ = true;
+}
+
+void Curl::set_resume_from(const curl_off_t offset)
+{
+    if (offset <= 0) {
+        return;
+    }
+
+    // libcurl adds the header itself. It is only noted here so that ranged requests are recorded as such
+    this->request_.headers.push_back("Range: bytes=" + std::to_string(offset) + "-");
+    curl_easy_setopt(this->curl_, CURLOPT_RESUME_FROM_LARGE, offset);
+}
+
+void Curl::set_response_headers(std::vector<std::string> *headers)
+{
+    this->response_headers_ = headers;
+}
+
+CurlResult Curl::perform(const StreamCallback &on_chunk)
+{
+    if (is_replaying()) {
+        return replay_interaction(this->request_, on_chunk, this->stream_only_, this->response_headers_);
+    }
+
+    Transfer transfer;
+    transfer.handle = this->curl_;
+    transfer.on_chunk = on_chunk;
+    transfer.stream_only = this->stream_only_;
+    transfer.record = is_recording();
+
+    if (transfer.record and this->stream_only_) {
+        transfer.spool.emplace();
+    }
+
+    curl_easy_setopt(this->curl_, CURLOPT_WRITEFUNCTION, transfer_callback_);
+    curl_easy_setopt(this->curl_, CURLOPT_WRITEDATA, &transfer);
+
+    if (transfer.record or this->response_headers_) {
+        curl_easy_setopt(this->curl_, CURLOPT_HEADERFUNCTION, header_callback_);
+        curl_easy_setopt(this->curl_, CURLOPT_HEADERDATA, &transfer);
+    }
+
+    const CURLcode code = curl_easy_perform(this->curl_);
+
+    if (transfer.error) {
+        std::rethrow_exception(transfer.error);
+    }
+
+    const CurlResult result = check_curl_code(this->curl_, code, transfer.response);
+
+    if (this->response_headers_) {
+        *this->response_headers_ = transfer.interaction.headers;
+    }
+
+    if (transfer.record) {
+        transfer.interaction.request = this->request_;
+        transfer.interaction.status = result ? result->code : result.error().code;
+        transfer.interaction.elapsed_ms = get_elapsed_ms_(transfer.start);
+        record_interaction(transfer.interaction, transfer.spool ? &transfer.spool.value() : nullptr);
+    }
+
+    return result;
 }
 
 } // namespace networking
@@ -2,31 +2,14 @@
 
 #include <curl/curl.h>
 #include <expected>
+#include <functional>
 #include <stdexcept>
 #include <string>
+#include <string_view>
+#include <vector>
 
 namespace networking {
 
-class Curl {
-public:
-    Curl();
-    ~Curl();
-
-    CURL *get_handle();
-    curl_slist *get_headers();
-    void append_header(const std::string &header);
-
-    // We want to prevent any copies from being made otherwise we'll attempt
-    // to delete a shallow copy of the headers list multiple times (i.e. because the destructor will
-    // be called for each copy)
-    Curl(const Curl &) = delete;
-    Curl &operator=(const Curl &) = delete;
-
-private:
-    CURL *curl_ = nullptr;
-    curl_slist *headers_ = nullptr;
-};
-
 struct Ok {
     long code = -1;
     std::string response;
@@ -39,6 +22,25 @@ struct Err {
 
 using CurlResult = std::expected<Ok, Err>;
 
+// 206 (Partial Content) is what ranged requests succeed with
+inline bool is_success_status(const long http_status_code)
+{
+    return http_status_code == 200 or http_status_code == 206;
+}
+
+inline CurlResult get_curl_result(const long http_status_code, const std::string &response)
+{
+    if (is_success_status(http_status_code)) {
+        return Ok { http_status_code, response };
+    }
+
+    if (http_status_code == 404 and response.empty()) {
+        return std::unexpected(Err { http_status_code, "{\"error\": {\"message\": \"URL not found\"}}" });
+    }
+
+    return std::unexpected(Err { http_status_code, response });
+}
+
 inline CurlResult check_curl_code(CURL *handle, const CURLcode code, const std::string &response)
 {
     if (code != CURLE_OK) {
@@ -49,15 +51,62 @@ inline CurlResult check_curl_code(CURL *handle, const CURLcode code, const std::
     long http_status_code = -1;
     curl_easy_getinfo(handle, CURLINFO_RESPONSE_CODE, &http_status_code);
 
-    if (http_status_code == 200) {
-        return Ok { http_status_code, response };
-    }
+    return get_curl_result(http_status_code, response);
+}
 
-    if (http_status_code == 404 and response.empty()) {
-        return std::unexpected(Err { http_status_code, "{\"error\": {\"message\": \"URL not found\"}}" });
-    }
+using StreamCallback = std::function<void(std::string_view chunk)>;
 
-    return std::unexpected(Err { http_status_code, response });
-}
+// What a handle was asked to send. Kept alongside the handle so that transfers can be recorded and replayed
+struct HttpRequest {
+    std::string body;
+    std::string method = "GET";
+    std::string url;
+    std::vector<std::string> headers;
+};
+
+class Curl {
+public:
+    Curl();
+    ~Curl();
+
+    CURL *get_handle();
+    curl_slist *get_headers();
+    void append_header(const std::string &header);
+
+    void set_url(const std::string &url);
+    void set_post_fields(const std::string &post_fields);
+    void set_custom_request(const std::string &method);
+
+    // The form itself cannot be recorded, so `description` stands in for it when matching replayed requests
+    void set_mime_post(curl_mime *form, const std::string &description);
+
+    // Hand the body of a successful response to `on_chunk` only rather than also holding all of it in
+    // memory. Error responses are still buffered (and not streamed) so that they can be reported
+    void set_stream_only();
+
+    // Ask for the response body from byte `offset` onwards, i.e. to resume a download. libcurl fails the
+    // transfer with CURLE_RANGE_ERROR if the server ignores the range
+    void set_resume_from(curl_off_t offset);
+
+    // Store the header lines of the response in `headers` once the transfer completes
+    void set_response_headers(std::vector<std::string> *headers);
+
+    // Perform the transfer, or serve it from a cassette when replaying (see cassette.hpp). If given,
+    // `on_chunk` is handed each piece of the response as it arrives
+    CurlResult perform(const StreamCallback &on_chunk = nullptr);
+
+    // We want to prevent any copies from being made otherwise we'll attempt
+    // to delete a shallow copy of the headers list multiple times (i.e. because the destructor will
+    // be called for each copy)
+    Curl(const Curl &) = delete;
+    Curl &operator=(const Curl &) = delete;
+
+private:
+    bool stream_only_ = false;
+    CURL *curl_ = nullptr;
+    HttpRequest request_;
+    curl_slist *headers_ = nullptr;
+    std::vector<std::string> *response_headers_ = nullptr;
+};
 
 } // namespace networking
@@ -0,0 +1,254 @@
+#include "hedging.hpp"
+
+#include "cassette.hpp"
+#include "datadir.hpp"
+#include "sample_log.hpp"
+#include "utils.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <fmt/core.h>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+namespace fs = std::filesystem;
+using Clock = std::chrono::steady_clock;
+
+// Latencies are tracked over a sliding window of this many requests per endpoint
+const std::size_t HISTORY_SIZE = 100;
+
+// A percentile of fewer latencies than this says little about the tail, so do not hedge until then
+const std::size_t MIN_SAMPLES = 10;
+
+networking::HedgePolicy policy;
+std::atomic<int> hedges_fired = 0;
+
+struct History {
+    explicit History(const fs::path &filename) :
+        log(filename, HISTORY_SIZE)
+    {
+        for (const std::string &line: this->log.get_samples()) {
+            std::istringstream stream(line);
+            int latency_ms = 0;
+            int hedged = 0;
+
+            if (stream >> latency_ms >> hedged) {
+                this->samples.emplace_back(latency_ms, hedged != 0);
+            }
+        }
+    }
+
+    utils::SampleLog log;
+    std::vector<std::pair<int, bool>> samples;
+};
+
+fs::path get_history_path_(const std::string &url)
+{
+    static const fs::path directory = datadir::GPT_DATADIR / "latencies";
+
+    std::error_code ec;
+    fs::create_directories(directory, ec);
+
+    return directory / fmt::format("{}.txt", utils::hash_content(url));
+}
+
+std::optional<std::chrono::milliseconds> get_hedge_delay_(const History &history)
+{
+    if (history.samples.size() < MIN_SAMPLES) {
+        return std::nullopt;
+    }
+
+    const std::size_t num_hedged = std::count_if(history.samples.begin(), history.samples.end(), [](const auto &sample) {
+        return sample.second;
+    });
+
+    // Measured against the samples actually in the window, which is not yet full for new endpoints
+    if (num_hedged + 1 > policy.budget * history.samples.size()) {
+        return std::nullopt;
+    }
+
+    std::vector<int> latencies;
+    latencies.reserve(history.samples.size());
+
+    for (const auto &sample: history.samples) {
+        latencies.push_back(sample.first);
+    }
+
+    const std::size_t rank = std::ceil(policy.percentile / 100.0 * latencies.size()) - 1;
+    std::nth_element(latencies.begin(), latencies.begin() + rank, latencies.end());
+
+    return std::chrono::milliseconds(latencies[rank]);
+}
+
+class Multi {
+public:
+    Multi()
+    {
+        this->multi_ = curl_multi_init();
+
+        if (this->multi_ == nullptr) {
+            throw std::runtime_error("Something went wrong when starting libcurl multi session");
+        }
+    }
+
+    ~Multi()
+    {
+        // Removing a handle that is still transferring aborts the transfer
+        for (CURL *handle: this->handles_) {
+            curl_multi_remove_handle(this->multi_, handle);
+        }
+
+        curl_multi_cleanup(this->multi_);
+    }
+
+    Multi(const Multi &) = delete;
+    Multi &operator=(const Multi &) = delete;
+
+    CURLM *get_handle()
+    {
+        return this->multi_;
+    }
+
+    void add_handle(CURL *handle)
+    {
+        if (curl_multi_add_handle(this->multi_, handle) != CURLM_OK) {
+            throw std::runtime_error("Something went wrong when adding a transfer to libcurl multi session");
+        }
+
+        this->handles_.push_back(handle);
+    }
+
+private:
+    CURLM *multi_ = nullptr;
+    std::vector<CURL *> handles_;
+};
+
+struct Attempt {
+    networking::Curl curl;
+    std::string response;
+};
+
+networking::CurlResult perform_once_(const std::function<void(networking::Curl &)> &setup)
+{
+    networking::Curl curl;
+    setup(curl);
+
+    return curl.perform();
+}
+
+} // namespace
+
+namespace networking {
+
+void set_hedge_policy(const HedgePolicy &new_policy)
+{
+    if (new_policy.percentile <= 0.0 or new_policy.percentile > 100.0) {
+        throw std::runtime_error("Hedge percentile must be greater than 0 and at most 100");
+    }
+
+    if (new_policy.budget < 0.0 or new_policy.budget > 1.0) {
+        throw std::runtime_error("Hedge budget must be between 0 and 1");
+    }
+
+    policy = new_policy;
+}
+
+int get_hedges_fired()
+{
+    return hedges_fired;
+}
+
+CurlResult perform_hedged(const std::string &url, const std::function<void(Curl &)> &setup)
+{
+    // Racing duplicates would make recorded and replayed runs differ from one another
+    if (not policy.enabled or is_recording() or is_replaying()) {
+        return perform_once_(setup);
+    }
+
+    History history(get_history_path_(url));
+    const std::optional<std::chrono::milliseconds> delay = get_hedge_delay_(history);
+
+    std::array<Attempt, 2> attempts;
+
+    for (Attempt &attempt: attempts) {
+        setup(attempt.curl);
+        curl_easy_setopt(attempt.curl.get_handle(), CURLOPT_WRITEDATA, &attempt.response);
+    }
+
+    Multi multi;
+    multi.add_handle(attempts[0].curl.get_handle());
+
+    const auto start = Clock::now();
+    bool hedged = false;
+    std::optional<std::size_t> winner;
+    std::size_t failed = 0;
+    CURLcode error = CURLE_OK;
+
+    while (not winner) {
+        int running = 0;
+
+        if (curl_multi_perform(multi.get_handle(), &running) != CURLM_OK) {
+            throw std::runtime_error("Something went wrong when performing libcurl multi session");
+        }
+
+        int queued = 0;
+
+        while (CURLMsg *message = curl_multi_info_read(multi.get_handle(), &queued)) {
+            if (message->msg != CURLMSG_DONE) {
+                continue;
+            }
+
+            const std::size_t index = message->easy_handle == attempts[0].curl.get_handle() ? 0 : 1;
+
+            // A transfer that failed outright does not win the race as long as the other one may succeed
+            if (message->data.result == CURLE_OK) {
+                winner = index;
+                break;
+            }
+
+            failed = index;
+            error = message->data.result;
+        }
+
+        if (winner) {
+            break;
+        }
+
+        if (running == 0) {
+            return check_curl_code(attempts[failed].curl.get_handle(), error, attempts[failed].response);
+        }
+
+        int timeout_ms = 1000;
+
+        if (not hedged and delay) {
+            const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start);
+
+            if (elapsed >= delay.value()) {
+                multi.add_handle(attempts[1].curl.get_handle());
+                hedged = true;
+                hedges_fired++;
+                continue;
+            }
+
+            timeout_ms = std::min<int>(timeout_ms, (delay.value() - elapsed).count());
+        }
+
+        curl_multi_poll(multi.get_handle(), nullptr, 0, timeout_ms, nullptr);
+    }
+
+    const auto latency = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start);
+    history.log.append(fmt::format("{} {}", latency.count(), hedged ? 1 : 0));
+
+    Attempt &attempt = attempts[winner.value()];
+    return check_curl_code(attempt.curl.get_handle(), CURLE_OK, attempt.response);
+}
+
+} // namespace networking
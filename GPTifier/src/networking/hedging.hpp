@@ -0,0 +1,29 @@
+#pragma once
+
+#include "curl_base.hpp"
+
+#include <functional>
+#include <string>
+
+namespace networking {
+
+struct HedgePolicy {
+    bool enabled = false;
+
+    // Fire a duplicate request once the first has been outstanding for longer than this percentile of
+    // the latencies recently observed for the same endpoint
+    float percentile = 95.0;
+
+    // Hedge at most this fraction of the requests recently sent to the same endpoint
+    float budget = 0.1;
+};
+
+void set_hedge_policy(const HedgePolicy &policy);
+int get_hedges_fired();
+
+// Send the request configured by `setup` and, if hedging is enabled, race it against a duplicate should
+// it be slow. The first response wins and the other transfer is aborted. `setup` must not set
+// CURLOPT_WRITEDATA
+CurlResult perform_hedged(const std::string &url, const std::function<void(Curl &)> &setup);
+
+} // namespace networking
@@ -0,0 +1,266 @@
+#include "single_flight.hpp"
+
+#include "datadir.hpp"
+#include "utils.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <fcntl.h>
+#include <filesystem>
+#include <fmt/core.h>
+#include <fstream>
+#include <future>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+
+namespace {
+
+namespace fs = std::filesystem;
+
+// Results are only needed by processes that were already waiting when the request completed
+const std::chrono::seconds RESULT_TTL(60);
+
+std::atomic<bool> single_flight_enabled = true;
+std::mutex mutex_flights;
+std::unordered_map<std::string, std::shared_future<networking::CurlResult>> flights;
+
+std::string get_key_(const std::string &method, const std::string &url, const std::string &body, const std::string &credentials)
+{
+    // Separate the fields so that e.g. ("ab", "c") and ("a", "bc") do not collide. Requests sent with different
+    // credentials are billed to different accounts so they are never merged
+    return utils::hash_content(method + '\0' + url + '\0' + body + '\0' + utils::hash_content(credentials));
+}
+
+// Cross process coordination ------------------------------------------------------------------------------
+
+void remove_stale_results_(const fs::path &directory)
+{
+    std::error_code ec;
+    const auto now = fs::file_time_type::clock::now();
+
+    for (const auto &entry: fs::directory_iterator(directory, ec)) {
+        if (entry.path().extension() != ".result") {
+            continue;
+        }
+
+        const auto modified = entry.last_write_time(ec);
+
+        if (not ec and now - modified > RESULT_TTL) {
+            fs::remove(entry.path(), ec);
+        }
+    }
+}
+
+void write_result_(const fs::path &filename, const networking::CurlResult &result)
+{
+    std::string text;
+
+    if (result) {
+        text = fmt::format("ok {}\n{}", result->code, result->response);
+    } else {
+        text = fmt::format("err {}\n{}", result.error().code, result.error().response);
+    }
+
+    // Renamed into place so that waiting processes never read a partially written result. Should this fail,
+    // waiting processes find no result and send the request themselves
+    try {
+        utils::write_file_atomically(filename.string(), text);
+    } catch (const std::runtime_error &) {
+    }
+}
+
+std::optional<networking::CurlResult> read_result_(const fs::path &filename)
+{
+    std::ifstream file(filename, std::ios::binary);
+
+    if (not file.is_open()) {
+        return std::nullopt;
+    }
+
+    std::string status;
+    long code = -1;
+
+    if (not(file >> status >> code) or file.get() != '\n') {
+        return std::nullopt;
+    }
+
+    std::ostringstream response;
+    response << file.rdbuf();
+
+    if (status == "ok") {
+        return networking::Ok { code, response.str() };
+    }
+
+    return std::unexpected(networking::Err { code, response.str() });
+}
+
+bool is_same_file_(const int fd, const fs::path &path)
+{
+    struct stat by_fd;
+    struct stat by_path;
+
+    if (fstat(fd, &by_fd) != 0 or stat(path.c_str(), &by_path) != 0) {
+        return false;
+    }
+
+    return by_fd.st_dev == by_path.st_dev and by_fd.st_ino == by_path.st_ino;
+}
+
+class FileLock {
+public:
+    explicit FileLock(const fs::path &path)
+    {
+        this->fd_ = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    }
+
+    ~FileLock()
+    {
+        if (this->fd_ != -1) {
+            flock(this->fd_, LOCK_UN);
+            close(this->fd_);
+        }
+    }
+
+    FileLock(const FileLock &) = delete;
+    FileLock &operator=(const FileLock &) = delete;
+
+    int get_fd() const
+    {
+        return this->fd_;
+    }
+
+private:
+    int fd_ = -1;
+};
+
+networking::CurlResult perform_across_processes_(const std::string &key, const std::function<networking::CurlResult()> &perform)
+{
+    const fs::path directory = datadir::GPT_DATADIR / "inflight";
+    std::error_code ec;
+
+    // Results hold response bodies so keep them private
+    if (not fs::exists(directory) and fs::create_directories(directory, ec)) {
+        fs::permissions(directory, fs::perms::owner_all, ec);
+    }
+
+    const fs::path lockfile = directory / (key + ".lock");
+    const fs::path waitfile = directory / (key + ".wait");
+    const fs::path resultfile = directory / (key + ".result");
+
+    // The process holding the lock file is the one sending the request. Processes that find it locked leave a
+    // wait file behind before blocking on it. Once done, the process in flight publishes the result if anyone
+    // is waiting and unlinks the lock file before unlocking it. A waiting process that then wakes up holding a
+    // lock on an unlinked file therefore knows that a result may be ready for it
+    while (true) {
+        const auto waiting_since = fs::file_time_type::clock::now();
+        const FileLock lock(lockfile);
+
+        if (lock.get_fd() == -1) {
+            return perform();
+        }
+
+        const bool waited = flock(lock.get_fd(), LOCK_EX | LOCK_NB) != 0;
+
+        if (waited) {
+            const std::ofstream marker(waitfile);
+
+            if (flock(lock.get_fd(), LOCK_EX) != 0) {
+                return perform();
+            }
+        }
+
+        if (not is_same_file_(lock.get_fd(), lockfile)) {
+            if (waited and fs::exists(resultfile) and fs::last_write_time(resultfile, ec) >= waiting_since) {
+                if (const auto result = read_result_(resultfile)) {
+                    return result.value();
+                }
+            }
+
+            // Either the lock file was replaced in between opening and locking it, or the process in flight
+            // did not see this one waiting in time. Either way, try again with the new lock file
+            continue;
+        }
+
+        // The lock is still in place, so either nobody was in flight or the process in flight died before
+        // publishing a result. Either way, send the request. Should it throw, waiting processes find no
+        // result and send the request themselves
+        std::optional<networking::CurlResult> result;
+
+        try {
+            result = perform();
+        } catch (...) {
+            fs::remove(lockfile, ec);
+            throw;
+        }
+
+        // Nothing touches the disk beyond the lock file unless another process is waiting for the result
+        if (fs::remove(waitfile, ec)) {
+            remove_stale_results_(directory);
+            write_result_(resultfile, result.value());
+        }
+
+        fs::remove(lockfile, ec);
+        return result.value();
+    }
+}
+
+} // namespace
+
+namespace networking {
+
+CurlResult single_flight(const std::string &method, const std::string &url, const std::string &body, const std::string &credentials, const std::function<CurlResult()> &perform)
+{
+    if (not single_flight_enabled) {
+        return perform();
+    }
+
+    const std::string key = get_key_(method, url, body, credentials);
+
+    std::promise<CurlResult> promise;
+    std::shared_future<CurlResult> flight;
+    bool leader = false;
+
+    {
+        const std::lock_guard<std::mutex> lock(mutex_flights);
+        const auto it = flights.find(key);
+
+        if (it == flights.end()) {
+            flight = promise.get_future().share();
+            flights.emplace(key, flight);
+            leader = true;
+        } else {
+            flight = it->second;
+        }
+    }
+
+    // Another thread is already sending this request so wait for its result (or exception)
+    if (not leader) {
+        return flight.get();
+    }
+
+    try {
+        promise.set_value(perform_across_processes_(key, perform));
+    } catch (...) {
+        promise.set_exception(std::current_exception());
+    }
+
+    {
+        const std::lock_guard<std::mutex> lock(mutex_flights);
+        flights.erase(key);
+    }
+
+    return flight.get();
+}
+
+void set_single_flight(const bool enabled)
+{
+    single_flight_enabled = enabled;
+}
+
+} // namespace networking
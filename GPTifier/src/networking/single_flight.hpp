@@ -0,0 +1,19 @@
+#pragma once
+
+#include "curl_base.hpp"
+
+#include <functional>
+#include <string>
+
+namespace networking {
+
+// Call `perform` unless an identical request (same method, URL, body and credentials, i.e. the API key) is
+// already in flight, either on another thread or in another process on this machine. In that case wait for
+// the request in flight to complete and share its result instead of sending a duplicate. Only use this for
+// requests that can safely be answered once on behalf of several callers
+CurlResult single_flight(const std::string &method, const std::string &url, const std::string &body, const std::string &credentials, const std::function<CurlResult()> &perform);
+
+// Send every request even if an identical one is in flight (i.e. when generating load on purpose)
+void set_single_flight(const bool enabled);
+
+} // namespace networking
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace parallel {
+
+// Call func(i) for every i in [0, count) using at most `jobs` worker threads. The first exception thrown
+// by any worker stops the remaining work and is rethrown on the calling thread once all workers have joined
+template<typename Func>
+void for_each_index(const std::size_t count, const int jobs, Func &&func)
+{
+    if (count == 0) {
+        return;
+    }
+
+    const std::size_t num_workers = std::min<std::size_t>(std::max(jobs, 1), count);
+
+    std::atomic<std::size_t> next_index = 0;
+    std::atomic<bool> failed = false;
+    std::exception_ptr error;
+    std::mutex mutex_error;
+
+    auto worker = [&]() {
+        while (not failed.load()) {
+            const std::size_t i = next_index.fetch_add(1);
+
+            if (i >= count) {
+                break;
+            }
+
+            try {
+                func(i);
+            } catch (...) {
+                const std::lock_guard<std::mutex> lock(mutex_error);
+
+                if (not error) {
+                    error = std::current_exception();
+                }
+
+                failed.store(true);
+            }
+        }
+    };
+
+    if (num_workers == 1) {
+        worker();
+    } else {
+        std::vector<std::thread> workers;
+
+        for (std::size_t w = 0; w < num_workers; ++w) {
+            workers.emplace_back(worker);
+        }
+
+        for (auto &thread: workers) {
+            thread.join();
+        }
+    }
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+// Hands values from one producer thread to one consumer thread. push blocks while the channel is full so
+// that a fast producer cannot run arbitrarily far ahead of a slow consumer. The producer calls close once
+// done, passing along the exception that stopped it (if any), which pop then rethrows on the consumer
+template<typename T>
+class Channel {
+public:
+    explicit Channel(const std::size_t capacity) :
+        capacity_(std::max<std::size_t>(capacity, 1))
+    {
+    }
+
+    // Returns false if the consumer has gone away, in which case the producer should stop
+    bool push(T value)
+    {
+        std::unique_lock<std::mutex> lock(this->mutex_);
+        this->not_full_.wait(lock, [this]() {
+            return this->cancelled_ or this->values_.size() < this->capacity_;
+        });
+
+        if (this->cancelled_) {
+            return false;
+        }
+
+        this->values_.push_back(std::move(value));
+        this->not_empty_.notify_one();
+        return true;
+    }
+
+    // Returns std::nullopt once the channel has been closed and drained
+    std::optional<T> pop()
+    {
+        std::unique_lock<std::mutex> lock(this->mutex_);
+        this->not_empty_.wait(lock, [this]() {
+            return this->closed_ or not this->values_.empty();
+        });
+
+        if (this->values_.empty()) {
+            if (this->error_) {
+                std::rethrow_exception(this->error_);
+            }
+
+            return std::nullopt;
+        }
+
+        T value = std::move(this->values_.front());
+        this->values_.pop_front();
+        this->not_full_.notify_one();
+        return value;
+    }
+
+    void close(const std::exception_ptr error = nullptr)
+    {
+        const std::lock_guard<std::mutex> lock(this->mutex_);
+        this->closed_ = true;
+        this->error_ = error;
+        this->not_empty_.notify_all();
+    }
+
+    // Called by the consumer to unblock and stop the producer
+    void cancel()
+    {
+        const std::lock_guard<std::mutex> lock(this->mutex_);
+        this->cancelled_ = true;
+        this->values_.clear();
+        this->not_full_.notify_all();
+    }
+
+private:
+    bool cancelled_ = false;
+    bool closed_ = false;
+    std::condition_variable not_empty_;
+    std::condition_variable not_full_;
+    std::deque<T> values_;
+    std::exception_ptr error_;
+    std::mutex mutex_;
+    std::size_t capacity_;
+};
+
+} // namespace parallel
@@ -0,0 +1,335 @@
+#include "bm25.hpp"
+
+#include "store.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <fmt/core.h>
+#include <fstream>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace retrieval {
+
+namespace {
+
+namespace fs = std::filesystem;
+
+const float BM25_K1 = 1.2;
+const float BM25_B = 0.75;
+
+// Longer runs are almost always hashes or encoded blobs which only bloat the index
+const std::size_t MAX_TERM_LENGTH = 64;
+
+const std::uint32_t LEXICAL_VERSION = 1;
+
+struct LexicalHeader {
+    char magic[4] = { 'G', 'P', 'T', 'L' };
+    std::uint32_t version = LEXICAL_VERSION;
+    std::uint32_t num_chunks = 0;
+    std::uint32_t num_terms = 0;
+    double average_length = 0.0;
+    std::uint64_t strings_size = 0;
+};
+
+struct Posting {
+    std::uint32_t chunk = 0;
+    std::uint32_t frequency = 0;
+};
+
+bool is_term_char_(const unsigned char c)
+{
+    // Bytes above 0x7f are treated as part of a word so that UTF-8 text is not torn apart
+    return std::isalnum(c) or c == '_' or c >= 0x80;
+}
+
+void append_varint_(std::string &buffer, std::uint32_t value)
+{
+    while (value >= 0x80) {
+        buffer.push_back(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+
+    buffer.push_back(static_cast<char>(value));
+}
+
+std::uint32_t read_varint_(const unsigned char *&ptr)
+{
+    std::uint32_t value = 0;
+    int shift = 0;
+
+    while (*ptr & 0x80) {
+        value |= static_cast<std::uint32_t>(*ptr++ & 0x7f) << shift;
+        shift += 7;
+    }
+
+    value |= static_cast<std::uint32_t>(*ptr++) << shift;
+    return value;
+}
+
+template<typename T>
+void write_raw_(std::ofstream &file, const T *data, const std::size_t count)
+{
+    file.write(reinterpret_cast<const char *>(data), count * sizeof(T));
+}
+
+} // namespace
+
+struct LexicalIndex::ChunkEntry {
+    std::uint64_t offset = 0;
+    std::uint32_t length = 0;
+    std::uint32_t reserved = 0;
+};
+
+struct LexicalIndex::TermEntry {
+    std::uint64_t postings_offset = 0;
+    std::uint32_t postings_size = 0;
+    std::uint32_t frequency = 0;
+    std::uint32_t string_offset = 0;
+    std::uint32_t string_length = 0;
+};
+
+std::vector<std::string> tokenize(std::string_view text)
+{
+    std::vector<std::string> terms;
+    std::size_t pos = 0;
+
+    while (pos < text.size()) {
+        while (pos < text.size() and not is_term_char_(text[pos])) {
+            ++pos;
+        }
+
+        const std::size_t start = pos;
+
+        while (pos < text.size() and is_term_char_(text[pos])) {
+            ++pos;
+        }
+
+        if (pos == start or pos - start > MAX_TERM_LENGTH) {
+            continue;
+        }
+
+        std::string term(text.substr(start, pos - start));
+
+        for (char &c: term) {
+            c = std::tolower(static_cast<unsigned char>(c));
+        }
+
+        terms.push_back(std::move(term));
+    }
+
+    return terms;
+}
+
+void LexicalIndex::write(const std::vector<Record> &records, const std::vector<std::uint64_t> &offsets, const fs::path &filename)
+{
+    std::unordered_map<std::string, std::vector<Posting>> postings;
+    std::vector<ChunkEntry> chunks(records.size());
+    std::uint64_t total_length = 0;
+
+    for (std::size_t i = 0; i < records.size(); ++i) {
+        std::vector<std::string> terms = tokenize(records[i].text);
+        std::sort(terms.begin(), terms.end());
+
+        chunks[i].offset = offsets[i];
+        chunks[i].length = terms.size();
+        total_length += terms.size();
+
+        // Chunks are visited in order so every posting list stays sorted by chunk
+        for (std::size_t t = 0; t < terms.size();) {
+            std::size_t end = t + 1;
+
+            while (end < terms.size() and terms[end] == terms[t]) {
+                ++end;
+            }
+
+            postings[terms[t]].push_back({ static_cast<std::uint32_t>(i), static_cast<std::uint32_t>(end - t) });
+            t = end;
+        }
+    }
+
+    std::vector<const std::string *> sorted_terms;
+    sorted_terms.reserve(postings.size());
+
+    for (const auto &[term, list]: postings) {
+        sorted_terms.push_back(&term);
+    }
+
+    std::sort(sorted_terms.begin(), sorted_terms.end(), [](const std::string *a, const std::string *b) {
+        return *a < *b;
+    });
+
+    std::vector<TermEntry> terms(sorted_terms.size());
+    std::string strings;
+    std::string encoded;
+
+    for (std::size_t t = 0; t < sorted_terms.size(); ++t) {
+        const std::vector<Posting> &list = postings[*sorted_terms[t]];
+
+        terms[t].string_offset = strings.size();
+        terms[t].string_length = sorted_terms[t]->size();
+        terms[t].frequency = list.size();
+        terms[t].postings_offset = encoded.size();
+        strings += *sorted_terms[t];
+
+        std::uint32_t previous = 0;
+
+        for (const auto &posting: list) {
+            append_varint_(encoded, posting.chunk - previous);
+            append_varint_(encoded, posting.frequency);
+            previous = posting.chunk;
+        }
+
+        terms[t].postings_size = encoded.size() - terms[t].postings_offset;
+    }
+
+    // Keep the postings section 8 byte aligned
+    strings.resize((strings.size() + 7) & ~std::size_t(7), '\0');
+
+    LexicalHeader header;
+    header.num_chunks = records.size();
+    header.num_terms = terms.size();
+    header.average_length = records.empty() ? 0.0 : static_cast<double>(total_length) / records.size();
+    header.strings_size = strings.size();
+
+    std::ofstream file(filename, std::ios::binary);
+
+    if (not file.is_open()) {
+        throw std::runtime_error(fmt::format("Unable to open '{}'", filename.string()));
+    }
+
+    write_raw_(file, &header, 1);
+    write_raw_(file, chunks.data(), chunks.size());
+    write_raw_(file, terms.data(), terms.size());
+    write_raw_(file, strings.data(), strings.size());
+    write_raw_(file, encoded.data(), encoded.size());
+
+    if (not file) {
+        throw std::runtime_error(fmt::format("Failed to write '{}'", filename.string()));
+    }
+}
+
+LexicalIndex::LexicalIndex(const fs::path &filename) :
+    file_(filename)
+{
+    LexicalHeader header;
+
+    if (this->file_.size() < sizeof(header)) {
+        throw std::runtime_error(fmt::format("'{}' is not a GPTifier lexical index", filename.string()));
+    }
+
+    std::memcpy(&header, this->file_.data(), sizeof(header));
+
+    if (std::memcmp(header.magic, "GPTL", 4) != 0 or header.version != LEXICAL_VERSION) {
+        throw std::runtime_error(fmt::format("'{}' is not a GPTifier lexical index", filename.string()));
+    }
+
+    const std::size_t chunks_offset = sizeof(header);
+    const std::size_t terms_offset = chunks_offset + header.num_chunks * sizeof(ChunkEntry);
+    const std::size_t strings_offset = terms_offset + header.num_terms * sizeof(TermEntry);
+    const std::size_t postings_offset = strings_offset + header.strings_size;
+
+    if (postings_offset > this->file_.size()) {
+        throw std::runtime_error(fmt::format("'{}' is truncated", filename.string()));
+    }
+
+    this->average_length_ = header.average_length;
+    this->num_chunks_ = header.num_chunks;
+    this->num_terms_ = header.num_terms;
+    this->chunks_ = reinterpret_cast<const ChunkEntry *>(this->file_.data() + chunks_offset);
+    this->terms_ = reinterpret_cast<const TermEntry *>(this->file_.data() + terms_offset);
+    this->strings_ = this->file_.data() + strings_offset;
+    this->postings_ = reinterpret_cast<const unsigned char *>(this->file_.data() + postings_offset);
+    this->postings_size_ = this->file_.size() - postings_offset;
+}
+
+std::uint64_t LexicalIndex::get_chunk_offset(const std::size_t chunk) const
+{
+    if (chunk >= this->num_chunks_) {
+        throw std::runtime_error(fmt::format("Chunk {} is out of range", chunk));
+    }
+
+    return this->chunks_[chunk].offset;
+}
+
+const LexicalIndex::TermEntry *LexicalIndex::find_term_(const std::string_view term) const
+{
+    const TermEntry *begin = this->terms_;
+    const TermEntry *end = this->terms_ + this->num_terms_;
+
+    const TermEntry *it = std::lower_bound(begin, end, term, [this](const TermEntry &entry, const std::string_view value) {
+        return std::string_view(this->strings_ + entry.string_offset, entry.string_length) < value;
+    });
+
+    if (it == end or std::string_view(this->strings_ + it->string_offset, it->string_length) != term) {
+        return nullptr;
+    }
+
+    return it;
+}
+
+std::vector<ScoredChunk> LexicalIndex::search(const std::string_view query, const std::size_t top_k) const
+{
+    std::vector<std::string> terms = tokenize(query);
+    std::sort(terms.begin(), terms.end());
+    terms.erase(std::unique(terms.begin(), terms.end()), terms.end());
+
+    std::vector<float> scores(this->num_chunks_, 0.0);
+    std::vector<std::uint32_t> touched;
+
+    const double num_chunks = this->num_chunks_;
+
+    for (const auto &term: terms) {
+        const TermEntry *entry = this->find_term_(term);
+
+        if (entry == nullptr) {
+            continue;
+        }
+
+        if (entry->postings_offset + entry->postings_size > this->postings_size_) {
+            throw std::runtime_error("Lexical index is corrupt. Re-ingest to rebuild it");
+        }
+
+        const float idf = std::log(1.0 + (num_chunks - entry->frequency + 0.5) / (entry->frequency + 0.5));
+        const unsigned char *ptr = this->postings_ + entry->postings_offset;
+        std::uint32_t chunk = 0;
+
+        for (std::uint32_t i = 0; i < entry->frequency; ++i) {
+            chunk += read_varint_(ptr);
+            const float frequency = read_varint_(ptr);
+
+            if (chunk >= this->num_chunks_) {
+                throw std::runtime_error("Lexical index is corrupt. Re-ingest to rebuild it");
+            }
+
+            const float length = this->chunks_[chunk].length;
+            const float norm = BM25_K1 * (1.0 - BM25_B + BM25_B * length / this->average_length_);
+
+            if (scores[chunk] == 0.0) {
+                touched.push_back(chunk);
+            }
+
+            scores[chunk] += idf * frequency * (BM25_K1 + 1.0) / (frequency + norm);
+        }
+    }
+
+    std::vector<ScoredChunk> results;
+    results.reserve(touched.size());
+
+    for (const std::uint32_t chunk: touched) {
+        results.push_back({ chunk, scores[chunk] });
+    }
+
+    const std::size_t count = std::min(top_k, results.size());
+
+    std::partial_sort(results.begin(), results.begin() + count, results.end(), [](const ScoredChunk &a, const ScoredChunk &b) {
+        return a.score > b.score or (a.score == b.score and a.chunk < b.chunk);
+    });
+
+    results.resize(count);
+    return results;
+}
+
+} // namespace retrieval
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "mapped_file.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace retrieval {
+
+struct Record;
+
+// An inverted index over chunk text, scored with Okapi BM25. The index is a single file holding:
+//   a header
+//   one entry per chunk (byte offset of the chunk in chunks.jsonl and its length in terms)
+//   one entry per term, sorted by term, pointing into the strings and postings sections
+//   the term strings
+//   the postings. Each posting is a varint encoded (chunk delta, term frequency) pair
+
+struct ScoredChunk {
+    std::uint32_t chunk = 0;
+    float score = 0.0;
+};
+
+// Split text into lowercase terms. Identifiers such as snake_case names are kept whole so that exact
+// identifiers and error codes can be found
+std::vector<std::string> tokenize(std::string_view text);
+
+class LexicalIndex {
+public:
+    explicit LexicalIndex(const std::filesystem::path &filename);
+
+    // Index the text of every record. Offsets are the byte offsets of the records in chunks.jsonl
+    static void write(const std::vector<Record> &records, const std::vector<std::uint64_t> &offsets, const std::filesystem::path &filename);
+
+    std::size_t size() const
+    {
+        return this->num_chunks_;
+    }
+
+    std::uint64_t get_chunk_offset(std::size_t chunk) const;
+    std::vector<ScoredChunk> search(std::string_view query, std::size_t top_k) const;
+
+private:
+    struct TermEntry;
+    struct ChunkEntry;
+
+    const TermEntry *find_term_(std::string_view term) const;
+
+    MappedFile file_;
+    double average_length_ = 0.0;
+    std::size_t num_chunks_ = 0;
+    std::size_t num_terms_ = 0;
+    const ChunkEntry *chunks_ = nullptr;
+    const TermEntry *terms_ = nullptr;
+    const char *strings_ = nullptr;
+    const unsigned char *postings_ = nullptr;
+    std::size_t postings_size_ = 0;
+};
+
+} // namespace retrieval
@@ -0,0 +1,189 @@
+#include "chunking.hpp"
+
+#include "utils.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string_view>
+
+namespace retrieval {
+
+namespace {
+
+// The strength of the break preceding a word. Chunks are preferably cut at paragraph breaks, then at line
+// breaks and only then between arbitrary words
+enum class Boundary {
+    None,
+    Line,
+    Paragraph,
+};
+
+struct Unit {
+    Boundary boundary = Boundary::None;
+    int tokens = 0;
+    std::size_t begin = 0;
+    std::size_t end = 0;
+};
+
+bool is_blank_(std::string_view line)
+{
+    return line.find_first_not_of(" \t\r\v\f") == std::string_view::npos;
+}
+
+bool is_code_fence_(std::string_view line)
+{
+    const std::size_t first = line.find_first_not_of(" \t");
+
+    if (first == std::string_view::npos) {
+        return false;
+    }
+
+    line.remove_prefix(first);
+    return line.starts_with("```") or line.starts_with("~~~");
+}
+
+bool is_space_(const char c)
+{
+    return c == ' ' or c == '\t' or c == '\r' or c == '\v' or c == '\f';
+}
+
+std::vector<Unit> split_into_units_(const std::string &text)
+{
+    std::vector<Unit> units;
+    Boundary pending = Boundary::None;
+    bool in_code_block = false;
+    std::size_t line_start = 0;
+
+    while (line_start < text.size()) {
+        std::size_t line_end = text.find('\n', line_start);
+
+        if (line_end == std::string::npos) {
+            line_end = text.size();
+        }
+
+        const std::string_view line(text.data() + line_start, line_end - line_start);
+        const bool is_fence = is_code_fence_(line);
+
+        // Blank lines inside a fenced code block do not end a paragraph. This keeps code blocks together
+        if (not in_code_block and (is_fence or is_blank_(line))) {
+            pending = Boundary::Paragraph;
+        }
+
+        pending = std::max(pending, Boundary::Line);
+        std::size_t pos = line_start;
+
+        while (pos < line_end) {
+            while (pos < line_end and is_space_(text[pos])) {
+                ++pos;
+            }
+
+            if (pos == line_end) {
+                break;
+            }
+
+            Unit unit;
+            unit.begin = pos;
+
+            while (pos < line_end and not is_space_(text[pos])) {
+                ++pos;
+            }
+
+            unit.end = pos;
+            unit.boundary = pending;
+            unit.tokens = utils::estimate_token_count(std::string_view(text).substr(unit.begin, unit.end - unit.begin));
+            units.push_back(unit);
+
+            pending = Boundary::None;
+        }
+
+        if (is_fence) {
+            in_code_block = not in_code_block;
+
+            if (not in_code_block) {
+                pending = Boundary::Paragraph;
+            }
+        }
+
+        line_start = line_end + 1;
+    }
+
+    return units;
+}
+
+std::size_t find_cut_(const std::vector<Unit> &units, const std::size_t start, const std::size_t end)
+{
+    // Only consider the back half of the window so that a stray boundary near the start of the window
+    // does not produce a tiny chunk
+    const std::size_t earliest = start + (end - start) / 2 + 1;
+
+    for (const Boundary wanted: { Boundary::Paragraph, Boundary::Line }) {
+        for (std::size_t cut = end; cut >= earliest and cut > start; --cut) {
+            if (units[cut].boundary >= wanted) {
+                return cut;
+            }
+        }
+    }
+
+    return end;
+}
+
+} // namespace
+
+std::vector<Chunk> chunk_text(const std::string &text, const ChunkOptions &options)
+{
+    if (options.chunk_size < 1) {
+        throw std::runtime_error("Chunk size must be a positive number of tokens");
+    }
+
+    if (options.overlap < 0 or options.overlap >= options.chunk_size) {
+        throw std::runtime_error("Chunk overlap must be non-negative and smaller than the chunk size");
+    }
+
+    const std::vector<Unit> units = split_into_units_(text);
+    const std::size_t num_units = units.size();
+
+    std::vector<Chunk> chunks;
+    std::size_t start = 0;
+
+    while (start < num_units) {
+        // Always take at least one unit so that a single oversized word cannot stall the loop
+        std::size_t end = start;
+        int tokens = 0;
+
+        while (end < num_units and (end == start or tokens + units[end].tokens <= options.chunk_size)) {
+            tokens += units[end].tokens;
+            ++end;
+        }
+
+        const std::size_t cut = end < num_units ? find_cut_(units, start, end) : end;
+
+        Chunk chunk;
+        chunk.offset = units[start].begin;
+        chunk.length = units[cut - 1].end - chunk.offset;
+        chunk.text = text.substr(chunk.offset, chunk.length);
+
+        for (std::size_t i = start; i < cut; ++i) {
+            chunk.tokens += units[i].tokens;
+        }
+
+        chunks.push_back(std::move(chunk));
+
+        if (cut >= num_units) {
+            break;
+        }
+
+        std::size_t next = cut;
+        int overlap_tokens = 0;
+
+        while (next > start + 1 and overlap_tokens + units[next - 1].tokens <= options.overlap) {
+            overlap_tokens += units[next - 1].tokens;
+            --next;
+        }
+
+        start = next;
+    }
+
+    return chunks;
+}
+
+} // namespace retrieval
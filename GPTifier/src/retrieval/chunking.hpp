@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace retrieval {
+
+struct ChunkOptions {
+    int chunk_size = 512;
+    int overlap = 64;
+};
+
+struct Chunk {
+    int tokens = 0;
+    std::size_t length = 0;
+    std::size_t offset = 0;
+    std::string text;
+};
+
+std::vector<Chunk> chunk_text(const std::string &text, const ChunkOptions &options);
+
+} // namespace retrieval
@@ -0,0 +1,89 @@
+#include "cluster.hpp"
+
+#include "kernels.hpp"
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+
+namespace retrieval {
+
+namespace {
+
+const std::size_t BLOCK_SIZE = 8192;
+
+} // namespace
+
+Clustering cluster_store(const StoreReader &reader, const KMeansOptions &options)
+{
+    const std::size_t count = reader.size();
+    const std::size_t dimensions = reader.get_manifest().dimensions;
+
+    if (count == 0) {
+        throw std::runtime_error("Cannot cluster an empty store");
+    }
+
+    const float *vectors = reader.get_vector(0);
+
+    Clustering clustering;
+    clustering.centroids = train_kmeans(vectors, count, dimensions, options);
+
+    // Mini-batch training only ever sees a sample, so every chunk gets a final assignment pass
+    clustering.labels = assign_to_centroids(vectors, count, clustering.centroids, dimensions, options.jobs);
+
+    const std::size_t num_clusters = options.clusters;
+    std::vector<float> best_distances(num_clusters, std::numeric_limits<float>::max());
+
+    clustering.representatives.assign(num_clusters, std::nullopt);
+    clustering.sizes.assign(num_clusters, 0);
+
+    const std::size_t num_blocks = (count + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    std::mutex mutex_results;
+
+    parallel::for_each_index(num_blocks, options.jobs, [&](const std::size_t block) {
+        const std::size_t begin = block * BLOCK_SIZE;
+        const std::size_t end = std::min(begin + BLOCK_SIZE, count);
+
+        std::vector<float> distances(num_clusters, std::numeric_limits<float>::max());
+        std::vector<std::size_t> nearest(num_clusters, 0);
+        std::vector<std::size_t> sizes(num_clusters, 0);
+
+        for (std::size_t i = begin; i < end; ++i) {
+            const std::size_t c = clustering.labels[i];
+            const float distance = squared_distance_f32(vectors + i * dimensions, clustering.centroids.data() + c * dimensions, dimensions);
+
+            if (distance < distances[c]) {
+                distances[c] = distance;
+                nearest[c] = i;
+            }
+
+            sizes[c]++;
+        }
+
+        const std::lock_guard<std::mutex> lock(mutex_results);
+
+        for (std::size_t c = 0; c < num_clusters; ++c) {
+            clustering.sizes[c] += sizes[c];
+
+            // Clusters can be left empty when there are fewer distinct vectors than clusters
+            if (sizes[c] == 0) {
+                continue;
+            }
+
+            // Ties go to the earliest chunk so that the result does not depend on thread scheduling
+            const std::optional<std::size_t> &representative = clustering.representatives[c];
+            const bool tie = distances[c] == best_distances[c] and nearest[c] < representative.value_or(count);
+
+            if (not representative or distances[c] < best_distances[c] or tie) {
+                best_distances[c] = distances[c];
+                clustering.representatives[c] = nearest[c];
+            }
+        }
+    });
+
+    return clustering;
+}
+
+} // namespace retrieval
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "kmeans.hpp"
+#include "store.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace retrieval {
+
+struct Clustering {
+    std::vector<float> centroids;
+    std::vector<std::uint32_t> labels; // The cluster of each chunk, in store order
+    std::vector<std::optional<std::size_t>> representatives; // The chunk closest to each centroid, if any
+    std::vector<std::size_t> sizes;
+};
+
+// Cluster the vectors of a saved store in place, straight from the memory mapped vectors file
+Clustering cluster_store(const StoreReader &reader, const KMeansOptions &options);
+
+} // namespace retrieval
@@ -0,0 +1,52 @@
+#include "context.hpp"
+
+#include "store.hpp"
+#include "utils.hpp"
+
+#include <fmt/core.h>
+#include <stdexcept>
+
+namespace retrieval {
+
+Context build_context(const std::string &store, const std::string &prompt, const ContextOptions &options)
+{
+    if (options.token_budget < 1) {
+        throw std::runtime_error("Context budget must be a positive number of tokens");
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+
+    const StoreReader reader(get_store_path(store));
+    const std::vector<SearchResult> results = search_store(reader, prompt, options.search_options);
+
+    Context context;
+    std::string excerpts;
+
+    // Results arrive best first. A chunk that does not fit is skipped in favour of smaller ones further down
+    for (const auto &result: results) {
+        const std::string excerpt = fmt::format("--- {} (offset {}) ---\n{}\n\n", result.record.path, result.record.offset, result.record.text);
+        const int tokens = utils::estimate_token_count(excerpt);
+
+        if (context.num_tokens + tokens > options.token_budget) {
+            continue;
+        }
+
+        excerpts += excerpt;
+        context.num_tokens += tokens;
+        context.num_chunks++;
+    }
+
+    if (context.num_chunks > 0) {
+        context.prompt = fmt::format(
+            "Use the following excerpts to answer the question at the end. Each excerpt is labeled with its source.\n\n"
+            "{}Question:\n{}",
+            excerpts, prompt);
+    } else {
+        context.prompt = prompt;
+    }
+
+    context.retrieval_time = std::chrono::steady_clock::now() - start;
+    return context;
+}
+
+} // namespace retrieval
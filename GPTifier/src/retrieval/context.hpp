@@ -0,0 +1,27 @@
+#pragma once
+
+#include "search.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+
+namespace retrieval {
+
+struct ContextOptions {
+    SearchOptions search_options;
+    int token_budget = 2000;
+};
+
+struct Context {
+    int num_tokens = 0;
+    std::chrono::duration<float> retrieval_time;
+    std::size_t num_chunks = 0;
+    std::string prompt;
+};
+
+// Search a store for the chunks most relevant to a prompt and prepend as many of them as fit within the
+// token budget to the prompt
+Context build_context(const std::string &store, const std::string &prompt, const ContextOptions &options);
+
+} // namespace retrieval
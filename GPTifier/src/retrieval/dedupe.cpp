@@ -0,0 +1,245 @@
+#include "dedupe.hpp"
+
+#include "kernels.hpp"
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <mutex>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <utility>
+
+namespace retrieval {
+
+namespace {
+
+// Each table hashes a chunk by the signs of its projections onto 16 random hyperplanes
+const std::size_t BAND_BITS = 16;
+const std::size_t NUM_BUCKETS = std::size_t(1) << BAND_BITS;
+
+const std::size_t BLOCK_SIZE = 4096;
+const std::size_t BUCKETS_PER_TASK = 1024;
+
+// Buckets of unrelated chunks would otherwise cost a comparison per pair of chunks
+const std::size_t MAX_LEADERS_PER_BUCKET = 32;
+
+using Pair = std::pair<std::uint32_t, std::uint32_t>;
+
+class DisjointSets {
+public:
+    explicit DisjointSets(const std::size_t count) :
+        parents_(count)
+    {
+        std::iota(this->parents_.begin(), this->parents_.end(), 0);
+    }
+
+    std::size_t find(std::size_t i)
+    {
+        while (this->parents_[i] != i) {
+            this->parents_[i] = this->parents_[this->parents_[i]];
+            i = this->parents_[i];
+        }
+
+        return i;
+    }
+
+    void merge(const std::size_t a, const std::size_t b)
+    {
+        const std::size_t root_a = this->find(a);
+        const std::size_t root_b = this->find(b);
+
+        // Keep the smaller chunk as root so that the output is stable
+        if (root_a < root_b) {
+            this->parents_[root_b] = root_a;
+        } else if (root_b < root_a) {
+            this->parents_[root_a] = root_b;
+        }
+    }
+
+private:
+    std::vector<std::size_t> parents_;
+};
+
+std::vector<float> create_hyperplanes_(const std::size_t num_planes, const std::size_t dimensions, const std::uint64_t seed)
+{
+    std::mt19937_64 rng(seed);
+    std::normal_distribution<float> normal(0.0, 1.0);
+
+    std::vector<float> planes(num_planes * dimensions);
+
+    for (float &value: planes) {
+        value = normal(rng);
+    }
+
+    return planes;
+}
+
+std::vector<std::uint64_t> compute_signatures_(const float *vectors, const std::size_t count, const std::size_t dimensions, const std::vector<float> &planes, const int jobs)
+{
+    const std::size_t num_planes = planes.size() / dimensions;
+    const std::size_t num_words = (num_planes + 63) / 64;
+    const std::size_t num_blocks = (count + BLOCK_SIZE - 1) / BLOCK_SIZE;
+
+    std::vector<std::uint64_t> signatures(count * num_words, 0);
+
+    parallel::for_each_index(num_blocks, jobs, [&](const std::size_t block) {
+        const std::size_t end = std::min(count, (block + 1) * BLOCK_SIZE);
+
+        for (std::size_t i = block * BLOCK_SIZE; i < end; ++i) {
+            std::uint64_t *words = signatures.data() + i * num_words;
+
+            for (std::size_t p = 0; p < num_planes; ++p) {
+                if (dot_f32(vectors + i * dimensions, planes.data() + p * dimensions, dimensions) > 0.0f) {
+                    words[p / 64] |= std::uint64_t(1) << (p % 64);
+                }
+            }
+        }
+    });
+
+    return signatures;
+}
+
+std::vector<float> compute_norms_(const float *vectors, const std::size_t count, const std::size_t dimensions, const int jobs)
+{
+    std::vector<float> norms(count);
+    const std::size_t num_blocks = (count + BLOCK_SIZE - 1) / BLOCK_SIZE;
+
+    parallel::for_each_index(num_blocks, jobs, [&](const std::size_t block) {
+        const std::size_t end = std::min(count, (block + 1) * BLOCK_SIZE);
+
+        for (std::size_t i = block * BLOCK_SIZE; i < end; ++i) {
+            const float *row = vectors + i * dimensions;
+            norms[i] = std::sqrt(dot_f32(row, row, dimensions));
+        }
+    });
+
+    return norms;
+}
+
+} // namespace
+
+std::vector<std::vector<std::size_t>> find_near_duplicates(const StoreReader &reader, const DedupeOptions &options)
+{
+    if (options.threshold <= 0.0f or options.threshold > 1.0f) {
+        throw std::runtime_error("Threshold must be greater than 0 and at most 1");
+    }
+
+    if (options.tables < 1) {
+        throw std::runtime_error("Number of tables must be positive");
+    }
+
+    const std::size_t count = reader.size();
+    const std::size_t dimensions = reader.get_manifest().dimensions;
+
+    if (count < 2) {
+        return {};
+    }
+
+    const float *vectors = reader.get_vector(0);
+    const std::size_t num_planes = options.tables * BAND_BITS;
+    const std::size_t num_words = (num_planes + 63) / 64;
+
+    const std::vector<std::uint64_t> signatures = compute_signatures_(vectors, count, dimensions, create_hyperplanes_(num_planes, dimensions, options.seed), options.jobs);
+    const std::vector<float> norms = compute_norms_(vectors, count, dimensions, options.jobs);
+
+    auto is_near_duplicate = [&](const std::size_t a, const std::size_t b) {
+        const float denominator = norms[a] * norms[b];
+        return denominator > 0.0f and dot_f32(vectors + a * dimensions, vectors + b * dimensions, dimensions) >= options.threshold * denominator;
+    };
+
+    std::vector<Pair> pairs;
+    std::mutex mutex_pairs;
+
+    std::vector<std::uint32_t> keys(count);
+    std::vector<std::uint32_t> order(count);
+
+    for (int table = 0; table < options.tables; ++table) {
+        const std::size_t bit = table * BAND_BITS;
+
+        for (std::size_t i = 0; i < count; ++i) {
+            keys[i] = (signatures[i * num_words + bit / 64] >> (bit % 64)) & (NUM_BUCKETS - 1);
+        }
+
+        // Counting sort by bucket, leaving every bucket as a contiguous range of chunks
+        std::vector<std::size_t> starts(NUM_BUCKETS + 1, 0);
+
+        for (const std::uint32_t key: keys) {
+            starts[key + 1]++;
+        }
+
+        std::partial_sum(starts.begin(), starts.end(), starts.begin());
+        std::vector<std::size_t> cursors(starts.begin(), starts.end() - 1);
+
+        for (std::size_t i = 0; i < count; ++i) {
+            order[cursors[keys[i]]++] = i;
+        }
+
+        parallel::for_each_index(NUM_BUCKETS / BUCKETS_PER_TASK, options.jobs, [&](const std::size_t task) {
+            std::vector<Pair> found;
+            std::vector<std::uint32_t> leaders;
+
+            for (std::size_t bucket = task * BUCKETS_PER_TASK; bucket < (task + 1) * BUCKETS_PER_TASK; ++bucket) {
+                leaders.clear();
+
+                // Each chunk is compared against the first chunk of each group seen so far in its bucket
+                // rather than against every other chunk. Other tables catch what this misses
+                for (std::size_t pos = starts[bucket]; pos < starts[bucket + 1]; ++pos) {
+                    const std::uint32_t chunk = order[pos];
+                    bool matched = false;
+
+                    for (const std::uint32_t leader: leaders) {
+                        if (is_near_duplicate(chunk, leader)) {
+                            found.emplace_back(leader, chunk);
+                            matched = true;
+                            break;
+                        }
+                    }
+
+                    if (not matched and leaders.size() < MAX_LEADERS_PER_BUCKET) {
+                        leaders.push_back(chunk);
+                    }
+                }
+            }
+
+            const std::lock_guard<std::mutex> lock(mutex_pairs);
+            pairs.insert(pairs.end(), found.begin(), found.end());
+        });
+    }
+
+    DisjointSets sets(count);
+
+    for (const auto &[a, b]: pairs) {
+        sets.merge(a, b);
+    }
+
+    std::map<std::size_t, std::vector<std::size_t>> groups_by_root;
+
+    for (const auto &[a, b]: pairs) {
+        groups_by_root[sets.find(a)];
+    }
+
+    for (std::size_t i = 0; i < count; ++i) {
+        const auto it = groups_by_root.find(sets.find(i));
+
+        if (it != groups_by_root.end()) {
+            it->second.push_back(i);
+        }
+    }
+
+    std::vector<std::vector<std::size_t>> groups;
+
+    for (auto &[root, members]: groups_by_root) {
+        groups.push_back(std::move(members));
+    }
+
+    std::stable_sort(groups.begin(), groups.end(), [](const auto &a, const auto &b) {
+        return a.size() > b.size();
+    });
+
+    return groups;
+}
+
+} // namespace retrieval
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "store.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace retrieval {
+
+struct DedupeOptions {
+    float threshold = 0.95; // Minimum cosine similarity between near duplicates
+    int jobs = 1;
+    int tables = 16; // More tables find more duplicates at the cost of more comparisons
+    std::uint64_t seed = 42;
+};
+
+// Find groups of chunks whose vectors are near duplicates of each other. Candidates are found with SimHash
+// locality sensitive hashing and then confirmed by their exact cosine similarity, so no quadratic all pairs
+// comparison is needed. Groups are returned largest first, each sorted by chunk
+std::vector<std::vector<std::size_t>> find_near_duplicates(const StoreReader &reader, const DedupeOptions &options);
+
+} // namespace retrieval
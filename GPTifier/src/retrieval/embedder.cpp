@@ -0,0 +1,52 @@
+#include "embedder.hpp"
+
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <mutex>
+#include <stdexcept>
+
+namespace retrieval {
+
+serialization::Embeddings embed_texts(const std::vector<std::string> &texts, const EmbedOptions &options)
+{
+    if (options.batch_size < 1) {
+        throw std::runtime_error("Batch size must be a positive number");
+    }
+
+    const std::size_t batch_size = options.batch_size;
+    const std::size_t num_batches = (texts.size() + batch_size - 1) / batch_size;
+
+    serialization::Embeddings results;
+    results.embeddings.resize(texts.size());
+    std::mutex mutex_results;
+
+    // Both OpenAI and Ollama accept an array of inputs so each request carries a whole batch. Batches are
+    // then sent concurrently
+    parallel::for_each_index(num_batches, options.jobs, [&](const std::size_t b) {
+        const std::size_t begin = b * batch_size;
+        const std::size_t end = std::min(begin + batch_size, texts.size());
+        const std::vector<std::string> batch(texts.begin() + begin, texts.begin() + end);
+
+        serialization::Embeddings embeddings;
+
+        if (options.use_local) {
+            embeddings = serialization::create_ollama_embeddings(options.model, batch, options.dimensions);
+        } else {
+            embeddings = serialization::create_openai_embeddings(options.model, batch, options.dimensions);
+        }
+
+        const std::lock_guard<std::mutex> lock(mutex_results);
+
+        for (std::size_t i = 0; i < embeddings.embeddings.size(); ++i) {
+            results.embeddings[begin + i] = std::move(embeddings.embeddings[i]);
+        }
+
+        results.model = embeddings.model;
+        results.source = embeddings.source;
+    });
+
+    return results;
+}
+
+} // namespace retrieval
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "embeddings.hpp"
+
+#include <string>
+#include <vector>
+
+namespace retrieval {
+
+struct EmbedOptions {
+    bool use_local = false;
+    int batch_size = 64;
+    int dimensions = 0; // Use the model's full dimensions when not positive
+    int jobs = 4;
+    std::string model;
+};
+
+serialization::Embeddings embed_texts(const std::vector<std::string> &texts, const EmbedOptions &options);
+
+} // namespace retrieval
@@ -0,0 +1,442 @@
+#include "ingest.hpp"
+
+#include "parallel.hpp"
+#include "utils.hpp"
+
+#include <algorithm>
+#include <fmt/core.h>
+#include <fnmatch.h>
+#include <set>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace retrieval {
+
+namespace {
+
+namespace fs = std::filesystem;
+
+const std::vector<std::string> DEFAULT_IGNORE_GLOBS = { ".git", ".hg", ".svn" };
+
+struct SourceFile {
+    bool changed = false;
+    bool skipped = false;
+    std::string content;
+    std::string hash;
+    std::string path;
+};
+
+bool matches_any_glob_(const std::string &path, const std::string &name, const std::vector<std::string> &globs)
+{
+    for (const auto &glob: globs) {
+        if (fnmatch(glob.c_str(), path.c_str(), 0) == 0 or fnmatch(glob.c_str(), name.c_str(), 0) == 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void walk_directory_(const fs::path &directory, const fs::path &root, const std::vector<std::string> &globs, std::vector<fs::path> &files)
+{
+    const auto options = fs::directory_options::skip_permission_denied;
+
+    for (auto it = fs::recursive_directory_iterator(directory, options); it != fs::recursive_directory_iterator(); ++it) {
+        // Parent directories were already checked on the way down so only the entry itself needs checking
+        const fs::path relative = it->path().lexically_relative(root);
+
+        if (matches_any_glob_(relative.string(), relative.filename().string(), globs)) {
+            if (it->is_directory()) {
+                it.disable_recursion_pending();
+            }
+            continue;
+        }
+
+        if (it->is_regular_file()) {
+            files.push_back(it->path());
+        }
+    }
+}
+
+std::vector<fs::path> collect_files_(const fs::path &root, const std::vector<std::string> &globs)
+{
+    std::vector<fs::path> files;
+    std::vector<fs::path> subdirectories;
+
+    for (const auto &entry: fs::directory_iterator(root, fs::directory_options::skip_permission_denied)) {
+        if (is_ignored(entry.path().lexically_relative(root), globs)) {
+            continue;
+        }
+
+        if (entry.is_directory()) {
+            subdirectories.push_back(entry.path());
+        } else if (entry.is_regular_file()) {
+            files.push_back(entry.path());
+        }
+    }
+
+    // Walk each top level subdirectory on its own thread
+    std::vector<std::vector<fs::path>> found(subdirectories.size());
+
+    parallel::for_each_index(subdirectories.size(), 8, [&](const std::size_t i) {
+        walk_directory_(subdirectories[i], root, globs, found[i]);
+    });
+
+    for (const auto &batch: found) {
+        files.insert(files.end(), batch.begin(), batch.end());
+    }
+
+    std::sort(files.begin(), files.end());
+    return files;
+}
+
+bool is_binary_(const std::string &content)
+{
+    static const std::size_t bytes_to_check = 8000;
+    return content.find('\0') < std::min(content.size(), bytes_to_check);
+}
+
+void read_and_hash_(SourceFile &file, const Store &store)
+{
+    std::string content;
+
+    try {
+        content = utils::read_from_file(file.path);
+    } catch (const std::runtime_error &) {
+        // The file vanished or became unreadable between listing and reading it
+        file.skipped = true;
+        return;
+    }
+
+    if (content.empty() or is_binary_(content)) {
+        file.skipped = true;
+        return;
+    }
+
+    file.hash = utils::hash_content(content);
+
+    const auto it = store.files.find(file.path);
+    file.changed = it == store.files.end() or it->second != file.hash;
+
+    // Only hold onto the contents of files that need to be re-chunked
+    if (file.changed) {
+        file.content = std::move(content);
+    }
+}
+
+void read_and_hash_files_(std::vector<SourceFile> &files, const Store &store, const int jobs)
+{
+    parallel::for_each_index(files.size(), jobs, [&](const std::size_t i) {
+        read_and_hash_(files[i], store);
+    });
+}
+
+bool is_under_root_(const std::string &path, const fs::path &root)
+{
+    const std::string prefix = root.string() + "/";
+    return path.starts_with(prefix);
+}
+
+void check_store_compatibility_(const Store &store, const EmbedOptions &options)
+{
+    if (store.model.empty()) {
+        return;
+    }
+
+    const std::string source = options.use_local ? "Ollama" : "OpenAI";
+
+    if (store.model != options.model or store.source != source) {
+        throw std::runtime_error(fmt::format(
+            "Store was built with model '{}' ({}). Use the same model or a different store", store.model, store.source));
+    }
+
+    if (options.dimensions > 0 and store.dimensions != 0 and options.dimensions != store.dimensions) {
+        throw std::runtime_error(fmt::format(
+            "Store holds embeddings with {} dimensions. Use the same dimensions or a different store", store.dimensions));
+    }
+}
+
+// Bring the codes of a rebuilt store up to date. Codes of rows carried over from the previous store are
+// reused where the codebook is still valid so that only new rows need encoding
+void quantize_store_(Store &updated, const Store &previous, const std::vector<std::ptrdiff_t> &sources, const IngestOptions &options)
+{
+    const Quantization kind = options.quantization.value_or(previous.codebook.kind);
+
+    if (kind == Quantization::None) {
+        return;
+    }
+
+    const std::size_t count = updated.records.size();
+    const std::size_t dimensions = updated.dimensions;
+    const Codebook &old_codebook = previous.codebook;
+
+    const bool reuse = old_codebook.kind == kind and old_codebook.dimensions == dimensions and not needs_retraining(old_codebook, count);
+
+    if (reuse) {
+        updated.codebook = old_codebook;
+    } else {
+        updated.codebook = create_codebook(kind, updated.vectors.data(), count, dimensions, options.embed_options.jobs);
+    }
+
+    const std::size_t code_size = updated.codebook.get_code_size();
+    updated.codes.resize(count * code_size);
+
+    parallel::for_each_index(count, options.embed_options.jobs, [&](const std::size_t i) {
+        std::uint8_t *code = updated.codes.data() + i * code_size;
+
+        if (reuse and sources[i] >= 0) {
+            const std::uint8_t *old_code = previous.codes.data() + sources[i] * code_size;
+            std::copy(old_code, old_code + code_size, code);
+        } else {
+            encode_vector(updated.codebook, updated.vectors.data() + i * dimensions, code);
+        }
+    });
+}
+
+IngestSummary update_store_(Store &store, const std::vector<SourceFile> &files, const std::set<std::string> &removed, const IngestOptions &options)
+{
+    IngestSummary summary;
+    summary.files_removed = removed.size();
+
+    std::set<std::string> stale = removed;
+    std::vector<const SourceFile *> changed;
+
+    for (const auto &file: files) {
+        if (file.skipped) {
+            continue;
+        }
+
+        if (not file.changed) {
+            summary.files_unchanged++;
+            continue;
+        }
+
+        if (store.files.contains(file.path)) {
+            summary.files_updated++;
+        } else {
+            summary.files_added++;
+        }
+
+        changed.push_back(&file);
+        stale.insert(file.path);
+    }
+
+    std::vector<std::vector<Chunk>> chunks(changed.size());
+
+    parallel::for_each_index(changed.size(), options.embed_options.jobs, [&](const std::size_t i) {
+        chunks[i] = chunk_text(changed[i]->content, options.chunk_options);
+    });
+
+    // An edit usually only touches a few chunks of a file. Chunks whose text did not change keep their
+    // existing vectors and only the remaining chunks are sent off to be embedded. Keying on the text alone
+    // means that renamed or moved files are not re-embedded either
+    std::unordered_map<std::string, std::size_t> reusable;
+
+    for (std::size_t i = 0; i < store.records.size(); ++i) {
+        if (stale.contains(store.records[i].path)) {
+            reusable.emplace(store.records[i].text, i);
+        }
+    }
+
+    std::vector<std::string> texts;
+
+    for (std::size_t f = 0; f < changed.size(); ++f) {
+        for (const auto &chunk: chunks[f]) {
+            if (not reusable.contains(chunk.text)) {
+                texts.push_back(chunk.text);
+            }
+        }
+    }
+
+    // Shortened stores keep requesting their dimensions so that later runs need not repeat the option
+    EmbedOptions embed_options = options.embed_options;
+
+    if (embed_options.dimensions < 1 and store.shortened) {
+        embed_options.dimensions = store.dimensions;
+    }
+
+    serialization::Embeddings embeddings;
+
+    if (not texts.empty()) {
+        embeddings = embed_texts(texts, embed_options);
+    }
+
+    // Rebuild the store, keeping records (and vectors) of untouched files as is
+    Store updated;
+    updated.model = embed_options.model;
+    updated.source = embed_options.use_local ? "Ollama" : "OpenAI";
+    updated.shortened = embed_options.dimensions > 0;
+    updated.dimensions = store.dimensions;
+
+    if (not embeddings.embeddings.empty()) {
+        const int dimensions = embeddings.embeddings.front().size();
+
+        if (updated.dimensions != 0 and updated.dimensions != dimensions) {
+            throw std::runtime_error("Embedding dimensions do not match the dimensions of the store");
+        }
+
+        updated.dimensions = dimensions;
+    }
+
+    const std::size_t dimensions = updated.dimensions;
+
+    // The row of the previous store each row was copied from, or -1 for freshly embedded rows
+    std::vector<std::ptrdiff_t> sources;
+
+    for (std::size_t i = 0; i < store.records.size(); ++i) {
+        if (stale.contains(store.records[i].path)) {
+            continue;
+        }
+
+        sources.push_back(i);
+        updated.records.push_back(store.records[i]);
+        updated.vectors.insert(updated.vectors.end(), store.vectors.begin() + i * dimensions, store.vectors.begin() + (i + 1) * dimensions);
+    }
+
+    for (const auto &[path, hash]: store.files) {
+        if (not stale.contains(path)) {
+            updated.files[path] = hash;
+        }
+    }
+
+    std::size_t row = 0;
+
+    for (std::size_t f = 0; f < changed.size(); ++f) {
+        updated.files[changed[f]->path] = changed[f]->hash;
+
+        for (const auto &chunk: chunks[f]) {
+            Record record;
+            record.length = chunk.length;
+            record.offset = chunk.offset;
+            record.path = changed[f]->path;
+            record.text = chunk.text;
+
+            const auto it = reusable.find(record.text);
+
+            if (it != reusable.end()) {
+                const std::size_t old_row = it->second;
+                updated.vectors.insert(updated.vectors.end(), store.vectors.begin() + old_row * dimensions, store.vectors.begin() + (old_row + 1) * dimensions);
+                sources.push_back(old_row);
+                summary.chunks_reused++;
+            } else {
+                const std::vector<float> &vector = embeddings.embeddings[row++];
+
+                if (vector.size() != dimensions) {
+                    throw std::runtime_error("Embedding dimensions do not match the dimensions of the store");
+                }
+
+                updated.vectors.insert(updated.vectors.end(), vector.begin(), vector.end());
+                sources.push_back(-1);
+            }
+
+            updated.records.push_back(std::move(record));
+        }
+    }
+
+    quantize_store_(updated, store, sources, options);
+
+    summary.chunks_embedded = texts.size();
+    store = std::move(updated);
+
+    return summary;
+}
+
+} // namespace
+
+std::vector<std::string> get_ignore_globs(const IngestOptions &options)
+{
+    std::vector<std::string> globs = DEFAULT_IGNORE_GLOBS;
+    globs.insert(globs.end(), options.ignore_globs.begin(), options.ignore_globs.end());
+    return globs;
+}
+
+bool is_ignored(const fs::path &relative, const std::vector<std::string> &globs)
+{
+    // A path is ignored if it or any of its parent directories match
+    fs::path partial;
+
+    for (const auto &component: relative) {
+        partial /= component;
+
+        if (matches_any_glob_(partial.string(), component.string(), globs)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+IngestSummary ingest_directory(const fs::path &root, Store &store, const IngestOptions &options)
+{
+    if (not fs::is_directory(root)) {
+        throw std::runtime_error(fmt::format("'{}' is not a directory", root.string()));
+    }
+
+    check_store_compatibility_(store, options.embed_options);
+
+    const fs::path canonical_root = fs::canonical(root);
+    const std::vector<fs::path> paths = collect_files_(canonical_root, get_ignore_globs(options));
+
+    std::vector<SourceFile> files(paths.size());
+
+    for (std::size_t i = 0; i < paths.size(); ++i) {
+        files[i].path = paths[i].string();
+    }
+
+    read_and_hash_files_(files, store, options.embed_options.jobs);
+
+    // Anything previously ingested from under this root that was not seen this time around was deleted
+    // (or is now ignored) and should drop out of the store
+    std::set<std::string> seen;
+    std::set<std::string> removed;
+
+    for (const auto &file: files) {
+        if (not file.skipped) {
+            seen.insert(file.path);
+        }
+    }
+
+    for (const auto &[path, hash]: store.files) {
+        if (is_under_root_(path, canonical_root) and not seen.contains(path)) {
+            removed.insert(path);
+        }
+    }
+
+    return update_store_(store, files, removed, options);
+}
+
+IngestSummary ingest_files(const fs::path &root, const std::vector<std::string> &paths, Store &store, const IngestOptions &options)
+{
+    check_store_compatibility_(store, options.embed_options);
+
+    const fs::path canonical_root = fs::canonical(root);
+    const std::vector<std::string> globs = get_ignore_globs(options);
+
+    std::vector<SourceFile> files;
+    std::set<std::string> removed;
+
+    for (const auto &path: paths) {
+        const fs::path relative = fs::path(path).lexically_relative(canonical_root);
+        const bool exists = fs::is_regular_file(path);
+
+        if (exists and not is_ignored(relative, globs)) {
+            SourceFile file;
+            file.path = path;
+            files.push_back(file);
+        } else if (store.files.contains(path)) {
+            removed.insert(path);
+        }
+    }
+
+    read_and_hash_files_(files, store, options.embed_options.jobs);
+
+    for (const auto &file: files) {
+        if (file.skipped and store.files.contains(file.path)) {
+            removed.insert(file.path);
+        }
+    }
+
+    return update_store_(store, files, removed, options);
+}
+
+} // namespace retrieval
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "chunking.hpp"
+#include "embedder.hpp"
+#include "store.hpp"
+
+#include <cstddef>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace retrieval {
+
+struct IngestOptions {
+    ChunkOptions chunk_options;
+    EmbedOptions embed_options;
+    std::optional<Quantization> quantization; // Keep the quantization of the store when not set
+    std::vector<std::string> ignore_globs;
+};
+
+struct IngestSummary {
+    int files_added = 0;
+    int files_removed = 0;
+    int files_unchanged = 0;
+    int files_updated = 0;
+    std::size_t chunks_embedded = 0;
+    std::size_t chunks_reused = 0;
+};
+
+std::vector<std::string> get_ignore_globs(const IngestOptions &options);
+bool is_ignored(const std::filesystem::path &relative, const std::vector<std::string> &globs);
+
+IngestSummary ingest_directory(const std::filesystem::path &root, Store &store, const IngestOptions &options);
+IngestSummary ingest_files(const std::filesystem::path &root, const std::vector<std::string> &paths, Store &store, const IngestOptions &options);
+
+} // namespace retrieval
@@ -0,0 +1,170 @@
+#include "kernels.hpp"
+
+#include <algorithm>
+#include <bit>
+
+#if defined(__x86_64__) && defined(__linux__) && defined(__GNUC__) && !defined(__clang__)
+#define TARGET_CLONES __attribute__((target_clones("avx2", "default")))
+#else
+#define TARGET_CLONES
+#endif
+
+namespace retrieval {
+
+namespace {
+
+const std::size_t LANES = 8;
+
+} // namespace
+
+TARGET_CLONES float dot_f32(const float *a, const float *b, const std::size_t size)
+{
+    float sums[LANES] = {};
+    std::size_t i = 0;
+
+    for (; i + LANES <= size; i += LANES) {
+        for (std::size_t j = 0; j < LANES; ++j) {
+            sums[j] += a[i + j] * b[i + j];
+        }
+    }
+
+    float sum = 0.0;
+
+    for (; i < size; ++i) {
+        sum += a[i] * b[i];
+    }
+
+    for (std::size_t j = 0; j < LANES; ++j) {
+        sum += sums[j];
+    }
+
+    return sum;
+}
+
+TARGET_CLONES float squared_distance_f32(const float *a, const float *b, const std::size_t size)
+{
+    float sums[LANES] = {};
+    std::size_t i = 0;
+
+    for (; i + LANES <= size; i += LANES) {
+        for (std::size_t j = 0; j < LANES; ++j) {
+            const float diff = a[i + j] - b[i + j];
+            sums[j] += diff * diff;
+        }
+    }
+
+    float sum = 0.0;
+
+    for (; i < size; ++i) {
+        const float diff = a[i] - b[i];
+        sum += diff * diff;
+    }
+
+    for (std::size_t j = 0; j < LANES; ++j) {
+        sum += sums[j];
+    }
+
+    return sum;
+}
+
+TARGET_CLONES std::int32_t dot_i8(const std::int8_t *a, const std::int8_t *b, const std::size_t size)
+{
+    // Integer addition is associative so a plain loop vectorizes as is
+    std::int32_t sum = 0;
+
+    for (std::size_t i = 0; i < size; ++i) {
+        sum += static_cast<std::int16_t>(a[i]) * static_cast<std::int16_t>(b[i]);
+    }
+
+    return sum;
+}
+
+TARGET_CLONES std::uint32_t hamming_distance(const std::uint64_t *a, const std::uint64_t *b, const std::size_t words)
+{
+    std::uint32_t distance = 0;
+
+    for (std::size_t i = 0; i < words; ++i) {
+        distance += std::popcount(a[i] ^ b[i]);
+    }
+
+    return distance;
+}
+
+TARGET_CLONES void squared_distances_transposed(const float *point, const float *centroids, const std::size_t num_centroids, const std::size_t dimensions, float *distances)
+{
+    std::fill(distances, distances + num_centroids, 0.0f);
+
+    for (std::size_t d = 0; d < dimensions; ++d) {
+        const float value = point[d];
+        const float *row = centroids + d * num_centroids;
+
+        for (std::size_t c = 0; c < num_centroids; ++c) {
+            const float diff = value - row[c];
+            distances[c] += diff * diff;
+        }
+    }
+}
+
+TARGET_CLONES std::size_t argmin_f32(const float *values, const std::size_t size)
+{
+    if (size < LANES) {
+        return std::min_element(values, values + size) - values;
+    }
+
+    // Track the minimum of each lane with branchless selects, then reduce the lanes
+    float minima[LANES];
+    std::uint32_t indices[LANES];
+
+    for (std::size_t j = 0; j < LANES; ++j) {
+        minima[j] = values[j];
+        indices[j] = j;
+    }
+
+    std::size_t i = LANES;
+
+    for (; i + LANES <= size; i += LANES) {
+        for (std::size_t j = 0; j < LANES; ++j) {
+            const bool smaller = values[i + j] < minima[j];
+            minima[j] = smaller ? values[i + j] : minima[j];
+            indices[j] = smaller ? static_cast<std::uint32_t>(i + j) : indices[j];
+        }
+    }
+
+    std::size_t best = indices[0];
+
+    for (std::size_t j = 1; j < LANES; ++j) {
+        if (minima[j] < values[best] or (minima[j] == values[best] and indices[j] < best)) {
+            best = indices[j];
+        }
+    }
+
+    for (; i < size; ++i) {
+        if (values[i] < values[best]) {
+            best = i;
+        }
+    }
+
+    return best;
+}
+
+float sum_lookups(const float *lut, const std::uint8_t *codes, const std::size_t num_subspaces, const std::size_t num_centroids)
+{
+    // Four independent sums hide the latency of the table lookups
+    float sums[4] = {};
+    std::size_t m = 0;
+
+    for (; m + 4 <= num_subspaces; m += 4) {
+        sums[0] += lut[m * num_centroids + codes[m]];
+        sums[1] += lut[(m + 1) * num_centroids + codes[m + 1]];
+        sums[2] += lut[(m + 2) * num_centroids + codes[m + 2]];
+        sums[3] += lut[(m + 3) * num_centroids + codes[m + 3]];
+    }
+
+    for (; m < num_subspaces; ++m) {
+        sums[0] += lut[m * num_centroids + codes[m]];
+    }
+
+    return sums[0] + sums[1] + sums[2] + sums[3];
+}
+
+} // namespace retrieval
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace retrieval {
+
+// Distance kernels used to scan vectors and quantized codes. They are written so that the compiler can
+// vectorize them without -ffast-math (fixed width partial sums instead of one running sum) and on x86-64
+// Linux an AVX2 variant of each is selected at runtime when the CPU supports it
+
+float dot_f32(const float *a, const float *b, std::size_t size);
+float squared_distance_f32(const float *a, const float *b, std::size_t size);
+std::int32_t dot_i8(const std::int8_t *a, const std::int8_t *b, std::size_t size);
+std::uint32_t hamming_distance(const std::uint64_t *a, const std::uint64_t *b, std::size_t words);
+
+// Squared distances from a point to many short centroids stored transposed, i.e. dimension by dimension
+// (centroids[d * num_centroids + c]), such that the loop runs across centroids and vectorizes
+void squared_distances_transposed(const float *point, const float *centroids, std::size_t num_centroids, std::size_t dimensions, float *distances);
+
+// Index of the smallest value. Ties resolve to the lowest index
+std::size_t argmin_f32(const float *values, std::size_t size);
+
+// Sum lut[m * num_centroids + codes[m]] over all subspaces m
+float sum_lookups(const float *lut, const std::uint8_t *codes, std::size_t num_subspaces, std::size_t num_centroids);
+
+} // namespace retrieval
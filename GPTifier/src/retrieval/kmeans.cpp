@@ -0,0 +1,250 @@
+#include "kmeans.hpp"
+
+#include "kernels.hpp"
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <random>
+#include <stdexcept>
+
+namespace retrieval {
+
+namespace {
+
+const std::size_t ASSIGN_BLOCK_SIZE = 1024;
+
+// Seeding is quadratic in the number of clusters so it runs on a sample once the input is large
+const std::size_t SEED_SAMPLE_PER_CLUSTER = 32;
+const std::size_t MIN_SEED_SAMPLE = 4096;
+
+const std::size_t SHORT_DIMENSIONS = 16;
+
+float squared_distance_(const float *a, const float *b, const std::size_t dimensions)
+{
+    // Short vectors (i.e. product quantization subspaces) are cheaper to handle inline than through the
+    // dispatched kernel
+    if (dimensions <= SHORT_DIMENSIONS) {
+        float sum = 0.0;
+
+        for (std::size_t d = 0; d < dimensions; ++d) {
+            const float diff = a[d] - b[d];
+            sum += diff * diff;
+        }
+
+        return sum;
+    }
+
+    return squared_distance_f32(a, b, dimensions);
+}
+
+std::vector<float> seed_centroids_(const float *points, const std::size_t count, const std::size_t dimensions, const KMeansOptions &options, std::mt19937_64 &rng)
+{
+    std::vector<std::size_t> sample(count);
+
+    for (std::size_t i = 0; i < count; ++i) {
+        sample[i] = i;
+    }
+
+    const std::size_t sample_size = std::min(count, std::max(MIN_SEED_SAMPLE, options.clusters * SEED_SAMPLE_PER_CLUSTER));
+
+    if (sample_size < count) {
+        std::shuffle(sample.begin(), sample.end(), rng);
+        sample.resize(sample_size);
+    }
+
+    std::vector<float> centroids;
+    centroids.reserve(options.clusters * dimensions);
+
+    const float *first = points + sample[std::uniform_int_distribution<std::size_t>(0, sample_size - 1)(rng)] * dimensions;
+    centroids.insert(centroids.end(), first, first + dimensions);
+
+    std::vector<float> distances(sample_size, std::numeric_limits<float>::max());
+
+    // k-means++: pick each further centroid with probability proportional to its squared distance from the
+    // nearest centroid picked so far
+    for (std::size_t c = 1; c < options.clusters; ++c) {
+        const float *latest = centroids.data() + (c - 1) * dimensions;
+
+        const std::size_t num_blocks = (sample_size + ASSIGN_BLOCK_SIZE - 1) / ASSIGN_BLOCK_SIZE;
+
+        parallel::for_each_index(num_blocks, options.jobs, [&](const std::size_t block) {
+            const std::size_t end = std::min(sample_size, (block + 1) * ASSIGN_BLOCK_SIZE);
+
+            for (std::size_t i = block * ASSIGN_BLOCK_SIZE; i < end; ++i) {
+                distances[i] = std::min(distances[i], squared_distance_(points + sample[i] * dimensions, latest, dimensions));
+            }
+        });
+
+        std::size_t picked = 0;
+
+        // All remaining points coincide with a centroid (i.e. duplicates) so any point will do
+        if (std::all_of(distances.begin(), distances.end(), [](const float d) { return d == 0.0f; })) {
+            picked = std::uniform_int_distribution<std::size_t>(0, sample_size - 1)(rng);
+        } else {
+            std::discrete_distribution<std::size_t> pick(distances.begin(), distances.end());
+            picked = pick(rng);
+        }
+
+        const float *next = points + sample[picked] * dimensions;
+        centroids.insert(centroids.end(), next, next + dimensions);
+    }
+
+    return centroids;
+}
+
+} // namespace
+
+std::size_t find_nearest_centroid(const float *point, const float *centroids, const std::size_t num_centroids, const std::size_t dimensions)
+{
+    std::size_t nearest = 0;
+    float nearest_distance = std::numeric_limits<float>::max();
+
+    for (std::size_t c = 0; c < num_centroids; ++c) {
+        const float distance = squared_distance_(point, centroids + c * dimensions, dimensions);
+
+        if (distance < nearest_distance) {
+            nearest_distance = distance;
+            nearest = c;
+        }
+    }
+
+    return nearest;
+}
+
+std::vector<float> transpose_centroids(const std::vector<float> &centroids, const std::size_t dimensions)
+{
+    const std::size_t num_centroids = centroids.size() / dimensions;
+    std::vector<float> transposed(centroids.size());
+
+    for (std::size_t c = 0; c < num_centroids; ++c) {
+        for (std::size_t d = 0; d < dimensions; ++d) {
+            transposed[d * num_centroids + c] = centroids[c * dimensions + d];
+        }
+    }
+
+    return transposed;
+}
+
+std::size_t find_nearest_transposed_centroid(const float *point, const float *centroids, const std::size_t num_centroids, const std::size_t dimensions, std::vector<float> &scratch)
+{
+    scratch.resize(num_centroids);
+    squared_distances_transposed(point, centroids, num_centroids, dimensions, scratch.data());
+    return argmin_f32(scratch.data(), num_centroids);
+}
+
+std::vector<std::uint32_t> assign_to_centroids(const float *points, const std::size_t count, const std::vector<float> &centroids, const std::size_t dimensions, const int jobs)
+{
+    std::vector<std::uint32_t> labels(count);
+    const std::size_t num_blocks = (count + ASSIGN_BLOCK_SIZE - 1) / ASSIGN_BLOCK_SIZE;
+    const std::size_t num_centroids = centroids.size() / dimensions;
+
+    // Short points are compared against all centroids at once, which vectorizes far better than comparing
+    // them one centroid at a time
+    const bool transpose = dimensions <= SHORT_DIMENSIONS;
+    const std::vector<float> transposed = transpose ? transpose_centroids(centroids, dimensions) : std::vector<float>();
+
+    parallel::for_each_index(num_blocks, jobs, [&](const std::size_t block) {
+        const std::size_t end = std::min(count, (block + 1) * ASSIGN_BLOCK_SIZE);
+        std::vector<float> scratch;
+
+        for (std::size_t i = block * ASSIGN_BLOCK_SIZE; i < end; ++i) {
+            if (transpose) {
+                labels[i] = find_nearest_transposed_centroid(points + i * dimensions, transposed.data(), num_centroids, dimensions, scratch);
+            } else {
+                labels[i] = find_nearest_centroid(points + i * dimensions, centroids.data(), num_centroids, dimensions);
+            }
+        }
+    });
+
+    return labels;
+}
+
+std::vector<float> train_kmeans(const float *points, const std::size_t count, const std::size_t dimensions, const KMeansOptions &options)
+{
+    if (options.clusters < 1) {
+        throw std::runtime_error("Number of clusters must be positive");
+    }
+
+    if (count < options.clusters) {
+        throw std::runtime_error("Cannot form more clusters than there are vectors");
+    }
+
+    std::mt19937_64 rng(options.seed);
+    std::vector<float> centroids = seed_centroids_(points, count, dimensions, options, rng);
+    std::uniform_int_distribution<std::size_t> random_point(0, count - 1);
+
+    if (options.batch_size > 0 and options.batch_size < count) {
+        // Mini-batch k-means (Sculley, 2010). Each centroid moves towards its assigned points with a learning
+        // rate that decays with the number of points it has absorbed so far
+        std::vector<std::size_t> absorbed(options.clusters, 0);
+        std::vector<float> batch(options.batch_size * dimensions);
+
+        for (int iteration = 0; iteration < options.iterations; ++iteration) {
+            for (std::size_t i = 0; i < options.batch_size; ++i) {
+                const float *point = points + random_point(rng) * dimensions;
+                std::copy(point, point + dimensions, batch.begin() + i * dimensions);
+            }
+
+            const std::vector<std::uint32_t> labels = assign_to_centroids(batch.data(), options.batch_size, centroids, dimensions, options.jobs);
+
+            for (std::size_t i = 0; i < options.batch_size; ++i) {
+                const std::size_t c = labels[i];
+                const float rate = 1.0f / ++absorbed[c];
+                float *centroid = centroids.data() + c * dimensions;
+                const float *point = batch.data() + i * dimensions;
+
+                for (std::size_t d = 0; d < dimensions; ++d) {
+                    centroid[d] += rate * (point[d] - centroid[d]);
+                }
+            }
+        }
+
+        return centroids;
+    }
+
+    std::vector<std::uint32_t> previous;
+
+    for (int iteration = 0; iteration < options.iterations; ++iteration) {
+        const std::vector<std::uint32_t> labels = assign_to_centroids(points, count, centroids, dimensions, options.jobs);
+
+        if (labels == previous) {
+            break;
+        }
+
+        std::vector<double> sums(options.clusters * dimensions, 0.0);
+        std::vector<std::size_t> sizes(options.clusters, 0);
+
+        for (std::size_t i = 0; i < count; ++i) {
+            const float *point = points + i * dimensions;
+            double *sum = sums.data() + labels[i] * dimensions;
+
+            for (std::size_t d = 0; d < dimensions; ++d) {
+                sum[d] += point[d];
+            }
+
+            sizes[labels[i]]++;
+        }
+
+        for (std::size_t c = 0; c < options.clusters; ++c) {
+            float *centroid = centroids.data() + c * dimensions;
+
+            // Restart empty clusters from a random point rather than letting them go to waste
+            if (sizes[c] == 0) {
+                const float *point = points + random_point(rng) * dimensions;
+                std::copy(point, point + dimensions, centroid);
+                continue;
+            }
+
+            for (std::size_t d = 0; d < dimensions; ++d) {
+                centroid[d] = sums[c * dimensions + d] / sizes[c];
+            }
+        }
+
+        previous = labels;
+    }
+
+    return centroids;
+}
+
+} // namespace retrieval
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace retrieval {
+
+struct KMeansOptions {
+    int iterations = 20;
+    int jobs = 1;
+    std::size_t batch_size = 0; // Update centroids from random mini-batches of this size. 0 uses all points
+    std::size_t clusters = 8;
+    std::uint64_t seed = 42;
+};
+
+// Cluster `count` points of `dimensions` floats each (stored contiguously) using k-means++ seeding followed
+// by Lloyd or mini-batch iterations. Returns clusters * dimensions centroid values
+std::vector<float> train_kmeans(const float *points, std::size_t count, std::size_t dimensions, const KMeansOptions &options);
+
+std::size_t find_nearest_centroid(const float *point, const float *centroids, std::size_t num_centroids, std::size_t dimensions);
+
+// Centroids stored dimension by dimension (see squared_distances_transposed)
+std::vector<float> transpose_centroids(const std::vector<float> &centroids, std::size_t dimensions);
+std::size_t find_nearest_transposed_centroid(const float *point, const float *centroids, std::size_t num_centroids, std::size_t dimensions, std::vector<float> &scratch);
+
+// Assign every point to its nearest centroid in parallel
+std::vector<std::uint32_t> assign_to_centroids(const float *points, std::size_t count, const std::vector<float> &centroids, std::size_t dimensions, int jobs);
+
+} // namespace retrieval
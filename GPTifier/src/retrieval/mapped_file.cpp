@@ -0,0 +1,54 @@
+#include "mapped_file.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <fmt/core.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace retrieval {
+
+MappedFile::MappedFile(const std::filesystem::path &filename)
+{
+    const int fd = open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+
+    if (fd == -1) {
+        throw std::runtime_error(fmt::format("Unable to open '{}': {}", filename.string(), std::strerror(errno)));
+    }
+
+    struct stat status;
+
+    if (fstat(fd, &status) != 0) {
+        close(fd);
+        throw std::runtime_error(fmt::format("Unable to stat '{}': {}", filename.string(), std::strerror(errno)));
+    }
+
+    this->size_ = status.st_size;
+
+    // mmap rejects zero length mappings
+    if (this->size_ == 0) {
+        close(fd);
+        return;
+    }
+
+    void *addr = mmap(nullptr, this->size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (addr == MAP_FAILED) {
+        throw std::runtime_error(fmt::format("Unable to map '{}': {}", filename.string(), std::strerror(errno)));
+    }
+
+    this->data_ = static_cast<const char *>(addr);
+}
+
+MappedFile::~MappedFile()
+{
+    if (this->data_ != nullptr) {
+        munmap(const_cast<char *>(this->data_), this->size_);
+    }
+}
+
+} // namespace retrieval
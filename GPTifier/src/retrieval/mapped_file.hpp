@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <string_view>
+
+namespace retrieval {
+
+// A read only memory mapping of an entire file. Pages are only read in as they are touched, which
+// keeps queries against large stores cheap
+class MappedFile {
+public:
+    explicit MappedFile(const std::filesystem::path &filename);
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    const char *data() const
+    {
+        return this->data_;
+    }
+
+    std::size_t size() const
+    {
+        return this->size_;
+    }
+
+    std::string_view view() const
+    {
+        return { this->data_, this->size_ };
+    }
+
+private:
+    const char *data_ = nullptr;
+    std::size_t size_ = 0;
+};
+
+} // namespace retrieval
@@ -0,0 +1,310 @@
+#include "quantization.hpp"
+
+#include "kernels.hpp"
+#include "kmeans.hpp"
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fmt/core.h>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+
+namespace retrieval {
+
+namespace {
+
+const std::size_t PQ_MAX_CENTROIDS = 256;
+const std::size_t PQ_SUBSPACE_DIMENSIONS = 8;
+const std::size_t PQ_TRAINING_SAMPLE = 8192;
+const int PQ_TRAINING_ITERATIONS = 8;
+const std::size_t PQ_RETRAIN_GROWTH = 4;
+
+std::vector<float> normalize_(const float *vector, const std::size_t dimensions)
+{
+    std::vector<float> normalized(vector, vector + dimensions);
+    const float norm = std::sqrt(dot_f32(vector, vector, dimensions));
+
+    if (norm > 0.0f) {
+        for (float &value: normalized) {
+            value /= norm;
+        }
+    }
+
+    return normalized;
+}
+
+std::size_t get_subspace_dimensions_(const std::size_t dimensions)
+{
+    // Fall back to narrower subspaces for dimensions that do not divide evenly
+    for (std::size_t width = PQ_SUBSPACE_DIMENSIONS; width > 1; width /= 2) {
+        if (dimensions % width == 0) {
+            return width;
+        }
+    }
+
+    return 1;
+}
+
+std::size_t get_num_words_(const std::size_t dimensions)
+{
+    return (dimensions + 63) / 64;
+}
+
+float quantize_int8_(const std::vector<float> &vector, std::int8_t *out)
+{
+    float max = 0.0;
+
+    for (const float value: vector) {
+        max = std::max(max, std::fabs(value));
+    }
+
+    const float scale = max > 0.0f ? max / 127.0f : 1.0f;
+
+    for (std::size_t i = 0; i < vector.size(); ++i) {
+        out[i] = static_cast<std::int8_t>(std::lround(vector[i] / scale));
+    }
+
+    return scale;
+}
+
+void pack_signs_(const float *vector, const std::size_t dimensions, std::uint64_t *words)
+{
+    std::fill(words, words + get_num_words_(dimensions), 0);
+
+    for (std::size_t i = 0; i < dimensions; ++i) {
+        if (vector[i] > 0.0f) {
+            words[i / 64] |= std::uint64_t(1) << (i % 64);
+        }
+    }
+}
+
+void train_product_quantizer_(Codebook &codebook, const float *vectors, const std::size_t count, const int jobs)
+{
+    const std::size_t dimensions = codebook.dimensions;
+    const std::size_t width = get_subspace_dimensions_(dimensions);
+
+    codebook.num_subspaces = dimensions / width;
+    codebook.num_centroids = std::min(PQ_MAX_CENTROIDS, count);
+    codebook.trained_on = count;
+
+    if (count == 0) {
+        return;
+    }
+
+    std::vector<std::size_t> sample(count);
+    std::iota(sample.begin(), sample.end(), 0);
+
+    if (count > PQ_TRAINING_SAMPLE) {
+        std::mt19937_64 rng(42);
+        std::shuffle(sample.begin(), sample.end(), rng);
+        sample.resize(PQ_TRAINING_SAMPLE);
+    }
+
+    std::vector<float> normalized(sample.size() * dimensions);
+
+    for (std::size_t i = 0; i < sample.size(); ++i) {
+        const std::vector<float> row = normalize_(vectors + sample[i] * dimensions, dimensions);
+        std::copy(row.begin(), row.end(), normalized.begin() + i * dimensions);
+    }
+
+    codebook.centroids.resize(codebook.num_subspaces * codebook.num_centroids * width);
+
+    KMeansOptions options;
+    options.clusters = codebook.num_centroids;
+    options.iterations = PQ_TRAINING_ITERATIONS;
+
+    // Subspaces are independent so they are trained in parallel, each on a single thread
+    parallel::for_each_index(codebook.num_subspaces, jobs, [&](const std::size_t m) {
+        std::vector<float> points(sample.size() * width);
+
+        for (std::size_t i = 0; i < sample.size(); ++i) {
+            const float *begin = normalized.data() + i * dimensions + m * width;
+            std::copy(begin, begin + width, points.begin() + i * width);
+        }
+
+        // Stored transposed so that encoding and lookup table construction vectorize across centroids
+        const std::vector<float> centroids = transpose_centroids(train_kmeans(points.data(), sample.size(), width, options), width);
+        std::copy(centroids.begin(), centroids.end(), codebook.centroids.begin() + m * codebook.num_centroids * width);
+    });
+}
+
+} // namespace
+
+Quantization get_quantization(const std::string &name)
+{
+    if (name == "none") {
+        return Quantization::None;
+    }
+
+    if (name == "int8") {
+        return Quantization::Int8;
+    }
+
+    if (name == "binary") {
+        return Quantization::Binary;
+    }
+
+    if (name == "pq") {
+        return Quantization::Product;
+    }
+
+    throw std::runtime_error(fmt::format("Invalid quantization '{}'. Use one of none, int8, binary or pq", name));
+}
+
+std::string get_quantization_name(const Quantization kind)
+{
+    switch (kind) {
+        case Quantization::Int8:
+            return "int8";
+        case Quantization::Binary:
+            return "binary";
+        case Quantization::Product:
+            return "pq";
+        default:
+            return "none";
+    }
+}
+
+std::size_t Codebook::get_code_size() const
+{
+    switch (this->kind) {
+        case Quantization::Int8:
+            // A float scale followed by the values, padded so that the next scale stays aligned
+            return sizeof(float) + (this->dimensions + 3) / 4 * 4;
+        case Quantization::Binary:
+            return get_num_words_(this->dimensions) * sizeof(std::uint64_t);
+        case Quantization::Product:
+            return this->num_subspaces;
+        default:
+            return 0;
+    }
+}
+
+Codebook create_codebook(const Quantization kind, const float *vectors, const std::size_t count, const std::size_t dimensions, const int jobs)
+{
+    Codebook codebook;
+    codebook.kind = kind;
+    codebook.dimensions = dimensions;
+
+    if (kind == Quantization::Product) {
+        train_product_quantizer_(codebook, vectors, count, jobs);
+    }
+
+    return codebook;
+}
+
+bool needs_retraining(const Codebook &codebook, const std::size_t count)
+{
+    if (codebook.kind != Quantization::Product) {
+        return false;
+    }
+
+    return count > 0 and count >= codebook.trained_on * PQ_RETRAIN_GROWTH;
+}
+
+void encode_vector(const Codebook &codebook, const float *vector, std::uint8_t *code)
+{
+    const std::size_t dimensions = codebook.dimensions;
+
+    switch (codebook.kind) {
+        case Quantization::Int8: {
+            std::memset(code, 0, codebook.get_code_size());
+            const float scale = quantize_int8_(normalize_(vector, dimensions), reinterpret_cast<std::int8_t *>(code + sizeof(float)));
+            std::memcpy(code, &scale, sizeof(float));
+            break;
+        }
+        case Quantization::Binary: {
+            std::vector<std::uint64_t> words(get_num_words_(dimensions));
+            pack_signs_(vector, dimensions, words.data());
+            std::memcpy(code, words.data(), words.size() * sizeof(std::uint64_t));
+            break;
+        }
+        case Quantization::Product: {
+            const std::vector<float> normalized = normalize_(vector, dimensions);
+            const std::size_t width = dimensions / codebook.num_subspaces;
+            std::vector<float> scratch;
+
+            for (std::size_t m = 0; m < codebook.num_subspaces; ++m) {
+                const float *centroids = codebook.centroids.data() + m * codebook.num_centroids * width;
+                const std::size_t nearest = find_nearest_transposed_centroid(normalized.data() + m * width, centroids, codebook.num_centroids, width, scratch);
+
+                code[m] = nearest;
+            }
+            break;
+        }
+        default:
+            throw std::runtime_error("Cannot encode vectors without a quantization");
+    }
+}
+
+CodeScorer::CodeScorer(const Codebook &codebook, const std::vector<float> &query) :
+    codebook_(codebook)
+{
+    if (query.size() != codebook.dimensions) {
+        throw std::runtime_error("Query dimensions do not match the dimensions of the codebook");
+    }
+
+    const std::size_t dimensions = codebook.dimensions;
+
+    switch (codebook.kind) {
+        case Quantization::Int8:
+            this->query_i8_.resize(dimensions);
+            this->query_scale_ = quantize_int8_(normalize_(query.data(), dimensions), this->query_i8_.data());
+            break;
+        case Quantization::Binary:
+            this->query_bits_.resize(get_num_words_(dimensions));
+            pack_signs_(query.data(), dimensions, this->query_bits_.data());
+            break;
+        case Quantization::Product: {
+            // Precompute the similarity between each query subvector and every centroid of its subspace. A
+            // code is then scored with one table lookup per subspace
+            const std::vector<float> normalized = normalize_(query.data(), dimensions);
+            const std::size_t width = dimensions / codebook.num_subspaces;
+
+            this->lut_.resize(codebook.num_subspaces * codebook.num_centroids);
+
+            for (std::size_t m = 0; m < codebook.num_subspaces; ++m) {
+                const float *centroids = codebook.centroids.data() + m * codebook.num_centroids * width;
+                float *lut = this->lut_.data() + m * codebook.num_centroids;
+
+                for (std::size_t d = 0; d < width; ++d) {
+                    const float value = normalized[m * width + d];
+
+                    for (std::size_t c = 0; c < codebook.num_centroids; ++c) {
+                        lut[c] += value * centroids[d * codebook.num_centroids + c];
+                    }
+                }
+            }
+            break;
+        }
+        default:
+            throw std::runtime_error("Cannot score codes without a quantization");
+    }
+}
+
+float CodeScorer::score(const std::uint8_t *code) const
+{
+    switch (this->codebook_.kind) {
+        case Quantization::Int8: {
+            float scale = 0.0;
+            std::memcpy(&scale, code, sizeof(float));
+
+            const std::int8_t *values = reinterpret_cast<const std::int8_t *>(code + sizeof(float));
+            return dot_i8(this->query_i8_.data(), values, this->codebook_.dimensions) * this->query_scale_ * scale;
+        }
+        case Quantization::Binary: {
+            const std::uint64_t *words = reinterpret_cast<const std::uint64_t *>(code);
+            const std::uint32_t distance = hamming_distance(this->query_bits_.data(), words, this->query_bits_.size());
+            return 1.0f - 2.0f * distance / this->codebook_.dimensions;
+        }
+        case Quantization::Product:
+            return sum_lookups(this->lut_.data(), code, this->codebook_.num_subspaces, this->codebook_.num_centroids);
+        default:
+            return 0.0;
+    }
+}
+
+} // namespace retrieval
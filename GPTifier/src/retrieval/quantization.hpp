@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace retrieval {
+
+// Compressed representations of the vectors of a store. All of them approximate cosine similarity:
+//   int8    Each normalized vector is scaled into [-127, 127] and stored with its scale (~4x smaller)
+//   binary  One sign bit per dimension, compared by Hamming distance (32x smaller)
+//   pq      Product quantization. Vectors are split into subspaces of 8 dimensions and each subspace is
+//           replaced by the index of its nearest of 256 centroids (32x smaller)
+enum class Quantization {
+    None,
+    Int8,
+    Binary,
+    Product,
+};
+
+Quantization get_quantization(const std::string &name);
+std::string get_quantization_name(Quantization kind);
+
+struct Codebook {
+    Quantization kind = Quantization::None;
+    std::size_t dimensions = 0;
+    std::size_t num_centroids = 0;
+    std::size_t num_subspaces = 0;
+    std::uint64_t trained_on = 0;
+    std::vector<float> centroids;
+
+    std::size_t get_code_size() const;
+};
+
+// Product quantization centroids are trained on (a sample of) the vectors passed in
+Codebook create_codebook(Quantization kind, const float *vectors, std::size_t count, std::size_t dimensions, int jobs);
+
+// A product quantization codebook trained on far fewer vectors than a store now holds no longer represents
+// the store well
+bool needs_retraining(const Codebook &codebook, std::size_t count);
+
+void encode_vector(const Codebook &codebook, const float *vector, std::uint8_t *code);
+
+// Scores codes against a single query. The query is prepared once (quantized or turned into lookup tables)
+// so that scoring a code is as cheap as possible
+class CodeScorer {
+public:
+    CodeScorer(const Codebook &codebook, const std::vector<float> &query);
+
+    float score(const std::uint8_t *code) const;
+
+private:
+    const Codebook &codebook_;
+    float query_scale_ = 0.0;
+    std::vector<std::int8_t> query_i8_;
+    std::vector<std::uint64_t> query_bits_;
+    std::vector<float> lut_;
+};
+
+} // namespace retrieval
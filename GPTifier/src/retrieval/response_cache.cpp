@@ -0,0 +1,269 @@
+#include "response_cache.hpp"
+
+#include "kernels.hpp"
+#include "mapped_file.hpp"
+#include "store.hpp"
+#include "utils.hpp"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fmt/core.h>
+#include <fstream>
+#include <json.hpp>
+#include <stdexcept>
+
+namespace retrieval {
+
+namespace {
+
+namespace fs = std::filesystem;
+
+const std::string FILE_INDEX = "index.bin";
+const std::string FILE_RESPONSES = "responses.jsonl";
+
+const std::uint32_t CACHE_VERSION = 1;
+
+struct IndexHeader {
+    char magic[4] = { 'G', 'P', 'T', 'C' };
+    std::uint32_t version = CACHE_VERSION;
+};
+
+struct IndexRow {
+    std::uint64_t key = 0;
+    std::uint64_t prompt_hash = 0;
+    std::uint64_t offset = 0;
+    std::uint32_t length = 0;
+    std::uint32_t dimensions = 0;
+};
+
+std::uint64_t hash_(const std::string_view data)
+{
+    return std::stoull(utils::hash_content(data), nullptr, 16);
+}
+
+std::uint64_t get_key_(const std::string &source, const std::string &model, const std::string &embedding_model)
+{
+    // Responses are only ever shared between identical models. The embedding model is part of the key too since
+    // similarities between embeddings of different models are meaningless
+    return hash_(source + '\0' + model + '\0' + embedding_model);
+}
+
+serialization::Response read_response_(const fs::path &filename, const IndexRow &row)
+{
+    std::ifstream file(filename, std::ios::binary);
+    std::string line(row.length, '\0');
+
+    file.seekg(row.offset);
+    file.read(line.data(), row.length);
+
+    if (not file) {
+        throw std::runtime_error(fmt::format("Response cache '{}' is truncated", filename.string()));
+    }
+
+    serialization::Response response;
+
+    try {
+        const nlohmann::json json = nlohmann::json::parse(line);
+
+        response.created = json["created"];
+        response.input = json["input"];
+        response.input_tokens = json["input_tokens"];
+        response.model = json["model"];
+        response.output = json["output"];
+        response.output_tokens = json["output_tokens"];
+        response.raw_response = json["raw_response"];
+        response.source = json["source"];
+    } catch (const nlohmann::json::exception &e) {
+        throw std::runtime_error(fmt::format("Failed to read response cache: {}", e.what()));
+    }
+
+    return response;
+}
+
+} // namespace
+
+ResponseCache::ResponseCache(const fs::path &path, const CacheOptions &options) :
+    options_(options),
+    path_(path)
+{
+    if (options.threshold <= 0.0f or options.threshold > 1.0f) {
+        throw std::runtime_error("Cache threshold must be greater than 0 and at most 1");
+    }
+}
+
+const std::vector<float> &ResponseCache::embed_(const std::string &prompt)
+{
+    if (this->embedded_prompt_ == prompt and not this->embedding_.empty()) {
+        return this->embedding_;
+    }
+
+    serialization::Embeddings embeddings = embed_texts({ prompt }, this->options_.embed_options);
+
+    if (embeddings.embeddings.size() != 1 or embeddings.embeddings[0].empty()) {
+        throw std::runtime_error("Failed to embed prompt for the response cache");
+    }
+
+    std::vector<float> &embedding = embeddings.embeddings[0];
+    const float norm = std::sqrt(dot_f32(embedding.data(), embedding.data(), embedding.size()));
+
+    if (norm > 0.0f) {
+        for (float &value: embedding) {
+            value /= norm;
+        }
+    }
+
+    this->embedded_prompt_ = prompt;
+    this->embedding_ = std::move(embedding);
+
+    return this->embedding_;
+}
+
+std::optional<CacheHit> ResponseCache::find(const std::string &prompt, const std::string &model, const std::string &source)
+{
+    const fs::path index_file = this->path_ / FILE_INDEX;
+
+    if (not fs::exists(index_file)) {
+        return std::nullopt;
+    }
+
+    const MappedFile index(index_file);
+    IndexHeader header;
+
+    if (index.size() < sizeof(header)) {
+        return std::nullopt;
+    }
+
+    std::memcpy(&header, index.data(), sizeof(header));
+
+    if (std::memcmp(header.magic, "GPTC", 4) != 0 or header.version != CACHE_VERSION) {
+        throw std::runtime_error(fmt::format("'{}' is not a GPTifier response cache", index_file.string()));
+    }
+
+    const std::uint64_t key = get_key_(source, model, this->options_.embed_options.model);
+    const std::uint64_t prompt_hash = hash_(prompt);
+
+    // Rows are variable length since their dimensions depend on the embedding model. A row that is cut short
+    // is still being appended by another process and is skipped
+    std::vector<IndexRow> candidates;
+    std::vector<const char *> vectors;
+
+    for (std::size_t pos = sizeof(header); pos + sizeof(IndexRow) <= index.size();) {
+        IndexRow row;
+        std::memcpy(&row, index.data() + pos, sizeof(row));
+
+        const std::size_t row_size = sizeof(row) + row.dimensions * sizeof(float);
+
+        if (pos + row_size > index.size()) {
+            break;
+        }
+
+        if (row.key == key) {
+            candidates.push_back(row);
+            vectors.push_back(index.data() + pos + sizeof(row));
+        }
+
+        pos += row_size;
+    }
+
+    if (candidates.empty()) {
+        return std::nullopt;
+    }
+
+    const fs::path responses_file = this->path_ / FILE_RESPONSES;
+
+    for (const auto &row: candidates) {
+        if (row.prompt_hash != prompt_hash) {
+            continue;
+        }
+
+        serialization::Response response = read_response_(responses_file, row);
+
+        if (response.input == prompt) {
+            response.from_cache = true;
+            return CacheHit { 1.0, std::move(response) };
+        }
+    }
+
+    const std::vector<float> &embedding = this->embed_(prompt);
+
+    std::size_t best = candidates.size();
+    float best_similarity = this->options_.threshold;
+
+    for (std::size_t i = 0; i < candidates.size(); ++i) {
+        if (candidates[i].dimensions != embedding.size()) {
+            continue;
+        }
+
+        const float *vector = reinterpret_cast<const float *>(vectors[i]);
+        const float similarity = dot_f32(embedding.data(), vector, embedding.size());
+
+        if (similarity >= best_similarity) {
+            best_similarity = similarity;
+            best = i;
+        }
+    }
+
+    if (best == candidates.size()) {
+        return std::nullopt;
+    }
+
+    serialization::Response response = read_response_(responses_file, candidates[best]);
+    response.from_cache = true;
+
+    return CacheHit { best_similarity, std::move(response) };
+}
+
+void ResponseCache::insert(const std::string &model, const serialization::Response &response)
+{
+    const std::vector<float> &embedding = this->embed_(response.input);
+
+    const nlohmann::json json = {
+        { "created", response.created },
+        { "input", response.input },
+        { "input_tokens", response.input_tokens },
+        { "model", response.model },
+        { "output", response.output },
+        { "output_tokens", response.output_tokens },
+        { "raw_response", response.raw_response },
+        { "source", response.source },
+    };
+
+    const std::string line = json.dump(-1, ' ', false, nlohmann::json::error_handler_t::replace) + "\n";
+
+    const StoreLock lock(this->path_);
+
+    const fs::path responses_file = this->path_ / FILE_RESPONSES;
+    const fs::path index_file = this->path_ / FILE_INDEX;
+
+    IndexRow row;
+    row.key = get_key_(response.source, model, this->options_.embed_options.model);
+    row.prompt_hash = hash_(response.input);
+    row.offset = fs::exists(responses_file) ? fs::file_size(responses_file) : 0;
+    row.length = line.size();
+    row.dimensions = embedding.size();
+
+    // The response goes first so that an index row never points past the end of the responses file
+    utils::append_to_file(responses_file.string(), line);
+
+    const bool is_new = not fs::exists(index_file) or fs::file_size(index_file) == 0;
+    std::ofstream index(index_file, std::ios::binary | std::ios::app);
+
+    if (not index.is_open()) {
+        throw std::runtime_error(fmt::format("Unable to open '{}'", index_file.string()));
+    }
+
+    if (is_new) {
+        const IndexHeader header;
+        index.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    }
+
+    index.write(reinterpret_cast<const char *>(&row), sizeof(row));
+    index.write(reinterpret_cast<const char *>(embedding.data()), embedding.size() * sizeof(float));
+
+    if (not index) {
+        throw std::runtime_error(fmt::format("Failed to write '{}'", index_file.string()));
+    }
+}
+
+} // namespace retrieval
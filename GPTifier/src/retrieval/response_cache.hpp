@@ -0,0 +1,47 @@
+#pragma once
+
+#include "embedder.hpp"
+#include "responses.hpp"
+
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace retrieval {
+
+struct CacheOptions {
+    EmbedOptions embed_options; // The model used to embed prompts
+    float threshold = 0.95; // Minimum cosine similarity between a prompt and a cached prompt
+};
+
+struct CacheHit {
+    float similarity = 0.0;
+    serialization::Response response;
+};
+
+// A local cache of responses keyed by the embedding of their prompt, such that paraphrases of a question that
+// was already answered by the same model are served without generating a new response. The cache directory
+// holds:
+//   responses.jsonl  One line per cached response
+//   index.bin        A small header followed by one row per response holding a key over source and model,
+//                    a hash of the prompt, the location of the response and the normalized prompt embedding
+class ResponseCache {
+public:
+    ResponseCache(const std::filesystem::path &path, const CacheOptions &options);
+
+    // Identical prompts are looked up by hash first and do not need to be embedded at all
+    std::optional<CacheHit> find(const std::string &prompt, const std::string &model, const std::string &source);
+    // Responses are keyed by the model that was asked for, which may differ from the model OpenAI reports
+    void insert(const std::string &model, const serialization::Response &response);
+
+private:
+    const std::vector<float> &embed_(const std::string &prompt);
+
+    CacheOptions options_;
+    std::filesystem::path path_;
+    std::string embedded_prompt_;
+    std::vector<float> embedding_;
+};
+
+} // namespace retrieval
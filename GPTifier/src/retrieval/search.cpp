@@ -0,0 +1,229 @@
+#include "search.hpp"
+
+#include "embedder.hpp"
+#include "kernels.hpp"
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <fmt/core.h>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+namespace retrieval {
+
+namespace {
+
+// The constant from the original reciprocal rank fusion paper. It damps the influence of the very top ranks
+const float RRF_K = 60.0;
+
+const std::size_t VECTOR_BLOCK_SIZE = 8192;
+
+bool by_score_(const ScoredChunk &a, const ScoredChunk &b)
+{
+    return a.score > b.score or (a.score == b.score and a.chunk < b.chunk);
+}
+
+void keep_top_k_(std::vector<ScoredChunk> &chunks, const std::size_t top_k)
+{
+    const std::size_t count = std::min(top_k, chunks.size());
+    std::partial_sort(chunks.begin(), chunks.begin() + count, chunks.end(), by_score_);
+    chunks.resize(count);
+}
+
+std::vector<float> embed_query_(const StoreReader &reader, const std::string &query)
+{
+    const Store &manifest = reader.get_manifest();
+
+    EmbedOptions options;
+    options.model = manifest.model;
+    options.use_local = manifest.source == "Ollama";
+
+    if (manifest.shortened) {
+        options.dimensions = manifest.dimensions;
+    }
+
+    const serialization::Embeddings embeddings = embed_texts({ query }, options);
+
+    if (embeddings.embeddings.size() != 1 or static_cast<int>(embeddings.embeddings[0].size()) != manifest.dimensions) {
+        throw std::runtime_error("Query embedding dimensions do not match the dimensions of the store");
+    }
+
+    return embeddings.embeddings[0];
+}
+
+float cosine_(const std::vector<float> &query, const float query_norm, const float *row)
+{
+    const float denominator = query_norm * std::sqrt(dot_f32(row, row, query.size()));
+    return denominator > 0.0f ? dot_f32(query.data(), row, query.size()) / denominator : 0.0f;
+}
+
+// Score every chunk of the store in parallel. Each block keeps its own top k and only those are merged, so
+// the merge stays cheap no matter how large the store is
+template<typename Score>
+std::vector<ScoredChunk> scan_(const std::size_t num_chunks, const std::size_t top_k, Score &&score)
+{
+    const std::size_t num_blocks = (num_chunks + VECTOR_BLOCK_SIZE - 1) / VECTOR_BLOCK_SIZE;
+
+    std::vector<ScoredChunk> results;
+    std::mutex mutex_results;
+
+    parallel::for_each_index(num_blocks, std::thread::hardware_concurrency(), [&](const std::size_t block) {
+        const std::size_t begin = block * VECTOR_BLOCK_SIZE;
+        const std::size_t end = std::min(begin + VECTOR_BLOCK_SIZE, num_chunks);
+
+        std::vector<ScoredChunk> scores;
+        scores.reserve(end - begin);
+
+        for (std::size_t chunk = begin; chunk < end; ++chunk) {
+            scores.push_back({ static_cast<std::uint32_t>(chunk), score(chunk) });
+        }
+
+        keep_top_k_(scores, top_k);
+
+        const std::lock_guard<std::mutex> lock(mutex_results);
+        results.insert(results.end(), scores.begin(), scores.end());
+    });
+
+    keep_top_k_(results, top_k);
+    return results;
+}
+
+std::vector<ScoredChunk> search_vectors_(const StoreReader &reader, const std::vector<float> &query, const SearchOptions &options, const std::size_t top_k)
+{
+    const float query_norm = std::sqrt(dot_f32(query.data(), query.data(), query.size()));
+    const Codebook &codebook = reader.get_codebook();
+
+    if (codebook.kind == Quantization::None) {
+        return scan_(reader.size(), top_k, [&](const std::size_t chunk) {
+            return cosine_(query, query_norm, reader.get_vector(chunk));
+        });
+    }
+
+    // Scan the compact codes only, then optionally re-score the best candidates with the full vectors. Only
+    // the pages holding those few full vectors are ever read
+    const CodeScorer scorer(codebook, query);
+
+    std::vector<ScoredChunk> candidates = scan_(reader.size(), std::max(top_k, options.rerank), [&](const std::size_t chunk) {
+        return scorer.score(reader.get_code(chunk));
+    });
+
+    if (options.rerank > 0) {
+        for (auto &candidate: candidates) {
+            candidate.score = cosine_(query, query_norm, reader.get_vector(candidate.chunk));
+        }
+    }
+
+    keep_top_k_(candidates, top_k);
+    return candidates;
+}
+
+std::vector<SearchResult> fuse_rankings_(const std::vector<ScoredChunk> &lexical, const std::vector<ScoredChunk> &vector, const std::size_t top_k)
+{
+    std::map<std::uint32_t, SearchResult> fused;
+
+    for (std::size_t rank = 0; rank < lexical.size(); ++rank) {
+        SearchResult &result = fused[lexical[rank].chunk];
+        result.chunk = lexical[rank].chunk;
+        result.lexical_rank = rank + 1;
+        result.score += 1.0 / (RRF_K + rank + 1);
+    }
+
+    for (std::size_t rank = 0; rank < vector.size(); ++rank) {
+        SearchResult &result = fused[vector[rank].chunk];
+        result.chunk = vector[rank].chunk;
+        result.vector_rank = rank + 1;
+        result.score += 1.0 / (RRF_K + rank + 1);
+    }
+
+    std::vector<ScoredChunk> ranking;
+
+    for (const auto &[chunk, result]: fused) {
+        ranking.push_back({ chunk, result.score });
+    }
+
+    keep_top_k_(ranking, top_k);
+
+    std::vector<SearchResult> results;
+
+    for (const auto &scored: ranking) {
+        results.push_back(fused[scored.chunk]);
+    }
+
+    return results;
+}
+
+} // namespace
+
+SearchMode get_search_mode(const std::string &mode)
+{
+    if (mode == "hybrid") {
+        return SearchMode::Hybrid;
+    }
+
+    if (mode == "lexical") {
+        return SearchMode::Lexical;
+    }
+
+    if (mode == "vector") {
+        return SearchMode::Vector;
+    }
+
+    throw std::runtime_error(fmt::format("Invalid search mode '{}'. Use one of hybrid, lexical or vector", mode));
+}
+
+std::vector<SearchResult> search_store(const StoreReader &reader, const std::string &query, const SearchOptions &options)
+{
+    if (query.empty()) {
+        throw std::runtime_error("Query is empty");
+    }
+
+    if (options.top_k < 1) {
+        throw std::runtime_error("Number of results must be positive");
+    }
+
+    std::vector<SearchResult> results;
+
+    if (options.mode == SearchMode::Hybrid) {
+        // Fuse deeper rankings than requested so that chunks ranked moderately well by both can surface
+        const std::size_t depth = std::max<std::size_t>(options.top_k * 4, 50);
+
+        const std::vector<ScoredChunk> lexical = reader.get_lexical_index().search(query, depth);
+        const std::vector<ScoredChunk> vector = search_vectors_(reader, embed_query_(reader, query), options, depth);
+
+        results = fuse_rankings_(lexical, vector, options.top_k);
+    } else {
+        std::vector<ScoredChunk> ranking;
+
+        if (options.mode == SearchMode::Lexical) {
+            ranking = reader.get_lexical_index().search(query, options.top_k);
+        } else {
+            ranking = search_vectors_(reader, embed_query_(reader, query), options, options.top_k);
+        }
+
+        for (std::size_t rank = 0; rank < ranking.size(); ++rank) {
+            SearchResult result;
+            result.chunk = ranking[rank].chunk;
+            result.score = ranking[rank].score;
+
+            if (options.mode == SearchMode::Lexical) {
+                result.lexical_rank = rank + 1;
+            } else {
+                result.vector_rank = rank + 1;
+            }
+
+            results.push_back(std::move(result));
+        }
+    }
+
+    // Chunk text is only read for the final results
+    for (auto &result: results) {
+        result.record = reader.get_record(result.chunk);
+    }
+
+    return results;
+}
+
+} // namespace retrieval
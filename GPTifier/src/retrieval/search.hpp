@@ -0,0 +1,38 @@
+#pragma once
+
+#include "store.hpp"
+
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace retrieval {
+
+enum class SearchMode {
+    Hybrid,
+    Lexical,
+    Vector,
+};
+
+struct SearchOptions {
+    SearchMode mode = SearchMode::Hybrid;
+    std::size_t rerank = 100; // Re-score this many of the best quantized matches using the full vectors
+    std::size_t top_k = 5;
+};
+
+struct SearchResult {
+    float score = 0.0;
+    std::size_t chunk = 0;
+    std::optional<std::size_t> lexical_rank;
+    std::optional<std::size_t> vector_rank;
+    Record record;
+};
+
+SearchMode get_search_mode(const std::string &mode);
+
+// Lexical mode runs fully offline. Vector and hybrid mode embed the query with the model the store was
+// built with. Hybrid mode merges both rankings using reciprocal rank fusion
+std::vector<SearchResult> search_store(const StoreReader &reader, const std::string &query, const SearchOptions &options);
+
+} // namespace retrieval
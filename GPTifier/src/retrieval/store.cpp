@@ -0,0 +1,474 @@
+#include "store.hpp"
+
+#include "datadir.hpp"
+#include "utils.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <fmt/core.h>
+#include <fstream>
+#include <json.hpp>
+#include <stdexcept>
+#include <sys/file.h>
+#include <unistd.h>
+
+namespace retrieval {
+
+namespace {
+
+namespace fs = std::filesystem;
+
+const std::string FILE_CHUNKS = "chunks.jsonl";
+const std::string FILE_CODES = "codes.bin";
+const std::string FILE_LEXICAL_INDEX = "bm25.idx";
+const std::string FILE_MANIFEST = "manifest.json";
+const std::string FILE_VECTORS = "vectors.bin";
+
+const int STORE_VERSION = 1;
+
+struct VectorsHeader {
+    char magic[4] = { 'G', 'P', 'T', 'V' };
+    std::uint32_t version = STORE_VERSION;
+    std::uint32_t dimensions = 0;
+    std::uint32_t reserved = 0;
+    std::uint64_t count = 0;
+};
+
+struct CodesHeader {
+    char magic[4] = { 'G', 'P', 'T', 'Q' };
+    std::uint32_t version = STORE_VERSION;
+    std::uint32_t kind = 0;
+    std::uint32_t dimensions = 0;
+    std::uint32_t num_subspaces = 0;
+    std::uint32_t num_centroids = 0;
+    std::uint64_t trained_on = 0;
+    std::uint64_t count = 0;
+    std::uint64_t num_centroid_values = 0;
+};
+
+std::size_t align_to_8_(const std::size_t offset)
+{
+    return (offset + 7) & ~std::size_t(7);
+}
+
+void load_manifest_(Store &store, const fs::path &path)
+{
+    const nlohmann::json json = nlohmann::json::parse(utils::read_from_file(path / FILE_MANIFEST));
+
+    if (json["version"] != STORE_VERSION) {
+        throw std::runtime_error(fmt::format("Unsupported store version in '{}'", path.string()));
+    }
+
+    store.dimensions = json["dimensions"];
+    store.model = json["model"];
+    store.source = json["source"];
+    store.shortened = json.value("shortened", false);
+    store.files = json["files"].template get<std::map<std::string, std::string>>();
+    store.codebook.kind = get_quantization(json.value("quantization", "none"));
+}
+
+// Read the codebook from a mapped codes file and return the offset at which the codes start
+std::size_t parse_codes_(const MappedFile &file, Codebook &codebook, const std::size_t count, const fs::path &filename)
+{
+    CodesHeader header;
+
+    if (file.size() < sizeof(header)) {
+        throw std::runtime_error(fmt::format("'{}' is not a GPTifier codes file", filename.string()));
+    }
+
+    std::memcpy(&header, file.data(), sizeof(header));
+
+    if (std::memcmp(header.magic, "GPTQ", 4) != 0 or header.kind != static_cast<std::uint32_t>(codebook.kind)) {
+        throw std::runtime_error(fmt::format("'{}' is not a GPTifier codes file", filename.string()));
+    }
+
+    codebook.dimensions = header.dimensions;
+    codebook.num_subspaces = header.num_subspaces;
+    codebook.num_centroids = header.num_centroids;
+    codebook.trained_on = header.trained_on;
+
+    const std::size_t centroids_size = header.num_centroid_values * sizeof(float);
+    const std::size_t offset = align_to_8_(sizeof(header) + centroids_size);
+
+    if (header.count != count or file.size() < offset + count * codebook.get_code_size()) {
+        throw std::runtime_error(fmt::format("'{}' is inconsistent. Re-ingest to rebuild it", filename.string()));
+    }
+
+    codebook.centroids.resize(header.num_centroid_values);
+    std::memcpy(codebook.centroids.data(), file.data() + sizeof(header), centroids_size);
+
+    return offset;
+}
+
+void load_codes_(Store &store, const fs::path &path)
+{
+    const MappedFile file(path / FILE_CODES);
+    const std::size_t offset = parse_codes_(file, store.codebook, store.records.size(), path / FILE_CODES);
+
+    const std::uint8_t *codes = reinterpret_cast<const std::uint8_t *>(file.data() + offset);
+    store.codes.assign(codes, codes + store.records.size() * store.codebook.get_code_size());
+}
+
+void load_chunks_(Store &store, const fs::path &path)
+{
+    std::ifstream file(path / FILE_CHUNKS);
+
+    if (not file.is_open()) {
+        throw std::runtime_error(fmt::format("Unable to open '{}'", (path / FILE_CHUNKS).string()));
+    }
+
+    std::string line;
+
+    while (std::getline(file, line)) {
+        if (line.empty()) {
+            continue;
+        }
+
+        const nlohmann::json json = nlohmann::json::parse(line);
+
+        Record record;
+        record.length = json["length"];
+        record.offset = json["offset"];
+        record.path = json["path"];
+        record.text = json["text"];
+        store.records.push_back(std::move(record));
+    }
+}
+
+void load_vectors_(Store &store, const fs::path &path)
+{
+    std::ifstream file(path / FILE_VECTORS, std::ios::binary);
+
+    if (not file.is_open()) {
+        throw std::runtime_error(fmt::format("Unable to open '{}'", (path / FILE_VECTORS).string()));
+    }
+
+    VectorsHeader header;
+    file.read(reinterpret_cast<char *>(&header), sizeof(header));
+
+    if (not file or std::memcmp(header.magic, "GPTV", 4) != 0) {
+        throw std::runtime_error(fmt::format("'{}' is not a GPTifier vectors file", (path / FILE_VECTORS).string()));
+    }
+
+    if (header.count != store.records.size() or static_cast<int>(header.dimensions) != store.dimensions) {
+        throw std::runtime_error(fmt::format("Store at '{}' is inconsistent. Re-ingest to rebuild it", path.string()));
+    }
+
+    store.vectors.resize(header.count * header.dimensions);
+    file.read(reinterpret_cast<char *>(store.vectors.data()), store.vectors.size() * sizeof(float));
+
+    if (not file) {
+        throw std::runtime_error(fmt::format("'{}' is truncated", (path / FILE_VECTORS).string()));
+    }
+}
+
+void write_manifest_(const Store &store, const fs::path &filename)
+{
+    const nlohmann::json json = {
+        { "dimensions", store.dimensions },
+        { "files", store.files },
+        { "model", store.model },
+        { "num_chunks", store.records.size() },
+        { "quantization", get_quantization_name(store.codebook.kind) },
+        { "shortened", store.shortened },
+        { "source", store.source },
+        { "version", STORE_VERSION },
+    };
+
+    utils::write_to_file(filename, json.dump(2, ' ', false, nlohmann::json::error_handler_t::replace));
+}
+
+void write_codes_(const Store &store, const fs::path &filename)
+{
+    std::ofstream file(filename, std::ios::binary);
+
+    if (not file.is_open()) {
+        throw std::runtime_error(fmt::format("Unable to open '{}'", filename.string()));
+    }
+
+    const Codebook &codebook = store.codebook;
+
+    CodesHeader header;
+    header.kind = static_cast<std::uint32_t>(codebook.kind);
+    header.dimensions = codebook.dimensions;
+    header.num_subspaces = codebook.num_subspaces;
+    header.num_centroids = codebook.num_centroids;
+    header.trained_on = codebook.trained_on;
+    header.count = store.records.size();
+    header.num_centroid_values = codebook.centroids.size();
+
+    const std::size_t centroids_size = codebook.centroids.size() * sizeof(float);
+    const std::string padding(align_to_8_(sizeof(header) + centroids_size) - sizeof(header) - centroids_size, '\0');
+
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char *>(codebook.centroids.data()), centroids_size);
+    file.write(padding.data(), padding.size());
+    file.write(reinterpret_cast<const char *>(store.codes.data()), store.codes.size());
+}
+
+std::vector<std::uint64_t> write_chunks_(const Store &store, const fs::path &filename)
+{
+    std::ofstream file(filename, std::ios::binary);
+
+    if (not file.is_open()) {
+        throw std::runtime_error(fmt::format("Unable to open '{}'", filename.string()));
+    }
+
+    // The byte offset of each line lets readers jump straight to a chunk without parsing the whole file
+    std::vector<std::uint64_t> offsets;
+    offsets.reserve(store.records.size());
+
+    for (const auto &record: store.records) {
+        offsets.push_back(file.tellp());
+
+        const nlohmann::json json = {
+            { "length", record.length },
+            { "offset", record.offset },
+            { "path", record.path },
+            { "text", record.text },
+        };
+
+        // Source files are not guaranteed to be valid UTF-8
+        file << json.dump(-1, ' ', false, nlohmann::json::error_handler_t::replace) << '\n';
+    }
+
+    return offsets;
+}
+
+void write_vectors_(const Store &store, const fs::path &filename)
+{
+    std::ofstream file(filename, std::ios::binary);
+
+    if (not file.is_open()) {
+        throw std::runtime_error(fmt::format("Unable to open '{}'", filename.string()));
+    }
+
+    VectorsHeader header;
+    header.dimensions = store.dimensions;
+    header.count = store.records.size();
+
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char *>(store.vectors.data()), store.vectors.size() * sizeof(float));
+}
+
+fs::path require_saved_store_(const fs::path &path)
+{
+    if (not fs::exists(path / FILE_MANIFEST)) {
+        throw std::runtime_error(fmt::format("Store '{}' does not exist. Ingest a directory into it first", path.filename().string()));
+    }
+
+    if (not fs::exists(path / FILE_LEXICAL_INDEX)) {
+        throw std::runtime_error(fmt::format("Store '{}' has no lexical index. Re-run ingest to build one", path.filename().string()));
+    }
+
+    return path;
+}
+
+} // namespace
+
+fs::path get_store_path(const std::string &name)
+{
+    if (name.empty()) {
+        throw std::runtime_error("Store name is empty");
+    }
+
+    if (name.find('/') != std::string::npos or name == "." or name == "..") {
+        throw std::runtime_error(fmt::format("Invalid store name '{}'", name));
+    }
+
+    return datadir::GPT_STORES / name;
+}
+
+Store load_store(const fs::path &path)
+{
+    Store store;
+
+    if (not fs::exists(path / FILE_MANIFEST)) {
+        return store;
+    }
+
+    try {
+        load_manifest_(store, path);
+        load_chunks_(store, path);
+    } catch (const nlohmann::json::exception &e) {
+        throw std::runtime_error(fmt::format("Failed to load store at '{}': {}", path.string(), e.what()));
+    }
+
+    load_vectors_(store, path);
+
+    if (store.codebook.kind != Quantization::None) {
+        load_codes_(store, path);
+    }
+
+    return store;
+}
+
+void save_store(const Store &store, const fs::path &path)
+{
+    if (store.vectors.size() != store.records.size() * static_cast<std::size_t>(store.dimensions)) {
+        throw std::runtime_error("Cannot save store. Number of vectors does not match number of chunks");
+    }
+
+    const bool quantized = store.codebook.kind != Quantization::None;
+
+    if (quantized and store.codes.size() != store.records.size() * store.codebook.get_code_size()) {
+        throw std::runtime_error("Cannot save store. Number of codes does not match number of chunks");
+    }
+
+    fs::create_directories(path);
+
+    // Write everything next to the live files then swap the files in. The manifest goes last since its
+    // presence marks a store as loadable
+    const std::vector<std::uint64_t> offsets = write_chunks_(store, path / (FILE_CHUNKS + ".tmp"));
+    write_vectors_(store, path / (FILE_VECTORS + ".tmp"));
+    LexicalIndex::write(store.records, offsets, path / (FILE_LEXICAL_INDEX + ".tmp"));
+    write_manifest_(store, path / (FILE_MANIFEST + ".tmp"));
+
+    if (quantized) {
+        write_codes_(store, path / (FILE_CODES + ".tmp"));
+    }
+
+    const StoreSwapLock lock(path, true);
+
+    if (quantized) {
+        fs::rename(path / (FILE_CODES + ".tmp"), path / FILE_CODES);
+    }
+
+    fs::rename(path / (FILE_CHUNKS + ".tmp"), path / FILE_CHUNKS);
+    fs::rename(path / (FILE_VECTORS + ".tmp"), path / FILE_VECTORS);
+    fs::rename(path / (FILE_LEXICAL_INDEX + ".tmp"), path / FILE_LEXICAL_INDEX);
+    fs::rename(path / (FILE_MANIFEST + ".tmp"), path / FILE_MANIFEST);
+
+    if (not quantized) {
+        fs::remove(path / FILE_CODES);
+    }
+}
+
+StoreReader::StoreReader(const fs::path &path) :
+    StoreReader(path, StoreSwapLock(path, false))
+{
+}
+
+// The lock is held until the delegating constructor returns, so everything is opened from the same save
+StoreReader::StoreReader(const fs::path &path, const StoreSwapLock &) :
+    chunks_(require_saved_store_(path) / FILE_CHUNKS),
+    vectors_(path / FILE_VECTORS),
+    lexical_index_(path / FILE_LEXICAL_INDEX)
+{
+    try {
+        load_manifest_(this->manifest_, path);
+    } catch (const nlohmann::json::exception &e) {
+        throw std::runtime_error(fmt::format("Failed to load store at '{}': {}", path.string(), e.what()));
+    }
+
+    VectorsHeader header;
+
+    if (this->vectors_.size() < sizeof(header)) {
+        throw std::runtime_error(fmt::format("'{}' is not a GPTifier vectors file", (path / FILE_VECTORS).string()));
+    }
+
+    std::memcpy(&header, this->vectors_.data(), sizeof(header));
+
+    if (std::memcmp(header.magic, "GPTV", 4) != 0) {
+        throw std::runtime_error(fmt::format("'{}' is not a GPTifier vectors file", (path / FILE_VECTORS).string()));
+    }
+
+    const std::size_t expected_size = sizeof(header) + header.count * header.dimensions * sizeof(float);
+    const bool consistent = header.count == this->lexical_index_.size() and static_cast<int>(header.dimensions) == this->manifest_.dimensions;
+
+    if (not consistent or this->vectors_.size() < expected_size) {
+        throw std::runtime_error(fmt::format("Store at '{}' is inconsistent. Re-ingest to rebuild it", path.string()));
+    }
+
+    if (this->manifest_.codebook.kind != Quantization::None) {
+        this->codes_.emplace(path / FILE_CODES);
+        const std::size_t offset = parse_codes_(*this->codes_, this->manifest_.codebook, header.count, path / FILE_CODES);
+        this->code_rows_ = reinterpret_cast<const std::uint8_t *>(this->codes_->data() + offset);
+    }
+}
+
+const std::uint8_t *StoreReader::get_code(const std::size_t chunk) const
+{
+    return this->code_rows_ + chunk * this->manifest_.codebook.get_code_size();
+}
+
+const float *StoreReader::get_vector(const std::size_t chunk) const
+{
+    // The header is 24 bytes so rows stay 4 byte aligned within the page aligned mapping
+    const char *rows = this->vectors_.data() + sizeof(VectorsHeader);
+    return reinterpret_cast<const float *>(rows) + chunk * this->manifest_.dimensions;
+}
+
+Record StoreReader::get_record(const std::size_t chunk) const
+{
+    const std::string_view chunks = this->chunks_.view();
+    const std::size_t begin = this->lexical_index_.get_chunk_offset(chunk);
+
+    if (begin >= chunks.size()) {
+        throw std::runtime_error("Store is inconsistent. Re-ingest to rebuild it");
+    }
+
+    const std::size_t end = chunks.find('\n', begin);
+    const nlohmann::json json = nlohmann::json::parse(chunks.substr(begin, end == std::string_view::npos ? end : end - begin));
+
+    Record record;
+    record.length = json["length"];
+    record.offset = json["offset"];
+    record.path = json["path"];
+    record.text = json["text"];
+
+    return record;
+}
+
+StoreLock::StoreLock(const fs::path &path)
+{
+    fs::create_directories(path);
+    const fs::path lockfile = path / ".lock";
+
+    this->fd_ = open(lockfile.c_str(), O_RDWR | O_CREAT, 0600);
+
+    if (this->fd_ == -1) {
+        throw std::runtime_error(fmt::format("Unable to open '{}'", lockfile.string()));
+    }
+
+    if (flock(this->fd_, LOCK_EX | LOCK_NB) != 0) {
+        fmt::print("Waiting for another process to release store '{}'\n", path.filename().string());
+        flock(this->fd_, LOCK_EX);
+    }
+}
+
+StoreLock::~StoreLock()
+{
+    if (this->fd_ != -1) {
+        flock(this->fd_, LOCK_UN);
+        close(this->fd_);
+    }
+}
+
+StoreSwapLock::StoreSwapLock(const fs::path &path, const bool exclusive)
+{
+    const fs::path lockfile = path / ".swap";
+    this->fd_ = open(lockfile.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+
+    if (this->fd_ == -1) {
+        // Nothing to read from if the store does not exist yet. Readers report that once they look for it
+        if (exclusive) {
+            throw std::runtime_error(fmt::format("Unable to open '{}'", lockfile.string()));
+        }
+
+        return;
+    }
+
+    flock(this->fd_, exclusive ? LOCK_EX : LOCK_SH);
+}
+
+StoreSwapLock::~StoreSwapLock()
+{
+    if (this->fd_ != -1) {
+        flock(this->fd_, LOCK_UN);
+        close(this->fd_);
+    }
+}
+
+} // namespace retrieval
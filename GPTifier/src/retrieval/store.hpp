@@ -0,0 +1,116 @@
+#pragma once
+
+#include "bm25.hpp"
+#include "mapped_file.hpp"
+#include "quantization.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace retrieval {
+
+// A store is a directory holding:
+//   manifest.json  The model used to build the store and the content hash of every ingested file
+//   chunks.jsonl   One line per chunk (source path, byte offset, length and text)
+//   vectors.bin    A small header followed by one row of float32 values per chunk, in chunks.jsonl order
+//   bm25.idx       A lexical index over the chunk text (see bm25.hpp)
+//   codes.bin      Optional. A small header, the codebook and one quantized code per chunk (see quantization.hpp)
+
+struct Record {
+    std::size_t length = 0;
+    std::size_t offset = 0;
+    std::string path;
+    std::string text;
+};
+
+struct Store {
+    bool shortened = false; // Whether dimensions were requested explicitly rather than being the model's own
+    int dimensions = 0;
+    std::string model;
+    std::string source;
+    std::map<std::string, std::string> files;
+    std::vector<Record> records;
+    std::vector<float> vectors;
+    Codebook codebook;
+    std::vector<std::uint8_t> codes;
+};
+
+std::filesystem::path get_store_path(const std::string &name);
+Store load_store(const std::filesystem::path &path);
+void save_store(const Store &store, const std::filesystem::path &path);
+
+// Held while a saved store's files are swapped in (exclusive) or opened (shared) so that a reader never
+// mixes files from two saves. Readers keep working from the files they mapped after releasing it
+class StoreSwapLock {
+public:
+    StoreSwapLock(const std::filesystem::path &path, bool exclusive);
+    ~StoreSwapLock();
+
+    StoreSwapLock(const StoreSwapLock &) = delete;
+    StoreSwapLock &operator=(const StoreSwapLock &) = delete;
+
+private:
+    int fd_ = -1;
+};
+
+// Read only access to a saved store for querying. Only the manifest is parsed up front. Chunks, vectors
+// and the lexical index are memory mapped and read on demand
+class StoreReader {
+public:
+    explicit StoreReader(const std::filesystem::path &path);
+
+    const Store &get_manifest() const
+    {
+        return this->manifest_;
+    }
+
+    const LexicalIndex &get_lexical_index() const
+    {
+        return this->lexical_index_;
+    }
+
+    const Codebook &get_codebook() const
+    {
+        return this->manifest_.codebook;
+    }
+
+    std::size_t size() const
+    {
+        return this->lexical_index_.size();
+    }
+
+    const float *get_vector(std::size_t chunk) const;
+    const std::uint8_t *get_code(std::size_t chunk) const;
+    Record get_record(std::size_t chunk) const;
+
+private:
+    StoreReader(const std::filesystem::path &path, const StoreSwapLock &lock);
+
+    Store manifest_;
+    MappedFile chunks_;
+    MappedFile vectors_;
+    LexicalIndex lexical_index_;
+    std::optional<MappedFile> codes_;
+    const std::uint8_t *code_rows_ = nullptr;
+};
+
+// Holds an exclusive advisory lock on a store for the lifetime of the object so that concurrent
+// ingest or watch processes do not clobber each other
+class StoreLock {
+public:
+    explicit StoreLock(const std::filesystem::path &path);
+    ~StoreLock();
+
+    StoreLock(const StoreLock &) = delete;
+    StoreLock &operator=(const StoreLock &) = delete;
+
+private:
+    int fd_ = -1;
+};
+
+} // namespace retrieval
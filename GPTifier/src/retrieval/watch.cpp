@@ -0,0 +1,291 @@
+#include "watch.hpp"
+
+#include "store.hpp"
+
+#include <stdexcept>
+
+#ifdef __linux__
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fmt/core.h>
+#include <poll.h>
+#include <set>
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <unordered_map>
+#endif
+
+namespace retrieval {
+
+#ifdef __linux__
+
+namespace {
+
+namespace fs = std::filesystem;
+using Clock = std::chrono::steady_clock;
+
+// Files are only picked up once closed after writing so that half written files are never embedded
+const std::uint32_t WATCH_MASK = IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR;
+
+const int MAX_RETRY_DELAY_MS = 60000;
+
+class Inotify {
+public:
+    Inotify(const fs::path &root, const std::vector<std::string> &globs) :
+        globs_(globs),
+        root_(root)
+    {
+        this->fd_ = inotify_init1(IN_CLOEXEC);
+
+        if (this->fd_ == -1) {
+            throw std::runtime_error(fmt::format("Failed to initialize inotify: {}", std::strerror(errno)));
+        }
+    }
+
+    ~Inotify()
+    {
+        close(this->fd_);
+    }
+
+    Inotify(const Inotify &) = delete;
+    Inotify &operator=(const Inotify &) = delete;
+
+    int get_fd() const
+    {
+        return this->fd_;
+    }
+
+    bool has_watches() const
+    {
+        return not this->directories_.empty();
+    }
+
+    // Watch a directory and all of its (non-ignored) subdirectories. Files already present are queued since
+    // they may have been created before the watch was in place
+    void add_tree(const fs::path &directory, std::set<std::string> *pending)
+    {
+        this->add_watch_(directory);
+
+        std::error_code ec;
+        const auto options = fs::directory_options::skip_permission_denied;
+
+        for (auto it = fs::recursive_directory_iterator(directory, options, ec); it != fs::recursive_directory_iterator(); it.increment(ec)) {
+            if (ec) {
+                break;
+            }
+
+            if (is_ignored(it->path().lexically_relative(this->root_), this->globs_)) {
+                if (it->is_directory()) {
+                    it.disable_recursion_pending();
+                }
+                continue;
+            }
+
+            if (it->is_directory()) {
+                this->add_watch_(it->path());
+            } else if (pending and it->is_regular_file()) {
+                pending->insert(it->path().string());
+            }
+        }
+    }
+
+    // Drain all queued events, collecting paths that need to be re-examined
+    void read_events(std::set<std::string> &pending, bool &rescan)
+    {
+        alignas(inotify_event) char buffer[64 * 1024];
+        const ssize_t length = read(this->fd_, buffer, sizeof(buffer));
+
+        if (length == -1) {
+            if (errno == EAGAIN or errno == EINTR) {
+                return;
+            }
+
+            throw std::runtime_error(fmt::format("Failed to read inotify events: {}", std::strerror(errno)));
+        }
+
+        for (char *ptr = buffer; ptr < buffer + length;) {
+            const inotify_event *event = reinterpret_cast<const inotify_event *>(ptr);
+            ptr += sizeof(inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                rescan = true;
+                continue;
+            }
+
+            const auto it = this->directories_.find(event->wd);
+
+            if (it == this->directories_.end()) {
+                continue;
+            }
+
+            if (event->mask & IN_IGNORED) {
+                this->directories_.erase(it);
+                continue;
+            }
+
+            if (event->len == 0) {
+                continue;
+            }
+
+            const fs::path path = it->second / event->name;
+
+            if (is_ignored(path.lexically_relative(this->root_), this->globs_)) {
+                continue;
+            }
+
+            if ((event->mask & IN_ISDIR) and (event->mask & (IN_CREATE | IN_MOVED_TO))) {
+                this->add_tree(path, &pending);
+            }
+
+            pending.insert(path.string());
+        }
+    }
+
+private:
+    void add_watch_(const fs::path &directory)
+    {
+        const int wd = inotify_add_watch(this->fd_, directory.c_str(), WATCH_MASK);
+
+        if (wd == -1) {
+            if (errno == ENOSPC) {
+                throw std::runtime_error("Ran out of inotify watches. Consider raising fs.inotify.max_user_watches");
+            }
+            return;
+        }
+
+        this->directories_[wd] = directory;
+    }
+
+    int fd_ = -1;
+    std::unordered_map<int, fs::path> directories_;
+    std::vector<std::string> globs_;
+    fs::path root_;
+};
+
+std::vector<std::string> expand_pending_(const std::set<std::string> &pending, const Store &store)
+{
+    // A deleted or moved directory only produces a single event, so expand it to all the files that the
+    // store holds from underneath it
+    std::vector<std::string> paths;
+
+    for (const auto &path: pending) {
+        paths.push_back(path);
+
+        const std::string prefix = path + "/";
+
+        for (auto it = store.files.lower_bound(prefix); it != store.files.end() and it->first.starts_with(prefix); ++it) {
+            paths.push_back(it->first);
+        }
+    }
+
+    std::sort(paths.begin(), paths.end());
+    paths.erase(std::unique(paths.begin(), paths.end()), paths.end());
+
+    return paths;
+}
+
+IngestSummary sync_store_(const fs::path &root, const fs::path &store_path, const IngestOptions &options, const std::set<std::string> *pending)
+{
+    // The store is loaded per update and released right after so that an idle watcher holds no vectors
+    const StoreLock lock(store_path);
+    Store store = load_store(store_path);
+
+    IngestSummary summary;
+
+    if (pending) {
+        summary = ingest_files(root, expand_pending_(*pending, store), store, options);
+    } else {
+        summary = ingest_directory(root, store, options);
+    }
+
+    save_store(store, store_path);
+    return summary;
+}
+
+} // namespace
+
+void watch_directory(const fs::path &root, const fs::path &store_path, const WatchOptions &options, const WatchCallbacks &callbacks)
+{
+    if (not fs::is_directory(root)) {
+        throw std::runtime_error(fmt::format("'{}' is not a directory", root.string()));
+    }
+
+    if (options.debounce_ms < 0) {
+        throw std::runtime_error("Debounce interval must not be negative");
+    }
+
+    const fs::path canonical_root = fs::canonical(root);
+    const IngestOptions &ingest_options = options.ingest_options;
+
+    Inotify inotify(canonical_root, get_ignore_globs(ingest_options));
+    inotify.add_tree(canonical_root, nullptr);
+
+    // Catch up on anything that changed while nobody was watching
+    callbacks.on_update(sync_store_(canonical_root, store_path, ingest_options, nullptr));
+
+    std::set<std::string> pending;
+    bool rescan = false;
+    int retry_delay_ms = 0;
+    Clock::time_point last_event = Clock::now();
+
+    while (inotify.has_watches()) {
+        int timeout_ms = -1;
+
+        // Block indefinitely when idle. Otherwise wait until events have stopped arriving for the debounce
+        // interval so that bursts (i.e. a checkout touching many files) are coalesced into one update
+        if (rescan or not pending.empty()) {
+            const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - last_event);
+            timeout_ms = std::max<int>(0, options.debounce_ms + retry_delay_ms - elapsed.count());
+        }
+
+        pollfd pfd = { inotify.get_fd(), POLLIN, 0 };
+        const int rc = poll(&pfd, 1, timeout_ms);
+
+        if (rc == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            throw std::runtime_error(fmt::format("Failed to poll inotify: {}", std::strerror(errno)));
+        }
+
+        if (rc > 0) {
+            inotify.read_events(pending, rescan);
+            last_event = Clock::now();
+            continue;
+        }
+
+        // Directories created while events were being dropped have no watch yet. Existing watches are reused
+        if (rescan) {
+            inotify.add_tree(canonical_root, nullptr);
+        }
+
+        try {
+            callbacks.on_update(sync_store_(canonical_root, store_path, ingest_options, rescan ? nullptr : &pending));
+            pending.clear();
+            rescan = false;
+            retry_delay_ms = 0;
+        } catch (const std::runtime_error &e) {
+            // Keep the pending changes around and back off (i.e. the embedding backend is unreachable)
+            retry_delay_ms = std::clamp(retry_delay_ms * 2, 1000, MAX_RETRY_DELAY_MS);
+            last_event = Clock::now();
+            callbacks.on_error(e.what());
+        }
+    }
+
+    throw std::runtime_error(fmt::format("'{}' is no longer being watched (i.e. it was deleted)", canonical_root.string()));
+}
+
+#else
+
+void watch_directory(const std::filesystem::path &, const std::filesystem::path &, const WatchOptions &, const WatchCallbacks &)
+{
+    throw std::runtime_error("Watch mode requires inotify and is only supported on Linux");
+}
+
+#endif
+
+} // namespace retrieval
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "ingest.hpp"
+
+#include <filesystem>
+#include <functional>
+#include <string>
+
+namespace retrieval {
+
+struct WatchOptions {
+    IngestOptions ingest_options;
+    int debounce_ms = 500;
+};
+
+struct WatchCallbacks {
+    std::function<void(const IngestSummary &summary)> on_update;
+    std::function<void(const std::string &errmsg)> on_error;
+};
+
+// Block forever, keeping the store at store_path in sync with the tree under root
+void watch_directory(const std::filesystem::path &root, const std::filesystem::path &store_path, const WatchOptions &options, const WatchCallbacks &callbacks);
+
+} // namespace retrieval
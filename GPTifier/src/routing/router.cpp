@@ -0,0 +1,202 @@
+#include "router.hpp"
+
+#include "datadir.hpp"
+#include "sample_log.hpp"
+#include "utils.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fmt/core.h>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+namespace routing {
+
+namespace {
+
+namespace fs = std::filesystem;
+
+// Only recent outcomes say anything about the state of a backend. Older ones age out so that a backend
+// which was avoided for a while is eventually tried again
+const std::chrono::seconds HEALTH_HORIZON(600);
+const std::size_t HEALTH_WINDOW = 50;
+
+// Do not judge a backend on fewer outcomes than this
+const std::size_t MIN_SAMPLES = 5;
+
+struct Sample {
+    std::int64_t time = 0;
+    int latency_ms = 0;
+    bool ok = false;
+};
+
+struct Health {
+    std::vector<Sample> samples;
+};
+
+std::int64_t get_unix_time_()
+{
+    return std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+fs::path get_health_path_(const Backend backend)
+{
+    static const fs::path directory = datadir::GPT_DATADIR / "routes";
+
+    std::error_code ec;
+    fs::create_directories(directory, ec);
+
+    return directory / (backend == Backend::OpenAI ? "openai.txt" : "ollama.txt");
+}
+
+Health load_health_(const Backend backend)
+{
+    Health health;
+
+    const utils::SampleLog log(get_health_path_(backend), HEALTH_WINDOW);
+    const std::int64_t horizon = get_unix_time_() - HEALTH_HORIZON.count();
+
+    for (const std::string &line: log.get_samples()) {
+        std::istringstream stream(line);
+        Sample sample;
+        int ok = 0;
+
+        if (stream >> sample.time >> sample.latency_ms >> ok and sample.time >= horizon) {
+            sample.ok = ok != 0;
+            health.samples.push_back(sample);
+        }
+    }
+
+    return health;
+}
+
+void record_outcome_(const Backend backend, const std::chrono::milliseconds latency, const bool ok)
+{
+    utils::SampleLog log(get_health_path_(backend), HEALTH_WINDOW);
+    log.append(fmt::format("{} {} {}", get_unix_time_(), latency.count(), ok ? 1 : 0));
+}
+
+bool is_healthy_(const Backend backend, const BackendLimits &limits, const int cooldown)
+{
+    const Health health = load_health_(backend);
+
+    if (health.samples.empty()) {
+        return true;
+    }
+
+    const Sample &last = health.samples.back();
+
+    if (not last.ok and get_unix_time_() - last.time < cooldown) {
+        return false;
+    }
+
+    if (health.samples.size() < MIN_SAMPLES) {
+        return true;
+    }
+
+    std::vector<int> latencies;
+    std::size_t num_failures = 0;
+
+    for (const Sample &sample: health.samples) {
+        if (sample.ok) {
+            latencies.push_back(sample.latency_ms);
+        } else {
+            num_failures++;
+        }
+    }
+
+    if (static_cast<float>(num_failures) / health.samples.size() > limits.max_error_rate) {
+        return false;
+    }
+
+    if (latencies.empty()) {
+        return true;
+    }
+
+    const auto median = latencies.begin() + latencies.size() / 2;
+    std::nth_element(latencies.begin(), median, latencies.end());
+
+    return *median <= limits.max_latency * 1000.0;
+}
+
+const BackendLimits &get_limits_(const Backend backend, const RouterOptions &options)
+{
+    return backend == Backend::OpenAI ? options.limits_openai : options.limits_ollama;
+}
+
+Route get_route_(const Backend backend, const RouterOptions &options)
+{
+    return { backend, backend == Backend::OpenAI ? options.model_openai : options.model_ollama };
+}
+
+} // namespace
+
+std::string get_backend_name(const Backend backend)
+{
+    return backend == Backend::OpenAI ? "OpenAI" : "Ollama";
+}
+
+std::vector<Route> plan_routes(const std::string &prompt, const RouterOptions &options)
+{
+    if (options.local_token_limit < 0) {
+        throw std::runtime_error("Local token limit must not be negative");
+    }
+
+    // Short prompts stay local where they are cheap and fast while long ones go to OpenAI
+    Backend preferred = Backend::Ollama;
+    Backend other = Backend::OpenAI;
+
+    if (utils::estimate_token_count(prompt) > options.local_token_limit) {
+        std::swap(preferred, other);
+    }
+
+    const bool preferred_healthy = is_healthy_(preferred, get_limits_(preferred, options), options.cooldown);
+
+    if (not preferred_healthy and is_healthy_(other, get_limits_(other, options), options.cooldown)) {
+        std::swap(preferred, other);
+    }
+
+    return { get_route_(preferred, options), get_route_(other, options) };
+}
+
+serialization::Response create_routed_response(const std::string &prompt, const std::vector<Route> &routes, const RouterOptions &options, const RouterCallbacks &callbacks)
+{
+    if (routes.empty()) {
+        throw std::runtime_error("No routes to send the prompt through");
+    }
+
+    for (std::size_t i = 0; i < routes.size(); ++i) {
+        const Route &route = routes[i];
+        const auto start = std::chrono::steady_clock::now();
+
+        try {
+            serialization::Response response;
+
+            if (route.backend == Backend::OpenAI) {
+                response = serialization::create_openai_response(prompt, route.model, options.temperature);
+            } else {
+                response = serialization::create_ollama_response(prompt, route.model);
+            }
+
+            record_outcome_(route.backend, std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start), true);
+            return response;
+        } catch (const std::runtime_error &e) {
+            record_outcome_(route.backend, std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start), false);
+
+            if (i + 1 == routes.size()) {
+                throw;
+            }
+
+            if (callbacks.on_fallback) {
+                callbacks.on_fallback(route, e.what());
+            }
+        }
+    }
+
+    throw std::runtime_error("No routes to send the prompt through");
+}
+
+} // namespace routing
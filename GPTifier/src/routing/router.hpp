@@ -0,0 +1,57 @@
+#pragma once
+
+#include "responses.hpp"
+
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace routing {
+
+enum class Backend {
+    OpenAI,
+    Ollama,
+};
+
+struct Route {
+    Backend backend = Backend::Ollama;
+    std::string model;
+};
+
+struct BackendLimits {
+    // A backend whose median latency over recent requests exceeds this is considered slow
+    float max_latency = 30.0;
+
+    // A backend failing more often than this over recent requests is considered unreliable
+    float max_error_rate = 0.5;
+};
+
+struct RouterOptions {
+    BackendLimits limits_ollama;
+    BackendLimits limits_openai;
+
+    // Prompts estimated to be longer than this many tokens are sent to OpenAI first
+    int local_token_limit = 1000;
+
+    // A backend that just failed (i.e. it is down or rate limited) is avoided for this many seconds
+    int cooldown = 60;
+
+    float temperature = 1.0;
+    std::string model_ollama;
+    std::string model_openai;
+};
+
+struct RouterCallbacks {
+    std::function<void(const Route &route, const std::string &error)> on_fallback;
+};
+
+std::string get_backend_name(const Backend backend);
+
+// Order the backends by preference for `prompt`. The first route is the one expected to serve the prompt
+// while the second is only used if the first fails
+std::vector<Route> plan_routes(const std::string &prompt, const RouterOptions &options);
+
+// Try each route in turn until one succeeds, recording the outcome so that later plans account for it
+serialization::Response create_routed_response(const std::string &prompt, const std::vector<Route> &routes, const RouterOptions &options, const RouterCallbacks &callbacks);
+
+} // namespace routing
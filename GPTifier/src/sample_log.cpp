@@ -0,0 +1,53 @@
+#include "sample_log.hpp"
+
+#include "utils.hpp"
+
+#include <fstream>
+
+namespace utils {
+
+SampleLog::SampleLog(const std::filesystem::path &filename, const std::size_t window) :
+    filename_(filename), window_(window)
+{
+    std::ifstream file(filename);
+    std::string line;
+
+    while (std::getline(file, line)) {
+        if (not line.empty()) {
+            this->samples_.push_back(line);
+        }
+    }
+
+    this->num_lines_ = this->samples_.size();
+
+    if (this->samples_.size() > window) {
+        this->samples_.erase(this->samples_.begin(), this->samples_.end() - window);
+    }
+}
+
+void SampleLog::append(const std::string &sample)
+{
+    this->samples_.push_back(sample);
+
+    if (this->samples_.size() > this->window_) {
+        this->samples_.erase(this->samples_.begin());
+    }
+
+    if (this->num_lines_ < 2 * this->window_) {
+        append_to_file(this->filename_, sample + '\n');
+        this->num_lines_++;
+        return;
+    }
+
+    // Concurrent processes may lose a sample or two here, which is of no consequence over a window
+    std::string text;
+
+    for (const std::string &line: this->samples_) {
+        text += line + '\n';
+    }
+
+    write_file_atomically(this->filename_, text);
+    this->num_lines_ = this->samples_.size();
+}
+
+} // namespace utils
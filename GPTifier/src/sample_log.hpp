@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace utils {
+
+// A text file of recent samples (i.e. request latencies), one per line, shared by concurrent processes.
+// Samples are appended, and the file is compacted down to the newest `window` samples once it holds twice
+// that many
+class SampleLog {
+public:
+    SampleLog(const std::filesystem::path &filename, std::size_t window);
+
+    // The newest `window` samples, oldest first
+    const std::vector<std::string> &get_samples() const
+    {
+        return this->samples_;
+    }
+
+    void append(const std::string &sample);
+
+private:
+    std::filesystem::path filename_;
+    std::size_t window_ = 0;
+    std::size_t num_lines_ = 0;
+    std::vector<std::string> samples_;
+};
+
+} // namespace utils
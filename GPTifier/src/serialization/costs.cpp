@@ -9,6 +9,65 @@
 
 namespace serialization {
 
+#ifdef USE_SIMDJSON
+
+namespace {
+
+float get_costs_amount_(simdjson::ondemand::object cost_object)
+{
+    simdjson::ondemand::value value = cost_object["amount"]["value"];
+
+    if (value.type() == simdjson::ondemand::json_type::number) {
+        return double(value);
+    }
+
+    return std::stof(std::string(std::string_view(value)));
+}
+
+} // namespace
+
+Costs unpack_costs_response(const std::string &response)
+{
+    Costs costs;
+    costs.raw_response = response;
+
+    try {
+        const simdjson::padded_string padded(response);
+        simdjson::ondemand::document json = iterate_json(padded);
+
+        for (simdjson::ondemand::object entry: json["data"]) {
+            CostsBucket bucket;
+            bucket.start_time = std::int64_t(entry["start_time"]);
+            bucket.end_time = std::int64_t(entry["end_time"]);
+
+            bool has_results = false;
+
+            // Only the first result of each bucket is needed. The rest are skipped without being parsed
+            for (simdjson::ondemand::object result: entry["results"]) {
+                bucket.cost = get_costs_amount_(result);
+                bucket.org_id = std::string_view(result["organization_id"]);
+                has_results = true;
+                break;
+            }
+
+            if (not has_results) {
+                continue;
+            }
+
+            bucket.start_time_dt_str = datetime_from_unix_timestamp(bucket.start_time);
+            bucket.end_time_dt_str = datetime_from_unix_timestamp(bucket.end_time);
+            costs.total_cost += bucket.cost;
+            costs.buckets.push_back(bucket);
+        }
+    } catch (const simdjson::simdjson_error &e) {
+        throw_on_simdjson_error(e);
+    }
+
+    return costs;
+}
+
+#else
+
 namespace {
 
 float get_costs_amount_(const nlohmann::json &cost_object)
@@ -32,7 +91,9 @@ CostsBucket unpack_individual_bucket_(const nlohmann::json &entry)
     return bucket;
 }
 
-Costs unpack_costs_response_(const std::string &response)
+} // namespace
+
+Costs unpack_costs_response(const std::string &response)
 {
     const nlohmann::json json = parse_json(response);
 
@@ -56,7 +117,7 @@ Costs unpack_costs_response_(const std::string &response)
     return costs;
 }
 
-} // namespace
+#endif
 
 Costs get_costs(const std::time_t start_time, const int limit)
 {
@@ -66,7 +127,7 @@ Costs get_costs(const std::time_t start_time, const int limit)
         throw_on_openai_error_response(result.error().response);
     }
 
-    return unpack_costs_response_(result->response);
+    return unpack_costs_response(result->response);
 }
 
 } // namespace serialization
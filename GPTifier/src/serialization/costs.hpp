@@ -27,5 +27,6 @@ struct Costs {
 };
 
 Costs get_costs(const std::time_t start_time, const int limit);
+Costs unpack_costs_response(const std::string &response);
 
 } // namespace serialization
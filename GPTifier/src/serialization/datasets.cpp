@@ -0,0 +1,479 @@
+#include "datasets.hpp"
+
+#include "mapped_file.hpp"
+#include "parallel.hpp"
+#include "utils.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <fmt/core.h>
+#include <json.hpp>
+#include <numeric>
+#include <stdexcept>
+#include <string_view>
+
+#ifdef USE_SIMDJSON
+#include <simdjson.h>
+#endif
+
+namespace serialization {
+
+namespace {
+
+// A few chunks per thread keep all threads busy when line lengths vary across the file
+const std::size_t CHUNKS_PER_JOB = 4;
+const std::size_t MIN_CHUNK_SIZE = 1024 * 1024;
+
+// Chat formatting overhead, as counted in OpenAI's cookbook
+const int TOKENS_PER_EXAMPLE = 3;
+const int TOKENS_PER_MESSAGE = 3;
+const int TOKENS_PER_NAME = 1;
+
+// OpenAI's default number of epochs aims for roughly this many examples seen over a job
+const int TARGET_EPOCHS = 3;
+const int MIN_TARGET_EXAMPLES = 100;
+const int MAX_TARGET_EXAMPLES = 25000;
+const int MAX_DEFAULT_EPOCHS = 25;
+
+const std::array<std::string_view, 4> ROLES = { "assistant", "system", "tool", "user" };
+const std::array<std::string_view, 8> MESSAGE_KEYS = { "content", "function_call", "name", "refusal", "role", "tool_call_id", "tool_calls", "weight" };
+
+// Splitting ------------------------------------------------------------------------------------------------
+
+std::vector<std::string_view> split_at_lines_(const std::string_view data, const std::size_t num_chunks)
+{
+    std::vector<std::string_view> chunks;
+    std::size_t begin = 0;
+
+    for (std::size_t i = 1; i <= num_chunks and begin < data.size(); ++i) {
+        std::size_t end = std::max(begin, data.size() * i / num_chunks);
+
+        // Move the boundary past the end of the line it falls on
+        if (end < data.size()) {
+            const std::size_t newline = data.find('\n', end);
+            end = newline == std::string_view::npos ? data.size() : newline + 1;
+        }
+
+        chunks.push_back(data.substr(begin, end - begin));
+        begin = end;
+    }
+
+    return chunks;
+}
+
+// Validation -----------------------------------------------------------------------------------------------
+
+struct Example {
+    int tokens = TOKENS_PER_EXAMPLE;
+    int assistant_tokens = 0;
+    std::size_t num_messages = 0;
+};
+
+template<std::size_t N>
+bool contains_(const std::array<std::string_view, N> &values, const std::string_view value)
+{
+    return std::find(values.begin(), values.end(), value) != values.end();
+}
+
+#ifdef USE_SIMDJSON
+
+// Lines are parsed into a DOM rather than on demand since on demand parsing skips over the values it is not
+// asked for without fully validating them
+using simdjson::dom::element;
+
+int count_content_tokens_(const element content)
+{
+    std::string_view text;
+
+    if (content.get(text) == simdjson::SUCCESS) {
+        return utils::estimate_token_count(text);
+    }
+
+    // Content parts, of which only text counts towards the estimate
+    int tokens = 0;
+    simdjson::dom::array parts;
+
+    if (content.get(parts) == simdjson::SUCCESS) {
+        for (const element part: parts) {
+            if (part["text"].get(text) == simdjson::SUCCESS) {
+                tokens += utils::estimate_token_count(text);
+            }
+        }
+    }
+
+    return tokens;
+}
+
+void check_message_(const element message, const std::size_t index)
+{
+    simdjson::dom::object object;
+
+    if (message.get(object) != simdjson::SUCCESS) {
+        throw std::runtime_error(fmt::format("messages[{}] is not an object", index));
+    }
+
+    for (const auto field: object) {
+        if (not contains_(MESSAGE_KEYS, field.key)) {
+            throw std::runtime_error(fmt::format("messages[{}] has unrecognized key '{}'", index, field.key));
+        }
+    }
+
+    std::string_view role;
+
+    if (object["role"].get(role) != simdjson::SUCCESS) {
+        throw std::runtime_error(fmt::format("messages[{}] is missing 'role'", index));
+    }
+
+    if (not contains_(ROLES, role)) {
+        throw std::runtime_error(fmt::format("messages[{}] has unrecognized role '{}'", index, role));
+    }
+
+    // Assistant messages calling tools need not say anything
+    const bool is_call = role == "assistant" and (object["tool_calls"].error() == simdjson::SUCCESS or object["function_call"].error() == simdjson::SUCCESS);
+    element content;
+
+    if (object["content"].get(content) != simdjson::SUCCESS or content.is_null()) {
+        if (not is_call) {
+            throw std::runtime_error(fmt::format("messages[{}] is missing 'content'", index));
+        }
+    } else if (not content.is_string() and not content.is_array()) {
+        throw std::runtime_error(fmt::format("messages[{}] has 'content' that is neither text nor a list of parts", index));
+    }
+
+    element weight;
+
+    if (object["weight"].get(weight) == simdjson::SUCCESS and (not weight.is_number() or (double(weight) != 0 and double(weight) != 1))) {
+        throw std::runtime_error(fmt::format("messages[{}] has 'weight' other than 0 or 1", index));
+    }
+}
+
+Example unpack_example_(const std::string_view line)
+{
+    thread_local simdjson::dom::parser parser;
+    thread_local std::string padded;
+
+    // Copying the line is cheap next to parsing it and leaves the padding simdjson reads past the end to us
+    padded.resize(line.size() + simdjson::SIMDJSON_PADDING);
+    std::memcpy(padded.data(), line.data(), line.size());
+
+    element example;
+    const simdjson::error_code error = parser.parse(padded.data(), line.size(), false).get(example);
+
+    if (error != simdjson::SUCCESS) {
+        throw std::runtime_error(fmt::format("Invalid JSON: {}", simdjson::error_message(error)));
+    }
+
+    if (not example.is_object()) {
+        throw std::runtime_error("Example is not a JSON object");
+    }
+
+    simdjson::dom::array messages;
+
+    if (example["messages"].get(messages) != simdjson::SUCCESS) {
+        throw std::runtime_error("Missing 'messages' list");
+    }
+
+    if (messages.size() == 0) {
+        throw std::runtime_error("'messages' list is empty");
+    }
+
+    Example unpacked;
+    bool has_assistant = false;
+    std::size_t i = 0;
+
+    for (const element message: messages) {
+        check_message_(message, i++);
+
+        int tokens = TOKENS_PER_MESSAGE;
+        element content;
+        std::string_view name;
+
+        if (message["content"].get(content) == simdjson::SUCCESS) {
+            tokens += count_content_tokens_(content);
+        }
+
+        if (message["name"].get(name) == simdjson::SUCCESS) {
+            tokens += TOKENS_PER_NAME + utils::estimate_token_count(name);
+        }
+
+        if (std::string_view(message["role"]) == "assistant") {
+            has_assistant = true;
+            unpacked.assistant_tokens += tokens;
+        }
+
+        unpacked.tokens += tokens;
+    }
+
+    if (not has_assistant) {
+        throw std::runtime_error("Example has no assistant message");
+    }
+
+    unpacked.num_messages = messages.size();
+    return unpacked;
+}
+
+#else
+
+using json = nlohmann::json;
+
+int count_content_tokens_(const json &content)
+{
+    if (content.is_string()) {
+        return utils::estimate_token_count(content.get_ref<const std::string &>());
+    }
+
+    // Content parts, of which only text counts towards the estimate
+    int tokens = 0;
+
+    if (content.is_array()) {
+        for (const auto &part: content) {
+            if (part.is_object() and part.contains("text") and part["text"].is_string()) {
+                tokens += utils::estimate_token_count(part["text"].get_ref<const std::string &>());
+            }
+        }
+    }
+
+    return tokens;
+}
+
+void check_message_(const json &message, const std::size_t index)
+{
+    if (not message.is_object()) {
+        throw std::runtime_error(fmt::format("messages[{}] is not an object", index));
+    }
+
+    for (const auto &item: message.items()) {
+        if (not contains_(MESSAGE_KEYS, item.key())) {
+            throw std::runtime_error(fmt::format("messages[{}] has unrecognized key '{}'", index, item.key()));
+        }
+    }
+
+    if (not message.contains("role") or not message["role"].is_string()) {
+        throw std::runtime_error(fmt::format("messages[{}] is missing 'role'", index));
+    }
+
+    const std::string &role = message["role"].get_ref<const std::string &>();
+
+    if (not contains_(ROLES, role)) {
+        throw std::runtime_error(fmt::format("messages[{}] has unrecognized role '{}'", index, role));
+    }
+
+    // Assistant messages calling tools need not say anything
+    const bool is_call = role == "assistant" and (message.contains("tool_calls") or message.contains("function_call"));
+    const auto content = message.find("content");
+
+    if (content == message.end() or content->is_null()) {
+        if (not is_call) {
+            throw std::runtime_error(fmt::format("messages[{}] is missing 'content'", index));
+        }
+    } else if (not content->is_string() and not content->is_array()) {
+        throw std::runtime_error(fmt::format("messages[{}] has 'content' that is neither text nor a list of parts", index));
+    }
+
+    if (message.contains("weight") and message["weight"] != 0 and message["weight"] != 1) {
+        throw std::runtime_error(fmt::format("messages[{}] has 'weight' other than 0 or 1", index));
+    }
+}
+
+Example unpack_example_(const std::string_view line)
+{
+    json example;
+
+    try {
+        example = json::parse(line);
+    } catch (const json::parse_error &e) {
+        throw std::runtime_error(fmt::format("Invalid JSON at column {}", e.byte));
+    }
+
+    if (not example.is_object()) {
+        throw std::runtime_error("Example is not a JSON object");
+    }
+
+    if (not example.contains("messages") or not example["messages"].is_array()) {
+        throw std::runtime_error("Missing 'messages' list");
+    }
+
+    const json &messages = example["messages"];
+
+    if (messages.empty()) {
+        throw std::runtime_error("'messages' list is empty");
+    }
+
+    Example unpacked;
+    bool has_assistant = false;
+
+    for (std::size_t i = 0; i < messages.size(); ++i) {
+        const json &message = messages[i];
+        check_message_(message, i);
+
+        int tokens = TOKENS_PER_MESSAGE;
+
+        if (message.contains("content")) {
+            tokens += count_content_tokens_(message["content"]);
+        }
+
+        if (message.contains("name") and message["name"].is_string()) {
+            tokens += TOKENS_PER_NAME + utils::estimate_token_count(message["name"].get_ref<const std::string &>());
+        }
+
+        if (message["role"] == "assistant") {
+            has_assistant = true;
+            unpacked.assistant_tokens += tokens;
+        }
+
+        unpacked.tokens += tokens;
+    }
+
+    if (not has_assistant) {
+        throw std::runtime_error("Example has no assistant message");
+    }
+
+    unpacked.num_messages = messages.size();
+    return unpacked;
+}
+
+#endif
+
+bool is_blank_(const std::string_view line)
+{
+    return line.find_first_not_of(" \t\r") == std::string_view::npos;
+}
+
+// Line numbers in a chunk's report are relative to the start of the chunk
+struct ChunkReport {
+    DatasetReport report;
+    std::vector<int> example_tokens;
+};
+
+void validate_chunk_(std::string_view chunk, const DatasetOptions &options, ChunkReport &chunk_report)
+{
+    DatasetReport &report = chunk_report.report;
+
+    while (not chunk.empty()) {
+        const std::size_t newline = chunk.find('\n');
+        const std::string_view line = chunk.substr(0, newline);
+        chunk.remove_prefix(newline == std::string_view::npos ? chunk.size() : newline + 1);
+
+        report.num_lines++;
+
+        try {
+            if (is_blank_(line)) {
+                throw std::runtime_error("Line is empty");
+            }
+
+            const Example example = unpack_example_(line);
+
+            report.num_examples++;
+            report.num_messages += example.num_messages;
+            report.assistant_tokens += example.assistant_tokens;
+            report.tokens_per_epoch += std::min(example.tokens, options.max_tokens_per_example);
+
+            if (example.tokens > options.max_tokens_per_example) {
+                report.num_truncated++;
+            }
+
+            chunk_report.example_tokens.push_back(example.tokens);
+        } catch (const std::runtime_error &e) {
+            report.num_errors++;
+
+            if (report.errors.size() < options.max_errors) {
+                report.errors.push_back({ report.num_lines, e.what() });
+            }
+        }
+    }
+}
+
+// Statistics -----------------------------------------------------------------------------------------------
+
+// Nearest rank, i.e. the smallest value that at least `percentile` percent of values are less than or equal to
+int get_percentile_(std::vector<int> &values, const int percentile)
+{
+    const auto nth = values.begin() + (values.size() * percentile + 99) / 100 - 1;
+    std::nth_element(values.begin(), nth, values.end());
+    return *nth;
+}
+
+TokenDistribution get_distribution_(std::vector<int> &values)
+{
+    TokenDistribution distribution;
+
+    if (values.empty()) {
+        return distribution;
+    }
+
+    const auto [min, max] = std::minmax_element(values.begin(), values.end());
+    distribution.min = *min;
+    distribution.max = *max;
+    distribution.mean = static_cast<double>(std::accumulate(values.begin(), values.end(), std::uint64_t(0))) / values.size();
+    distribution.p50 = get_percentile_(values, 50);
+    distribution.p90 = get_percentile_(values, 90);
+    distribution.p99 = get_percentile_(values, 99);
+    return distribution;
+}
+
+int get_default_epochs_(const std::size_t num_examples)
+{
+    if (num_examples == 0) {
+        return 0;
+    }
+
+    if (num_examples * TARGET_EPOCHS < MIN_TARGET_EXAMPLES) {
+        return std::min<int>(MAX_DEFAULT_EPOCHS, MIN_TARGET_EXAMPLES / num_examples);
+    }
+
+    if (num_examples * TARGET_EPOCHS > MAX_TARGET_EXAMPLES) {
+        return std::max<int>(1, MAX_TARGET_EXAMPLES / num_examples);
+    }
+
+    return TARGET_EPOCHS;
+}
+
+} // namespace
+
+DatasetReport validate_fine_tuning_file(const std::string &filename, const DatasetOptions &options)
+{
+    const retrieval::MappedFile file(filename);
+
+    const std::size_t max_chunks = std::max<std::size_t>(1, file.size() / MIN_CHUNK_SIZE);
+    const std::size_t num_chunks = std::min<std::size_t>(max_chunks, std::max(options.jobs, 1) * CHUNKS_PER_JOB);
+
+    const std::vector<std::string_view> chunks = split_at_lines_(file.view(), num_chunks);
+    std::vector<ChunkReport> chunk_reports(chunks.size());
+
+    parallel::for_each_index(chunks.size(), options.jobs, [&](const std::size_t i) {
+        validate_chunk_(chunks[i], options, chunk_reports[i]);
+    });
+
+    DatasetReport report;
+    report.bytes = file.size();
+
+    std::vector<int> example_tokens;
+    example_tokens.reserve(std::accumulate(chunk_reports.begin(), chunk_reports.end(), std::size_t(0), [](const std::size_t sum, const ChunkReport &chunk) {
+        return sum + chunk.example_tokens.size();
+    }));
+
+    for (const auto &[chunk, tokens]: chunk_reports) {
+        for (const auto &error: chunk.errors) {
+            if (report.errors.size() < options.max_errors) {
+                report.errors.push_back({ report.num_lines + error.line, error.message });
+            }
+        }
+
+        report.num_lines += chunk.num_lines;
+        report.num_examples += chunk.num_examples;
+        report.num_messages += chunk.num_messages;
+        report.num_errors += chunk.num_errors;
+        report.num_truncated += chunk.num_truncated;
+        report.assistant_tokens += chunk.assistant_tokens;
+        report.tokens_per_epoch += chunk.tokens_per_epoch;
+
+        example_tokens.insert(example_tokens.end(), tokens.begin(), tokens.end());
+    }
+
+    report.tokens = get_distribution_(example_tokens);
+    report.default_epochs = get_default_epochs_(report.num_examples);
+    return report;
+}
+
+} // namespace serialization
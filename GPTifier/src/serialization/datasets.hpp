@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace serialization {
+
+struct DatasetOptions {
+    int jobs = 1;
+
+    // Errors past this many are counted but not kept
+    std::size_t max_errors = 20;
+
+    // OpenAI truncates longer examples and only bills for what is left
+    int max_tokens_per_example = 65536;
+};
+
+struct DatasetError {
+    std::size_t line = 0;
+    std::string message;
+};
+
+struct TokenDistribution {
+    int min = 0;
+    int p50 = 0;
+    int p90 = 0;
+    int p99 = 0;
+    int max = 0;
+    double mean = 0.0;
+};
+
+struct DatasetReport {
+    std::size_t bytes = 0;
+    std::size_t num_lines = 0;
+    std::size_t num_examples = 0;
+    std::size_t num_messages = 0;
+    std::size_t num_errors = 0;
+    std::size_t num_truncated = 0;
+    std::uint64_t assistant_tokens = 0;
+    std::uint64_t tokens_per_epoch = 0;
+    int default_epochs = 0;
+    std::vector<DatasetError> errors;
+    TokenDistribution tokens;
+};
+
+// Validate a chat formatted fine-tuning file and gather statistics about it in a single pass. The file is
+// memory mapped and split at line boundaries so that up to `options.jobs` threads can work through it at
+// once. Token counts are estimates, not the tokenizer's exact counts
+DatasetReport validate_fine_tuning_file(const std::string &filename, const DatasetOptions &options);
+
+} // namespace serialization
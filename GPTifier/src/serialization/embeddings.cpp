@@ -4,6 +4,7 @@
 #include "api_openai_user.hpp"
 #include "ser_utils.hpp"
 
+#include <cmath>
 #include <fmt/core.h>
 #include <json.hpp>
 #include <stdexcept>
@@ -12,7 +13,158 @@ namespace serialization {
 
 namespace {
 
-Embedding unpack_openai_embedding_(const std::string &response, const std::string &input)
+nlohmann::json pack_openai_request_(const std::string &model, const nlohmann::json &input, const int dimensions)
+{
+    nlohmann::json data = { { "model", model }, { "input", input } };
+
+    if (dimensions > 0) {
+        data["dimensions"] = dimensions;
+    }
+
+    return data;
+}
+
+void truncate_embedding_(std::vector<float> &embedding, const int dimensions)
+{
+    if (dimensions < 1) {
+        return;
+    }
+
+    if (embedding.size() < static_cast<std::size_t>(dimensions)) {
+        throw std::runtime_error(fmt::format(
+            "Cannot shorten embedding to {} dimensions since the model only returns {}", dimensions, embedding.size()));
+    }
+
+    embedding.resize(dimensions);
+
+    // The leading dimensions alone are not unit length anymore
+    double norm = 0.0;
+
+    for (const float value: embedding) {
+        norm += value * value;
+    }
+
+    if (norm > 0.0) {
+        const float scale = 1.0 / std::sqrt(norm);
+
+        for (float &value: embedding) {
+            value *= scale;
+        }
+    }
+}
+
+} // namespace
+
+#ifdef USE_SIMDJSON
+
+namespace {
+
+std::vector<float> read_embedding_(simdjson::ondemand::array values)
+{
+    std::vector<float> embedding;
+
+    for (const double value: values) {
+        embedding.push_back(value);
+    }
+
+    return embedding;
+}
+
+} // namespace
+
+Embedding unpack_openai_embedding(const std::string &response, const std::string &input)
+{
+    Embedding embedding;
+
+    try {
+        const simdjson::padded_string padded(response);
+        simdjson::ondemand::document json = iterate_json(padded);
+
+        embedding.embedding = read_embedding_(json["data"].at(0)["embedding"]);
+        embedding.model = std::string_view(json["model"]);
+    } catch (const simdjson::simdjson_error &e) {
+        throw_on_simdjson_error(e);
+    }
+
+    embedding.input = input;
+    embedding.source = "OpenAI";
+    return embedding;
+}
+
+Embedding unpack_ollama_embedding(const std::string &response, const std::string &input)
+{
+    Embedding embedding;
+
+    try {
+        const simdjson::padded_string padded(response);
+        simdjson::ondemand::document json = iterate_json(padded);
+
+        embedding.model = std::string_view(json["model"]);
+        embedding.embedding = read_embedding_(json["embeddings"].at(0));
+    } catch (const simdjson::simdjson_error &e) {
+        throw_on_simdjson_error(e);
+    }
+
+    embedding.input = input;
+    embedding.source = "Ollama";
+    return embedding;
+}
+
+Embeddings unpack_openai_embeddings(const std::string &response, const std::size_t num_inputs)
+{
+    Embeddings embeddings;
+
+    try {
+        const simdjson::padded_string padded(response);
+        simdjson::ondemand::document json = iterate_json(padded);
+
+        embeddings.embeddings.resize(num_inputs);
+
+        // OpenAI does not guarantee that the data array is in input order
+        for (simdjson::ondemand::object entry: json["data"]) {
+            const std::size_t index = std::uint64_t(entry["index"]);
+            embeddings.embeddings.at(index) = read_embedding_(entry["embedding"]);
+        }
+
+        embeddings.model = std::string_view(json["model"]);
+    } catch (const simdjson::simdjson_error &e) {
+        throw_on_simdjson_error(e);
+    } catch (const std::out_of_range &e) {
+        throw std::runtime_error(fmt::format("Failed to unpack response: {}", e.what()));
+    }
+
+    embeddings.source = "OpenAI";
+    return embeddings;
+}
+
+Embeddings unpack_ollama_embeddings(const std::string &response, const std::size_t num_inputs)
+{
+    Embeddings embeddings;
+
+    try {
+        const simdjson::padded_string padded(response);
+        simdjson::ondemand::document json = iterate_json(padded);
+
+        embeddings.model = std::string_view(json["model"]);
+
+        for (simdjson::ondemand::array values: json["embeddings"]) {
+            embeddings.embeddings.push_back(read_embedding_(values));
+        }
+    } catch (const simdjson::simdjson_error &e) {
+        throw_on_simdjson_error(e);
+    }
+
+    if (embeddings.embeddings.size() != num_inputs) {
+        throw std::runtime_error("Failed to unpack response: Number of embeddings does not match number of inputs");
+    }
+
+    embeddings.source = "Ollama";
+    return embeddings;
+}
+
+#else
+
+Embedding unpack_openai_embedding(const std::string &response, const std::string &input)
 {
     const nlohmann::json json = parse_json(response);
     Embedding embedding;
@@ -29,7 +181,7 @@ Embedding unpack_openai_embedding_(const std::string &response, const std::strin
     return embedding;
 }
 
-Embedding unpack_ollama_embedding_(const std::string &response, const std::string &input)
+Embedding unpack_ollama_embedding(const std::string &response, const std::string &input)
 {
     const nlohmann::json json = parse_json(response);
     Embedding embedding;
@@ -46,21 +198,66 @@ Embedding unpack_ollama_embedding_(const std::string &response, const std::strin
     return embedding;
 }
 
-} // namespace
+Embeddings unpack_openai_embeddings(const std::string &response, const std::size_t num_inputs)
+{
+    const nlohmann::json json = parse_json(response);
+    Embeddings embeddings;
+
+    try {
+        embeddings.embeddings.resize(num_inputs);
+
+        // OpenAI does not guarantee that the data array is in input order
+        for (const auto &entry: json["data"]) {
+            const std::size_t index = entry["index"];
+            embeddings.embeddings.at(index) = entry["embedding"].template get<std::vector<float>>();
+        }
+
+        embeddings.model = json["model"];
+    } catch (const nlohmann::json::exception &e) {
+        throw std::runtime_error(fmt::format("Failed to unpack response: {}", e.what()));
+    } catch (const std::out_of_range &e) {
+        throw std::runtime_error(fmt::format("Failed to unpack response: {}", e.what()));
+    }
+
+    embeddings.source = "OpenAI";
+    return embeddings;
+}
 
-Embedding create_openai_embedding(const std::string &model, const std::string &input)
+Embeddings unpack_ollama_embeddings(const std::string &response, const std::size_t num_inputs)
 {
-    const nlohmann::json data = { { "model", model }, { "input", input } };
+    const nlohmann::json json = parse_json(response);
+    Embeddings embeddings;
+
+    try {
+        embeddings.embeddings = json["embeddings"].template get<std::vector<std::vector<float>>>();
+        embeddings.model = json["model"];
+    } catch (const nlohmann::json::exception &e) {
+        throw std::runtime_error(fmt::format("Failed to unpack response: {}", e.what()));
+    }
+
+    if (embeddings.embeddings.size() != num_inputs) {
+        throw std::runtime_error("Failed to unpack response: Number of embeddings does not match number of inputs");
+    }
+
+    embeddings.source = "Ollama";
+    return embeddings;
+}
+
+#endif
+
+Embedding create_openai_embedding(const std::string &model, const std::string &input, const int dimensions)
+{
+    const nlohmann::json data = pack_openai_request_(model, input, dimensions);
     const auto result = networking::create_openai_embedding(data.dump());
 
     if (not result) {
         throw_on_openai_error_response(result.error().response);
     }
 
-    return unpack_openai_embedding_(result->response, input);
+    return unpack_openai_embedding(result->response, input);
 }
 
-Embedding create_ollama_embedding(const std::string &model, const std::string &input)
+Embedding create_ollama_embedding(const std::string &model, const std::string &input, const int dimensions)
 {
     const nlohmann::json data = { { "model", model }, { "input", input } };
     const auto result = networking::create_ollama_embedding(data.dump());
@@ -69,7 +266,40 @@ Embedding create_ollama_embedding(const std::string &model, const std::string &i
         throw_on_ollama_error_response(result.error().response);
     }
 
-    return unpack_ollama_embedding_(result->response, input);
+    Embedding embedding = unpack_ollama_embedding(result->response, input);
+    truncate_embedding_(embedding.embedding, dimensions);
+
+    return embedding;
+}
+
+Embeddings create_openai_embeddings(const std::string &model, const std::vector<std::string> &inputs, const int dimensions)
+{
+    const nlohmann::json data = pack_openai_request_(model, inputs, dimensions);
+    const auto result = networking::create_openai_embedding(data.dump());
+
+    if (not result) {
+        throw_on_openai_error_response(result.error().response);
+    }
+
+    return unpack_openai_embeddings(result->response, inputs.size());
+}
+
+Embeddings create_ollama_embeddings(const std::string &model, const std::vector<std::string> &inputs, const int dimensions)
+{
+    const nlohmann::json data = { { "model", model }, { "input", inputs } };
+    const auto result = networking::create_ollama_embedding(data.dump());
+
+    if (not result) {
+        throw_on_ollama_error_response(result.error().response);
+    }
+
+    Embeddings embeddings = unpack_ollama_embeddings(result->response, inputs.size());
+
+    for (auto &embedding: embeddings.embeddings) {
+        truncate_embedding_(embedding, dimensions);
+    }
+
+    return embeddings;
 }
 
 } // namespace serialization
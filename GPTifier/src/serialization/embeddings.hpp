@@ -12,7 +12,24 @@ struct Embedding {
     std::vector<float> embedding;
 };
 
-Embedding create_openai_embedding(const std::string &model, const std::string &input);
-Embedding create_ollama_embedding(const std::string &model, const std::string &input);
+struct Embeddings {
+    std::string model;
+    std::string source;
+    std::vector<std::vector<float>> embeddings;
+};
+
+// A positive number of dimensions requests shortened embeddings. OpenAI shortens them server side while
+// Ollama embeddings are truncated and renormalized locally, which only preserves meaning for models trained
+// with Matryoshka representation learning (i.e. nomic-embed-text)
+Embedding create_openai_embedding(const std::string &model, const std::string &input, int dimensions);
+Embedding create_ollama_embedding(const std::string &model, const std::string &input, int dimensions);
+Embeddings create_openai_embeddings(const std::string &model, const std::vector<std::string> &inputs, int dimensions);
+Embeddings create_ollama_embeddings(const std::string &model, const std::vector<std::string> &inputs, int dimensions);
+
+// Parse raw API responses. The functions above call these after the request completes
+Embedding unpack_openai_embedding(const std::string &response, const std::string &input);
+Embedding unpack_ollama_embedding(const std::string &response, const std::string &input);
+Embeddings unpack_openai_embeddings(const std::string &response, std::size_t num_inputs);
+Embeddings unpack_ollama_embeddings(const std::string &response, std::size_t num_inputs);
 
 } // namespace serialization
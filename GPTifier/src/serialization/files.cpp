@@ -1,11 +1,22 @@
 #include "files.hpp"
 
 #include "api_openai_user.hpp"
+#include "list_stream.hpp"
+#include "parallel.hpp"
 #include "ser_utils.hpp"
 
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
 #include <fmt/core.h>
+#include <fstream>
 #include <json.hpp>
+#include <mutex>
+#include <optional>
 #include <stdexcept>
+#include <system_error>
+#include <thread>
+#include <unordered_set>
 
 namespace serialization {
 
@@ -15,6 +26,7 @@ File unpack_file_object_(const nlohmann::json &entry)
 {
     File file_obj;
     file_obj.created_at = entry["created_at"];
+    file_obj.bytes = entry.value("bytes", std::size_t(0));
     file_obj.created_at_dt_str = datetime_from_unix_timestamp(entry["created_at"]);
     file_obj.filename = entry["filename"];
     file_obj.id = entry["id"];
@@ -22,35 +34,419 @@ File unpack_file_object_(const nlohmann::json &entry)
     return file_obj;
 }
 
-Files unpack_files_response_(const std::string &response)
+void fetch_file_pages_(const FilesQuery &query, parallel::Channel<File> &channel)
+{
+    std::string after;
+    bool has_more = true;
+    bool past_range = false;
+
+    while (has_more and not past_range) {
+        const std::string cursor = after;
+
+        ListStream stream([&](const nlohmann::json &entry) {
+            File file = unpack_file_object_(entry);
+            after = file.id;
+
+            if (past_range) {
+                return;
+            }
+
+            // Files arrive oldest first, so nothing after this one can match either
+            if (query.created_before and file.created_at >= query.created_before.value()) {
+                past_range = true;
+                return;
+            }
+
+            if (query.created_after and file.created_at < query.created_after.value()) {
+                return;
+            }
+
+            if (query.keep_raw_json) {
+                file.raw_json = entry.dump();
+            }
+
+            if (not channel.push(std::move(file))) {
+                throw std::runtime_error("Listing files was cancelled");
+            }
+        });
+
+        const auto result = networking::get_uploaded_files(cursor, query.page_size, query.purpose, [&stream](const std::string_view chunk) {
+            stream.feed(chunk);
+        });
+
+        if (not result) {
+            throw_on_openai_error_response(result.error().response);
+        }
+
+        stream.finish();
+
+        // Guard against looping forever on an empty page that claims there is more
+        has_more = stream.has_more() and after != cursor;
+    }
+}
+
+using OnEntry = std::function<void(const nlohmann::json &entry)>;
+
+bool is_stale_cursor_(const networking::Err &error, const std::string &cursor)
+{
+    if (error.code == 404) {
+        return true;
+    }
+
+    // I.e. "No such File object: file-abc123" for an 'after' parameter naming a deleted file
+    return error.code == 400 and error.response.find(cursor) != std::string::npos;
+}
+
+// Returns false without listing anything if the last file seen can no longer be continued from
+bool fetch_files_after_(nlohmann::json &data, const int page_size, const OnEntry &on_entry)
+{
+    // Files are listed oldest first, so anything uploaded since the last sync comes after the last file seen
+    std::string after = data.empty() ? "" : data.back()["id"].get<std::string>();
+    const std::string first_cursor = after;
+    bool has_more = true;
+
+    while (has_more) {
+        const std::string cursor = after;
+
+        ListStream stream([&](const nlohmann::json &entry) {
+            after = entry["id"];
+            data.push_back(entry);
+            on_entry(data.back());
+        });
+
+        const auto result = networking::get_uploaded_files(cursor, page_size, "", [&stream](const std::string_view chunk) {
+            stream.feed(chunk);
+        });
+
+        if (not result) {
+            if (not first_cursor.empty() and cursor == first_cursor and is_stale_cursor_(result.error(), cursor)) {
+                return false;
+            }
+
+            throw_on_openai_error_response(result.error().response);
+        }
+
+        stream.finish();
+        has_more = stream.has_more() and after != cursor;
+    }
+
+    return true;
+}
+
+// Sync the mirror, calling `on_entry` for every file it holds once synced, oldest first, as soon as each
+// file is known to be part of the result
+void sync_files_mirror_(Mirror &mirror, const int page_size, const OnEntry &on_entry)
+{
+    if (not mirror.data.empty() and not is_full_sync_due(mirror)) {
+        // Mirrored files are held back until the first page shows that the sync can continue from them
+        const std::size_t num_mirrored = mirror.data.size();
+        bool released = false;
+
+        const auto release = [&]() {
+            if (not released) {
+                released = true;
+
+                for (std::size_t i = 0; i < num_mirrored; ++i) {
+                    on_entry(mirror.data[i]);
+                }
+            }
+        };
+
+        const bool synced = fetch_files_after_(mirror.data, page_size, [&](const nlohmann::json &entry) {
+            release();
+            on_entry(entry);
+        });
+
+        if (synced) {
+            release();
+            return;
+        }
+
+        // I.e. the file to continue from was deleted elsewhere. Start over instead
+    }
+
+    mirror.data = nlohmann::json::array();
+    fetch_files_after_(mirror.data, page_size, on_entry);
+    mirror.full_synced_at = std::time(nullptr);
+}
+
+bool unpack_deleted_(const std::string &response)
 {
     const nlohmann::json json = parse_json(response);
 
-    Files files;
-    files.raw_response = response;
+    if (not json.contains("deleted")) {
+        throw std::runtime_error("Malformed response. Missing 'deleted' key");
+    }
 
+    return json["deleted"];
+}
+
+std::string get_error_message_(const std::string &response)
+{
     try {
-        for (const auto &entry: json["data"]) {
-            files.files.push_back(unpack_file_object_(entry));
+        throw_on_openai_error_response(response);
+    } catch (const std::runtime_error &e) {
+        return e.what();
+    }
+
+    return response;
+}
+
+DeleteResult delete_file_with_retries_(const std::string &file_id, const int retries)
+{
+    DeleteResult result;
+    result.id = file_id;
+
+    try {
+        const auto response = perform_with_retries([&file_id]() {
+            return networking::delete_file(file_id);
+        }, retries, result.attempts);
+
+        if (response) {
+            result.deleted = unpack_deleted_(response->response);
+        } else {
+            result.error = get_error_message_(response.error().response);
         }
+    } catch (const std::runtime_error &e) {
+        result.error = e.what();
+    }
+
+    return result;
+}
+
+File get_file_with_retries_(const std::string &file_id, const int retries, int &attempts)
+{
+    const auto response = perform_with_retries([&file_id]() {
+        return networking::get_uploaded_file(file_id);
+    }, retries, attempts);
+
+    if (not response) {
+        throw_on_openai_error_response(response.error().response);
+    }
+
+    try {
+        return unpack_file_object_(parse_json(response->response));
     } catch (const nlohmann::json::exception &e) {
         throw std::runtime_error(fmt::format("Failed to unpack response: {}", e.what()));
     }
+}
 
-    return files;
+std::filesystem::path get_download_path_(const File &file, const std::string &output_dir, std::unordered_set<std::string> &taken)
+{
+    // Never let the name of an uploaded file point outside of the output directory
+    std::filesystem::path name = std::filesystem::path(file.filename).filename();
+
+    if (name.empty() or name == "." or name == "..") {
+        name = file.id;
+    }
+
+    // Files uploaded under the same name (i.e. several jobs' step_metrics.csv) must not overwrite each other,
+    // so all but the first are told apart by their ID
+    if (not taken.insert(name.string()).second) {
+        name = fmt::format("{}.{}{}", name.stem().string(), file.id, name.extension().string());
+        taken.insert(name.string());
+    }
+
+    return std::filesystem::path(output_dir) / name;
+}
+
+std::size_t get_partial_size_(const std::filesystem::path &path)
+{
+    std::error_code ec;
+    const std::uintmax_t size = std::filesystem::file_size(path, ec);
+    return ec ? 0 : size;
+}
+
+DownloadResult download_file_with_retries_(const File &file, DownloadResult result, const DownloadOptions &options)
+{
+    namespace fs = std::filesystem;
+
+    const auto start = std::chrono::steady_clock::now();
+
+    try {
+        const fs::path path = result.path;
+
+        // Keyed by ID so that a partial download is only ever resumed by the same file
+        const fs::path partial = fmt::format("{}.{}.part", path.string(), file.id);
+
+        result.resumed_from = get_partial_size_(partial);
+
+        // Left over from a since replaced file
+        if (file.bytes > 0 and result.resumed_from > file.bytes) {
+            fs::remove(partial);
+            result.resumed_from = 0;
+        }
+
+        if (file.bytes == 0 or result.resumed_from < file.bytes) {
+            // Each attempt picks up from however much made it to disk, including attempts that dropped midway
+            const auto attempt = [&]() {
+                std::ofstream out(partial, std::ios::binary | std::ios::app);
+
+                if (not out.is_open()) {
+                    throw std::runtime_error(fmt::format("Unable to open '{}'", partial.string()));
+                }
+
+                return networking::download_file(file.id, get_partial_size_(partial), [&out, &result](const std::string_view chunk) {
+                    out.write(chunk.data(), chunk.size());
+
+                    if (not out) {
+                        throw std::runtime_error("Failed to write downloaded data to disk");
+                    }
+
+                    result.bytes_downloaded += chunk.size();
+                });
+            };
+
+            int attempts = 0;
+            auto response = perform_with_retries(attempt, options.retries, attempts);
+            result.attempts += attempts;
+
+            // The range could not be served, so start over from the beginning
+            if (not response and response.error().code == 416 and get_partial_size_(partial) > 0) {
+                fs::remove(partial);
+                response = perform_with_retries(attempt, options.retries, attempts);
+                result.attempts += attempts;
+            }
+
+            if (not response) {
+                result.error = get_error_message_(response.error().response);
+                return result;
+            }
+        }
+
+        const std::size_t size = get_partial_size_(partial);
+
+        if (file.bytes > 0 and size != file.bytes) {
+            result.error = fmt::format("Expected {} bytes but got {}. Run again to resume", file.bytes, size);
+            return result;
+        }
+
+        fs::rename(partial, path);
+    } catch (const std::exception &e) {
+        result.error = e.what();
+    }
+
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+// Call func(i) for every i in [0, count) on up to `jobs` threads. Results are parked until all results
+// before them are in so that `on_result` sees them in order
+template<typename Result, typename Func>
+void for_each_in_order_(const std::size_t count, const int jobs, Func &&func, const std::function<void(const Result &)> &on_result)
+{
+    std::vector<std::optional<Result>> results(count);
+    std::size_t next_to_report = 0;
+    std::mutex mutex_results;
+
+    parallel::for_each_index(count, jobs, [&](const std::size_t i) {
+        Result result = func(i);
+
+        const std::lock_guard<std::mutex> lock(mutex_results);
+        results[i] = std::move(result);
+
+        while (next_to_report < results.size() and results[next_to_report]) {
+            on_result(results[next_to_report].value());
+            results[next_to_report].reset();
+            ++next_to_report;
+        }
+    });
 }
 
 } // namespace
 
-Files get_files()
+Files unpack_files_response(const std::string &response)
 {
-    const auto result = networking::get_uploaded_files();
+    Files files;
 
-    if (not result) {
-        throw_on_openai_error_response(result.error().response);
+    ListStream stream([&files](const nlohmann::json &entry) {
+        files.files.push_back(unpack_file_object_(entry));
+    });
+
+    stream.feed(response);
+    stream.finish();
+
+    return files;
+}
+
+void list_files(const FilesQuery &query, const std::function<void(const File &)> &on_file)
+{
+    // Enough room for a full page to arrive while the previous page is still being handled
+    parallel::Channel<File> channel(2 * query.page_size);
+
+    std::thread producer([&query, &channel]() {
+        try {
+            fetch_file_pages_(query, channel);
+            channel.close();
+        } catch (...) {
+            channel.close(std::current_exception());
+        }
+    });
+
+    try {
+        while (const auto file = channel.pop()) {
+            on_file(file.value());
+        }
+    } catch (...) {
+        channel.cancel();
+        producer.join();
+        throw;
     }
 
-    return unpack_files_response_(result->response);
+    producer.join();
+}
+
+void list_mirrored_files(const FilesQuery &query, const MirrorOptions &options, const std::function<void(const File &)> &on_file)
+{
+    const auto on_entry = [&query, &on_file](const nlohmann::json &entry) {
+        File file;
+
+        try {
+            file = unpack_file_object_(entry);
+        } catch (const nlohmann::json::exception &e) {
+            throw std::runtime_error(fmt::format("Failed to unpack mirrored file: {}", e.what()));
+        }
+
+        if (query.created_after and file.created_at < query.created_after.value()) {
+            return;
+        }
+
+        if (query.created_before and file.created_at >= query.created_before.value()) {
+            return;
+        }
+
+        if (not query.purpose.empty() and file.purpose != query.purpose) {
+            return;
+        }
+
+        if (query.keep_raw_json) {
+            file.raw_json = entry.dump();
+        }
+
+        on_file(file);
+    };
+
+    // A cold mirror or --sync may mean listing the whole account, so files are handed out page by page as
+    // the sync goes rather than once it is done
+    bool handed_out = false;
+
+    const Mirror mirror = get_mirror("files", options, [&](Mirror &mirror) {
+        if (is_syncing_in_background()) {
+            sync_files_mirror_(mirror, query.page_size, [](const nlohmann::json &) {});
+            return;
+        }
+
+        sync_files_mirror_(mirror, query.page_size, on_entry);
+        handed_out = true;
+    });
+
+    if (handed_out) {
+        return;
+    }
+
+    for (const auto &entry: mirror.data) {
+        on_entry(entry);
+    }
 }
 
 bool delete_file(const std::string &file_id)
@@ -60,31 +456,74 @@ bool delete_file(const std::string &file_id)
         throw_on_openai_error_response(result.error().response);
     }
 
-    const nlohmann::json json = parse_json(result->response);
+    return unpack_deleted_(result->response);
+}
 
-    if (not json.contains("deleted")) {
-        throw std::runtime_error("Malformed response. Missing 'deleted' key");
+void delete_files(const std::vector<std::string> &file_ids, const DeleteOptions &options, const std::function<void(const DeleteResult &)> &on_result)
+{
+    std::unordered_set<std::string> deleted;
+
+    for_each_in_order_<DeleteResult>(file_ids.size(), options.concurrency, [&](const std::size_t i) {
+        return delete_file_with_retries_(file_ids[i], options.retries);
+    }, [&](const DeleteResult &result) {
+        if (result.deleted) {
+            deleted.insert(result.id);
+        }
+
+        on_result(result);
+    });
+
+    if (deleted.empty()) {
+        return;
     }
 
-    return json["deleted"];
+    edit_mirror("files", [&deleted](Mirror &mirror) {
+        nlohmann::json kept = nlohmann::json::array();
+
+        for (auto &entry: mirror.data) {
+            if (not deleted.contains(entry.value("id", ""))) {
+                kept.push_back(std::move(entry));
+            }
+        }
+
+        mirror.data = std::move(kept);
+    });
 }
 
-std::string upload_file(const std::string &filename)
+void download_files(const std::vector<std::string> &file_ids, const DownloadOptions &options, const std::function<void(const DownloadResult &)> &on_result)
 {
-    const std::string purpose = "fine-tune";
+    std::error_code ec;
+    std::filesystem::create_directories(options.output_dir, ec);
 
-    const auto result = networking::upload_file(filename, purpose);
-    if (not result) {
-        throw_on_openai_error_response(result.error().response);
-    }
+    // Look up all files before downloading any so that files sharing a name can be given distinct paths
+    std::vector<std::optional<File>> files(file_ids.size());
+    std::vector<DownloadResult> results(file_ids.size());
+
+    parallel::for_each_index(file_ids.size(), options.concurrency, [&](const std::size_t i) {
+        results[i].id = file_ids[i];
 
-    const nlohmann::json json = parse_json(result->response);
+        try {
+            files[i] = get_file_with_retries_(file_ids[i], options.retries, results[i].attempts);
+        } catch (const std::exception &e) {
+            results[i].error = e.what();
+        }
+    });
+
+    std::unordered_set<std::string> taken;
 
-    if (not json.contains("id")) {
-        throw std::runtime_error("Malformed response. Missing 'id' key");
+    for (std::size_t i = 0; i < file_ids.size(); ++i) {
+        if (files[i]) {
+            results[i].path = get_download_path_(files[i].value(), options.output_dir, taken).string();
+        }
     }
 
-    return json["id"];
+    for_each_in_order_<DownloadResult>(file_ids.size(), options.concurrency, [&](const std::size_t i) {
+        if (not files[i]) {
+            return results[i];
+        }
+
+        return download_file_with_retries_(files[i].value(), results[i], options);
+    }, on_result);
 }
 
 } // namespace serialization
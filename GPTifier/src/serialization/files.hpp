@@ -1,5 +1,11 @@
 #pragma once
 
+#include "mirror.hpp"
+
+#include <cstddef>
+#include <ctime>
+#include <functional>
+#include <optional>
 #include <string>
 #include <vector>
 
@@ -7,19 +13,78 @@ namespace serialization {
 
 struct File {
     int created_at = 0;
+    std::size_t bytes = 0;
     std::string created_at_dt_str;
     std::string filename;
     std::string id;
     std::string purpose;
+
+    // Only kept if requested
+    std::string raw_json;
 };
 
 struct Files {
-    std::string raw_response;
     std::vector<File> files;
 };
 
-Files get_files();
+struct FilesQuery {
+    bool keep_raw_json = false;
+    int page_size = 1000;
+    std::optional<std::time_t> created_after;
+    std::optional<std::time_t> created_before;
+    std::string purpose;
+};
+
+// Walk over all uploaded files, oldest first, calling `on_file` for each file created in
+// [created_after, created_before). Pages are fetched on a background thread so the next page is already
+// on its way while the current one is being handled
+void list_files(const FilesQuery &query, const std::function<void(const File &)> &on_file);
+
+// Like list_files, but answered from the local mirror of all uploaded files (see mirror.hpp). The mirror is
+// synced incrementally by listing only the files uploaded after the last file it holds. Files are passed to
+// `on_file` while a sync in the foreground is still fetching pages
+void list_mirrored_files(const FilesQuery &query, const MirrorOptions &options, const std::function<void(const File &)> &on_file);
 bool delete_file(const std::string &file_id);
-std::string upload_file(const std::string &filename);
+
+struct DeleteOptions {
+    int concurrency = 8;
+    int retries = 3;
+};
+
+struct DeleteResult {
+    bool deleted = false;
+    int attempts = 0;
+    std::string error;
+    std::string id;
+};
+
+// Delete files with up to `concurrency` requests in flight. Failures that may be transient (rate limits,
+// server errors and dropped connections) are retried with exponential backoff. `on_result` is called once
+// per file, in the order of `file_ids`, as soon as that file and all files before it are done
+void delete_files(const std::vector<std::string> &file_ids, const DeleteOptions &options, const std::function<void(const DeleteResult &)> &on_result);
+
+struct DownloadOptions {
+    int concurrency = 4;
+    int retries = 3;
+    std::string output_dir = ".";
+};
+
+struct DownloadResult {
+    double seconds = 0.0;
+    int attempts = 0;
+    std::size_t bytes_downloaded = 0;
+    std::size_t resumed_from = 0;
+    std::string error;
+    std::string id;
+    std::string path;
+};
+
+// Download the contents of files into `output_dir`, each named after the uploaded file. Later files sharing
+// a name with an earlier one get their ID added to it. Contents are streamed straight to a "<name>.<ID>.part"
+// file next to the destination which is renamed once complete. A ".part" file left behind by an earlier
+// attempt is resumed from where it stopped using a range request, as are attempts that fail midway.
+// `on_result` is called once per file, in the order of `file_ids`
+void download_files(const std::vector<std::string> &file_ids, const DownloadOptions &options, const std::function<void(const DownloadResult &)> &on_result);
+Files unpack_files_response(const std::string &response);
 
 } // namespace serialization
@@ -1,12 +1,15 @@
 #include "fine_tuning.hpp"
 
 #include "api_openai_user.hpp"
+#include "list_stream.hpp"
 #include "ser_utils.hpp"
 
 #include <algorithm>
+#include <ctime>
 #include <fmt/core.h>
 #include <json.hpp>
 #include <stdexcept>
+#include <unordered_set>
 
 namespace serialization {
 
@@ -32,40 +35,121 @@ FineTuningJob unpack_fine_tuning_job_(const nlohmann::json &entry)
     return ft_job_obj;
 }
 
-FineTuningJobs unpack_fine_tuning_jobs_(const std::string &response)
+const int MIN_JOBS_TO_LIST = 1;
+const int MAX_JOBS_TO_LIST = 100;
+
+bool is_finished_(const nlohmann::json &job)
 {
-    const nlohmann::json json = parse_json(response);
+    const std::string status = job.value("status", "");
+    return status == "succeeded" or status == "failed" or status == "cancelled";
+}
 
-    FineTuningJobs fine_tuning_jobs;
-    fine_tuning_jobs.raw_response = response;
+void sync_fine_tuning_jobs_mirror_(Mirror &mirror)
+{
+    const bool full = is_full_sync_due(mirror);
 
-    try {
-        for (const auto &entry: json["data"]) {
-            fine_tuning_jobs.jobs.push_back(unpack_fine_tuning_job_(entry));
+    // Jobs that were still running at the last sync may have changed since, so they all have to be seen again
+    std::unordered_set<std::string> finished;
+    std::unordered_set<std::string> running;
+
+    if (not full) {
+        for (const auto &job: mirror.data) {
+            (is_finished_(job) ? finished : running).insert(job.value("id", ""));
         }
-    } catch (const nlohmann::json::exception &e) {
-        throw std::runtime_error(fmt::format("Failed to unpack response: {}", e.what()));
     }
 
-    return fine_tuning_jobs;
+    nlohmann::json data = nlohmann::json::array();
+    std::unordered_set<std::string> seen;
+    std::string after;
+    bool has_more = true;
+    bool caught_up = false;
+
+    // Jobs are listed newest first
+    while (has_more and not caught_up) {
+        const std::string cursor = after;
+
+        ListStream stream([&](const nlohmann::json &entry) {
+            after = entry["id"];
+            running.erase(after);
+
+            if (finished.contains(after) and running.empty()) {
+                caught_up = true;
+            }
+
+            seen.insert(after);
+            data.push_back(entry);
+        });
+
+        const auto result = networking::get_fine_tuning_jobs(cursor, MAX_JOBS_TO_LIST, [&stream](const std::string_view chunk) {
+            stream.feed(chunk);
+        });
+
+        if (not result) {
+            throw_on_openai_error_response(result.error().response);
+        }
+
+        stream.finish();
+        has_more = stream.has_more() and after != cursor;
+    }
+
+    if (full) {
+        mirror.full_synced_at = std::time(nullptr);
+    } else {
+        // Everything older than where paging stopped is unchanged
+        for (auto &job: mirror.data) {
+            if (not seen.contains(job.value("id", ""))) {
+                data.push_back(std::move(job));
+            }
+        }
+    }
+
+    mirror.data = std::move(data);
 }
 
 } // namespace
 
-FineTuningJobs get_fine_tuning_jobs(const int limit_jobs_to_print)
+FineTuningJobs unpack_fine_tuning_jobs(const std::string &response)
 {
-    static int min_jobs_to_list = 1;
-    static int max_jobs_to_list = 100;
+    FineTuningJobs fine_tuning_jobs;
 
-    const int limit_clamped = std::clamp(limit_jobs_to_print, min_jobs_to_list, max_jobs_to_list);
+    ListStream stream([&fine_tuning_jobs](const nlohmann::json &entry) {
+        fine_tuning_jobs.jobs.push_back(unpack_fine_tuning_job_(entry));
+    });
 
-    const auto result = networking::get_fine_tuning_jobs(limit_clamped);
+    stream.feed(response);
+    stream.finish();
 
-    if (not result) {
-        throw_on_openai_error_response(result.error().response);
+    return fine_tuning_jobs;
+}
+
+FineTuningJobs get_mirrored_fine_tuning_jobs(const int limit_jobs_to_print, const MirrorOptions &options, const bool keep_raw_response)
+{
+    const int limit_clamped = std::clamp(limit_jobs_to_print, MIN_JOBS_TO_LIST, MAX_JOBS_TO_LIST);
+    const Mirror mirror = get_mirror("fine_tuning_jobs", options, sync_fine_tuning_jobs_mirror_);
+
+    FineTuningJobs fine_tuning_jobs;
+    nlohmann::json data = nlohmann::json::array();
+
+    for (const auto &entry: mirror.data) {
+        if (static_cast<int>(data.size()) == limit_clamped) {
+            break;
+        }
+
+        try {
+            fine_tuning_jobs.jobs.push_back(unpack_fine_tuning_job_(entry));
+        } catch (const nlohmann::json::exception &e) {
+            throw std::runtime_error(fmt::format("Failed to unpack mirrored fine-tuning job: {}", e.what()));
+        }
+
+        data.push_back(entry);
+    }
+
+    if (keep_raw_response) {
+        const bool has_more = data.size() < mirror.data.size();
+        fine_tuning_jobs.raw_response = nlohmann::json({ { "object", "list" }, { "data", data }, { "has_more", has_more } }).dump();
     }
 
-    return unpack_fine_tuning_jobs_(result->response);
+    return fine_tuning_jobs;
 }
 
 std::string create_fine_tuning_job(const std::string &model, const std::string &training_file)
@@ -83,6 +167,7 @@ std::string create_fine_tuning_job(const std::string &model, const std::string &
         throw std::runtime_error("Malformed response. Missing 'id' key");
     }
 
+    invalidate_mirror("fine_tuning_jobs");
     return json["id"];
 }
 
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "mirror.hpp"
+
 #include <string>
 #include <vector>
 
@@ -19,11 +21,15 @@ struct FineTuningJob {
 };
 
 struct FineTuningJobs {
+    // Only kept if requested
     std::string raw_response;
     std::vector<FineTuningJob> jobs;
 };
 
-FineTuningJobs get_fine_tuning_jobs(const int limit_jobs_to_print);
+// Get the newest fine tuning jobs from the local mirror (see mirror.hpp). Syncs page through the
+// newest jobs until they reach jobs that had already finished as of the last sync
+FineTuningJobs get_mirrored_fine_tuning_jobs(const int limit_jobs_to_print, const MirrorOptions &options, const bool keep_raw_response);
 std::string create_fine_tuning_job(const std::string &model, const std::string &training_file);
+FineTuningJobs unpack_fine_tuning_jobs(const std::string &response);
 
 } // namespace serialization
@@ -8,9 +8,37 @@
 
 namespace serialization {
 
-namespace {
+#ifdef USE_SIMDJSON
 
-Image unpack_image_response_(const std::string &response)
+Image unpack_image_response(const std::string &response)
+{
+    Image image_obj;
+
+    try {
+        const simdjson::padded_string padded(response);
+        simdjson::ondemand::document json = iterate_json(padded);
+
+        image_obj.created = std::int64_t(json["created"]);
+
+        // The image is by far the largest field and is copied straight out of the response without a DOM
+        simdjson::ondemand::object data = json["data"].at(0);
+        image_obj.b64_json = std::string_view(data["b64_json"]);
+
+        std::string_view revised_prompt;
+
+        if (data["revised_prompt"].get(revised_prompt) == simdjson::SUCCESS) {
+            image_obj.revised_prompt = std::string(revised_prompt);
+        }
+    } catch (const simdjson::simdjson_error &e) {
+        throw_on_simdjson_error(e);
+    }
+
+    return image_obj;
+}
+
+#else
+
+Image unpack_image_response(const std::string &response)
 {
     const nlohmann::json json = parse_json(response);
     Image image_obj;
@@ -29,7 +57,7 @@ Image unpack_image_response_(const std::string &response)
     return image_obj;
 }
 
-} // namespace
+#endif
 
 Image create_image(const std::string &model, const std::string &prompt, const std::string &quality, const std::string &style)
 {
@@ -48,7 +76,7 @@ Image create_image(const std::string &model, const std::string &prompt, const st
         throw_on_openai_error_response(result.error().response);
     }
 
-    return unpack_image_response_(result->response);
+    return unpack_image_response(result->response);
 }
 
 } // namespace serialization
@@ -13,4 +13,5 @@ struct Image {
 };
 
 Image create_image(const std::string &model, const std::string &prompt, const std::string &quality, const std::string &style);
+Image unpack_image_response(const std::string &response);
 } // namespace serialization
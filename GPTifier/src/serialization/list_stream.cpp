@@ -0,0 +1,182 @@
+#include "list_stream.hpp"
+
+#include <fmt/core.h>
+#include <stdexcept>
+#include <utility>
+
+namespace serialization {
+
+namespace {
+
+bool is_whitespace_(const std::string &text)
+{
+    return text.find_first_not_of(" \t\r\n") == std::string::npos;
+}
+
+} // namespace
+
+ListStream::ListStream(OnElement on_element) :
+    on_element_(std::move(on_element))
+{
+}
+
+void ListStream::emit_element_()
+{
+    if (is_whitespace_(this->element_)) {
+        this->element_.clear();
+        return;
+    }
+
+    nlohmann::json element;
+
+    try {
+        element = nlohmann::json::parse(this->element_);
+    } catch (const nlohmann::json::parse_error &e) {
+        throw std::runtime_error(fmt::format("Failed to parse response: {}", e.what()));
+    }
+
+    this->element_.clear();
+
+    try {
+        this->on_element_(element);
+    } catch (const nlohmann::json::exception &e) {
+        throw std::runtime_error(fmt::format("Failed to unpack response: {}", e.what()));
+    }
+}
+
+void ListStream::end_value_()
+{
+    // Only scalars outside of strings are captured, which is all that "has_more" can be
+    if (this->capturing_value_ and this->key_ == "has_more") {
+        this->has_more_ = this->value_.find("true") != std::string::npos;
+    }
+
+    this->capturing_value_ = false;
+}
+
+void ListStream::feed(const std::string_view chunk)
+{
+    // Brackets and commas only count outside of strings, so strings are tracked (with escapes) throughout.
+    // Depth 1 is the top level object and depth 2 is the inside of the "data" array. Bytes belonging to an
+    // element are copied over in runs rather than one at a time
+    std::size_t run_start = 0;
+
+    const auto flush_run = [&](const std::size_t run_end) {
+        if (this->in_data_) {
+            this->element_.append(chunk.substr(run_start, run_end - run_start));
+        }
+    };
+
+    for (std::size_t i = 0; i < chunk.size(); ++i) {
+        const char c = chunk[i];
+
+        if (this->in_string_) {
+            if (this->escaped_) {
+                this->escaped_ = false;
+            } else if (c == '\\') {
+                this->escaped_ = true;
+            } else if (c == '"') {
+                this->in_string_ = false;
+                this->capturing_key_ = false;
+            } else if (not this->capturing_key_) {
+                // Skip ahead to the next byte that could end the string
+                const std::size_t next = chunk.find_first_of("\\\"", i);
+                i = (next == std::string_view::npos ? chunk.size() : next) - 1;
+            } else {
+                this->key_ += c;
+            }
+
+            continue;
+        }
+
+        switch (c) {
+            case '"':
+                this->in_string_ = true;
+
+                if (not this->in_data_ and this->depth_ == 1 and this->expect_key_) {
+                    this->capturing_key_ = true;
+                    this->key_.clear();
+                }
+
+                this->capturing_value_ = false;
+                break;
+            case '{':
+            case '[':
+                if (this->depth_ == 0 and c == '[') {
+                    throw std::runtime_error("Failed to unpack response: Expected an object but got an array");
+                }
+
+                this->capturing_value_ = false;
+
+                if (this->depth_ == 1 and c == '[' and not this->expect_key_ and this->key_ == "data") {
+                    this->in_data_ = true;
+                    this->seen_data_ = true;
+                    run_start = i + 1;
+                }
+
+                this->depth_++;
+
+                if (this->depth_ == 1) {
+                    this->expect_key_ = true;
+                }
+                break;
+            case '}':
+            case ']':
+                this->depth_--;
+
+                if (this->in_data_ and this->depth_ == 1) {
+                    flush_run(i);
+                    this->emit_element_();
+                    this->in_data_ = false;
+                }
+
+                if (this->depth_ == 0) {
+                    this->end_value_();
+                    this->done_ = true;
+                }
+                break;
+            case ',':
+                if (this->in_data_ and this->depth_ == 2) {
+                    flush_run(i);
+                    this->emit_element_();
+                    run_start = i + 1;
+                } else if (not this->in_data_ and this->depth_ == 1) {
+                    this->end_value_();
+                    this->expect_key_ = true;
+                }
+                break;
+            case ':':
+                if (not this->in_data_ and this->depth_ == 1) {
+                    this->expect_key_ = false;
+                    this->capturing_value_ = true;
+                    this->value_.clear();
+                }
+                break;
+            default:
+                if (this->capturing_value_) {
+                    this->value_ += c;
+                }
+                break;
+        }
+    }
+
+    flush_run(chunk.size());
+}
+
+bool ListStream::has_more() const
+{
+    return this->has_more_;
+}
+
+void ListStream::finish() const
+{
+    if (not this->done_) {
+        throw std::runtime_error("Failed to parse response: The response ended unexpectedly");
+    }
+
+    if (not this->seen_data_) {
+        throw std::runtime_error("Failed to unpack response: Missing 'data' key");
+    }
+}
+
+} // namespace serialization
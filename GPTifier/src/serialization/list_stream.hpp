@@ -0,0 +1,47 @@
+#pragma once
+
+#include <functional>
+#include <json.hpp>
+#include <string>
+#include <string_view>
+
+namespace serialization {
+
+// Scans a list response (i.e. {"object": "list", "data": [...]}) as it arrives from the network and hands
+// each element of the top level "data" array to a callback as soon as the element is complete. Only the
+// element being assembled is ever held in memory, never the whole response
+class ListStream {
+public:
+    using OnElement = std::function<void(const nlohmann::json &element)>;
+
+    explicit ListStream(OnElement on_element);
+
+    void feed(std::string_view chunk);
+
+    // Throws if the response ended early or did not contain a "data" array
+    void finish() const;
+
+    // Whether the listing continues on another page (see "has_more")
+    bool has_more() const;
+
+private:
+    void emit_element_();
+    void end_value_();
+
+    bool capturing_key_ = false;
+    bool capturing_value_ = false;
+    bool done_ = false;
+    bool escaped_ = false;
+    bool expect_key_ = false;
+    bool has_more_ = false;
+    bool in_data_ = false;
+    bool in_string_ = false;
+    bool seen_data_ = false;
+    int depth_ = 0;
+    OnElement on_element_;
+    std::string element_;
+    std::string key_;
+    std::string value_;
+};
+
+} // namespace serialization
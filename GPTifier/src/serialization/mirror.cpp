@@ -0,0 +1,223 @@
+#include "mirror.hpp"
+
+#include "cassette.hpp"
+#include "datadir.hpp"
+#include "utils.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <filesystem>
+#include <fmt/core.h>
+#include <fstream>
+#include <optional>
+#include <stdexcept>
+#include <sys/file.h>
+#include <system_error>
+#include <unistd.h>
+
+namespace serialization {
+
+namespace {
+
+namespace fs = std::filesystem;
+
+const std::time_t FULL_SYNC_INTERVAL_S = 86400;
+
+bool syncing_in_background = false;
+
+fs::path get_mirror_path_(const std::string &name)
+{
+    // Replays get a mirror of their own next to the cassette so that they neither see nor touch the real one
+    if (networking::is_replaying()) {
+        return fs::path(networking::get_replay_path() + ".mirror") / (name + ".json");
+    }
+
+    return datadir::GPT_MIRROR / (name + ".json");
+}
+
+std::optional<Mirror> load_mirror_(const fs::path &path)
+{
+    std::ifstream file(path);
+
+    if (not file.is_open()) {
+        return std::nullopt;
+    }
+
+    try {
+        const nlohmann::json json = nlohmann::json::parse(file);
+
+        Mirror mirror;
+        mirror.data = json.at("data");
+        mirror.etag = json.value("etag", "");
+        mirror.last_modified = json.value("last_modified", "");
+        mirror.full_synced_at = json.value("full_synced_at", std::time_t(0));
+        mirror.synced_at = json.value("synced_at", std::time_t(0));
+        return mirror;
+    } catch (const nlohmann::json::exception &) {
+        // A corrupt mirror is simply synced again from scratch
+        return std::nullopt;
+    }
+}
+
+void save_mirror_(const fs::path &path, const Mirror &mirror)
+{
+    // Laid out like a list response so that the mirror doubles as the --json output
+    const nlohmann::json json = {
+        { "object", "list" },
+        { "data", mirror.data },
+        { "has_more", false },
+        { "etag", mirror.etag },
+        { "last_modified", mirror.last_modified },
+        { "full_synced_at", mirror.full_synced_at },
+        { "synced_at", mirror.synced_at },
+    };
+
+    std::error_code ec;
+    fs::create_directories(path.parent_path(), ec);
+
+    utils::write_file_atomically(path.string(), json.dump());
+}
+
+// Keeps concurrent syncs of the same mirror (i.e. from shell completion firing repeatedly) from racing
+class MirrorLock {
+public:
+    MirrorLock(const fs::path &path, const bool wait)
+    {
+        std::error_code ec;
+        fs::create_directories(path.parent_path(), ec);
+
+        const fs::path lockfile = path.string() + ".lock";
+        this->fd_ = open(lockfile.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+
+        if (this->fd_ == -1) {
+            throw std::runtime_error(fmt::format("Unable to open '{}'", lockfile.string()));
+        }
+
+        this->locked_ = flock(this->fd_, wait ? LOCK_EX : LOCK_EX | LOCK_NB) == 0;
+    }
+
+    ~MirrorLock()
+    {
+        if (this->locked_) {
+            flock(this->fd_, LOCK_UN);
+        }
+
+        close(this->fd_);
+    }
+
+    bool is_locked() const
+    {
+        return this->locked_;
+    }
+
+    MirrorLock(const MirrorLock &) = delete;
+    MirrorLock &operator=(const MirrorLock &) = delete;
+
+private:
+    bool locked_ = false;
+    int fd_ = -1;
+};
+
+void sync_and_save_(const fs::path &path, Mirror &mirror, const SyncMirror &sync)
+{
+    sync(mirror);
+    mirror.synced_at = std::time(nullptr);
+    save_mirror_(path, mirror);
+}
+
+void sync_in_background_(const fs::path &path, const SyncMirror &sync)
+{
+    // Anything still buffered would otherwise be written out by both processes
+    std::fflush(stdout);
+    std::fflush(stderr);
+
+    // If forking fails the mirror is just not refreshed this time around
+    if (fork() != 0) {
+        return;
+    }
+
+    syncing_in_background = true;
+
+    // Detach from the terminal and from any pipe the caller's output is read through
+    setsid();
+    const int devnull = open("/dev/null", O_RDWR);
+
+    if (devnull != -1) {
+        dup2(devnull, STDIN_FILENO);
+        dup2(devnull, STDOUT_FILENO);
+        dup2(devnull, STDERR_FILENO);
+    }
+
+    try {
+        const MirrorLock lock(path, false);
+
+        // Otherwise another process is already syncing
+        if (lock.is_locked()) {
+            Mirror mirror = load_mirror_(path).value_or(Mirror {});
+            sync_and_save_(path, mirror, sync);
+        }
+    } catch (...) {
+        // Nobody is listening. The next foreground sync will report the problem
+    }
+
+    _exit(EXIT_SUCCESS);
+}
+
+} // namespace
+
+Mirror get_mirror(const std::string &name, const MirrorOptions &options, const SyncMirror &sync)
+{
+    const fs::path path = get_mirror_path_(name);
+    const std::optional<Mirror> mirror = load_mirror_(path);
+
+    if (mirror and mirror->synced_at > 0 and options.ttl > 0 and not options.sync) {
+        if (std::time(nullptr) - mirror->synced_at >= options.ttl) {
+            sync_in_background_(path, sync);
+        }
+
+        return mirror.value();
+    }
+
+    const MirrorLock lock(path, true);
+
+    // Another process may have synced while this one was waiting for the lock
+    Mirror latest = load_mirror_(path).value_or(Mirror {});
+    sync_and_save_(path, latest, sync);
+    return latest;
+}
+
+bool is_syncing_in_background()
+{
+    return syncing_in_background;
+}
+
+void edit_mirror(const std::string &name, const std::function<void(Mirror &mirror)> &edit)
+{
+    const fs::path path = get_mirror_path_(name);
+
+    if (not fs::exists(path)) {
+        return;
+    }
+
+    const MirrorLock lock(path, true);
+
+    if (std::optional<Mirror> mirror = load_mirror_(path)) {
+        edit(mirror.value());
+        save_mirror_(path, mirror.value());
+    }
+}
+
+void invalidate_mirror(const std::string &name)
+{
+    edit_mirror(name, [](Mirror &mirror) {
+        mirror.synced_at = 0;
+    });
+}
+
+bool is_full_sync_due(const Mirror &mirror)
+{
+    return std::time(nullptr) - mirror.full_synced_at >= FULL_SYNC_INTERVAL_S;
+}
+
+} // namespace serialization
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <ctime>
+#include <functional>
+#include <json.hpp>
+#include <string>
+
+namespace serialization {
+
+// A local copy of everything a list endpoint returns (i.e. all uploaded files), stored as a compact list
+// response under ~/.gptifier/mirror so that listings can be answered without a round trip
+struct Mirror {
+    nlohmann::json data = nlohmann::json::array();
+    std::string etag;
+    std::string last_modified;
+    std::time_t full_synced_at = 0;
+    std::time_t synced_at = 0;
+};
+
+struct MirrorOptions {
+    // Sync before answering regardless of how old the mirror is
+    bool sync = false;
+
+    // Seconds after which a mirror is refreshed. Zero or less syncs before every answer
+    int ttl = 300;
+};
+
+using SyncMirror = std::function<void(Mirror &mirror)>;
+
+// Return the mirror called `name`. A missing or invalidated mirror is synced with `sync` before returning
+// it. A mirror older than the TTL is returned as is and synced by a detached background process instead,
+// so that the caller answers right away and the next call sees fresher results
+Mirror get_mirror(const std::string &name, const MirrorOptions &options, const SyncMirror &sync);
+
+// True within the detached process that syncs a mirror in the background, where nobody sees any output
+bool is_syncing_in_background();
+
+// Apply a change made through this program (i.e. deleting a file) to the mirror called `name`, if any
+void edit_mirror(const std::string &name, const std::function<void(Mirror &mirror)> &edit);
+
+// Make the next call to get_mirror sync before answering
+void invalidate_mirror(const std::string &name);
+
+// Incremental syncs only pick up additions and changes, so every so often a sync has to start over to
+// notice remote deletions
+bool is_full_sync_due(const Mirror &mirror);
+
+} // namespace serialization
@@ -1,8 +1,10 @@
 #include "models.hpp"
 
 #include "api_openai_user.hpp"
+#include "list_stream.hpp"
 #include "ser_utils.hpp"
 
+#include <ctime>
 #include <fmt/core.h>
 #include <json.hpp>
 #include <stdexcept>
@@ -35,35 +37,76 @@ Model unpack_model_object_(const nlohmann::json &entry)
     return model_object;
 }
 
-Models unpack_models_response_(const std::string &response)
+void sync_models_mirror_(Mirror &mirror)
 {
-    const nlohmann::json json = parse_json(response);
+    networking::Validators validators;
 
-    Models models;
-    models.raw_response = response;
+    if (not mirror.data.empty()) {
+        validators = { mirror.etag, mirror.last_modified };
+    }
 
-    try {
-        for (const auto &entry: json["data"]) {
-            models.models.push_back(unpack_model_object_(entry));
-        }
-    } catch (const nlohmann::json::exception &e) {
-        throw std::runtime_error(fmt::format("Failed to unpack response: {}", e.what()));
+    nlohmann::json data = nlohmann::json::array();
+
+    ListStream stream([&data](const nlohmann::json &entry) {
+        data.push_back(entry);
+    });
+
+    const auto result = networking::get_models([&stream](const std::string_view chunk) {
+        stream.feed(chunk);
+    }, &validators);
+
+    // Not Modified
+    if (not result and result.error().code == 304) {
+        return;
     }
 
-    return models;
+    if (not result) {
+        throw_on_openai_error_response(result.error().response);
+    }
+
+    stream.finish();
+
+    mirror.data = std::move(data);
+    mirror.etag = validators.etag;
+    mirror.last_modified = validators.last_modified;
+    mirror.full_synced_at = std::time(nullptr);
 }
 
 } // namespace
 
-Models get_models()
+Models unpack_models_response(const std::string &response)
 {
-    const auto result = networking::get_models();
+    Models models;
 
-    if (not result) {
-        throw_on_openai_error_response(result.error().response);
+    ListStream stream([&models](const nlohmann::json &entry) {
+        models.models.push_back(unpack_model_object_(entry));
+    });
+
+    stream.feed(response);
+    stream.finish();
+
+    return models;
+}
+
+Models get_mirrored_models(const MirrorOptions &options, const bool keep_raw_response)
+{
+    const Mirror mirror = get_mirror("models", options, sync_models_mirror_);
+
+    Models models;
+
+    try {
+        for (const auto &entry: mirror.data) {
+            models.models.push_back(unpack_model_object_(entry));
+        }
+    } catch (const nlohmann::json::exception &e) {
+        throw std::runtime_error(fmt::format("Failed to unpack mirrored model: {}", e.what()));
+    }
+
+    if (keep_raw_response) {
+        models.raw_response = nlohmann::json({ { "object", "list" }, { "data", mirror.data } }).dump();
     }
 
-    return unpack_models_response_(result->response);
+    return models;
 }
 
 bool delete_model(const std::string &model_id)
@@ -80,6 +123,7 @@ bool delete_model(const std::string &model_id)
         throw std::runtime_error("Malformed response. Missing 'deleted' key");
     }
 
+    invalidate_mirror("models");
     return json["deleted"];
 }
 
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "mirror.hpp"
+
 #include <string>
 #include <vector>
 
@@ -19,11 +21,15 @@ struct Model {
 };
 
 struct Models {
+    // Only kept if requested
     std::string raw_response;
     std::vector<Model> models;
 };
 
-Models get_models();
+// Get models from the local mirror (see mirror.hpp). The mirror is synced with a
+// conditional request so that an unchanged listing is not downloaded again
+Models get_mirrored_models(const MirrorOptions &options, const bool keep_raw_response);
 bool delete_model(const std::string &model_id);
+Models unpack_models_response(const std::string &response);
 
 } // namespace serialization
@@ -5,7 +5,10 @@
 #include "ser_utils.hpp"
 
 #include <algorithm>
+#include <optional>
 #include <stdexcept>
+#include <string_view>
+#include <vector>
 
 namespace serialization {
 
@@ -54,10 +57,8 @@ std::string extract_output_from_response_(const nlohmann::json &json)
     throw std::runtime_error("Some unknown object type was returned from OpenAI");
 }
 
-Response unpack_openai_response_(const std::string &response)
+Response unpack_openai_response_(const nlohmann::json &json)
 {
-    const nlohmann::json json = parse_json(response);
-
     is_valid_openai_response_object_(json);
     Response response_obj;
 
@@ -70,7 +71,90 @@ Response unpack_openai_response_(const std::string &response)
     return response_obj;
 }
 
-Response unpack_ollama_response_(const std::string &response)
+std::vector<std::string> split_lines_(const std::string &text)
+{
+    std::vector<std::string> lines;
+    std::size_t start = 0;
+
+    while (start < text.size()) {
+        std::size_t end = text.find('\n', start);
+
+        if (end == std::string::npos) {
+            end = text.size();
+        }
+
+        if (end > start) {
+            lines.push_back(text.substr(start, end - start));
+        }
+
+        start = end + 1;
+    }
+
+    return lines;
+}
+
+nlohmann::json find_completed_openai_response_(const std::string &stream)
+{
+    // The stream is a sequence of server-sent events where the last one carries the full response object
+    static const std::string prefix = "data: ";
+
+    for (const auto &line: split_lines_(stream)) {
+        if (not line.starts_with(prefix)) {
+            continue;
+        }
+
+        const nlohmann::json event = parse_json(line.substr(prefix.size()));
+        const std::string type = event.value("type", "");
+
+        if (type == "response.completed") {
+            return event["response"];
+        }
+
+        if (type == "error") {
+            throw std::runtime_error(event.value("message", "An error occurred but error message is empty"));
+        }
+
+        if (type == "response.failed") {
+            throw std::runtime_error(event["response"]["error"].value("message", "OpenAI did not complete the transaction"));
+        }
+    }
+
+    throw std::runtime_error("The stream from OpenAI ended before the response was completed");
+}
+
+Response unpack_ollama_stream_(const std::string &stream)
+{
+    // Ollama streams one JSON object per line. All but the last carry a fragment of the output while the
+    // last one carries the usage statistics
+    std::string output;
+
+    for (const auto &line: split_lines_(stream)) {
+        const nlohmann::json json = parse_json(line);
+
+        if (json.contains("error")) {
+            throw std::runtime_error(json["error"]);
+        }
+
+        output += json.value("response", "");
+
+        if (json.value("done", false)) {
+            Response response = unpack_ollama_response(line);
+            response.output = output;
+            return response;
+        }
+    }
+
+    throw std::runtime_error("The stream from Ollama ended before the response was done");
+}
+
+} // namespace
+
+Response unpack_openai_response(const std::string &response)
+{
+    return unpack_openai_response_(parse_json(response));
+}
+
+Response unpack_ollama_response(const std::string &response)
 {
     const nlohmann::json json = parse_json(response);
 
@@ -93,8 +177,6 @@ Response unpack_ollama_response_(const std::string &response)
     return response_obj;
 }
 
-} // namespace
-
 Response create_openai_response(const std::string &input, const std::string &model, const float temperature)
 {
     static float min_temp = 0.00;
@@ -116,7 +198,7 @@ Response create_openai_response(const std::string &input, const std::string &mod
         throw_on_openai_error_response(result.error().response);
     }
 
-    Response response = unpack_openai_response_(result->response);
+    Response response = unpack_openai_response(result->response);
 
     response.input = input;
     response.raw_response = result->response;
@@ -143,7 +225,7 @@ Response create_ollama_response(const std::string &prompt, const std::string &mo
         throw_on_ollama_error_response(result.error().response);
     }
 
-    Response response = unpack_ollama_response_(result->response);
+    Response response = unpack_ollama_response(result->response);
 
     response.input = prompt;
     response.raw_response = result->response;
@@ -153,6 +235,91 @@ Response create_ollama_response(const std::string &prompt, const std::string &mo
     return response;
 }
 
+Response stream_openai_response(const std::string &input, const std::string &model, const float temperature)
+{
+    static float min_temp = 0.00;
+    static float max_temp = 2.00;
+
+    const nlohmann::json data = {
+        { "input", input },
+        { "model", model },
+        { "store", false },
+        { "stream", true },
+        { "temperature", std::clamp(temperature, min_temp, max_temp) },
+    };
+
+    const auto start = std::chrono::high_resolution_clock::now();
+    std::optional<std::chrono::high_resolution_clock::time_point> first_token;
+    std::string head;
+
+    // Events announcing the response arrive before any output, so wait for the first delta
+    const auto on_chunk = [&](const std::string_view chunk) {
+        if (first_token) {
+            return;
+        }
+
+        head.append(chunk);
+
+        if (head.find("response.output_text.delta") != std::string::npos) {
+            first_token = std::chrono::high_resolution_clock::now();
+        }
+    };
+
+    const auto result = networking::stream_openai_response(data.dump(), on_chunk);
+    const auto end = std::chrono::high_resolution_clock::now();
+
+    if (not result) {
+        throw_on_openai_error_response(result.error().response);
+    }
+
+    const nlohmann::json completed = find_completed_openai_response_(result->response);
+    Response response = unpack_openai_response_(completed);
+
+    response.input = input;
+    response.raw_response = completed.dump();
+    response.rtt = end - start;
+    response.ttft = first_token.value_or(end) - start;
+    response.source = "OpenAI";
+
+    return response;
+}
+
+Response stream_ollama_response(const std::string &prompt, const std::string &model)
+{
+    const nlohmann::json data = {
+        { "model", model },
+        { "prompt", prompt },
+        { "stream", true },
+    };
+
+    const auto start = std::chrono::high_resolution_clock::now();
+    std::optional<std::chrono::high_resolution_clock::time_point> first_token;
+
+    // Each chunk carries a token (or more) of output
+    const auto on_chunk = [&](const std::string_view) {
+        if (not first_token) {
+            first_token = std::chrono::high_resolution_clock::now();
+        }
+    };
+
+    const auto result = networking::stream_ollama_response(data.dump(), on_chunk);
+    const auto end = std::chrono::high_resolution_clock::now();
+
+    if (not result) {
+        throw_on_ollama_error_response(result.error().response);
+    }
+
+    Response response = unpack_ollama_stream_(result->response);
+
+    response.input = prompt;
+    response.raw_response = result->response;
+    response.rtt = end - start;
+    response.ttft = first_token.value_or(end) - start;
+    response.source = "Ollama";
+
+    return response;
+}
+
 std::string test_curl_handle_is_reusable()
 {
     static std::string low_cost_model = "gpt-3.5-turbo";
@@ -180,9 +347,9 @@ std::string test_curl_handle_is_reusable()
         throw_on_openai_error_response(result_3.error().response);
     }
 
-    const Response rp_1 = unpack_openai_response_(result_1->response);
-    const Response rp_2 = unpack_openai_response_(result_2->response);
-    const Response rp_3 = unpack_openai_response_(result_3->response);
+    const Response rp_1 = unpack_openai_response(result_1->response);
+    const Response rp_2 = unpack_openai_response(result_2->response);
+    const Response rp_3 = unpack_openai_response(result_3->response);
 
     const nlohmann::json results = {
         { "result_1", rp_1.output },
@@ -7,9 +7,11 @@
 namespace serialization {
 
 struct Response {
+    bool from_cache = false;
     int input_tokens = 0;
     int output_tokens = 0;
     std::chrono::duration<float> rtt;
+    std::chrono::duration<float> ttft;
     std::string created;
     std::string input;
     std::string model;
@@ -20,6 +22,14 @@ struct Response {
 
 Response create_openai_response(const std::string &input, const std::string &model, const float temperature);
 Response create_ollama_response(const std::string &prompt, const std::string &model);
+
+// Like the above but the output is streamed, which allows for measuring the time to the first token (ttft)
+Response stream_openai_response(const std::string &input, const std::string &model, const float temperature);
+Response stream_ollama_response(const std::string &prompt, const std::string &model);
+
+// Parse raw API responses. The functions above call these after the request completes
+Response unpack_openai_response(const std::string &response);
+Response unpack_ollama_response(const std::string &response);
 std::string test_curl_handle_is_reusable();
 
 } // namespace serialization
@@ -1,10 +1,25 @@
 #include "ser_utils.hpp"
 
+#include <algorithm>
+#include <chrono>
 #include <fmt/core.h>
 #include <stdexcept>
+#include <thread>
 
 namespace serialization {
 
+namespace {
+
+const int RETRY_BASE_DELAY_MS = 250;
+const int RETRY_MAX_DELAY_MS = 8000;
+
+bool is_transient_(const long code)
+{
+    return code == 429 or code >= 500;
+}
+
+} // namespace
+
 std::string datetime_from_unix_timestamp(const std::time_t &timestamp)
 {
     const std::tm *datetime = std::gmtime(&timestamp);
@@ -27,6 +42,28 @@ nlohmann::json parse_json(const std::string &response)
     return json;
 }
 
+#ifdef USE_SIMDJSON
+simdjson::ondemand::document iterate_json(const simdjson::padded_string &response)
+{
+    thread_local simdjson::ondemand::parser parser;
+    return parser.iterate(response);
+}
+
+void throw_on_simdjson_error(const simdjson::simdjson_error &e)
+{
+    switch (e.error()) {
+        case simdjson::INCORRECT_TYPE:
+        case simdjson::INDEX_OUT_OF_BOUNDS:
+        case simdjson::NO_SUCH_FIELD:
+        case simdjson::NUMBER_OUT_OF_RANGE:
+        case simdjson::OUT_OF_BOUNDS:
+            throw std::runtime_error(fmt::format("Failed to unpack response: {}", e.what()));
+        default:
+            throw std::runtime_error(fmt::format("Failed to parse response: {}", e.what()));
+    }
+}
+#endif
+
 void throw_on_openai_error_response(const std::string &response)
 {
     const nlohmann::json json = parse_json(response);
@@ -42,6 +79,26 @@ void throw_on_openai_error_response(const std::string &response)
     throw std::runtime_error(json["error"]["message"]);
 }
 
+networking::CurlResult perform_with_retries(const std::function<networking::CurlResult()> &request, const int retries, int &attempts)
+{
+    for (attempts = 1;; ++attempts) {
+        try {
+            const networking::CurlResult result = request();
+
+            if (result or not is_transient_(result.error().code) or attempts > retries) {
+                return result;
+            }
+        } catch (const std::runtime_error &) {
+            if (attempts > retries) {
+                throw;
+            }
+        }
+
+        const int delay_ms = std::min(RETRY_BASE_DELAY_MS << std::min(attempts - 1, 10), RETRY_MAX_DELAY_MS);
+        std::this_thread::sleep_for(std::chrono::milliseconds(delay_ms));
+    }
+}
+
 void throw_on_ollama_error_response(const std::string &response)
 {
     const nlohmann::json json = parse_json(response);
@@ -1,12 +1,34 @@
 #pragma once
 
+#include "curl_base.hpp"
+
 #include <ctime>
+#include <functional>
 #include <json.hpp>
 #include <string>
 
+#ifdef USE_SIMDJSON
+#include <simdjson.h>
+#endif
+
 namespace serialization {
 std::string datetime_from_unix_timestamp(const std::time_t &timestamp);
 nlohmann::json parse_json(const std::string &response);
 void throw_on_openai_error_response(const std::string &response);
 void throw_on_ollama_error_response(const std::string &response);
+
+// Perform a request up to 1 + `retries` times with exponential backoff in between. Only failures that may go
+// away on their own (rate limits, server errors and transport errors) are retried, and transport errors from
+// the last attempt are rethrown. `attempts` is set to the number of attempts made
+networking::CurlResult perform_with_retries(const std::function<networking::CurlResult()> &request, const int retries, int &attempts);
+
+#ifdef USE_SIMDJSON
+// Start parsing a large response on demand, pulling out fields as they are requested rather than building a
+// DOM. Each thread reuses one parser, so a document must be consumed before the next is started
+simdjson::ondemand::document iterate_json(const simdjson::padded_string &response);
+
+// Raise the same errors as the nlohmann/json path. Malformed JSON fails to parse while missing or mistyped
+// fields fail to unpack
+[[noreturn]] void throw_on_simdjson_error(const simdjson::simdjson_error &e);
+#endif
 } // namespace serialization
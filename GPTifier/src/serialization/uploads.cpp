@@ -0,0 +1,356 @@
+#include "uploads.hpp"
+
+#include "api_openai_user.hpp"
+#include "datadir.hpp"
+#include "md5.hpp"
+#include "mirror.hpp"
+#include "parallel.hpp"
+#include "ser_utils.hpp"
+#include "utils.hpp"
+
+#include <algorithm>
+#include <ctime>
+#include <filesystem>
+#include <fmt/core.h>
+#include <fstream>
+#include <json.hpp>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <system_error>
+#include <vector>
+
+namespace serialization {
+
+const std::size_t MULTIPART_THRESHOLD = 64 * 1024 * 1024;
+
+namespace {
+
+namespace fs = std::filesystem;
+
+// Don't resume uploads that are about to expire. OpenAI expires uploads an hour after creation
+const std::time_t EXPIRY_MARGIN_S = 300;
+
+// Single request ---------------------------------------------------------------------------------------------
+
+std::string upload_single_(const std::string &filename, const std::string &purpose)
+{
+    const auto result = networking::upload_file(filename, purpose);
+    if (not result) {
+        throw_on_openai_error_response(result.error().response);
+    }
+
+    const nlohmann::json json = parse_json(result->response);
+
+    if (not json.contains("id")) {
+        throw std::runtime_error("Malformed response. Missing 'id' key");
+    }
+
+    return json["id"];
+}
+
+// Upload state -----------------------------------------------------------------------------------------------
+
+struct UploadedPart {
+    std::string id;
+    std::string md5;
+};
+
+struct UploadState {
+    std::map<int, UploadedPart> parts;
+    std::string upload_id;
+    std::time_t expires_at = 0;
+};
+
+// Parts of a resumed upload are only reused if the file, purpose and part layout are the same as before
+struct UploadKey {
+    std::size_t bytes = 0;
+    std::size_t part_size = 0;
+    std::string filename;
+    std::string purpose;
+};
+
+fs::path get_state_path_(const UploadKey &key)
+{
+    return datadir::GPT_UPLOADS / (utils::hash_content(key.filename) + ".json");
+}
+
+std::optional<UploadState> load_state_(const fs::path &path, const UploadKey &key)
+{
+    std::ifstream file(path);
+
+    if (not file.is_open()) {
+        return std::nullopt;
+    }
+
+    try {
+        const nlohmann::json json = nlohmann::json::parse(file);
+
+        if (json["filename"] != key.filename or json["purpose"] != key.purpose or json["bytes"] != key.bytes or json["part_size"] != key.part_size) {
+            return std::nullopt;
+        }
+
+        UploadState state;
+        state.upload_id = json["upload_id"];
+        state.expires_at = json["expires_at"];
+
+        for (const auto &[index, part]: json["parts"].items()) {
+            state.parts[std::stoi(index)] = { part["id"], part["md5"] };
+        }
+
+        return state;
+    } catch (const std::exception &) {
+        // A corrupt state file just means starting over
+        return std::nullopt;
+    }
+}
+
+void save_state_(const fs::path &path, const UploadKey &key, const UploadState &state)
+{
+    nlohmann::json json;
+    json["filename"] = key.filename;
+    json["purpose"] = key.purpose;
+    json["bytes"] = key.bytes;
+    json["part_size"] = key.part_size;
+    json["upload_id"] = state.upload_id;
+    json["expires_at"] = state.expires_at;
+    json["parts"] = nlohmann::json::object();
+
+    for (const auto &[index, part]: state.parts) {
+        json["parts"][std::to_string(index)] = { { "id", part.id }, { "md5", part.md5 } };
+    }
+
+    std::error_code ec;
+    fs::create_directories(path.parent_path(), ec);
+
+    // A crash never leaves a half written state file behind
+    utils::write_file_atomically(path.string(), json.dump(2));
+}
+
+// Multipart --------------------------------------------------------------------------------------------------
+
+std::string get_mime_type_(const fs::path &filename)
+{
+    static const std::map<std::string, std::string> mime_types = {
+        { ".csv", "text/csv" },
+        { ".json", "application/json" },
+        { ".jsonl", "text/jsonl" },
+        { ".md", "text/markdown" },
+        { ".pdf", "application/pdf" },
+        { ".txt", "text/plain" },
+    };
+
+    const auto it = mime_types.find(filename.extension().string());
+    return it == mime_types.end() ? "application/octet-stream" : it->second;
+}
+
+std::string read_part_(std::ifstream &file, const std::size_t offset, const std::size_t size)
+{
+    std::string data(size, '\0');
+
+    file.seekg(offset);
+    file.read(data.data(), size);
+
+    if (static_cast<std::size_t>(file.gcount()) != size) {
+        throw std::runtime_error("Failed to read file. Did the file change during the upload?");
+    }
+
+    return data;
+}
+
+struct Checksums {
+    std::string file_md5;
+    std::vector<std::string> part_md5s;
+};
+
+Checksums compute_checksums_(const fs::path &filename, const std::size_t bytes, const std::size_t part_size)
+{
+    std::ifstream file(filename, std::ios::binary);
+
+    if (not file.is_open()) {
+        throw std::runtime_error(fmt::format("Unable to open '{}'", filename.string()));
+    }
+
+    Checksums checksums;
+    utils::Md5 file_md5;
+
+    for (std::size_t offset = 0; offset < bytes; offset += part_size) {
+        const std::string data = read_part_(file, offset, std::min(part_size, bytes - offset));
+        file_md5.update(data);
+        checksums.part_md5s.push_back(utils::md5_hex(data));
+    }
+
+    checksums.file_md5 = file_md5.hex_digest();
+    return checksums;
+}
+
+std::string unpack_id_(const std::string &response)
+{
+    const nlohmann::json json = parse_json(response);
+
+    if (not json.contains("id")) {
+        throw std::runtime_error("Malformed response. Missing 'id' key");
+    }
+
+    return json["id"];
+}
+
+UploadState create_upload_(const UploadKey &key, const int retries)
+{
+    nlohmann::json body;
+    body["bytes"] = key.bytes;
+    body["filename"] = fs::path(key.filename).filename().string();
+    body["mime_type"] = get_mime_type_(key.filename);
+    body["purpose"] = key.purpose;
+
+    int attempts = 0;
+    const auto result = perform_with_retries([&body]() {
+        return networking::create_upload(body.dump());
+    }, retries, attempts);
+
+    if (not result) {
+        throw_on_openai_error_response(result.error().response);
+    }
+
+    const nlohmann::json json = parse_json(result->response);
+
+    if (not json.contains("id") or not json.contains("expires_at")) {
+        throw std::runtime_error("Malformed response. Missing 'id' or 'expires_at' key");
+    }
+
+    UploadState state;
+    state.upload_id = json["id"];
+    state.expires_at = json["expires_at"];
+    return state;
+}
+
+std::string complete_upload_(const UploadState &state, const std::string &file_md5, const fs::path &state_path, const int retries)
+{
+    nlohmann::json body;
+    body["md5"] = file_md5;
+    body["part_ids"] = nlohmann::json::array();
+
+    for (const auto &[index, part]: state.parts) {
+        body["part_ids"].push_back(part.id);
+    }
+
+    int attempts = 0;
+    const auto result = perform_with_retries([&state, &body]() {
+        return networking::complete_upload(state.upload_id, body.dump());
+    }, retries, attempts);
+
+    // Whether completed or rejected, the upload cannot be resumed anymore
+    std::error_code ec;
+    fs::remove(state_path, ec);
+
+    if (not result) {
+        throw_on_openai_error_response(result.error().response);
+    }
+
+    const nlohmann::json json = parse_json(result->response);
+
+    if (not json.contains("file") or not json["file"].contains("id")) {
+        throw std::runtime_error("Malformed response. Missing 'file' key");
+    }
+
+    return json["file"]["id"];
+}
+
+std::string upload_multipart_(const UploadKey &key, const UploadOptions &options, const std::function<void(const UploadProgress &)> &on_progress)
+{
+    const Checksums checksums = compute_checksums_(key.filename, key.bytes, key.part_size);
+    const int num_parts = static_cast<int>(checksums.part_md5s.size());
+    const fs::path state_path = get_state_path_(key);
+
+    std::optional<UploadState> state = load_state_(state_path, key);
+
+    if (state and state->expires_at > std::time(nullptr) + EXPIRY_MARGIN_S) {
+        // Parts that changed locally since they were uploaded are uploaded again
+        std::erase_if(state->parts, [&checksums](const auto &item) {
+            return item.first >= static_cast<int>(checksums.part_md5s.size()) or item.second.md5 != checksums.part_md5s[item.first];
+        });
+    } else {
+        state = create_upload_(key, options.retries);
+        save_state_(state_path, key, state.value());
+    }
+
+    UploadProgress progress;
+    progress.multipart = true;
+    progress.num_parts = num_parts;
+    progress.parts_resumed = static_cast<int>(state->parts.size());
+    progress.parts_done = progress.parts_resumed;
+    on_progress(progress);
+
+    std::vector<int> pending;
+
+    for (int i = 0; i < num_parts; ++i) {
+        if (not state->parts.contains(i)) {
+            pending.push_back(i);
+        }
+    }
+
+    std::mutex mutex_state;
+
+    parallel::for_each_index(pending.size(), options.concurrency, [&](const std::size_t i) {
+        const int index = pending[i];
+        const std::size_t offset = static_cast<std::size_t>(index) * key.part_size;
+
+        std::ifstream file(key.filename, std::ios::binary);
+        const std::string data = read_part_(file, offset, std::min(key.part_size, key.bytes - offset));
+        const std::string md5 = utils::md5_hex(data);
+
+        if (md5 != checksums.part_md5s[index]) {
+            throw std::runtime_error(fmt::format("'{}' changed during the upload", key.filename));
+        }
+
+        int attempts = 0;
+        const auto result = perform_with_retries([&]() {
+            return networking::add_upload_part(state->upload_id, data, fmt::format("part={}&md5={}", index, md5));
+        }, options.retries, attempts);
+
+        if (not result) {
+            throw_on_openai_error_response(result.error().response);
+        }
+
+        const std::string part_id = unpack_id_(result->response);
+
+        const std::lock_guard<std::mutex> lock(mutex_state);
+        state->parts[index] = { part_id, md5 };
+        save_state_(state_path, key, state.value());
+
+        progress.parts_done++;
+        on_progress(progress);
+    });
+
+    return complete_upload_(state.value(), checksums.file_md5, state_path, options.retries);
+}
+
+} // namespace
+
+std::string upload_file(const std::string &filename, const UploadOptions &options, const std::function<void(const UploadProgress &)> &on_progress)
+{
+    std::error_code ec;
+    const std::size_t bytes = fs::file_size(filename, ec);
+
+    std::string file_id;
+
+    // Missing files are left to the single request path to report
+    if (ec or (bytes < MULTIPART_THRESHOLD and not options.force_multipart)) {
+        file_id = upload_single_(filename, options.purpose);
+    } else {
+        UploadKey key;
+        key.bytes = bytes;
+        key.part_size = options.part_size;
+        key.filename = fs::absolute(filename).string();
+        key.purpose = options.purpose;
+
+        file_id = upload_multipart_(key, options, on_progress);
+    }
+
+    // So that the new file shows up in the next listing
+    invalidate_mirror("files");
+    return file_id;
+}
+
+} // namespace serialization
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <string>
+
+namespace serialization {
+
+struct UploadOptions {
+    bool force_multipart = false;
+    int concurrency = 4;
+    int retries = 3;
+    std::size_t part_size = 16 * 1024 * 1024;
+    std::string purpose = "fine-tune";
+};
+
+struct UploadProgress {
+    bool multipart = false;
+    int num_parts = 0;
+    int parts_done = 0;
+    int parts_resumed = 0;
+};
+
+// Files at least this large go through the Uploads API
+extern const std::size_t MULTIPART_THRESHOLD;
+
+// Upload a file and return the ID of the resulting file object. Large files are split into parts that are
+// uploaded with up to `concurrency` requests in flight. Progress is saved to the data directory after each
+// part so that an interrupted upload picks up where it left off the next time the same file is uploaded
+std::string upload_file(const std::string &filename, const UploadOptions &options, const std::function<void(const UploadProgress &)> &on_progress);
+
+} // namespace serialization
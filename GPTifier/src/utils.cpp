@@ -1,11 +1,16 @@
 #include "utils.hpp"
 
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <filesystem>
 #include <fmt/core.h>
 #include <fstream>
 #include <sstream>
 #include <stdexcept>
 #include <sys/ioctl.h>
 #include <unistd.h>
+#include <vector>
 
 namespace {
 
@@ -21,6 +26,26 @@ short get_terminal_columns_()
     return 20;
 }
 
+// How estimate_token_count treats each byte. Matches std::isalnum and std::isspace in the C locale, but
+// a table lookup is several times faster than calling into the C library for every byte of a large file
+enum TokenClass : unsigned char { TOKEN_SYMBOL, TOKEN_WORD, TOKEN_SPACE };
+
+constexpr std::array<TokenClass, 256> TOKEN_CLASSES = []() {
+    std::array<TokenClass, 256> classes {};
+
+    for (int c = 0; c < 256; ++c) {
+        if ((c >= '0' and c <= '9') or (c >= 'A' and c <= 'Z') or (c >= 'a' and c <= 'z') or c >= 0x80) {
+            classes[c] = TOKEN_WORD;
+        } else if (c == ' ' or (c >= '\t' and c <= '\r')) {
+            classes[c] = TOKEN_SPACE;
+        } else {
+            classes[c] = TOKEN_SYMBOL;
+        }
+    }
+
+    return classes;
+}();
+
 } // namespace
 
 namespace utils {
@@ -94,6 +119,24 @@ void append_to_file(const std::string &filename, const std::string &text)
     file.close();
 }
 
+// Write to a temporary file then rename it over the original so that readers (including other processes)
+// never see a half written file
+void write_file_atomically(const std::string &filename, const std::string &text)
+{
+    const std::string tempfile = fmt::format("{}.{}.tmp", filename, getpid());
+
+    write_to_file(tempfile, text);
+
+    std::error_code ec;
+    std::filesystem::rename(tempfile, filename, ec);
+
+    if (ec) {
+        const std::string errmsg = fmt::format("Unable to write '{}': {}", filename, ec.message());
+        std::filesystem::remove(tempfile, ec);
+        throw std::runtime_error(errmsg);
+    }
+}
+
 void write_to_png(const std::string &filename, const std::string &binary_data)
 {
     if (filename.empty()) {
@@ -160,4 +203,109 @@ int get_word_count(const std::string &str)
     return count;
 }
 
+std::string base64_encode(const std::string_view data)
+{
+    const char *alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+    int val = 0;
+    int valb = -6;
+    std::string str_encoded;
+
+    for (const unsigned char c: data) {
+        // Only the bits not yet encoded are kept so that long inputs do not overflow
+        val = ((val << 8) + c) & 0xFFFFFF;
+        valb += 8;
+
+        while (valb >= 0) {
+            str_encoded.push_back(alphabet[(val >> valb) & 0x3F]);
+            valb -= 6;
+        }
+    }
+
+    if (valb > -6) {
+        str_encoded.push_back(alphabet[(val << -valb) & 0x3F]);
+    }
+
+    while (str_encoded.size() % 4 != 0) {
+        str_encoded.push_back('=');
+    }
+
+    return str_encoded;
+}
+
+std::string base64_decode(const std::string &str_encoded)
+{
+    std::vector<int> T(256, -1);
+
+    for (int i = 0; i < 64; i++) {
+        T["ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/"[i]] = i;
+    }
+
+    int val = 0;
+    int valb = -8;
+    std::string str_decoded;
+
+    for (unsigned char c: str_encoded) {
+        if (T[c] == -1) {
+            break; // i.e. non-base64 character is found
+        }
+
+        val = (val << 6) + T[c];
+        valb += 6;
+
+        if (valb >= 0) {
+            str_decoded.push_back(char((val >> valb) & 0xFF));
+            valb -= 8;
+        }
+    }
+
+    return str_decoded;
+}
+
+int estimate_token_count(std::string_view str)
+{
+    // There is no tokenizer available offline so approximate one. Runs of alphanumeric characters
+    // cost roughly one token per four characters while punctuation and symbols (common in code)
+    // tend to be tokenized individually. Whitespace is folded into the following token
+    int count = 0;
+    int run_length = 0;
+
+    for (const unsigned char c: str) {
+        const TokenClass token_class = TOKEN_CLASSES[c];
+
+        if (token_class == TOKEN_WORD) {
+            ++run_length;
+            continue;
+        }
+
+        if (run_length > 0) {
+            count += std::max(1, (run_length + 2) / 4);
+            run_length = 0;
+        }
+
+        if (token_class == TOKEN_SYMBOL) {
+            ++count;
+        }
+    }
+
+    if (run_length > 0) {
+        count += std::max(1, (run_length + 2) / 4);
+    }
+
+    return count;
+}
+
+std::string hash_content(std::string_view data)
+{
+    // 64 bit FNV-1a. This is used for change detection only and is not a cryptographic hash
+    std::uint64_t hash = 0xcbf29ce484222325;
+
+    for (const unsigned char c: data) {
+        hash ^= c;
+        hash *= 0x100000001b3;
+    }
+
+    return fmt::format("{:016x}", hash);
+}
+
 } // namespace utils
@@ -2,6 +2,7 @@
 
 #include <fmt/color.h>
 #include <string>
+#include <string_view>
 
 constexpr fmt::terminal_color blue = fmt::terminal_color::bright_blue;
 constexpr fmt::terminal_color green = fmt::terminal_color::bright_green;
@@ -15,8 +16,13 @@ void exit_on_failure();
 std::string read_from_file(const std::string &filename);
 void write_to_file(const std::string &filename, const std::string &text);
 void append_to_file(const std::string &filename, const std::string &text);
+void write_file_atomically(const std::string &filename, const std::string &text);
 void write_to_png(const std::string &filename, const std::string &binary_data);
 float string_to_float(const std::string &str);
 int string_to_int(const std::string &str);
 int get_word_count(const std::string &str);
+std::string base64_encode(std::string_view data);
+std::string base64_decode(const std::string &str_encoded);
+int estimate_token_count(std::string_view str);
+std::string hash_content(std::string_view data);
 } // namespace utils
@@ -0,0 +1,83 @@
+from json import loads
+from tempfile import NamedTemporaryFile, gettempdir
+import pytest
+import utils
+
+
+@pytest.mark.parametrize("option", ["-h", "--help"])
+def test_help(option: str) -> None:
+    stdout = utils.assert_command_success("bench", option)
+    assert "Measure how a backend behaves under load" in stdout
+
+
+@pytest.mark.parametrize(
+    "option, message",
+    [
+        ("--concurrency=0", "Concurrency must be a positive number"),
+        ("--rate=-1", "Rate must not be negative"),
+        ("--duration=0", "Duration must be positive"),
+    ],
+)
+def test_invalid_load(option: str, message: str) -> None:
+    stderr = utils.assert_command_failure("bench", "--use-local", option)
+    assert message in stderr
+
+
+def test_unreachable_url() -> None:
+    # Nothing listens on the discard port so every request fails
+    with NamedTemporaryFile(dir=gettempdir()) as f:
+        stdout = utils.assert_command_success(
+            "bench",
+            "--use-local",
+            "--duration=0.2",
+            "--url=http://127.0.0.1:9",
+            f"-o{f.name}",
+        )
+        assert "Error: " in stdout
+
+        with open(f.name) as g:
+            report = loads(g.read())
+
+        assert report["num_errors"] == report["num_requests"] > 0
+        assert report["latency_ms"]["percentiles"]["p99"] == 0
+
+
+@pytest.mark.test_ollama
+def test_bench_ollama() -> None:
+    with NamedTemporaryFile(dir=gettempdir()) as f:
+        utils.assert_command_success(
+            "bench", "--use-local", "--concurrency=2", "--duration=2", f"-o{f.name}"
+        )
+
+        with open(f.name) as g:
+            report = loads(g.read())
+
+        assert report["source"] == "Ollama"
+        assert report["workload"] == "prompt"
+        assert report["num_errors"] == 0
+        assert report["output_tokens"] > 0
+
+        latency = report["latency_ms"]
+        assert latency["min"] <= latency["percentiles"]["p50"] <= latency["max"]
+        assert latency["percentiles"]["p99"] <= latency["max"]
+
+
+@pytest.mark.test_ollama
+def test_bench_embed_at_rate_ollama() -> None:
+    with NamedTemporaryFile(dir=gettempdir()) as f:
+        utils.assert_command_success(
+            "bench",
+            "--use-local",
+            "--embed",
+            "--rate=10",
+            "--concurrency=4",
+            "--duration=2",
+            f"-o{f.name}",
+        )
+
+        with open(f.name) as g:
+            report = loads(g.read())
+
+        assert report["workload"] == "embed"
+        assert report["rate"] == 10
+        assert report["num_requests"] == 20
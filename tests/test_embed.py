@@ -1,8 +1,8 @@
 from dataclasses import dataclass
 from json import loads
 from pathlib import Path
-from tempfile import gettempdir
-from typing import Generator
+from tempfile import TemporaryDirectory, gettempdir
+from typing import Any, Generator
 import pytest
 import utils
 
@@ -40,6 +40,35 @@ def test_empty_output_file() -> None:
     assert "Output file argument provided with no value" in stderr
 
 
+def test_empty_chunk_size() -> None:
+    stderr = utils.assert_command_failure("embed", "--input=foobar", "--chunk-size=")
+    assert "Cannot convert string to int. Input string is empty" in stderr
+
+
+def test_invalid_chunk_size() -> None:
+    stderr = utils.assert_command_failure("embed", "--input=foobar", "--chunk-size=0")
+    assert "Chunk size must be a positive number of tokens" in stderr
+
+
+def test_overlap_too_large() -> None:
+    stderr = utils.assert_command_failure(
+        "embed", "--input=foobar", "--chunk-size=10", "--overlap=10"
+    )
+    assert (
+        "Chunk overlap must be non-negative and smaller than the chunk size" in stderr
+    )
+
+
+def test_overlap_without_chunk_size() -> None:
+    stderr = utils.assert_command_failure("embed", "--input=foobar", "--overlap=10")
+    assert "Overlap can only be used alongside --chunk-size" in stderr
+
+
+def test_invalid_dimensions() -> None:
+    stderr = utils.assert_command_failure("embed", "--input=foobar", "--dimensions=0")
+    assert "Dimensions must be a positive number" in stderr
+
+
 @pytest.mark.test_openai
 def test_non_existent_model_openai() -> None:
     stderr = utils.assert_command_failure("embed", "-i'What is 3 + 5?'", "-mfoobar")
@@ -166,3 +195,284 @@ def test_get_embedding_ollama_default(embed_test_files: tuple[Path, Path]) -> No
     assert embedding.source == "Ollama"
     assert embedding.text in input_file.read_text()
     assert len(embedding.embedding) > 0
+
+
+@pytest.mark.test_openai
+def test_get_shortened_embedding_openai(embed_test_files: tuple[Path, Path]) -> None:
+    input_file, output_file = embed_test_files
+    utils.assert_command_success(
+        "embed", f"-r{input_file}", "-mtext-embedding-3-small", "-D256", f"-o{output_file}"
+    )
+
+    data = loads(output_file.read_text())
+    assert data["dimensions"] == 256
+    assert len(data["embedding"]) == 256
+
+
+@pytest.mark.test_ollama
+def test_get_shortened_embedding_ollama(embed_test_files: tuple[Path, Path]) -> None:
+    input_file, output_file = embed_test_files
+    utils.assert_command_success(
+        "embed", f"-r{input_file}", "-D4", f"-o{output_file}", "-l"
+    )
+
+    data = loads(output_file.read_text())
+    assert data["dimensions"] == 4
+    assert len(data["embedding"]) == 4
+    assert sum(value * value for value in data["embedding"]) == pytest.approx(1.0)
+
+
+def _load_chunked_embedding(results_file: Path) -> Any:
+    with results_file.open() as f:
+        return loads(f.read())
+
+
+@pytest.mark.test_openai
+def test_get_chunked_embedding_openai(embed_test_files: tuple[Path, Path]) -> None:
+    input_file, output_file = embed_test_files
+    utils.assert_command_success(
+        "embed", f"-r{input_file}", f"-o{output_file}", "--chunk-size=2", "--overlap=0"
+    )
+
+    data = _load_chunked_embedding(output_file)
+    assert data["source"] == "OpenAI"
+    assert len(data["chunks"]) > 1
+
+    text = input_file.read_bytes()
+
+    for chunk in data["chunks"]:
+        offset, length = chunk["offset"], chunk["length"]
+        assert text[offset : offset + length].decode() == chunk["input"]
+        assert len(chunk["embedding"]) > 0
+
+
+@pytest.mark.test_ollama
+def test_get_chunked_embedding_ollama(embed_test_files: tuple[Path, Path]) -> None:
+    input_file, output_file = embed_test_files
+    utils.assert_command_success(
+        "embed", f"-r{input_file}", f"-o{output_file}", "-l", "-c2", "-w0", "-j2"
+    )
+
+    data = _load_chunked_embedding(output_file)
+    assert data["source"] == "Ollama"
+    assert len(data["chunks"]) > 1
+
+    text = input_file.read_bytes()
+
+    for chunk in data["chunks"]:
+        offset, length = chunk["offset"], chunk["length"]
+        assert text[offset : offset + length].decode() == chunk["input"]
+        assert len(chunk["embedding"]) > 0
+
+
+@pytest.mark.parametrize("option", ["-h", "--help"])
+def test_help_ingest(option: str) -> None:
+    stdout = utils.assert_command_success("embed", "ingest", option)
+    assert "Embed every text file under a directory into a persistent store" in stdout
+
+
+def test_ingest_missing_directory() -> None:
+    stderr = utils.assert_command_failure("embed", "ingest")
+    assert "A directory to ingest needs to be provided" in stderr
+
+
+@pytest.mark.parametrize("command", ["ingest", "watch"])
+def test_ingest_extra_directory(command: str) -> None:
+    stderr = utils.assert_command_failure("embed", command, "/tmp", "/var")
+    assert "Unexpected argument '/var'" in stderr
+
+
+def test_ingest_non_existent_directory() -> None:
+    stderr = utils.assert_command_failure(
+        "embed", "ingest", "--store=pytest", "/tmp/yU8nnkRs"
+    )
+    assert "'/tmp/yU8nnkRs' is not a directory" in stderr
+
+
+def test_ingest_invalid_store_name() -> None:
+    stderr = utils.assert_command_failure("embed", "ingest", "--store=a/b", "/tmp")
+    assert "Invalid store name 'a/b'" in stderr
+
+
+def test_ingest_debounce() -> None:
+    stderr = utils.assert_command_failure("embed", "ingest", "--debounce=100", "/tmp")
+    assert "Debounce can only be used alongside the watch command" in stderr
+
+
+def test_ingest_invalid_quantization() -> None:
+    stderr = utils.assert_command_failure("embed", "ingest", "--quantize=foo", "/tmp")
+    assert "Invalid quantization 'foo'" in stderr
+
+
+@pytest.mark.test_ollama
+def test_ingest_incremental_ollama() -> None:
+    with TemporaryDirectory() as tempdir:
+        root = Path(tempdir)
+        (root / "a.txt").write_text("Lorem ipsum dolor sit amet!")
+        (root / "b.txt").write_text("Consectetur adipiscing elit")
+        (root / "skip.log").write_text("Ignored")
+        args = ["embed", "ingest", "-l", "--store=pytest", "-x*.log", tempdir]
+
+        stdout = utils.assert_command_success(*args)
+        assert "Files added: 2 | Updated: 0 | Removed: 0 | Unchanged: 0" in stdout
+
+        (root / "a.txt").write_text("Lorem ipsum dolor sit amet, again!")
+        (root / "b.txt").unlink()
+
+        stdout = utils.assert_command_success(*args)
+        assert "Files added: 0 | Updated: 1 | Removed: 1 | Unchanged: 0" in stdout
+
+
+@pytest.mark.parametrize("option", ["-h", "--help"])
+def test_help_watch(option: str) -> None:
+    stdout = utils.assert_command_success("embed", "watch", option)
+    assert "Keep a persistent store in sync with a directory tree" in stdout
+
+
+def test_watch_missing_directory() -> None:
+    stderr = utils.assert_command_failure("embed", "watch")
+    assert "A directory to ingest needs to be provided" in stderr
+
+
+def test_watch_non_existent_directory() -> None:
+    stderr = utils.assert_command_failure(
+        "embed", "watch", "--store=pytest", "/tmp/yU8nnkRs"
+    )
+    assert "'/tmp/yU8nnkRs' is not a directory" in stderr
+
+
+@pytest.mark.parametrize("option", ["-h", "--help"])
+def test_help_search(option: str) -> None:
+    stdout = utils.assert_command_success("embed", "search", option)
+    assert "Search a persistent store" in stdout
+
+
+def test_search_missing_query() -> None:
+    stderr = utils.assert_command_failure("embed", "search")
+    assert "A query needs to be provided" in stderr
+
+
+def test_search_non_existent_store() -> None:
+    stderr = utils.assert_command_failure("embed", "search", "--store=yU8nnkRs", "foo")
+    assert "Store 'yU8nnkRs' does not exist" in stderr
+
+
+def test_search_invalid_mode() -> None:
+    stderr = utils.assert_command_failure("embed", "search", "--mode=foo", "bar")
+    assert "Invalid search mode 'foo'" in stderr
+
+
+def test_search_negative_rerank() -> None:
+    stderr = utils.assert_command_failure("embed", "search", "--rerank=-1", "bar")
+    assert "Number of matches to re-rank must not be negative" in stderr
+
+
+@pytest.mark.test_ollama
+def test_search_lexical_ollama() -> None:
+    with TemporaryDirectory() as tempdir:
+        root = Path(tempdir)
+        (root / "a.txt").write_text("Lorem ipsum dolor sit amet!")
+        (root / "b.txt").write_text("raise ConnectionRefusedError in dial_upstream")
+
+        utils.assert_command_success("embed", "ingest", "-l", "--store=pytest", tempdir)
+        stdout = utils.assert_command_success(
+            "embed", "search", "--store=pytest", "--mode=lexical", "dial_upstream"
+        )
+
+        assert str(root / "b.txt") in stdout
+        assert str(root / "a.txt") not in stdout
+
+
+@pytest.mark.test_ollama
+@pytest.mark.parametrize("kind", ["int8", "binary", "pq"])
+def test_search_quantized_ollama(kind: str) -> None:
+    with TemporaryDirectory() as tempdir:
+        root = Path(tempdir)
+        (root / "a.txt").write_text("Lorem ipsum dolor sit amet!")
+        (root / "b.txt").write_text("Consectetur adipiscing elit")
+
+        utils.assert_command_success(
+            "embed", "ingest", "-l", "--store=pytest", f"--quantize={kind}", tempdir
+        )
+        stdout = utils.assert_command_success(
+            "embed", "search", "--store=pytest", "--mode=vector", "-k100", "Lorem"
+        )
+
+        assert str(root / "a.txt") in stdout
+        assert str(root / "b.txt") in stdout
+
+
+@pytest.mark.parametrize("option", ["-h", "--help"])
+def test_help_cluster(option: str) -> None:
+    stdout = utils.assert_command_success("embed", "cluster", option)
+    assert "Group the chunks of a persistent store" in stdout
+
+
+def test_cluster_invalid_clusters() -> None:
+    stderr = utils.assert_command_failure("embed", "cluster", "--clusters=0")
+    assert "Number of clusters must be positive" in stderr
+
+
+def test_cluster_non_existent_store() -> None:
+    stderr = utils.assert_command_failure("embed", "cluster", "--store=yU8nnkRs")
+    assert "Store 'yU8nnkRs' does not exist" in stderr
+
+
+@pytest.mark.parametrize("option", ["-h", "--help"])
+def test_help_dedupe(option: str) -> None:
+    stdout = utils.assert_command_success("embed", "dedupe", option)
+    assert "Find groups of near duplicate chunks" in stdout
+
+
+def test_dedupe_non_existent_store() -> None:
+    stderr = utils.assert_command_failure("embed", "dedupe", "--store=yU8nnkRs")
+    assert "Store 'yU8nnkRs' does not exist" in stderr
+
+
+@pytest.mark.test_ollama
+def test_cluster_and_dedupe_ollama() -> None:
+    with TemporaryDirectory() as tempdir:
+        root = Path(tempdir)
+        (root / "a.txt").write_text("Lorem ipsum dolor sit amet!")
+        (root / "b.txt").write_text("Lorem ipsum dolor sit amet!")
+        (root / "c.txt").write_text("Consectetur adipiscing elit")
+        output_file = root / "results.json"
+
+        utils.assert_command_success("embed", "ingest", "-l", "--store=pytest", tempdir)
+        utils.assert_command_success(
+            "embed", "cluster", "--store=pytest", "-k2", f"-o{output_file}"
+        )
+
+        data = loads(output_file.read_text())
+        assert len(data["clusters"]) == 2
+        assert len(data["labels"]) == data["num_chunks"]
+
+        utils.assert_command_success(
+            "embed", "dedupe", "--store=pytest", "-t0.999", f"-o{output_file}"
+        )
+
+        groups = loads(output_file.read_text())["groups"]
+        duplicates = {str(root / "a.txt"), str(root / "b.txt")}
+        assert any(duplicates <= {member["path"] for member in group} for group in groups)
+
+
+@pytest.mark.test_ollama
+def test_cluster_empty_clusters_ollama() -> None:
+    with TemporaryDirectory() as tempdir:
+        root = Path(tempdir)
+
+        # Identical files embed identically, leaving only one distinct vector for two clusters
+        for name in ("a.txt", "b.txt", "c.txt"):
+            (root / name).write_text("Lorem ipsum dolor sit amet!")
+
+        output_file = root / "results.json"
+
+        utils.assert_command_success("embed", "ingest", "-l", "--store=pytest", tempdir)
+        stdout = utils.assert_command_success(
+            "embed", "cluster", "--store=pytest", "-k2", f"-o{output_file}"
+        )
+        assert "(empty)" in stdout
+
+        clusters = loads(output_file.read_text())["clusters"]
+        empty = [cluster for cluster in clusters if cluster["size"] == 0]
+        assert empty == [{"offset": None, "path": None, "representative": None, "size": 0}]
@@ -1,5 +1,7 @@
 from re import search
 from pathlib import Path
+from typing import Any
+import json
 import pytest
 import utils
 
@@ -82,3 +84,299 @@ def test_files_delete_multiple() -> None:
         'Failed to delete file with ID: eggs. The error was: "No such File object: eggs"\n'
         "One or more failures occurred when deleting files\n"
     ) in stderr
+
+
+URL_FILES = "https://api.openai.com/v1/files?order=asc"
+
+
+def make_files(count: int) -> list[dict[str, Any]]:
+    return [
+        {
+            "id": f"file-{i}",
+            "filename": f'odd {{name}}, [{i}] "quoted".jsonl',
+            "created_at": 1704067200 + 86400 * i,  # 2024-01-01 onwards, one per day
+            "purpose": "fine-tune",
+        }
+        for i in range(count)
+    ]
+
+
+def write_cassette(tmp_path: Any, pages: list[tuple[str, dict[str, Any]]], deletes: Any = ()) -> str:
+    # Listings are parsed as they arrive, so split each body at awkward places (i.e. inside strings)
+    interactions = [("GET", url, 200, page) for url, page in pages]
+    interactions.extend(("DELETE", f"https://api.openai.com/v1/files/{id}", status, body) for id, status, body in deletes)
+    return utils.write_cassette(
+        tmp_path, [utils.make_interaction(method, url, status, json.dumps(page), chunk_size=7) for method, url, status, page in interactions]
+    )
+
+
+def test_files_list_replayed_in_chunks(monkeypatch: pytest.MonkeyPatch, tmp_path: Any) -> None:
+    files = make_files(50)
+    page = {"object": "list", "data": files, "has_more": False}
+    cassette = write_cassette(tmp_path, [(f"{URL_FILES}&limit=1000", page)])
+
+    monkeypatch.setenv("GPTIFIER_REPLAY", cassette)
+
+    stdout = utils.assert_command_success("files", "list")
+    assert search(PATTERN, stdout) is not None
+    assert stdout.count("file-") == 50
+    assert 'odd {name}, [49] "quoted".jsonl' in stdout
+
+    stdout = utils.assert_command_success("files", "list", "--json")
+    assert utils.load_stdout_to_json(stdout)["data"] == files
+
+
+def test_files_list_paginated(monkeypatch: pytest.MonkeyPatch, tmp_path: Any) -> None:
+    files = make_files(5)
+    pages = [
+        (f"{URL_FILES}&limit=2", {"object": "list", "data": files[0:2], "has_more": True}),
+        (f"{URL_FILES}&limit=2&after=file-1", {"object": "list", "data": files[2:4], "has_more": True}),
+        (f"{URL_FILES}&limit=2&after=file-3", {"object": "list", "data": files[4:], "has_more": False}),
+    ]
+
+    # Every listing gets a cassette and so a cold mirror of its own, which is synced page by page
+    def replay(name: str) -> None:
+        (tmp_path / name).mkdir()
+        monkeypatch.setenv("GPTIFIER_REPLAY", write_cassette(tmp_path / name, pages))
+
+    replay("plain")
+    stdout = utils.assert_command_success("files", "list", "--page-size=2")
+    assert [line.split()[0] for line in stdout.splitlines()[1:] if line] == [f["id"] for f in files]
+
+    replay("json")
+    stdout = utils.assert_command_success("files", "list", "--page-size=2", "--json")
+    assert utils.load_stdout_to_json(stdout)["data"] == files
+
+    # The whole account is synced into the mirror, but only files in range are listed
+    replay("range")
+    stdout = utils.assert_command_success(
+        "files", "list", "--page-size=2", "--after=2024-01-02", "--before=2024-01-04"
+    )
+    assert [line.split()[0] for line in stdout.splitlines()[1:] if line] == ["file-1", "file-2"]
+
+
+def test_files_delete_selected_paginated(monkeypatch: pytest.MonkeyPatch, tmp_path: Any) -> None:
+    # Selecting files to delete walks the listing itself and stops at the first page past --before. There is
+    # no third page to replay, so asking for it fails the command
+    files = make_files(6)
+    pages = [
+        (f"{URL_FILES}&limit=1000&purpose=fine-tune", {"object": "list", "data": files[0:3], "has_more": True}),
+        (f"{URL_FILES}&limit=1000&after=file-2&purpose=fine-tune", {"object": "list", "data": files[3:], "has_more": True}),
+    ]
+    monkeypatch.setenv("GPTIFIER_REPLAY", write_cassette(tmp_path, pages))
+
+    stdout = utils.assert_command_success("files", "delete", "--purpose=fine-tune", "--before=2024-01-05", "--dry-run")
+    assert [line.split()[0] for line in stdout.splitlines() if line.startswith("file-")] == [f"file-{i}" for i in range(4)]
+    assert "Selected 4 files\n" in stdout
+
+
+def test_files_list_invalid_date() -> None:
+    stderr = utils.assert_command_failure("files", "list", "--after=01/02/2024")
+    assert "Invalid date '01/02/2024'. Expected YYYY-MM-DD" in stderr
+
+
+@pytest.mark.parametrize("page_size", ["0", "10001"])
+def test_files_list_invalid_page_size(page_size: str) -> None:
+    stderr = utils.assert_command_failure("files", "list", f"--page-size={page_size}")
+    assert "Page size must be between 1 and 10000" in stderr
+
+
+def deleted(id: str) -> tuple[str, int, dict[str, Any]]:
+    return (id, 200, {"object": "file", "id": id, "deleted": True})
+
+
+def test_files_delete_selected(monkeypatch: pytest.MonkeyPatch, tmp_path: Any) -> None:
+    files = make_files(6)
+    files[4]["filename"] = "keep.jsonl"
+    page = {"object": "list", "data": files, "has_more": False}
+    url = f"{URL_FILES}&limit=1000&purpose=fine-tune"
+    cassette = write_cassette(tmp_path, [(url, page)], [deleted(f"file-{i}") for i in range(6)])
+
+    monkeypatch.setenv("GPTIFIER_REPLAY", cassette)
+
+    stdout = utils.assert_command_success(
+        "files", "delete", "--name=odd*", "--purpose=fine-tune", "--before=2024-01-06", "--concurrency=3"
+    )
+    assert "Selected 4 files\n" in stdout
+    assert "".join(f"Success! Deleted file with ID: file-{i}\n" for i in [0, 1, 2, 3]) in stdout
+    assert "Deleted 4 of 4 files in" in stdout
+
+    stdout = utils.assert_command_success("files", "delete", "--name=*.jsonl", "--purpose=fine-tune", "--dry-run")
+    assert "Selected 6 files\n" in stdout
+    assert "Success!" not in stdout
+
+
+def test_files_delete_retries(monkeypatch: pytest.MonkeyPatch, tmp_path: Any) -> None:
+    overloaded = {"error": {"message": "The server is overloaded"}}
+    missing = {"error": {"message": "No such File object: file-2"}}
+    deletes = [
+        ("file-1", 503, overloaded),
+        deleted("file-1"),
+        ("file-2", 404, missing),
+        deleted("file-2"),
+        deleted("file-3"),
+    ]
+    monkeypatch.setenv("GPTIFIER_REPLAY", write_cassette(tmp_path, [], deletes))
+
+    stdout = utils.assert_command_success("files", "delete", "--retries=1", "file-1", "file-3")
+    assert "Success! Deleted file with ID: file-1\nSuccess! Deleted file with ID: file-3\n" in stdout
+    assert "(0 failed, 1 retries)" in stdout
+
+    # Errors that will not go away on their own are not retried
+    stderr = utils.assert_command_failure("files", "delete", "--retries=1", "file-2")
+    assert (
+        'Failed to delete file with ID: file-2. The error was: "No such File object: file-2"\n'
+        "One or more failures occurred when deleting files\n"
+    ) in stderr
+
+
+def write_download_cassette(tmp_path: Any, contents: dict[str, bytes], ranges: Any = (), filenames: Any = None) -> str:
+    # Contents are split up to check that they are streamed to disk piece by piece
+    interactions = []
+
+    for id, content in contents.items():
+        file = {"id": id, "object": "file", "bytes": len(content), "created_at": 1704067200, "filename": (filenames or {}).get(id, f"{id}.csv"), "purpose": "fine-tune-results"}
+        interactions.append(utils.make_interaction("GET", f"https://api.openai.com/v1/files/{id}", 200, json.dumps(file), chunk_size=5, request_headers=[]))
+        interactions.append(utils.make_interaction("GET", f"https://api.openai.com/v1/files/{id}/content", 200, content.decode(), chunk_size=5, request_headers=[]))
+
+    for id, offset, status in ranges:
+        url = f"https://api.openai.com/v1/files/{id}/content"
+        interactions.append(utils.make_interaction("GET", url, status, contents[id][offset:].decode(), chunk_size=5, request_headers=[f"Range: bytes={offset}-"]))
+
+    return utils.write_cassette(tmp_path, interactions)
+
+
+def test_files_download(monkeypatch: pytest.MonkeyPatch, tmp_path: Any) -> None:
+    contents = {f"file-{i}": "".join(f"step,{n},0.{n}\n" for n in range(100 * (i + 1))).encode() for i in range(3)}
+    monkeypatch.setenv("GPTIFIER_REPLAY", write_download_cassette(tmp_path, contents))
+
+    output_dir = tmp_path / "out"
+    stdout = utils.assert_command_success("files", "download", f"--output-dir={output_dir}", "--concurrency=2", *contents)
+    assert [line.split()[1] for line in stdout.splitlines()[:3]] == list(contents)
+    assert "Downloaded 3 of 3 files" in stdout
+
+    for id, content in contents.items():
+        assert (output_dir / f"{id}.csv").read_bytes() == content
+        assert not (output_dir / f"{id}.csv.{id}.part").exists()
+
+
+def test_files_download_resumes(monkeypatch: pytest.MonkeyPatch, tmp_path: Any) -> None:
+    content = "".join(f"step,{n},0.{n}\n" for n in range(500)).encode()
+    cassette = write_download_cassette(tmp_path, {"file-0": content}, [("file-0", 1234, 206)])
+    monkeypatch.setenv("GPTIFIER_REPLAY", cassette)
+
+    (tmp_path / "file-0.csv.file-0.part").write_bytes(content[:1234])
+
+    stdout = utils.assert_command_success("files", "download", f"--output-dir={tmp_path}", "file-0")
+    assert ", resumed at 0.00 MiB)" in stdout
+    assert (tmp_path / "file-0.csv").read_bytes() == content
+
+
+def test_files_download_range_not_satisfiable(monkeypatch: pytest.MonkeyPatch, tmp_path: Any) -> None:
+    # A server that cannot serve the range causes the download to start over
+    content = b"a,b\n1,2\n3,4\n"
+    cassette = write_download_cassette(tmp_path, {"file-0": content}, [("file-0", 4, 416)])
+    monkeypatch.setenv("GPTIFIER_REPLAY", cassette)
+
+    (tmp_path / "file-0.csv.file-0.part").write_bytes(b"x,y\n")
+
+    utils.assert_command_success("files", "download", f"--output-dir={tmp_path}", "file-0")
+    assert (tmp_path / "file-0.csv").read_bytes() == content
+
+
+def test_files_download_same_filename(monkeypatch: pytest.MonkeyPatch, tmp_path: Any) -> None:
+    # Every fine-tuning job reports its results as step_metrics.csv
+    contents = {f"file-{i}": "".join(f"step,{n},{i}\n" for n in range(200)).encode() for i in range(3)}
+    filenames = {id: "step_metrics.csv" for id in contents}
+    monkeypatch.setenv("GPTIFIER_REPLAY", write_download_cassette(tmp_path, contents, filenames=filenames))
+
+    # A partial download of another file sharing the name is never resumed
+    (tmp_path / "step_metrics.csv.file-9.part").write_bytes(b"x,y\n")
+
+    stdout = utils.assert_command_success("files", "download", f"--output-dir={tmp_path}", "--concurrency=3", *contents)
+    assert "Downloaded 3 of 3 files" in stdout
+    assert "resumed" not in stdout
+
+    assert (tmp_path / "step_metrics.csv").read_bytes() == contents["file-0"]
+    assert (tmp_path / "step_metrics.file-1.csv").read_bytes() == contents["file-1"]
+    assert (tmp_path / "step_metrics.file-2.csv").read_bytes() == contents["file-2"]
+
+
+def test_files_download_replays_bytes(monkeypatch: pytest.MonkeyPatch, tmp_path: Any) -> None:
+    # Chunks of 5 bytes split the 3 byte euro sign, which only survives if the cassette keeps raw bytes
+    content = "price,5 €\n".encode() * 20 + bytes(range(256))
+    file = {"id": "file-0", "object": "file", "bytes": len(content), "created_at": 1704067200, "filename": "prices.csv", "purpose": "fine-tune-results"}
+    interactions = [
+        utils.make_interaction("GET", "https://api.openai.com/v1/files/file-0", 200, json.dumps(file), request_headers=[]),
+        utils.make_interaction("GET", "https://api.openai.com/v1/files/file-0/content", 200, content, chunk_size=5, request_headers=[]),
+    ]
+    assert any(isinstance(chunk[1], dict) for chunk in interactions[1]["response"]["chunks"])
+    monkeypatch.setenv("GPTIFIER_REPLAY", utils.write_cassette(tmp_path, interactions))
+
+    utils.assert_command_success("files", "download", f"--output-dir={tmp_path}", "file-0")
+    assert (tmp_path / "prices.csv").read_bytes() == content
+
+
+def test_files_download_no_ids() -> None:
+    stderr = utils.assert_command_failure("files", "download")
+    assert "One or more file IDs need to be provided" in stderr
+
+
+def test_files_list_mirror(monkeypatch: pytest.MonkeyPatch, tmp_path: Any) -> None:
+    files = make_files(4)
+    page = {"object": "list", "data": files[:3], "has_more": False}
+    cassette = write_cassette(tmp_path, [(f"{URL_FILES}&limit=1000", page)])
+    monkeypatch.setenv("GPTIFIER_REPLAY", cassette)
+
+    stdout = utils.assert_command_success("files", "list")
+    assert stdout.count("file-") == 3
+
+    # A fresh mirror answers without sending any requests
+    write_cassette(tmp_path, [])
+    stdout = utils.assert_command_success("files", "list", "--json")
+    assert utils.load_stdout_to_json(stdout)["data"] == files[:3]
+
+    # Syncing only asks for files uploaded after the last mirrored file
+    page = {"object": "list", "data": files[3:], "has_more": False}
+    write_cassette(tmp_path, [(f"{URL_FILES}&limit=1000&after=file-2", page)])
+    stdout = utils.assert_command_success("files", "list", "--sync")
+    assert [line.split()[0] for line in stdout.splitlines()[1:] if line] == [f["id"] for f in files]
+
+    # Deleted files are dropped from the mirror
+    write_cassette(tmp_path, [], [deleted("file-1")])
+    utils.assert_command_success("files", "delete", "file-1")
+    stdout = utils.assert_command_success("files", "list")
+    assert "file-1" not in stdout
+    assert stdout.count("file-") == 3
+
+
+def test_files_list_mirror_stale_cursor(monkeypatch: pytest.MonkeyPatch, tmp_path: Any) -> None:
+    files = make_files(3)
+    page = {"object": "list", "data": files[:2], "has_more": False}
+    monkeypatch.setenv("GPTIFIER_REPLAY", write_cassette(tmp_path, [(f"{URL_FILES}&limit=1000", page)]))
+    utils.assert_command_success("files", "list")
+
+    # The last mirrored file was deleted elsewhere, so the sync starts over
+    missing = {"error": {"message": "No such File object: file-1"}}
+    page = {"object": "list", "data": [files[0], files[2]], "has_more": False}
+    interactions = [
+        utils.make_interaction("GET", f"{URL_FILES}&limit=1000&after=file-1", 404, json.dumps(missing)),
+        utils.make_interaction("GET", f"{URL_FILES}&limit=1000", 200, json.dumps(page)),
+    ]
+    utils.write_cassette(tmp_path, interactions)
+    stdout = utils.assert_command_success("files", "list", "--sync")
+    assert [line.split()[0] for line in stdout.splitlines()[1:] if line] == ["file-0", "file-2"]
+
+
+def test_files_list_mirror_sync_error(monkeypatch: pytest.MonkeyPatch, tmp_path: Any) -> None:
+    files = make_files(2)
+    page = {"object": "list", "data": files, "has_more": False}
+    monkeypatch.setenv("GPTIFIER_REPLAY", write_cassette(tmp_path, [(f"{URL_FILES}&limit=1000", page)]))
+    utils.assert_command_success("files", "list")
+
+    # Errors other than a stale cursor are reported rather than answered with a full sync
+    unauthorized = {"error": {"message": "Incorrect API key provided"}}
+    interaction = utils.make_interaction("GET", f"{URL_FILES}&limit=1000&after=file-1", 401, json.dumps(unauthorized))
+    utils.write_cassette(tmp_path, [interaction])
+    stderr = utils.assert_command_failure("files", "list", "--sync")
+    assert "Incorrect API key provided" in stderr
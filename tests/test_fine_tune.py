@@ -1,4 +1,8 @@
 from pathlib import Path
+from time import time
+from typing import Any
+import hashlib
+import json
 import pytest
 import utils
 
@@ -121,3 +125,181 @@ def test_list_jobs_stoi() -> None:
 def test_list_jobs_empty_limit() -> None:
     stderr = utils.assert_command_failure("fine-tune", "list-jobs", "--limit=")
     assert "Limit is empty" in stderr
+
+
+URL_UPLOADS = "https://api.openai.com/v1/uploads"
+MIB = 1024 * 1024
+
+
+def write_upload_cassette(tmp_path: Any, interactions: list[tuple[str, str, str, int, dict[str, Any]]]) -> str:
+    return utils.write_cassette(
+        tmp_path, [utils.make_interaction(method, url, status, json.dumps(response), body=body) for method, url, body, status, response in interactions]
+    )
+
+
+def upload_interactions(path: Path, num_parts: int, part_status: int = 200) -> list[tuple[str, str, str, int, dict[str, Any]]]:
+    data = path.read_bytes()
+    created = {"id": "upload_abc", "object": "upload", "status": "pending", "expires_at": int(time()) + 3600}
+    create = {"bytes": len(data), "filename": path.name, "mime_type": "text/jsonl", "purpose": "fine-tune"}
+    interactions = [("POST", URL_UPLOADS, json.dumps(create, separators=(",", ":")), 200, created)]
+
+    for i in range(num_parts):
+        md5 = hashlib.md5(data[i * MIB : (i + 1) * MIB]).hexdigest()
+        url = f"{URL_UPLOADS}/upload_abc/parts"
+        description = f"part={i}&md5={md5}"
+
+        if i == 1 and part_status != 200:
+            interactions.append(("POST", url, description, part_status, {"error": {"message": "The server is overloaded"}}))
+        else:
+            interactions.append(("POST", url, description, 200, {"id": f"part_{i}"}))
+
+    complete = {"md5": hashlib.md5(data).hexdigest(), "part_ids": [f"part_{i}" for i in range(num_parts)]}
+    completed = {"id": "upload_abc", "status": "completed", "file": {"id": "file-xyz"}}
+    interactions.append(("POST", f"{URL_UPLOADS}/upload_abc/complete", json.dumps(complete, separators=(",", ":")), 200, completed))
+    return interactions
+
+
+def test_upload_multipart_resumes(monkeypatch: pytest.MonkeyPatch, tmp_path: Any) -> None:
+    path = tmp_path / "large.jsonl"
+    path.write_bytes(bytes(range(256)) * (MIB * 3 // 256) + b"tail")
+
+    # Part 1 fails on the first run
+    interactions = upload_interactions(path, 4, part_status=500)
+    monkeypatch.setenv("GPTIFIER_REPLAY", write_upload_cassette(tmp_path, interactions))
+
+    args = ("fine-tune", "upload-file", "--multipart", "--part-size=1", "--retries=0", "--concurrency=1", str(path))
+    stderr = utils.assert_command_failure(*args)
+    assert "The server is overloaded" in stderr
+
+    # The second run must neither create a new upload nor upload part 0 again
+    interactions = upload_interactions(path, 4)[2:]
+    monkeypatch.setenv("GPTIFIER_REPLAY", write_upload_cassette(tmp_path, interactions))
+
+    stdout = utils.assert_command_success(*args)
+    assert "Resuming upload. 1 of 4 parts already uploaded\n" in stdout
+    assert "Uploaded part 4/4\n" in stdout
+    assert stdout.endswith("With ID: file-xyz\n")
+
+
+@pytest.mark.parametrize("option", ["--part-size=0", "--part-size=65", "--concurrency=0", "--retries=-1"])
+def test_upload_invalid_options(option: str) -> None:
+    stderr = utils.assert_command_failure("fine-tune", "upload-file", option, "foo.jsonl")
+    assert "must" in stderr
+
+
+URL_JOBS = "https://api.openai.com/v1/fine_tuning/jobs?limit=100"
+
+
+def make_job(id: str, created_at: int, status: str) -> dict[str, Any]:
+    finished_at = created_at + 600 if status == "succeeded" else None
+    return {"id": id, "created_at": created_at, "status": status, "finished_at": finished_at, "estimated_finish": None}
+
+
+def test_list_jobs_mirror(monkeypatch: pytest.MonkeyPatch, tmp_path: Any) -> None:
+    jobs = [make_job("ftjob-3", 1704067300, "running"), make_job("ftjob-2", 1704067200, "succeeded"), make_job("ftjob-1", 1704067100, "succeeded")]
+    page = {"object": "list", "data": jobs, "has_more": False}
+    monkeypatch.setenv("GPTIFIER_REPLAY", write_upload_cassette(tmp_path, [("GET", URL_JOBS, "", 200, page)]))
+
+    stdout = utils.assert_command_success("fine-tune", "list-jobs", "--limit=2")
+    assert "ftjob-3" in stdout and "ftjob-2" in stdout and "ftjob-1" not in stdout
+
+    # Paging stops at the first finished job once the previously running job has been seen again
+    jobs = [make_job("ftjob-4", 1704067400, "running"), make_job("ftjob-3", 1704067300, "succeeded"), jobs[1]]
+    page = {"object": "list", "data": jobs, "has_more": True}
+    monkeypatch.setenv("GPTIFIER_REPLAY", write_upload_cassette(tmp_path, [("GET", URL_JOBS, "", 200, page)]))
+
+    stdout = utils.assert_command_success("fine-tune", "list-jobs", "--sync", "--json")
+    listing = utils.load_stdout_to_json(stdout)
+    assert [job["id"] for job in listing["data"]] == ["ftjob-4", "ftjob-3", "ftjob-2", "ftjob-1"]
+    assert listing["data"][1]["status"] == "succeeded"
+
+
+def write_dataset(tmp_path: Any, lines: list[str]) -> str:
+    path = tmp_path / "train.jsonl"
+    path.write_text("\n".join(lines) + "\n")
+    return str(path)
+
+
+def make_example(answer: str) -> str:
+    messages = [{"role": "system", "content": "Be terse."}, {"role": "user", "content": "What is 2+2?"}, {"role": "assistant", "content": answer}]
+    return json.dumps({"messages": messages})
+
+
+@pytest.mark.parametrize("option", ["-h", "--help"])
+def test_help_fine_tune_validate(option: str) -> None:
+    stdout = utils.assert_command_success("fine-tune", "validate", option)
+    assert "Check a chat formatted fine-tuning file" in stdout
+
+
+def test_validate_valid_file(tmp_path: Any) -> None:
+    tool_call = {"id": "call_1", "type": "function", "function": {"name": "add", "arguments": "{}"}}
+    calling = {"messages": [{"role": "user", "content": "Add 2 and 2"}, {"role": "assistant", "content": None, "tool_calls": [tool_call]}]}
+    path = write_dataset(tmp_path, [make_example("4"), make_example("Four"), json.dumps(calling)])
+
+    stdout = utils.assert_command_success("fine-tune", "validate", path)
+    assert "Examples:                   3\n" in stdout
+    assert "Invalid lines:              0\n" in stdout
+    assert "Messages:                   8\n" in stdout
+    assert "Default epochs:             25" in stdout
+
+
+@pytest.mark.parametrize(
+    "line, error",
+    [
+        ('{"messages": [{"role": "user", "content": "Hi"', "Invalid JSON"),
+        ('["messages"]', "Example is not a JSON object"),
+        ('{"prompt": "Hi", "completion": "Hello"}', "Missing 'messages' list"),
+        ('{"messages": []}', "'messages' list is empty"),
+        ('{"messages": [{"role": "bot", "content": "Hi"}]}', "messages[0] has unrecognized role 'bot'"),
+        ('{"messages": [{"role": "user", "text": "Hi"}]}', "messages[0] has unrecognized key 'text'"),
+        ('{"messages": [{"role": "user", "content": "Hi"}, {"role": "assistant"}]}', "messages[1] is missing 'content'"),
+        ('{"messages": [{"role": "user", "content": "Hi"}, {"role": "assistant", "content": "Hey", "weight": 2}]}', "messages[1] has 'weight' other than 0 or 1"),
+        ('{"messages": [{"role": "user", "content": "Hi"}]}', "Example has no assistant message"),
+        ("", "Line is empty"),
+    ],
+)
+def test_validate_invalid_line(tmp_path: Any, line: str, error: str) -> None:
+    path = write_dataset(tmp_path, [make_example("4"), line, make_example("4")])
+
+    stderr = utils.assert_command_failure("fine-tune", "validate", path)
+    assert f"Line 2: {error}" in stderr
+    assert "Found 1 invalid lines" in stderr
+
+
+def test_validate_reports_lines_across_threads(tmp_path: Any) -> None:
+    # Large enough to be split into several chunks, with errors in different chunks
+    lines = [make_example("The answer is " + "four " * 50) for _ in range(20000)]
+    lines[0] = lines[9999] = lines[19999] = '{"messages": []}'
+    path = write_dataset(tmp_path, lines)
+
+    stderr = utils.assert_command_failure("fine-tune", "validate", "--jobs=4", "--max-errors=2", path)
+    assert "Line 1: 'messages' list is empty\nLine 10000: 'messages' list is empty\n" in stderr
+    assert "... and 1 more invalid lines" in stderr
+    assert "Found 3 invalid lines" in stderr
+
+
+def test_validate_truncated_examples(tmp_path: Any) -> None:
+    path = write_dataset(tmp_path, [make_example("4"), make_example("four " * 100)])
+
+    stdout = utils.assert_command_success("fine-tune", "validate", "--max-tokens=50", path)
+    assert "Over 50 tokens:             1\n" in stdout
+    assert "will be truncated during training" in stdout
+
+
+@pytest.mark.parametrize("option", ["--jobs=0", "--max-errors=-1", "--max-tokens=0"])
+def test_validate_invalid_options(option: str) -> None:
+    stderr = utils.assert_command_failure("fine-tune", "validate", option, "foo.jsonl")
+    assert "must" in stderr
+
+
+def test_validate_missing_file() -> None:
+    stderr = utils.assert_command_failure("fine-tune", "validate", "foobar.jsonl")
+    assert "Unable to open 'foobar.jsonl'" in stderr
+
+
+def test_validate_empty_file(tmp_path: Any) -> None:
+    path = tmp_path / "train.jsonl"
+    path.write_text("")
+
+    stderr = utils.assert_command_failure("fine-tune", "validate", str(path))
+    assert "Found no examples" in stderr
@@ -1,3 +1,5 @@
+from typing import Any
+import json
 import re
 import pytest
 import utils
@@ -26,3 +28,29 @@ def test_models_user(option: str) -> None:
 def test_models_raw_json(option: str) -> None:
     stdout = utils.assert_command_success("models", option)
     utils.load_stdout_to_json(stdout)
+
+
+def write_models_cassette(tmp_path: Any, status: int, models: list[dict[str, Any]]) -> str:
+    body = json.dumps({"object": "list", "data": models}) if models else ""
+    interaction = utils.make_interaction("GET", "https://api.openai.com/v1/models", status, body, response_headers=['ETag: "abc"'])
+    return utils.write_cassette(tmp_path, [interaction])
+
+
+def test_models_mirror(monkeypatch: pytest.MonkeyPatch, tmp_path: Any) -> None:
+    models = [
+        {"id": "gpt-4o", "object": "model", "created": 1715367049, "owned_by": "system"},
+        {"id": "ft:gpt-4o:acme", "object": "model", "created": 1715367050, "owned_by": "user-abc"},
+    ]
+    monkeypatch.setenv("GPTIFIER_REPLAY", write_models_cassette(tmp_path, 200, models))
+
+    stdout = utils.assert_command_success("models", "--user")
+    assert "ft:gpt-4o:acme" in stdout
+
+    # Not Modified keeps the mirrored listing
+    write_models_cassette(tmp_path, 304, [])
+    stdout = utils.assert_command_success("models", "--sync")
+    assert "gpt-4o" in stdout
+    assert "ft:gpt-4o:acme" not in stdout
+
+    mirror = json.loads((tmp_path / "cassette.jsonl.mirror" / "models.json").read_text())
+    assert mirror["etag"] == '"abc"'
@@ -307,3 +307,55 @@ def test_wrong_endpoint_deep_research() -> None:
 def test_sora_2(model: str) -> None:
     stderr = utils.assert_command_failure("run", f"-p'{DUMMY_PROMPT_2}'", f"-m{model}")
     assert f"Model not found {model}" in stderr
+
+
+def test_context_budget_without_context() -> None:
+    stderr = utils.assert_command_failure(
+        "run", f"-p'{DUMMY_PROMPT_2}'", "--context-budget=100"
+    )
+    assert "can only be used alongside --context-from" in stderr
+
+
+def test_context_from_non_existent_store() -> None:
+    stderr = utils.assert_command_failure(
+        "run", f"-p'{DUMMY_PROMPT_2}'", "--context-from=yU8nnkRs"
+    )
+    assert "Store 'yU8nnkRs' does not exist" in stderr
+
+
+@pytest.mark.parametrize("option", ["--use-local", "--model=gpt-4o"])
+def test_models_with_single_model(option: str) -> None:
+    stderr = utils.assert_command_failure(
+        "run", f"-p'{DUMMY_PROMPT_2}'", "--models=gpt-4o,ollama:gemma3:latest", option
+    )
+    assert "Cannot combine --models with --model or --use-local" in stderr
+
+
+def test_models_empty_entry() -> None:
+    stderr = utils.assert_command_failure(
+        "run", f"-p'{DUMMY_PROMPT_2}'", "--models=gpt-4o,,gpt-4o-mini"
+    )
+    assert "Models must be a comma separated list of model names" in stderr
+
+
+@pytest.mark.test_ollama
+def test_compare_models_ollama() -> None:
+    prompt = "What is 1 + 4? Format the result as follows: >>>{result}<<<"
+
+    with NamedTemporaryFile(dir=gettempdir()) as f:
+        stdout = utils.assert_command_success(
+            "run",
+            f"-p{prompt}",
+            f"-o{f.name}",
+            "--models=ollama:gemma3:latest,ollama:foobar",
+        )
+        assert "TTFT (s)" in stdout
+
+        with open(f.name) as g:
+            results = loads(g.read())["results"]
+
+        assert results[0]["model"] == "gemma3:latest"
+        assert results[0]["source"] == "Ollama"
+        assert ">>>5<<<" in results[0]["output"]
+        assert results[0]["ttft"] <= results[0]["rtt"]
+        assert "not found" in results[1]["error"]
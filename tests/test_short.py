@@ -1,4 +1,5 @@
 from typing import Any
+from uuid import uuid4
 import pytest
 import utils
 
@@ -109,3 +110,98 @@ def test_missing_prompt() -> None:
 def test_empty_prompt() -> None:
     stderr = utils.assert_command_failure("short", "")
     assert "Prompt is empty" in stderr
+
+
+def test_top_k_without_context() -> None:
+    stderr = utils.assert_command_failure("short", "--top-k=3", PROMPT)
+    assert "can only be used alongside --context-from" in stderr
+
+
+@pytest.mark.parametrize(
+    "option, message",
+    [
+        ("--top-k=0", "Top k must be positive"),
+        ("--top-k=-3", "Top k must be positive"),
+        ("--context-budget=-1", "Context budget must be positive"),
+    ],
+)
+def test_invalid_context_options(option: str, message: str) -> None:
+    stderr = utils.assert_command_failure("short", "--context-from=yU8nnkRs", option, PROMPT)
+    assert message in stderr
+
+
+def test_context_from_non_existent_store() -> None:
+    stderr = utils.assert_command_failure("short", "--context-from=yU8nnkRs", PROMPT)
+    assert "Store 'yU8nnkRs' does not exist" in stderr
+
+
+def test_invalid_cache_threshold() -> None:
+    stderr = utils.assert_command_failure("short", "--cache", "--cache-threshold=2", PROMPT)
+    assert "Cache threshold must be greater than 0 and at most 1" in stderr
+
+
+@pytest.mark.test_ollama
+def test_cache_ollama() -> None:
+    # A unique prompt so that the first call is never served from an earlier run
+    prompt = f"{PROMPT} ({uuid4()})"
+
+    first = utils.assert_command_success("short", "-l", "--cache", prompt)
+    second = utils.assert_command_success("short", "-l", "--cache", prompt)
+    assert first == second
+
+
+@pytest.mark.parametrize(
+    "option, message",
+    [
+        ("--hedge-percentile=0", "Hedge percentile must be greater than 0 and at most 100"),
+        ("--hedge-budget=1.5", "Hedge budget must be between 0 and 1"),
+    ],
+)
+def test_invalid_hedge_policy(option: str, message: str) -> None:
+    stderr = utils.assert_command_failure("short", "--hedge", option, PROMPT)
+    assert message in stderr
+
+
+@pytest.mark.test_ollama
+def test_hedge_ollama() -> None:
+    stdout = utils.assert_command_success(
+        "short", "--use-local", f"--model={MODEL_OLLAMA}", "--hedge", PROMPT
+    )
+    assert ">>>4<<<" in stdout
+
+
+@pytest.mark.parametrize("option", ["--use-local", f"--model={MODEL_OLLAMA}"])
+def test_route_with_fixed_backend(option: str) -> None:
+    stderr = utils.assert_command_failure("short", "--route", option, PROMPT)
+    assert "Routing cannot be combined with --use-local or --model" in stderr
+
+
+@pytest.mark.test_ollama
+def test_route_short_prompt_ollama() -> None:
+    # Short prompts are kept local by default
+    stdout = utils.assert_command_success("short", "--route", "--json", PROMPT)
+    assert '"done":true' in stdout.replace(" ", "")
+
+
+def test_replay_missing_cassette(monkeypatch: pytest.MonkeyPatch) -> None:
+    monkeypatch.setenv("GPTIFIER_REPLAY", "/tmp/yU8nnkRs.jsonl")
+    stderr = utils.assert_command_failure("short", "--use-local", PROMPT)
+    assert "Unable to open cassette '/tmp/yU8nnkRs.jsonl'" in stderr
+
+
+@pytest.mark.test_ollama
+def test_record_and_replay_ollama(monkeypatch: pytest.MonkeyPatch, tmp_path: Any) -> None:
+    cassette = str(tmp_path / "cassette.jsonl")
+    prompt = f"{PROMPT} ({uuid4()})"
+
+    monkeypatch.setenv("GPTIFIER_RECORD", cassette)
+    recorded = utils.assert_command_success("short", "--use-local", "--json", prompt)
+
+    monkeypatch.delenv("GPTIFIER_RECORD")
+    monkeypatch.setenv("GPTIFIER_REPLAY", cassette)
+    monkeypatch.setenv("GPTIFIER_REPLAY_LATENCY", "0")
+    replayed = utils.assert_command_success("short", "--use-local", "--json", prompt)
+    assert recorded == replayed
+
+    stderr = utils.assert_command_failure("short", "--use-local", "What is 3 + 3?")
+    assert "No recorded response for POST" in stderr
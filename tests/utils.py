@@ -1,5 +1,6 @@
 from os import environ
-from json import loads
+from base64 import b64encode
+from json import dumps, loads
 from typing import Any
 from subprocess import run, PIPE
 
@@ -22,3 +23,46 @@ def assert_command_failure(*args: str) -> str:
     process = run(command, stdout=PIPE, stderr=PIPE, text=True)
     assert process.returncode == 1
     return process.stderr
+
+
+def encode_chunk(data: str | bytes) -> Any:
+    # Bytes that are not valid UTF-8 on their own (i.e. half a character) are recorded as base64
+    if isinstance(data, str):
+        return data
+
+    try:
+        return data.decode()
+    except UnicodeDecodeError:
+        return {"data_b64": b64encode(data).decode()}
+
+
+def make_interaction(
+    method: str,
+    url: str,
+    status: int,
+    response: str | bytes,
+    body: str = "",
+    chunk_size: int = 0,
+    request_headers: list[str] | None = None,
+    response_headers: list[str] | None = None,
+) -> dict[str, Any]:
+    # A chunk size splits the response up to check that it is handled piece by piece as it arrives
+    pieces = [response[i : i + chunk_size] for i in range(0, len(response), chunk_size)] if chunk_size else [response]
+    chunks = [[0, encode_chunk(piece)] for piece in pieces]
+    request: dict[str, Any] = {"method": method, "url": url, "body": body}
+    reply: dict[str, Any] = {"status": status, "elapsed_ms": 0, "chunks": chunks}
+
+    if request_headers is not None:
+        request["headers"] = request_headers
+
+    if response_headers is not None:
+        reply["headers"] = response_headers
+
+    return {"request": request, "response": reply}
+
+
+def write_cassette(tmp_path: Any, interactions: list[dict[str, Any]]) -> str:
+    # Replayed by setting GPTIFIER_REPLAY to the returned path
+    cassette = tmp_path / "cassette.jsonl"
+    cassette.write_text("".join(dumps(interaction) + "\n" for interaction in interactions))
+    return str(cassette)